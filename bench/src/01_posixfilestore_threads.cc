@@ -0,0 +1,81 @@
+/**
+ * \file
+ * \brief     Multi-threaded random read scaling of PosixFileStore vs FileStore.
+ * \author    Chris Smeele
+ * \copyright Copyright (c) 2016, Chris Smeele
+ * \license   Boost, see LICENSE
+ *
+ * A single FileStore can only be shared between threads with a lock
+ * around every seek() + read() pair, a PosixFileStore can be used by
+ * all threads at once.
+ */
+#include "bench.hh"
+
+#include <filestore.hh>
+#include <posixfilestore.hh>
+
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace MuStore;
+
+static const size_t OPS_PER_THREAD = 200000;
+
+template<typename F>
+static void runThreads(const char *name, size_t threadCount, F readBlock) {
+    std::vector<std::thread> threads;
+    size_t errors = 0;
+    std::mutex errorLock;
+
+    double start = benchNow();
+
+    for (size_t t = 0; t < threadCount; t++) {
+        threads.emplace_back([&, t]() {
+            BenchRandom rng(t + 1);
+            uint8_t buffer[512];
+            size_t threadErrors = 0;
+
+            for (size_t i = 0; i < OPS_PER_THREAD; i++)
+                threadErrors += readBlock(rng.next(), buffer) ? 1 : 0;
+
+            std::lock_guard<std::mutex> lock(errorLock);
+            errors += threadErrors;
+        });
+    }
+    for (auto &thread : threads)
+        thread.join();
+
+    double elapsed = benchNow() - start;
+
+    char label[64];
+    snprintf(label, sizeof(label), "%s, %2lu thread(s)", name, threadCount);
+    benchReport(label, threadCount * OPS_PER_THREAD, threadCount * OPS_PER_THREAD * 512, elapsed);
+
+    if (errors)
+        fprintf(stderr, "%s: %lu read errors\n", label, errors);
+}
+
+int main() {
+    FileStore      fileStore(MUBENCH_FILE, false);
+    PosixFileStore posixStore(MUBENCH_FILE, false);
+    std::mutex     fileLock;
+
+    size_t blockCount = posixStore.getBlockCount();
+    if (!blockCount || fileStore.getBlockCount() != blockCount) {
+        fprintf(stderr, "could not open %s\n", MUBENCH_FILE);
+        return 1;
+    }
+
+    for (size_t threadCount : { 1, 2, 4, 8 }) {
+        runThreads("FileStore (locked)", threadCount, [&](uint64_t r, void *buffer) {
+            std::lock_guard<std::mutex> lock(fileLock);
+            return fileStore.read((size_t)(r % blockCount), buffer);
+        });
+        runThreads("PosixFileStore", threadCount, [&](uint64_t r, void *buffer) {
+            return posixStore.readAt((size_t)(r % blockCount), 1, buffer);
+        });
+    }
+
+    return 0;
+}
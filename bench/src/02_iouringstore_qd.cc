@@ -0,0 +1,121 @@
+/**
+ * \file
+ * \brief     Queue depth sweep of IoUringStore vs FileStore random reads.
+ * \author    Chris Smeele
+ * \copyright Copyright (c) 2016, Chris Smeele
+ * \license   Boost, see LICENSE
+ *
+ * FileStore can only have a single request in flight. IoUringStore
+ * keeps the queue filled to the given depth, submitting a batch of new
+ * requests for every batch of completions it collects.
+ */
+#include "bench.hh"
+
+#include <filestore.hh>
+#include <iouringstore.hh>
+
+#include <vector>
+
+using namespace MuStore;
+
+static const size_t OPS          = 200000;
+static const size_t BLOCKS       = 8; ///< Blocks per request.
+static const size_t REQUEST_SIZE = BLOCKS * 512;
+
+static void runQueueDepth(IoUringStore &store, size_t queueDepth, bool registered) {
+    std::vector<uint8_t> memory(queueDepth * REQUEST_SIZE);
+    std::vector<AsyncStore::Completion> completions(queueDepth);
+
+    void  *buffers[] = { memory.data() };
+    size_t sizes[]   = { memory.size() };
+
+    if (registered && store.registerBuffers(buffers, sizes, 1)) {
+        fprintf(stderr, "could not register buffers\n");
+        return;
+    }
+
+    BenchRandom rng;
+    size_t slots    = store.getBlockCount() / BLOCKS;
+    size_t errors   = 0;
+    size_t submitted = 0;
+    size_t completed = 0;
+
+    double start = benchNow();
+
+    auto submitRead = [&](size_t slot) {
+        uint8_t *buffer = memory.data() + slot * REQUEST_SIZE;
+        if (store.submitRead((size_t)(rng.next() % slots) * BLOCKS, BLOCKS, buffer, (void*)slot))
+            errors++;
+        submitted++;
+    };
+
+    for (size_t i = 0; i < queueDepth && submitted < OPS; i++)
+        submitRead(i);
+
+    while (completed < OPS) {
+        size_t n = store.poll(completions.data(), queueDepth, 1);
+        if (!n)
+            break;
+
+        for (size_t i = 0; i < n; i++) {
+            if (completions[i].err)
+                errors++;
+            if (submitted < OPS)
+                submitRead((size_t)completions[i].cookie);
+        }
+        completed += n;
+    }
+
+    double elapsed = benchNow() - start;
+
+    char label[64];
+    snprintf(label, sizeof(label), "IoUringStore%s, QD %2lu",
+             registered ? " (registered)" : "", queueDepth);
+    benchReport(label, completed, completed * REQUEST_SIZE, elapsed);
+
+    if (errors)
+        fprintf(stderr, "%s: %lu read errors\n", label, errors);
+
+    store.registerBuffers(nullptr, nullptr, 0);
+}
+
+int main() {
+    FileStore fileStore(MUBENCH_FILE, false);
+
+    size_t blockCount = fileStore.getBlockCount();
+    if (!blockCount) {
+        fprintf(stderr, "could not open %s\n", MUBENCH_FILE);
+        return 1;
+    }
+
+    {
+        BenchRandom rng;
+        uint8_t buffer[REQUEST_SIZE];
+        size_t errors = 0;
+
+        double start = benchNow();
+        for (size_t i = 0; i < OPS; i++)
+            errors += fileStore.readBlocks((size_t)(rng.next() % (blockCount / BLOCKS)) * BLOCKS,
+                                           BLOCKS, buffer) ? 1 : 0;
+        double elapsed = benchNow() - start;
+
+        benchReport("FileStore, QD  1", OPS, OPS * REQUEST_SIZE, elapsed);
+        if (errors)
+            fprintf(stderr, "FileStore: %lu read errors\n", errors);
+    }
+
+    for (size_t queueDepth : { 1, 2, 4, 8, 16, 32, 64 }) {
+        IoUringStore store(MUBENCH_FILE, false, queueDepth);
+        if (!store.getBlockCount()) {
+            fprintf(stderr, "could not open %s\n", MUBENCH_FILE);
+            return 1;
+        }
+        if (!store.isNative() && queueDepth == 1)
+            fprintf(stderr, "io_uring not available, using pread() fallback\n");
+
+        runQueueDepth(store, queueDepth, false);
+        runQueueDepth(store, queueDepth, true);
+    }
+
+    return 0;
+}
@@ -0,0 +1,124 @@
+/**
+ * \file
+ * \brief     ScaleStore multi-block forwarding vs per-sub-block looping.
+ * \author    Chris Smeele
+ * \copyright Copyright (c) 2016, Chris Smeele
+ * \license   Boost, see LICENSE
+ *
+ * ScaleStore passes every logical block on as a single multi-block
+ * request. LoopingScaleStore is the previous implementation, which
+ * issued one read() or write() on the underlying store per sub-block.
+ */
+#include "bench.hh"
+
+#include <filestore.hh>
+#include <memstore.hh>
+#include <scalestore.hh>
+
+#include <vector>
+
+using namespace MuStore;
+
+static const size_t OPS = 100000;
+
+/// ScaleStore as it used to be: one underlying request per sub-block.
+class LoopingScaleStore : public Store {
+    Store *store;
+    size_t scale;
+
+public:
+    StoreError seek(size_t lba) {
+        auto err = store->seek(lba * scale);
+        if (!err)
+            pos = lba;
+        return err;
+    }
+
+    StoreError read(void *buffer) {
+        for (size_t i = 0; i < scale; i++) {
+            auto err = store->read((uint8_t*)buffer + i * store->getBlockSize());
+            if (err) {
+                seek(pos);
+                return err;
+            }
+        }
+        pos++;
+        return STORE_ERR_OK;
+    }
+
+    StoreError write(const void *buffer) {
+        for (size_t i = 0; i < scale; i++) {
+            auto err = store->write((const uint8_t*)buffer + i * store->getBlockSize());
+            if (err) {
+                seek(pos);
+                return err;
+            }
+        }
+        pos++;
+        return STORE_ERR_OK;
+    }
+
+    using Store::read;
+    using Store::write;
+
+    LoopingScaleStore(Store *store_, size_t blockSize_)
+        : Store(blockSize_,
+                store_->getBlockCount() / (blockSize_ / store_->getBlockSize()),
+                store_->isWritable()),
+          store(store_),
+          scale(blockSize_ / store_->getBlockSize()) { }
+};
+
+static void runRandom(const char *name, Store &store, bool write) {
+    BenchRandom rng;
+    std::vector<uint8_t> buffer(store.getBlockSize());
+    size_t errors = 0;
+
+    double start = benchNow();
+    for (size_t i = 0; i < OPS; i++) {
+        size_t lba = (size_t)(rng.next() % store.getBlockCount());
+        auto err = write ? store.write(lba, buffer.data())
+                         : store.read (lba, buffer.data());
+        errors += err ? 1 : 0;
+    }
+    double elapsed = benchNow() - start;
+
+    char label[64];
+    snprintf(label, sizeof(label), "%s, random %s", name, write ? "write" : "read");
+    benchReport(label, OPS, OPS * store.getBlockSize(), elapsed);
+
+    if (errors)
+        fprintf(stderr, "%s: %lu errors\n", label, errors);
+}
+
+int main() {
+    FileStore fileStore(MUBENCH_FILE);
+    if (!fileStore.getBlockCount()) {
+        fprintf(stderr, "could not open %s\n", MUBENCH_FILE);
+        return 1;
+    }
+
+    static std::vector<uint8_t> image(64 * 1024 * 1024);
+    MemStore memStore(image.data(), image.size());
+
+    for (size_t blockSize : { 4096, 65536 }) {
+        ScaleStore        fileScaled (&fileStore, blockSize);
+        LoopingScaleStore fileLooping(&fileStore, blockSize);
+        ScaleStore        memScaled  (&memStore,  blockSize);
+        LoopingScaleStore memLooping (&memStore,  blockSize);
+
+        char label[64];
+        for (bool write : { false, true }) {
+            snprintf(label, sizeof(label), "ScaleStore %5lu/FileStore", blockSize);
+            runRandom(label, fileScaled, write);
+            snprintf(label, sizeof(label), "Looping    %5lu/FileStore", blockSize);
+            runRandom(label, fileLooping, write);
+            snprintf(label, sizeof(label), "ScaleStore %5lu/MemStore", blockSize);
+            runRandom(label, memScaled, write);
+            snprintf(label, sizeof(label), "Looping    %5lu/MemStore", blockSize);
+            runRandom(label, memLooping, write);
+        }
+    }
+
+    return 0;
+}
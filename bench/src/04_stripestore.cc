@@ -0,0 +1,84 @@
+/**
+ * \file
+ * \brief     StripeStore sequential read throughput vs member count.
+ * \author    Chris Smeele
+ * \copyright Copyright (c) 2016, Chris Smeele
+ * \license   Boost, see LICENSE
+ *
+ * Each member is a separate DirectFileStore on its own slice of the
+ * benchmark image, standing in for separate files or devices. O_DIRECT
+ * keeps the page cache from turning this into a memcpy benchmark. The
+ * volume is read sequentially in large requests, with members accessed
+ * in parallel and, for comparison, one after another.
+ */
+#include "bench.hh"
+
+#include <partitionstore.hh>
+#include <directfilestore.hh>
+#include <stripestore.hh>
+
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+using namespace MuStore;
+
+static const size_t REQUEST_BLOCKS = 2048; // 1 MiB.
+static const size_t STRIPE_UNIT    = 128;  // 64 KiB.
+static const size_t PASSES         = 2;
+
+static void runSequential(size_t memberCount, bool parallel) {
+    std::vector<std::unique_ptr<DirectFileStore>> files;
+    std::vector<std::unique_ptr<PartitionStore>> slices;
+    std::vector<Store*> members;
+
+    for (size_t i = 0; i < memberCount; i++) {
+        files.emplace_back(new DirectFileStore(MUBENCH_FILE, false));
+        size_t sliceBlocks = files.back()->getBlockCount() / memberCount;
+        slices.emplace_back(new PartitionStore(files.back().get(), i * sliceBlocks, sliceBlocks));
+        members.push_back(slices.back().get());
+    }
+
+    StripeStore stripe(members.data(), members.size(), STRIPE_UNIT, parallel);
+    if (!stripe.getBlockCount()) {
+        fprintf(stderr, "could not open %s\n", MUBENCH_FILE);
+        return;
+    }
+
+    // Aligned, so that O_DIRECT does not need a bounce buffer.
+    size_t size = REQUEST_BLOCKS * stripe.getBlockSize();
+    void  *buffer;
+    if (posix_memalign(&buffer, 4096, size))
+        return;
+
+    size_t requests = stripe.getBlockCount() / REQUEST_BLOCKS;
+    size_t errors   = 0;
+
+    double start = benchNow();
+    for (size_t pass = 0; pass < PASSES; pass++) {
+        for (size_t i = 0; i < requests; i++) {
+            auto err = stripe.readBlocks(i * REQUEST_BLOCKS, REQUEST_BLOCKS, buffer);
+            errors += err ? 1 : 0;
+        }
+    }
+    double elapsed = benchNow() - start;
+
+    char label[64];
+    snprintf(label, sizeof(label), "StripeStore %lu members, %s, seq read",
+             memberCount, parallel ? "parallel" : "serial");
+    benchReport(label, PASSES * requests, PASSES * requests * size, elapsed);
+
+    if (errors)
+        fprintf(stderr, "%s: %lu errors\n", label, errors);
+
+    free(buffer);
+}
+
+int main() {
+    for (size_t memberCount : { 1, 2, 4, 8 }) {
+        runSequential(memberCount, true);
+        runSequential(memberCount, false);
+    }
+
+    return 0;
+}
@@ -0,0 +1,88 @@
+/**
+ * \file
+ * \brief     ChecksumStore verification overhead vs MemStore bandwidth.
+ * \author    Chris Smeele
+ * \copyright Copyright (c) 2016, Chris Smeele
+ * \license   Boost, see LICENSE
+ *
+ * Reads a 64 MiB memory image sequentially through a plain MemStore
+ * and through a ChecksumStore on the same MemStore, and reports the
+ * throughput of both along with raw CRC32C throughput.
+ */
+#include "bench.hh"
+
+#include <checksumstore.hh>
+#include <crc32c.hh>
+#include <memstore.hh>
+
+#include <vector>
+
+using namespace MuStore;
+
+static const size_t IMAGE_SIZE = 64 * 1024 * 1024;
+static const size_t PASSES     = 8;
+
+static double runSequential(const char *name, Store &store, size_t requestBlocks) {
+    std::vector<uint8_t> buffer(requestBlocks * store.getBlockSize());
+    size_t requests = store.getBlockCount() / requestBlocks;
+    size_t errors   = 0;
+
+    double start = benchNow();
+    for (size_t pass = 0; pass < PASSES; pass++) {
+        for (size_t i = 0; i < requests; i++)
+            errors += store.readBlocks(i * requestBlocks, requestBlocks, buffer.data()) ? 1 : 0;
+    }
+    double elapsed = benchNow() - start;
+
+    char label[64];
+    snprintf(label, sizeof(label), "%s, %3lu KiB seq read", name, buffer.size() / 1024);
+    benchReport(label, PASSES * requests, PASSES * requests * buffer.size(), elapsed);
+
+    if (errors)
+        fprintf(stderr, "%s: %lu errors\n", label, errors);
+
+    return elapsed;
+}
+
+static void runCrc(const char *name, uint32_t (*crc)(const void*, size_t, uint32_t), size_t size) {
+    std::vector<uint8_t> buffer(size, 0x5a);
+    size_t   ops    = (256 * 1024 * 1024) / size;
+    uint32_t result = 0;
+
+    double start = benchNow();
+    for (size_t i = 0; i < ops; i++)
+        result ^= crc(buffer.data(), buffer.size(), result);
+    double elapsed = benchNow() - start;
+
+    char label[64];
+    snprintf(label, sizeof(label), "%s, %5lu bytes", name, size);
+    benchReport(label, ops, ops * size, elapsed);
+
+    // Keep the result alive.
+    if (result == 0x12345678)
+        printf("!\n");
+}
+
+int main() {
+    printf("CRC32C hardware acceleration: %s\n", crc32cIsAccelerated() ? "yes" : "no");
+
+    for (size_t size : { 512, 4096 }) {
+        runCrc("crc32c",         crc32c,         size);
+        runCrc("crc32cPortable", crc32cPortable, size);
+    }
+
+    static std::vector<uint8_t> image(IMAGE_SIZE, 0x5a);
+    static std::vector<uint32_t> sums(IMAGE_SIZE / 512);
+
+    MemStore      mem(image.data(), image.size());
+    ChecksumStore checked(&mem, sums.data(), sums.size());
+
+    for (size_t requestBlocks : { 8, 128 }) {
+        double plain    = runSequential("MemStore",      mem,     requestBlocks);
+        double verified = runSequential("ChecksumStore", checked, requestBlocks);
+
+        printf("%-44s %+11.1f%%\n", "verification overhead", 100.0 * (verified - plain) / plain);
+    }
+
+    return 0;
+}
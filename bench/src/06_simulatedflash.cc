@@ -0,0 +1,102 @@
+/**
+ * \file
+ * \brief     FatFs write strategies on a simulated SD card.
+ * \author    Chris Smeele
+ * \copyright Copyright (c) 2016, Chris Smeele
+ * \license   Boost, see LICENSE
+ *
+ * Writes to a one-byte file on a FAT16 image in memory, with the image
+ * behind a SimulatedFlashStore using its default (SD card over SPI)
+ * timing. Reports simulated device time rather than host time, for
+ * different write sizes, with and without a write-back CachedStore,
+ * and for appending (allocating clusters) versus overwriting an
+ * existing file.
+ */
+#include "bench.hh"
+
+#include <cachedstore.hh>
+#include <fatfs.hh>
+#include <filestore.hh>
+#include <memstore.hh>
+#include <simulatedflashstore.hh>
+
+#include <vector>
+
+using namespace MuStore;
+
+static const size_t FILE_SIZE  = 1024 * 1024;
+static const size_t CACHE_SIZE = 64 * 1024;
+
+alignas(512) static uint8_t cacheMemory[CACHE_SIZE];
+
+static std::vector<uint8_t> image;
+
+static void run(const char *name, size_t writeSize, bool cached, bool overwrite) {
+    std::vector<uint8_t> disk(image);
+    MemStore            mem(disk.data(), disk.size());
+    SimulatedFlashStore flash(&mem);
+    CachedStore         cache(&flash, cacheMemory, sizeof(cacheMemory));
+    cache.setWritePolicy(CachedStore::WritePolicy::WRITE_BACK);
+
+    Store *store = cached ? (Store*)&cache : (Store*)&flash;
+    FatFs  fs(store);
+
+    FsError err;
+    FsNode  file = fs.get("/DATA.BIN", err);
+    if (err) {
+        fprintf(stderr, "%s: could not open /DATA.BIN (err=%d)\n", name, err);
+        return;
+    }
+
+    std::vector<uint8_t> buffer(writeSize, 0x5a);
+
+    auto writeFile = [&]() {
+        fs.seek(file, 0);
+        for (size_t done = 0; !err && done < FILE_SIZE; done += writeSize)
+            fs.write(file, buffer.data(), writeSize, err);
+        if (!err && store->flush())
+            err = FS_ERR_IO;
+    };
+
+    if (overwrite) {
+        writeFile();
+        flash.resetStats();
+    }
+
+    uint64_t start = flash.getTime();
+    writeFile();
+    double seconds = (double)(flash.getTime() - start) / 1e9;
+
+    if (err) {
+        fprintf(stderr, "%s: write failed (err=%d)\n", name, err);
+        return;
+    }
+
+    auto &stats = flash.getStats();
+    benchReport(name, FILE_SIZE / writeSize, FILE_SIZE, seconds);
+    printf("    %6lu device writes, %4lu unit programs, %5lu read-modify-writes, max latency %.1f ms\n",
+           stats.writes.count, stats.unitPrograms, stats.unitRmws,
+           (double)(stats.writes.maxTime > stats.flushes.maxTime
+                    ? stats.writes.maxTime : stats.flushes.maxTime) / 1e6);
+}
+
+int main() {
+    FileStore file(MUBENCH_FAT16FILE);
+    image.resize(file.getBlockCount() * file.getBlockSize());
+    if (!image.size() || file.readBlocks(0, file.getBlockCount(), image.data())) {
+        fprintf(stderr, "could not load " MUBENCH_FAT16FILE "\n");
+        return 1;
+    }
+
+    printf("1 MiB file on FAT16, simulated SD card time (not host time)\n");
+
+    run("append,       512 B writes",             512, false, false);
+    run("append,       4 KiB writes",            4096, false, false);
+    run("append,      64 KiB writes",       64 * 1024, false, false);
+    run("append,       512 B writes, cached",     512, true,  false);
+    run("append,       4 KiB writes, cached",    4096, true,  false);
+    run("overwrite,    4 KiB writes",            4096, false, true);
+    run("overwrite,    4 KiB writes, cached",    4096, true,  true);
+
+    return 0;
+}
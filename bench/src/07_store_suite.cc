@@ -0,0 +1,158 @@
+/**
+ * \file
+ * \brief     Store-layer baseline: throughput and latency of the basic stores.
+ * \author    Chris Smeele
+ * \copyright Copyright (c) 2016, Chris Smeele
+ * \license   Boost, see LICENSE
+ *
+ * Measures sequential and random reads and writes, of single blocks
+ * and of multi-block requests, on MemStore, FileStore and ScaleStore
+ * (scaling a MemStore up and down) at several block sizes. Reports
+ * throughput and per-request latency percentiles, and writes all
+ * results as JSON to MUBENCH_JSON (or the path given as the first
+ * argument), to compare backend changes against.
+ *
+ * Every request is timed individually, so the timer overhead (tens of
+ * nanoseconds) is included in both latency and throughput.
+ */
+#include "bench.hh"
+
+#include <filestore.hh>
+#include <memstore.hh>
+#include <scalestore.hh>
+
+#include <vector>
+
+using namespace MuStore;
+
+static const size_t IMAGE_SIZE    = 64 * 1024 * 1024;
+static const size_t MULTI_BLOCKS  = 16;
+static const double RUN_TIME      = 0.15;
+static const size_t MAX_REQUESTS  = 1000000;
+
+struct Suite {
+    FILE *json;
+    bool  first = true;
+};
+
+static void run(Suite &suite, const char *storeName, Store &store,
+                bool random, bool write, size_t requestBlocks) {
+    size_t blockSize = store.getBlockSize();
+    size_t slots     = store.getBlockCount() / requestBlocks;
+
+    std::vector<uint8_t> buffer(requestBlocks * blockSize, 0x5a);
+
+    BenchRandom  rng;
+    BenchLatency latency;
+    size_t       requests = 0;
+    size_t       errors   = 0;
+
+    double start = benchNow();
+    double now   = start;
+
+    while (now - start < RUN_TIME && requests < MAX_REQUESTS) {
+        size_t lba = (random ? rng.next() % slots : requests % slots) * requestBlocks;
+
+        double begin = now;
+        StoreError err = write
+                       ? store.writeBlocks(lba, requestBlocks, buffer.data())
+                       : store.readBlocks (lba, requestBlocks, buffer.data());
+        now = benchNow();
+
+        latency.add(now - begin);
+        errors += err ? 1 : 0;
+        requests++;
+    }
+
+    double elapsed = now - start;
+    size_t bytes   = requests * buffer.size();
+
+    const char *pattern = random ? "random" : "sequential";
+    const char *op      = write  ? "write"  : "read";
+
+    printf("%-26s %5lu %-10s %-5s %2lu blk %11.0f ops/s %9.1f MiB/s"
+           "  p50 %7.2f  p99 %7.2f  p99.9 %8.2f us\n",
+           storeName, blockSize, pattern, op, requestBlocks,
+           requests / elapsed, bytes / elapsed / (1024 * 1024),
+           latency.percentile(50) * 1e6, latency.percentile(99) * 1e6,
+           latency.percentile(99.9) * 1e6);
+
+    if (errors)
+        fprintf(stderr, "%s: %lu errors\n", storeName, errors);
+
+    if (!suite.json)
+        return;
+
+    fprintf(suite.json,
+            "%s\n    {\"store\": \"%s\", \"block_size\": %lu, \"pattern\": \"%s\", \"op\": \"%s\","
+            " \"request_blocks\": %lu, \"requests\": %lu, \"errors\": %lu, \"seconds\": %.6f,"
+            " \"ops_per_sec\": %.1f, \"mib_per_sec\": %.3f,"
+            " \"latency_us\": {\"p50\": %.3f, \"p90\": %.3f, \"p99\": %.3f, \"p999\": %.3f, \"max\": %.3f}}",
+            suite.first ? "" : ",",
+            storeName, blockSize, pattern, op,
+            requestBlocks, requests, errors, elapsed,
+            requests / elapsed, bytes / elapsed / (1024 * 1024),
+            latency.percentile(50)   * 1e6, latency.percentile(90)   * 1e6,
+            latency.percentile(99)   * 1e6, latency.percentile(99.9) * 1e6,
+            latency.percentile(100)  * 1e6);
+    suite.first = false;
+}
+
+static void runAll(Suite &suite, const char *storeName, Store &store) {
+    if (!store.getBlockCount()) {
+        fprintf(stderr, "%s: could not open store\n", storeName);
+        return;
+    }
+
+    for (bool random : { false, true }) {
+        for (size_t requestBlocks : { (size_t)1, MULTI_BLOCKS }) {
+            for (bool write : { false, true })
+                run(suite, storeName, store, random, write, requestBlocks);
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    const char *jsonPath = argc > 1 ? argv[1] : MUBENCH_JSON;
+
+    Suite suite;
+    suite.json = fopen(jsonPath, "w");
+    if (!suite.json)
+        fprintf(stderr, "could not open %s, not writing JSON\n", jsonPath);
+    else
+        fprintf(suite.json, "{\n  \"suite\": \"store\",\n  \"image_size\": %lu,\n  \"results\": [",
+                IMAGE_SIZE);
+
+    static std::vector<uint8_t> image(IMAGE_SIZE, 0xa5);
+
+    for (size_t blockSize : { 512, 4096, 65536 }) {
+        MemStore mem(image.data(), image.size(), blockSize);
+        runAll(suite, "MemStore", mem);
+    }
+
+    for (size_t blockSize : { 512, 4096, 65536 }) {
+        FileStore file(MUBENCH_FILE, true, blockSize);
+        runAll(suite, "FileStore", file);
+    }
+
+    MemStore mem512(image.data(), image.size(), 512);
+    for (size_t blockSize : { 4096, 65536 }) {
+        ScaleStore up(&mem512, blockSize);
+        runAll(suite, "ScaleStore/MemStore 512", up);
+    }
+
+    {
+        MemStore   mem4096(image.data(), image.size(), 4096);
+        std::vector<uint8_t> scaleBuffer(4096);
+        ScaleStore down(&mem4096, 512, scaleBuffer.data());
+        runAll(suite, "ScaleStore/MemStore 4096", down);
+    }
+
+    if (suite.json) {
+        fprintf(suite.json, "\n  ]\n}\n");
+        fclose(suite.json);
+        printf("\nResults written to %s\n", jsonPath);
+    }
+
+    return 0;
+}
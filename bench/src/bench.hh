@@ -0,0 +1,68 @@
+/**
+ * \file
+ * \brief     Benchmark helpers.
+ * \author    Chris Smeele
+ * \copyright Copyright (c) 2016, Chris Smeele
+ * \license   Boost, see LICENSE
+ */
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+/// Get a monotonic timestamp in seconds.
+inline double benchNow() {
+    return std::chrono::duration<double>(
+        std::chrono::steady_clock::now().time_since_epoch()
+    ).count();
+}
+
+/// A small, fast PRNG so that generating LBAs does not dominate the measurements.
+struct BenchRandom {
+    uint64_t state;
+
+    uint64_t next() {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return state;
+    }
+
+    BenchRandom(uint64_t seed = 0x2545f4914f6cdd1dULL)
+        : state(seed ? seed : 1) { }
+};
+
+/// Print a single result line.
+inline void benchReport(const char *name, size_t ops, size_t bytes, double seconds) {
+    printf("%-44s %12.0f ops/s %10.1f MiB/s\n",
+           name,
+           ops / seconds,
+           bytes / seconds / (1024 * 1024));
+}
+
+/// Per-operation latency samples, in seconds.
+struct BenchLatency {
+    std::vector<double> samples;
+    bool sorted = true;
+
+    void add(double seconds) {
+        samples.push_back(seconds);
+        sorted = false;
+    }
+
+    /// Get a percentile (0 to 100) of the samples, nearest rank.
+    double percentile(double p) {
+        if (samples.empty())
+            return 0;
+        if (!sorted) {
+            std::sort(samples.begin(), samples.end());
+            sorted = true;
+        }
+
+        size_t i = (size_t)(p / 100 * (double)samples.size());
+        return samples[std::min(i, samples.size() - 1)];
+    }
+};
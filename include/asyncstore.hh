@@ -0,0 +1,89 @@
+/**
+ * \file
+ * \brief     AsyncStore header.
+ * \author    Chris Smeele
+ * \copyright Copyright (c) 2016, Chris Smeele
+ *
+ * Distributed under the Boost Software License, Version 1.0.
+ * See accompanying file LICENSE or copy at
+ * http://www.boost.org/LICENSE_1_0.txt
+ */
+#pragma once
+
+#include "store.hh"
+
+namespace MuStore {
+
+/**
+ * \brief Asynchronous block storage interface.
+ *
+ * Requests are submitted with submitRead() and submitWrite(), which
+ * return as soon as the request has been queued. Completed requests
+ * are collected with poll(), and are identified by the cookie that was
+ * passed on submission.
+ *
+ * Requests may complete in any order. Buffers must remain valid and
+ * must not be touched by the caller until the request has completed.
+ *
+ * ThreadPoolStore implements this interface for any Store, backends
+ * that have native asynchronous I/O can implement it directly.
+ */
+class AsyncStore {
+
+public:
+    /// A completed request.
+    struct Completion {
+        void      *cookie; ///< The cookie passed on submission.
+        StoreError err;    ///< The result of the request.
+    };
+
+    /**
+     * \brief Queue a read of `count` blocks starting at `lba`.
+     *
+     * \param lba the first block to read
+     * \param count the amount of blocks to read
+     * \param buffer the destination buffer
+     * \param cookie an arbitrary value that identifies the completion
+     *
+     * \retval STORE_ERR_OK when the request was queued
+     * \retval STORE_ERR_OUT_OF_BOUNDS when the range exceeds the medium size
+     * \retval STORE_ERR_IO for other backend errors
+     */
+    virtual StoreError submitRead (size_t lba, size_t count, void *buffer, void *cookie) = 0;
+
+    /**
+     * \brief Queue a write of `count` blocks starting at `lba`.
+     *
+     * \param lba the first block to write
+     * \param count the amount of blocks to write
+     * \param buffer the source buffer
+     * \param cookie an arbitrary value that identifies the completion
+     *
+     * \retval STORE_ERR_OK when the request was queued
+     * \retval STORE_ERR_NOT_WRITABLE when the medium is read-only
+     * \retval STORE_ERR_OUT_OF_BOUNDS when the range exceeds the medium size
+     * \retval STORE_ERR_IO for other backend errors
+     */
+    virtual StoreError submitWrite(size_t lba, size_t count, const void *buffer, void *cookie) = 0;
+
+    /**
+     * \brief Collect completed requests.
+     *
+     * Waits until at least `min` requests have completed, or until no
+     * requests are outstanding anymore.
+     *
+     * \param completions array that receives the completions
+     * \param max the maximum amount of completions to return
+     * \param min the amount of completions to wait for, 0 to return immediately
+     *
+     * \return the amount of completions stored in `completions`
+     */
+    virtual size_t poll(Completion *completions, size_t max, size_t min = 0) = 0;
+
+    /// Get the amount of submitted requests that have not been returned by poll() yet.
+    virtual size_t getOutstanding() const = 0;
+
+    virtual ~AsyncStore() = default;
+};
+
+}
@@ -0,0 +1,231 @@
+/**
+ * \file
+ * \brief     CachedStore header.
+ * \author    Chris Smeele
+ * \copyright Copyright (c) 2016, Chris Smeele
+ *
+ * Distributed under the Boost Software License, Version 1.0.
+ * See accompanying file LICENSE or copy at
+ * http://www.boost.org/LICENSE_1_0.txt
+ */
+#pragma once
+
+#include "store.hh"
+
+namespace MuStore {
+
+/**
+ * \brief Store decorator for block caching.
+ *
+ * This keeps recently used blocks of the underlying store in a
+ * set-associative cache. The cache lives in a caller-provided memory
+ * region, see getMemorySize().
+ *
+ * Within a set, lines are replaced by an aging frequency count, which
+ * makes the cache resistant to scans:
+ *
+ * - Blocks that are hit again gain priority, up to a maximum.
+ * - Blocks read sequentially, or as part of a small multi-block read,
+ *   enter the cache with the lowest priority. They are the first to
+ *   be replaced, and replacing them does not age other lines.
+ * - Multi-block reads larger than a configurable threshold bypass
+ *   the cache entirely.
+ *
+ * This way, frequently used blocks (e.g. FAT sectors and directory
+ * entries) survive large sequential reads.
+ *
+ * Two write policies are available, see setWritePolicy():
+ *
+ * - WritePolicy::WRITE_THROUGH (default): Writes are passed through to
+ *   the underlying store immediately, and update blocks that are
+ *   already cached.
+ * - WritePolicy::WRITE_BACK: Written blocks are kept in the cache and
+ *   marked dirty. Repeated writes to the same block only update the
+ *   cached copy. Dirty blocks are written back in LBA order on
+ *   flush(), when the amount of dirty data reaches a configurable
+ *   threshold, or one by one when they are replaced. Multi-block
+ *   writes larger than the scan threshold are passed through.
+ *
+ * \warning In write-back mode, written data is not on the underlying
+ *          store until it is flushed. Dirty blocks are written back
+ *          on destruction, but errors are lost at that point: call
+ *          flush() before destroying the cache.
+ */
+class CachedStore : public Store {
+
+public:
+    /// Cache statistics.
+    struct Stats {
+        size_t hits;       ///< Blocks served from the cache.
+        size_t misses;     ///< Blocks read from the underlying store.
+        size_t evictions;  ///< Cached blocks replaced to make room for others.
+        size_t writebacks; ///< Dirty blocks written to the underlying store.
+    };
+
+    /// How writes are handled, see setWritePolicy().
+    enum class WritePolicy {
+        WRITE_THROUGH = 0, ///< Write to the underlying store immediately.
+        WRITE_BACK,        ///< Write to the underlying store on flush or replacement.
+    };
+
+private:
+    /// Cache line metadata.
+    struct Line {
+        size_t  lba;   ///< The cached block number.
+        bool    valid; ///< Whether this line holds a block.
+        bool    dirty; ///< Whether this line was modified since it was last written back.
+        uint8_t refs;  ///< Replacement priority, see MAX_REFS.
+    };
+
+    /// Maximum replacement priority of a cache line.
+    static const uint8_t MAX_REFS = 3;
+
+    /// The store we pass calls to.
+    Store *store;
+
+    Line    *lines; ///< Line metadata, `lineCount` entries.
+    uint8_t *data;  ///< Line data, `lineCount` blocks.
+    Line   **order; ///< Scratch space for sorting dirty lines, `lineCount` entries.
+
+    size_t lineCount;
+    size_t ways;     ///< Lines per set.
+    size_t setCount;
+
+    /// Multi-block reads larger than this amount of blocks bypass the cache.
+    size_t scanThreshold;
+
+    /// The most recently accessed block, used to detect sequential access.
+    size_t lastLba;
+
+    WritePolicy writePolicy;
+    size_t      maxDirtyBytes; ///< Write-back threshold, 0 for none.
+    size_t      dirtyCount;    ///< Amount of dirty lines.
+
+    Stats stats;
+
+    uint8_t *lineData(const Line *line) const {
+        return data + (size_t)(line - lines) * blockSize;
+    }
+
+    /// Find the line holding the given block, `nullptr` if not cached.
+    Line *lookup(size_t lba);
+
+    /**
+     * \brief Pick a line to hold the given block, replacing a block in its set if needed.
+     *
+     * \return the allocated line, or `nullptr` if the replaced block
+     *         is dirty and could not be written back
+     */
+    Line *allocate(size_t lba, uint8_t refs);
+
+    /// Write a single dirty line to the underlying store.
+    StoreError writeBackLine(Line *line);
+
+    /// Write all dirty lines to the underlying store, in LBA order.
+    StoreError writeBack();
+
+    /// Drop cached copies of a range of blocks, including dirty ones.
+    void drop(size_t lba, size_t count);
+
+    /// Read a single block through the cache.
+    StoreError readCached(size_t lba, void *buffer);
+
+    /// Update cached copies of blocks written to the underlying store.
+    void updateCached(size_t lba, size_t count, const void *buffer);
+
+    /// Write a single block into the cache, marking it dirty.
+    StoreError writeCached(size_t lba, const void *buffer);
+
+public:
+    StoreError seek(size_t lba);
+
+    StoreError read (void *buffer);
+    StoreError write(const void *buffer);
+
+    StoreError readBlocks (size_t lba, size_t count, void *buffer);
+    StoreError writeBlocks(size_t lba, size_t count, const void *buffer);
+
+    /// Drop cached copies of the blocks, dirty or not, then pass the discard on.
+    StoreError discard(size_t lba, size_t count);
+
+    using Store::read;
+    using Store::write;
+
+    /// Write back dirty blocks, then flush the underlying store.
+    StoreError flush();
+
+    /**
+     * \brief Set the write policy.
+     *
+     * Switching to WritePolicy::WRITE_THROUGH writes back all dirty blocks.
+     *
+     * \param policy the new write policy
+     * \param maxDirtyBytes_ in write-back mode, write back all dirty
+     *        blocks when they amount to at least this many bytes. 0
+     *        means dirty blocks are only written back on flush() or
+     *        replacement
+     *
+     * \retval STORE_ERR_OK
+     * \retval STORE_ERR_IO (or any other error) when writing back dirty blocks failed
+     */
+    StoreError setWritePolicy(WritePolicy policy, size_t maxDirtyBytes_ = 0);
+
+    /// Get the current write policy.
+    WritePolicy getWritePolicy() const { return writePolicy; }
+
+    /// Get the amount of bytes written to the cache but not yet to the underlying store.
+    size_t getDirtyBytes() const { return dirtyCount * blockSize; }
+
+    /// Get the amount of blocks the cache can hold.
+    size_t getLineCount() const { return lineCount; }
+
+    /// Get cache statistics.
+    const Stats &getStats() const { return stats; }
+
+    /// Reset cache statistics.
+    void resetStats() { stats = Stats(); }
+
+    /**
+     * \brief Drop all cached blocks, e.g. after the underlying store was modified directly.
+     *
+     * \warning This discards dirty blocks, call flush() first.
+     */
+    void invalidate();
+
+    /**
+     * \brief Get the memory size needed for a cache of the given amount of blocks.
+     *
+     * \param blockSize the block size of the store that will be cached
+     * \param lineCount the amount of blocks to cache
+     */
+    static size_t getMemorySize(size_t blockSize, size_t lineCount);
+
+    /**
+     * \brief CachedStore constructor.
+     *
+     * The amount of cached blocks is derived from the memory size,
+     * rounded down to a multiple of `ways`.
+     *
+     * \param store_ the store to cache
+     * \param memory the memory region used for the cache. Should be aligned to the block size
+     * \param size the size of the memory region in bytes
+     * \param ways_ the amount of lines per cache set
+     * \param scanThreshold_ multi-block reads of more than this amount of blocks bypass the cache
+     */
+    CachedStore(Store *store_,
+                void *memory,
+                size_t size,
+                size_t ways_ = 4,
+                size_t scanThreshold_ = 8);
+
+    /// Move constructor, takes over the cache contents of `other`.
+    CachedStore(CachedStore &&other);
+
+    CachedStore(const CachedStore&) = delete;
+    CachedStore &operator=(const CachedStore&) = delete;
+
+    /// Writes back dirty blocks.
+    ~CachedStore();
+};
+
+}
@@ -0,0 +1,121 @@
+/**
+ * \file
+ * \brief     ChecksumStore header.
+ * \author    Chris Smeele
+ * \copyright Copyright (c) 2016, Chris Smeele
+ *
+ * Distributed under the Boost Software License, Version 1.0.
+ * See accompanying file LICENSE or copy at
+ * http://www.boost.org/LICENSE_1_0.txt
+ */
+#pragma once
+
+#include "store.hh"
+
+namespace MuStore {
+
+/**
+ * \brief Store decorator that verifies blocks against CRC32C checksums.
+ *
+ * A CRC32C of every block is kept in a caller-provided side table.
+ * Writes update the table, and reads are verified against it. A block
+ * that does not match its checksum fails the read with
+ * STORE_ERR_CHECKSUM; the buffer then holds the data as read.
+ *
+ * The table can be persisted in a separate store, such as another
+ * partition or file. It is loaded on construction, and table blocks
+ * are written through after the data blocks they cover. The table is
+ * stored in native byte order.
+ *
+ * A MirrorStore of ChecksumStores fails over to another member on a
+ * checksum mismatch.
+ */
+class ChecksumStore : public Store {
+
+public:
+    /// Verification statistics.
+    struct Stats {
+        size_t verified;     ///< Blocks verified.
+        size_t mismatches;   ///< Blocks that did not match their checksum.
+        size_t lastMismatch; ///< LBA of the last mismatching block.
+    };
+
+private:
+    /// The store we pass calls to.
+    Store *store;
+
+    /// One checksum per block.
+    uint32_t *sums;
+
+    /// The store holding the persistent table, or nullptr.
+    Store *sumStore;
+
+    Stats stats;
+
+    /// Verify blocks against their checksums.
+    StoreError verify(size_t lba, size_t count, const uint8_t *data);
+
+    /// Update the checksums of blocks, and write them to the table store.
+    StoreError update(size_t lba, size_t count, const uint8_t *data);
+
+    /// Recompute the checksums of a range of blocks from their current contents.
+    StoreError rebuild(size_t lba, size_t count);
+
+public:
+    StoreError seek(size_t lba);
+
+    StoreError read (void *buffer);
+    StoreError write(const void *buffer);
+
+    StoreError readBlocks (size_t lba, size_t count, void *buffer);
+    StoreError writeBlocks(size_t lba, size_t count, const void *buffer);
+
+    /// Pass the discard on, then checksum the blocks as they read afterwards.
+    StoreError discard(size_t lba, size_t count);
+
+    StoreError flush();
+
+    const uint8_t *borrowBlock        (size_t lba, size_t count = 1);
+          uint8_t *borrowBlockWritable(size_t lba, size_t count = 1);
+    StoreError     commitBlock        (size_t lba, size_t count = 1);
+
+    using Store::read;
+    using Store::write;
+
+    /// Recompute all checksums from the current contents of the store.
+    StoreError rebuild();
+
+    /// Get verification statistics.
+    const Stats &getStats() const { return stats; }
+
+    /// Reset verification statistics.
+    void resetStats() { stats = Stats(); }
+
+    /**
+     * \brief Get the amount of table entries needed for a store.
+     *
+     * \param blockCount the amount of blocks in the store
+     * \param sumBlockSize the block size of the table store, or 0 if the table is not persisted
+     */
+    static size_t getTableSize(size_t blockCount, size_t sumBlockSize = 0);
+
+    /**
+     * \brief ChecksumStore constructor.
+     *
+     * \param store_ the store to verify
+     * \param sums_ the checksum table
+     * \param count the amount of entries in the table, at least getTableSize()
+     * \param sumStore_ the store to persist the table in, or nullptr
+     * \param build whether to compute the table from the store instead
+     *        of loading it. Always done if there is no table store
+     */
+    ChecksumStore(Store *store_,
+                  uint32_t *sums_,
+                  size_t count,
+                  Store *sumStore_ = nullptr,
+                  bool build = false);
+
+    ~ChecksumStore() = default;
+};
+
+}
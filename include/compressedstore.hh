@@ -0,0 +1,141 @@
+/**
+ * \file
+ * \brief     CompressedStore header.
+ * \author    Chris Smeele
+ * \copyright Copyright (c) 2016, Chris Smeele
+ *
+ * Distributed under the Boost Software License, Version 1.0.
+ * See accompanying file LICENSE or copy at
+ * http://www.boost.org/LICENSE_1_0.txt
+ */
+#pragma once
+
+#include "store.hh"
+
+#include <memory>
+
+namespace MuStore {
+
+/**
+ * \brief Read-only store backed by a compressed container.
+ *
+ * The image is divided into groups of blocks, which are compressed
+ * separately with lzCompress(). The container, itself a store with the
+ * same block size as the image, consists of:
+ *
+ * - Block 0: a header describing the image and group size.
+ * - Blocks 1 to N: the group index, 16 bytes per group: the container
+ *   LBA of the group, its compressed size in bytes, and its encoding.
+ * - Blocks N+1 and up: group data, each group starting on a block
+ *   boundary.
+ *
+ * Groups that do not compress are stored as-is, and all-zero groups
+ * take no space at all. Reading any block decompresses at most the one
+ * group containing it. Decompressed groups are kept in a small LRU
+ * cache, and requests covering a whole uncached group decompress it
+ * straight into the caller's buffer.
+ *
+ * Containers are created with pack(). The store is read-only; an
+ * OverlayStore can be put on top of it to make it writable.
+ *
+ * Blocks can not be borrowed, as cached groups are evicted while
+ * borrowed pointers would still be in use.
+ */
+class CompressedStore : public Store {
+
+public:
+    /// Group cache statistics.
+    struct Stats {
+        size_t hits;          ///< Requests served from the group cache.
+        size_t misses;        ///< Groups read and decompressed into the cache.
+        size_t directGroups;  ///< Groups decompressed straight into the caller's buffer.
+    };
+
+private:
+    struct Slot {
+        size_t group;   ///< Cached group, groupCount if empty.
+        size_t lastUse; ///< For LRU eviction.
+    };
+
+    /// The container store.
+    Store *container;
+
+    size_t groupBlocks; ///< Blocks per group.
+    size_t groupCount;
+
+    std::unique_ptr<uint8_t[]> index;  ///< The group index, as stored.
+    std::unique_ptr<uint8_t[]> input;  ///< Compressed group buffer.
+    std::unique_ptr<uint8_t[]> cache;  ///< Decompressed groups.
+    std::unique_ptr<Slot[]>    slots;
+    size_t                     slotCount;
+    size_t                     useClock;
+
+    Stats stats;
+
+    /// Get the amount of blocks in a group; the last group may be short.
+    size_t groupSize(size_t group) const;
+
+    /// Read and decompress a group into a buffer.
+    StoreError loadGroup(size_t group, uint8_t *buffer);
+
+    /// Find a group in the cache, or load it. Returns nullptr on error.
+    const uint8_t *getGroup(size_t group, StoreError &err);
+
+public:
+    StoreError seek(size_t lba);
+
+    StoreError read (void *buffer);
+    StoreError write(const void *buffer);
+
+    StoreError readBlocks (size_t lba, size_t count, void *buffer);
+    StoreError writeBlocks(size_t lba, size_t count, const void *buffer);
+
+    using Store::read;
+    using Store::write;
+
+    /// Get the amount of blocks per group.
+    size_t getGroupBlocks() const { return groupBlocks; }
+
+    /// Get group cache statistics.
+    const Stats &getStats() const { return stats; }
+
+    /// Reset group cache statistics.
+    void resetStats() { stats = Stats(); }
+
+    /// Get the maximum size of a container for an image, in blocks.
+    static size_t getMaxContainerBlockCount(size_t blockCount, size_t blockSize, size_t groupBlocks);
+
+    /**
+     * \brief Compress an image into a container.
+     *
+     * \param image the store to compress
+     * \param container the store to write the container to, with the
+     *        same block size and at least getMaxContainerBlockCount() blocks
+     * \param groupBlocks the amount of blocks per group
+     * \param usedBlocks set to the size of the container in blocks, if not nullptr
+     */
+    static StoreError pack(Store *image,
+                           Store *container,
+                           size_t groupBlocks = 64,
+                           size_t *usedBlocks = nullptr);
+
+    /**
+     * \brief CompressedStore constructor.
+     *
+     * An invalid container results in a store without blocks.
+     *
+     * \param container_ the container store
+     * \param cacheGroups the amount of decompressed groups to cache
+     */
+    CompressedStore(Store *container_, size_t cacheGroups = 4);
+
+    /// Move constructor, leaves `other` without a container.
+    CompressedStore(CompressedStore &&other);
+
+    CompressedStore(const CompressedStore&) = delete;
+    CompressedStore &operator=(const CompressedStore&) = delete;
+
+    ~CompressedStore() = default;
+};
+
+}
@@ -0,0 +1,41 @@
+/**
+ * \file
+ * \brief     CRC32C header.
+ * \author    Chris Smeele
+ * \copyright Copyright (c) 2016, Chris Smeele
+ *
+ * Distributed under the Boost Software License, Version 1.0.
+ * See accompanying file LICENSE or copy at
+ * http://www.boost.org/LICENSE_1_0.txt
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace MuStore {
+
+/**
+ * \brief Compute a CRC32C (Castagnoli) checksum.
+ *
+ * Uses the SSE4.2 CRC32 instruction on x86-64 CPUs that support it
+ * (detected at runtime), the ARMv8 CRC32 instructions when compiled
+ * for them, and a slicing-by-8 table otherwise.
+ *
+ * The hardware version runs three independent CRCs over adjacent
+ * parts of the buffer to hide instruction latency, and combines them
+ * afterwards.
+ *
+ * \param data the data to checksum
+ * \param size the size of the data in bytes
+ * \param crc the CRC of preceding data, to checksum data in parts
+ */
+uint32_t crc32c(const void *data, size_t size, uint32_t crc = 0);
+
+/// Compute a CRC32C checksum without hardware acceleration.
+uint32_t crc32cPortable(const void *data, size_t size, uint32_t crc = 0);
+
+/// Check whether crc32c() uses hardware acceleration.
+bool crc32cIsAccelerated();
+
+}
@@ -0,0 +1,164 @@
+/**
+ * \file
+ * \brief     DedupStore header.
+ * \author    Chris Smeele
+ * \copyright Copyright (c) 2016, Chris Smeele
+ *
+ * Distributed under the Boost Software License, Version 1.0.
+ * See accompanying file LICENSE or copy at
+ * http://www.boost.org/LICENSE_1_0.txt
+ */
+#pragma once
+
+#include "store.hh"
+#include "hash128.hh"
+
+#include <memory>
+
+namespace MuStore {
+
+/**
+ * \brief Content-addressed, deduplicating store.
+ *
+ * Blocks written to the volume are hashed with hash128(), and each
+ * unique block is stored once, as a chunk in a separate chunk store.
+ * The volume maps every LBA to a chunk, and chunks are reference
+ * counted: a chunk is freed when no LBA refers to it any more.
+ * All-zero blocks are not stored at all.
+ *
+ * The chunk store only needs to hold the unique data, so it can be
+ * much smaller than the volume. Writes fail with STORE_ERR_IO when it
+ * is full. To cache the volume in RAM, put a CachedStore on the chunk
+ * store rather than on the DedupStore: duplicate blocks are then
+ * cached only once.
+ *
+ * When hashes match, the chunk is read back and compared to the new
+ * data by default, since hash128() collisions can be constructed on
+ * purpose. This costs a chunk read per duplicate block written.
+ *
+ * The LBA-to-chunk map can be persisted in a map store, four bytes per
+ * block in native byte order. Map blocks are written through after the
+ * chunks they refer to. Reference counts and the hash index are
+ * rebuilt from the map and the chunks on construction. A zero-filled
+ * map store is an empty (all zero) volume.
+ *
+ * Blocks can not be borrowed: rewriting an LBA points it at another
+ * chunk, and freed chunks are reused for other LBAs, so a borrowed
+ * pointer would not reflect later writes.
+ */
+class DedupStore : public Store {
+
+    struct Chunk {
+        Hash128  hash;
+        uint32_t refs; ///< LBAs referring to this chunk, 0 if free.
+        uint32_t next; ///< Next free chunk + 1, if free.
+    };
+
+    /// The store holding unique blocks.
+    Store *chunkStore;
+
+    /// The store holding the persistent map, or nullptr.
+    Store *mapStore;
+
+    bool verify;
+
+    /// Chunk number + 1 for every LBA, 0 for zero blocks.
+    std::unique_ptr<uint32_t[]> map;
+
+    std::unique_ptr<Chunk[]> chunks;
+
+    /// Open-addressed hash table of chunk number + 1, 0 if empty.
+    std::unique_ptr<uint32_t[]> index;
+    size_t indexMask;
+
+    size_t chunkCount;
+    size_t usedChunks;
+    size_t freeList; ///< First free chunk + 1, 0 if full.
+
+    /// A block of scratch space, for verifying duplicates.
+    std::unique_ptr<uint8_t[]> scratch;
+
+    size_t slotOf(const Hash128 &hash) const { return (size_t)hash.lo & indexMask; }
+
+    void indexInsert(uint32_t chunk);
+    void indexRemove(uint32_t chunk);
+
+    /// Find a chunk with the given contents. Returns chunk + 1, or 0.
+    uint32_t find(const Hash128 &hash, const uint8_t *data);
+
+    /// Drop a reference to a chunk (number + 1). Returns whether the chunk was freed.
+    bool release(uint32_t id);
+
+    /// Point an LBA at the chunk holding the given data, storing it if needed.
+    StoreError writeBlock(size_t lba, const uint8_t *data);
+
+    /// Write the map blocks covering a range of LBAs to the map store.
+    StoreError writeMap(size_t lba, size_t count);
+
+    /// Load the map and rebuild the chunk table and index.
+    bool load();
+
+public:
+    StoreError seek(size_t lba);
+
+    StoreError read (void *buffer);
+    StoreError write(const void *buffer);
+
+    StoreError readBlocks (size_t lba, size_t count, void *buffer);
+    StoreError writeBlocks(size_t lba, size_t count, const void *buffer);
+
+    /// Unmap the blocks, discarding chunks that are no longer used. Discarded blocks read as zeroes.
+    StoreError discard(size_t lba, size_t count);
+
+    StoreError flush();
+
+    using Store::read;
+    using Store::write;
+
+    /// Get the amount of chunks the chunk store can hold.
+    size_t getChunkCount() const { return chunkCount; }
+
+    /// Get the amount of chunks in use, i.e. unique non-zero blocks.
+    size_t getUsedChunkCount() const { return usedChunks; }
+
+    /// Get the amount of LBAs that hold non-zero data.
+    size_t getMappedCount() const;
+
+    /// Get the amount of heap memory used for the map, chunk table and index, in bytes.
+    size_t getMemoryUsage() const;
+
+    /**
+     * \brief Get the size of the persistent map in blocks.
+     *
+     * \param blockCount the amount of blocks in the volume
+     * \param mapBlockSize the block size of the map store
+     */
+    static size_t getMapSize(size_t blockCount, size_t mapBlockSize);
+
+    /**
+     * \brief DedupStore constructor.
+     *
+     * The volume has the block size of the chunk store, which can hold
+     * at most 2^32 - 1 chunks. An unusable chunk or map store, or a map
+     * referring to chunks that do not exist, results in a store without
+     * blocks.
+     *
+     * \param chunkStore_ the store holding unique blocks
+     * \param blockCount_ the amount of blocks in the volume
+     * \param mapStore_ the store to persist the map in, or nullptr
+     * \param verify_ whether to compare data when hashes match
+     */
+    DedupStore(Store *chunkStore_,
+               size_t blockCount_,
+               Store *mapStore_ = nullptr,
+               bool verify_ = true);
+
+    DedupStore(DedupStore &&other);
+
+    DedupStore(const DedupStore&) = delete;
+    DedupStore &operator=(const DedupStore&) = delete;
+
+    ~DedupStore();
+};
+
+}
@@ -0,0 +1,63 @@
+/**
+ * \file
+ * \brief     DirectFileStore header.
+ * \author    Chris Smeele
+ * \copyright Copyright (c) 2016, Chris Smeele
+ *
+ * Distributed under the Boost Software License, Version 1.0.
+ * See accompanying file LICENSE or copy at
+ * http://www.boost.org/LICENSE_1_0.txt
+ */
+#pragma once
+
+#include "posixfilestore.hh"
+
+namespace MuStore {
+
+/**
+ * \brief Store file backend using direct I/O.
+ *
+ * A PosixFileStore that opens its file with `O_DIRECT`, bypassing the
+ * OS page cache. This makes sense when the store is used with a cache
+ * of its own (e.g. a CachedStore).
+ *
+ * Direct I/O requires buffers aligned to the block size. Callers that
+ * pass aligned buffers get zero-copy transfers, for unaligned buffers
+ * an aligned bounce buffer is allocated for the duration of the
+ * request.
+ *
+ * If the file system does not support direct I/O, the file is opened
+ * for regular I/O instead, see isDirect().
+ */
+class DirectFileStore : public PosixFileStore {
+
+private:
+    /// Whether the file was opened with O_DIRECT.
+    bool   direct;
+    /// The optimal I/O transfer size reported by the medium, in bytes.
+    size_t preferredIoSize;
+
+public:
+    /// The maximum bounce buffer size for transfers from / to unaligned buffers, in bytes.
+    static const size_t MAX_BOUNCE_SIZE = 1024 * 1024;
+
+    StoreError readAt (size_t lba, size_t count, void *buffer);
+    StoreError writeAt(size_t lba, size_t count, const void *buffer);
+
+    /// Check whether I/O bypasses the OS page cache.
+    bool   isDirect()           const { return direct;          }
+
+    /// Get the optimal I/O transfer size reported by the medium, in bytes.
+    size_t getPreferredIoSize() const { return preferredIoSize; }
+
+    /**
+     * \param path path to the file that will be used as a storage backend
+     * \param writable whether to allow write access to the file
+     * \param blockSize_ the block size in bytes, a power of two of at least 512
+     */
+    DirectFileStore(const char *path, bool writable = true, size_t blockSize_ = 512);
+
+    DirectFileStore(DirectFileStore &&other) = default;
+};
+
+}
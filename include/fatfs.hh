@@ -63,6 +63,16 @@ private:
     StoreError readCacheBlock(size_t lba, void *cache, size_t &cacheLba);
     StoreError writeCacheBlock(size_t lba, const void *buffer, void *cache, size_t &cacheLba);
 
+    /// Like readCacheBlock, but reads the block in place if the store allows it.
+    StoreError borrowCacheBlock(size_t lba, void *cache, size_t &cacheLba, const void **buffer);
+
+    StoreError borrowFatBlock(size_t blockNo, const void **buffer);
+
+    /// Get a FAT block for modification, in place if the store allows it.
+    StoreError  editFatBlock(size_t blockNo, void **buffer);
+    /// Write back a FAT block obtained with editFatBlock.
+    StoreError commitFatBlock(size_t blockNo, void *buffer);
+
     StoreError readFatBlock (size_t blockNo, void **buffer);
     StoreError readRootBlock(size_t blockNo, void **buffer);
     StoreError readDataBlock(size_t blockNo, void **buffer);
@@ -71,6 +81,9 @@ private:
     StoreError writeRootBlock(size_t blockNo, const void *buffer);
     StoreError writeDataBlock(size_t blockNo, const void *buffer);
 
+    /// Tell the store that a range of data blocks is no longer in use.
+    void discardDataBlocks(size_t blockNo, size_t count);
+
     /// Magic end-of-chain lba, used internally.
     static const size_t BLOCK_EOC    = ~(size_t)0ULL;
     /// FAT cluster EOC marker. NOTE: this is not the only possible EOC marker value!
@@ -99,7 +112,9 @@ private:
 
     FsError allocCluster(size_t currentCluster, size_t &nextCluster);
 
+    FsError  getNodeBlockLba(FsNode &node, size_t &lba);
     FsError  readNodeBlock(FsNode &node, void **buffer);
+    FsError borrowNodeBlock(FsNode &node, const void **buffer);
     FsError writeNodeBlock(FsNode &node, const void *buffer);
     FsError   incNodeBlock(FsNode &node, bool allocate = false);
 
@@ -39,15 +39,27 @@ public:
     StoreError read (void *buffer);
     StoreError write(const void *buffer);
 
+    StoreError readBlocks (size_t lba, size_t count, void *buffer);
+    StoreError writeBlocks(size_t lba, size_t count, const void *buffer);
+
+    /// Punch a hole in the file where supported (Linux), otherwise do nothing.
+    StoreError discard(size_t lba, size_t count);
+
+    /// Flush stdio buffers and, on POSIX systems, sync the file to disk.
+    StoreError flush();
+
     // Needed because we overload read and write methods.
     using Store::read;
     using Store::write;
 
     /**
+     * Any bytes past the last whole block are not accessible.
+     *
      * \param path path to the file that will be used as a storage backend
      * \param writable whether to allow write access to the file
+     * \param blockSize_ the block size in bytes, a power of two
      */
-    FileStore(const char *path, bool writable = true);
+    FileStore(const char *path, bool writable = true, size_t blockSize_ = 512);
     ~FileStore();
 };
 
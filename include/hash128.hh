@@ -0,0 +1,40 @@
+/**
+ * \file
+ * \brief     128-bit hash header.
+ * \author    Chris Smeele
+ * \copyright Copyright (c) 2016, Chris Smeele
+ *
+ * Distributed under the Boost Software License, Version 1.0.
+ * See accompanying file LICENSE or copy at
+ * http://www.boost.org/LICENSE_1_0.txt
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace MuStore {
+
+/// A 128-bit hash value.
+struct Hash128 {
+    uint64_t lo;
+    uint64_t hi;
+
+    bool operator==(const Hash128 &other) const { return lo == other.lo && hi == other.hi; }
+    bool operator!=(const Hash128 &other) const { return !(*this == other); }
+};
+
+/**
+ * \brief Compute a fast, non-cryptographic 128-bit hash (MurmurHash3 x64).
+ *
+ * The hash is well distributed, but collisions can be constructed on
+ * purpose. Users that must not confuse distinct data should compare
+ * the data itself when hashes match.
+ *
+ * \param data the data to hash
+ * \param size the size of the data in bytes
+ * \param seed the hash seed
+ */
+Hash128 hash128(const void *data, size_t size, uint64_t seed = 0);
+
+}
@@ -0,0 +1,96 @@
+/**
+ * \file
+ * \brief     IoUringStore header.
+ * \author    Chris Smeele
+ * \copyright Copyright (c) 2016, Chris Smeele
+ *
+ * Distributed under the Boost Software License, Version 1.0.
+ * See accompanying file LICENSE or copy at
+ * http://www.boost.org/LICENSE_1_0.txt
+ */
+#pragma once
+
+#include "posixfilestore.hh"
+#include "asyncstore.hh"
+
+#include <memory>
+
+namespace MuStore {
+
+/**
+ * \brief Store file backend with asynchronous I/O using Linux io_uring.
+ *
+ * This is a PosixFileStore that additionally implements AsyncStore on
+ * an io_uring instance, set up through raw system calls.
+ *
+ * Submitted requests are batched: submitRead() and submitWrite() only
+ * queue a submission entry, the whole batch is passed to the kernel
+ * with a single system call by submit() or poll(). The file is
+ * registered with the ring, and buffers can be registered with
+ * registerBuffers() to avoid mapping them on every request.
+ *
+ * When io_uring is not available (on other platforms, older kernels,
+ * or when it is blocked by a sandbox), submitted requests are
+ * executed immediately using pread() / pwrite(), see isNative().
+ *
+ * The synchronous Store operations are those of PosixFileStore. The
+ * asynchronous operations must not be used concurrently.
+ */
+class IoUringStore : public PosixFileStore, public AsyncStore {
+
+    struct Ring;
+
+    /// The ring state, nullptr if unusable.
+    std::unique_ptr<Ring> ring;
+
+    StoreError submitRequest(bool isWrite, size_t lba, size_t count, void *buffer, void *cookie);
+
+public:
+    StoreError submitRead (size_t lba, size_t count, void *buffer, void *cookie);
+    StoreError submitWrite(size_t lba, size_t count, const void *buffer, void *cookie);
+
+    /// Pass all queued requests to the kernel without waiting for completions.
+    StoreError submit();
+
+    size_t poll(Completion *completions, size_t max, size_t min = 0);
+
+    size_t getOutstanding() const;
+
+    /**
+     * \brief Register buffers with the kernel.
+     *
+     * Requests whose buffer lies entirely within a registered buffer
+     * use fixed-buffer I/O. Registering replaces previously registered
+     * buffers, and is only allowed while no requests are outstanding.
+     *
+     * \param buffers array of `count` buffer addresses
+     * \param sizes array of `count` buffer sizes in bytes
+     * \param count the amount of buffers, 0 to unregister all buffers
+     *
+     * \retval STORE_ERR_OK
+     * \retval STORE_ERR_IO when requests are outstanding, io_uring is
+     *         not available, or the kernel refused the buffers.
+     *         Requests will still work, using unregistered buffers.
+     */
+    StoreError registerBuffers(void *const *buffers, const size_t *sizes, size_t count);
+
+    /// Check whether requests are performed with io_uring, rather than pread() / pwrite().
+    bool isNative() const;
+
+    /// Get the maximum amount of requests in flight.
+    size_t getQueueDepth() const;
+
+    /**
+     * \param path path to the file that will be used as a storage backend
+     * \param writable_ whether to allow write access to the file
+     * \param queueDepth the maximum amount of requests in flight
+     */
+    IoUringStore(const char *path, bool writable_ = true, size_t queueDepth = 64);
+
+    IoUringStore(IoUringStore &&other);
+
+    /// Waits for requests in flight to complete.
+    ~IoUringStore();
+};
+
+}
@@ -0,0 +1,54 @@
+/**
+ * \file
+ * \brief     LZ compression header.
+ * \author    Chris Smeele
+ * \copyright Copyright (c) 2016, Chris Smeele
+ *
+ * Distributed under the Boost Software License, Version 1.0.
+ * See accompanying file LICENSE or copy at
+ * http://www.boost.org/LICENSE_1_0.txt
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace MuStore {
+
+/**
+ * \brief Compress data with a fast LZ77-class compressor.
+ *
+ * The output is a sequence of (literals, match) pairs: a token byte
+ * holding the literal length and match length in its high and low
+ * nibble, extended by additional length bytes when a nibble is 15,
+ * followed by the literals and a 16-bit little-endian match offset.
+ * Matches are at least 4 bytes. The last sequence has literals only.
+ *
+ * Matches are found greedily through a small hash table, trading
+ * ratio for speed.
+ *
+ * \param src the data to compress
+ * \param size the size of the data in bytes
+ * \param dst the output buffer
+ * \param capacity the size of the output buffer in bytes
+ *
+ * \return the compressed size, or 0 if it does not fit in the output buffer
+ */
+size_t lzCompress(const uint8_t *src, size_t size, uint8_t *dst, size_t capacity);
+
+/**
+ * \brief Decompress data compressed by lzCompress().
+ *
+ * All lengths and offsets are checked, so corrupt input can not cause
+ * reads or writes outside of the buffers.
+ *
+ * \param src the compressed data
+ * \param size the size of the compressed data in bytes
+ * \param dst the output buffer
+ * \param dstSize the exact size of the decompressed data in bytes
+ *
+ * \return whether the input was valid and decompressed to exactly dstSize bytes
+ */
+bool lzDecompress(const uint8_t *src, size_t size, uint8_t *dst, size_t dstSize);
+
+}
@@ -34,24 +34,35 @@ public:
     StoreError read (void *buffer);
     StoreError write(const void *buffer);
 
+    StoreError readBlocks (size_t lba, size_t count, void *buffer);
+    StoreError writeBlocks(size_t lba, size_t count, const void *buffer);
+
+    const uint8_t *borrowBlock        (size_t lba, size_t count = 1);
+          uint8_t *borrowBlockWritable(size_t lba, size_t count = 1);
+
     using Store::read;
     using Store::write;
 
     /**
      * \brief Writable blockstore constructor.
      *
+     * Any bytes past the last whole block are not accessible. An
+     * invalid block size results in a store without blocks.
+     *
      * \param store pointer to the memory region that will be used as a backend
      * \param size the size of the provided memory region
+     * \param blockSize_ the block size in bytes, a power of two
      */
-    MemStore(void *store, size_t size);
+    MemStore(void *store, size_t size, size_t blockSize_ = 512);
 
     /**
      * \brief Read-only blockstore constructor.
      *
      * \param store pointer to the memory region that will be used as a backend
      * \param size the size of the provided memory region
+     * \param blockSize_ the block size in bytes, a power of two
      */
-    MemStore(const void *store, size_t size);
+    MemStore(const void *store, size_t size, size_t blockSize_ = 512);
 
     ~MemStore() = default;
 };
@@ -0,0 +1,110 @@
+/**
+ * \file
+ * \brief     MirrorStore header.
+ * \author    Chris Smeele
+ * \copyright Copyright (c) 2016, Chris Smeele
+ *
+ * Distributed under the Boost Software License, Version 1.0.
+ * See accompanying file LICENSE or copy at
+ * http://www.boost.org/LICENSE_1_0.txt
+ */
+#pragma once
+
+#include "store.hh"
+
+#include <memory>
+
+namespace MuStore {
+
+/**
+ * \brief Mirrors blocks across multiple stores (RAID-1).
+ *
+ * Writes go to every member. Each read is served by a single member:
+ * the one with the least requests in flight, or if there is a tie, the
+ * one whose previous request ended closest to the requested LBA. The
+ * members' initial positions are spread over the volume, so that
+ * separate sequential streams tend to settle on separate members.
+ *
+ * When a member fails a read with STORE_ERR_IO or STORE_ERR_CHECKSUM,
+ * the read is retried on the next best member, until all members have
+ * been tried. A failed
+ * write to any member fails the write, but the other members are
+ * still written.
+ *
+ * readBlocks() and writeBlocks() may be called from multiple threads
+ * at once. Members are locked while in use, unless they are marked
+ * thread-safe, so concurrent readers can each have a member to
+ * themselves. The cursor position is not meaningful under concurrent
+ * use.
+ *
+ * Writable borrowed blocks come from the first member, and are copied
+ * to the other members by commitBlock().
+ *
+ * All members must have the same block size. The volume has the size
+ * of the smallest member, and is writable if all members are writable.
+ */
+class MirrorStore : public Store {
+
+    struct Members;
+
+    /// Member stores and their state, nullptr if unusable.
+    std::unique_ptr<Members> members;
+
+public:
+    /// The maximum amount of member stores.
+    static const size_t MAX_MEMBERS = 64;
+
+    /// Per-member request counters.
+    struct MemberStats {
+        size_t reads;       ///< Read requests served.
+        size_t readBlocks;  ///< Blocks read.
+        size_t writes;      ///< Write requests.
+        size_t errors;      ///< Failed requests.
+    };
+
+    StoreError seek(size_t lba);
+
+    StoreError read (void *buffer);
+    StoreError write(const void *buffer);
+
+    StoreError readBlocks (size_t lba, size_t count, void *buffer);
+    StoreError writeBlocks(size_t lba, size_t count, const void *buffer);
+
+    StoreError discard(size_t lba, size_t count);
+
+    StoreError flush();
+
+    const uint8_t *borrowBlock        (size_t lba, size_t count = 1);
+          uint8_t *borrowBlockWritable(size_t lba, size_t count = 1);
+    StoreError     commitBlock        (size_t lba, size_t count = 1);
+
+    using Store::read;
+    using Store::write;
+
+    /// Get the amount of member stores.
+    size_t getMemberCount() const;
+
+    /// Get the request counters of a member.
+    MemberStats getMemberStats(size_t i) const;
+
+    /// Reset the request counters of all members.
+    void resetStats();
+
+    /**
+     * \brief MirrorStore constructor.
+     *
+     * \param stores the member stores
+     * \param count the amount of member stores
+     * \param threadSafe whether members may be accessed from multiple threads at once
+     */
+    MirrorStore(Store *const *stores, size_t count, bool threadSafe = false);
+
+    MirrorStore(MirrorStore &&other);
+
+    MirrorStore(const MirrorStore&) = delete;
+    MirrorStore &operator=(const MirrorStore&) = delete;
+
+    ~MirrorStore();
+};
+
+}
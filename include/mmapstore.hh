@@ -0,0 +1,101 @@
+/**
+ * \file
+ * \brief     MmapStore header.
+ * \author    Chris Smeele
+ * \copyright Copyright (c) 2016, Chris Smeele
+ *
+ * Distributed under the Boost Software License, Version 1.0.
+ * See accompanying file LICENSE or copy at
+ * http://www.boost.org/LICENSE_1_0.txt
+ */
+#pragma once
+
+#include "store.hh"
+
+namespace MuStore {
+
+/**
+ * \brief Store memory-mapped file backend.
+ *
+ * This maps a single file into memory and serves block I/O from the
+ * mapping, like MemStore. No system calls are made for reads or
+ * writes, caching is left to the OS page cache.
+ *
+ * Writes reach the file at the discretion of the OS, use flush() to
+ * write them back explicitly.
+ */
+class MmapStore : public Store {
+
+public:
+    /// Access pattern hints, see advise().
+    enum class Advice {
+        NORMAL = 0, ///< No particular access pattern.
+        SEQUENTIAL, ///< Expect sequential access, read ahead aggressively.
+        RANDOM,     ///< Expect random access, do not read ahead.
+        WILLNEED,   ///< The given range will be accessed soon, start reading it in.
+    };
+
+private:
+    /// The mapped file, `nullptr` if unusable.
+    uint8_t *map;
+    /// Size of the mapping in bytes.
+    size_t   mapSize;
+
+public:
+    StoreError seek(size_t lba);
+
+    StoreError read (void *buffer);
+    StoreError write(const void *buffer);
+
+    StoreError readBlocks (size_t lba, size_t count, void *buffer);
+    StoreError writeBlocks(size_t lba, size_t count, const void *buffer);
+
+    /// Release the whole pages in the range from the mapping and the file (Linux).
+    StoreError discard(size_t lba, size_t count);
+
+    const uint8_t *borrowBlock        (size_t lba, size_t count = 1);
+          uint8_t *borrowBlockWritable(size_t lba, size_t count = 1);
+
+    using Store::read;
+    using Store::write;
+
+    /**
+     * \brief Give the OS a hint about the expected access pattern.
+     *
+     * \param advice the expected access pattern
+     * \param lba the first block the hint applies to
+     * \param count the amount of blocks the hint applies to, 0 for all blocks starting at `lba`
+     *
+     * \retval STORE_ERR_OK
+     * \retval STORE_ERR_OUT_OF_BOUNDS when the range exceeds getBlockCount()
+     * \retval STORE_ERR_IO for other backend errors
+     */
+    StoreError advise(Advice advice, size_t lba = 0, size_t count = 0);
+
+    /**
+     * \brief Synchronously write back all modified blocks to the file.
+     *
+     * \retval STORE_ERR_OK
+     * \retval STORE_ERR_IO for backend errors
+     */
+    StoreError flush();
+
+    /**
+     * Any bytes past the last whole block are not accessible.
+     *
+     * \param path path to the file that will be mapped
+     * \param writable whether to allow write access to the file
+     * \param blockSize_ the block size in bytes, a power of two
+     */
+    MmapStore(const char *path, bool writable = true, size_t blockSize_ = 512);
+
+    /// Move constructor, takes over the mapping of `other`.
+    MmapStore(MmapStore &&other);
+
+    MmapStore(const MmapStore&) = delete;
+    MmapStore &operator=(const MmapStore&) = delete;
+
+    ~MmapStore();
+};
+
+}
@@ -0,0 +1,125 @@
+/**
+ * \file
+ * \brief     OverlayStore header.
+ * \author    Chris Smeele
+ * \copyright Copyright (c) 2016, Chris Smeele
+ *
+ * Distributed under the Boost Software License, Version 1.0.
+ * See accompanying file LICENSE or copy at
+ * http://www.boost.org/LICENSE_1_0.txt
+ */
+#pragma once
+
+#include "store.hh"
+
+namespace MuStore {
+
+/**
+ * \brief Copy-on-write overlay of a read-only base store.
+ *
+ * Writes go to a delta store, and an allocation map with one bit per
+ * block records which blocks were modified. Reads of unmodified blocks
+ * go straight to the base, so many overlays can share one base image.
+ *
+ * The delta store is self-describing and can be reopened later. Its
+ * layout is:
+ *
+ * - Block 0: a header describing the geometry of the base.
+ * - Blocks 1 to N: the allocation map.
+ * - Blocks N+1 and up: modified blocks, at their base LBA plus N+1.
+ *
+ * Blocks are stored at a fixed offset, so the delta only takes up
+ * space for modified blocks if it is sparse, such as a sparse file or
+ * a SparseMemStore. Formatting a delta writes only the header and an
+ * empty allocation map, so a clone costs no copying of the base.
+ *
+ * The header and allocation map are kept in memory, in a
+ * caller-provided buffer of getMapSize() bytes. Map blocks are written
+ * to the delta as soon as a block is first modified, after the block
+ * itself.
+ *
+ * Writable borrowed blocks copy unmodified blocks up from the base
+ * first, which requires the delta to support borrowing. Unmodified
+ * blocks of a writable overlay can not be borrowed for reading, since
+ * writing them moves them to the delta.
+ */
+class OverlayStore : public Store {
+
+    /// The read-only store holding unmodified blocks.
+    Store *base;
+
+    /// The store holding the header, allocation map and modified blocks.
+    Store *delta;
+
+    uint8_t *header;    ///< The header block, followed by the allocation map.
+    uint8_t *map;       ///< The allocation map, one bit per block.
+    size_t   mapBlocks; ///< Size of the allocation map in blocks.
+
+    /// The delta LBA of block 0.
+    size_t dataStart() const { return 1 + mapBlocks; }
+
+    bool isModified(size_t lba) const {
+        return map[lba / 8] & (1 << (lba % 8));
+    }
+
+    /// Get the amount of consecutive blocks with the same allocation state as the first.
+    size_t runLength(size_t lba, size_t count) const;
+
+    /// Mark blocks as modified, and write the changed part of the allocation map.
+    StoreError markModified(size_t lba, size_t count);
+
+public:
+    StoreError seek(size_t lba);
+
+    StoreError read (void *buffer);
+    StoreError write(const void *buffer);
+
+    StoreError readBlocks (size_t lba, size_t count, void *buffer);
+    StoreError writeBlocks(size_t lba, size_t count, const void *buffer);
+
+    StoreError flush();
+
+    const uint8_t *borrowBlock        (size_t lba, size_t count = 1);
+          uint8_t *borrowBlockWritable(size_t lba, size_t count = 1);
+    StoreError     commitBlock        (size_t lba, size_t count = 1);
+
+    using Store::read;
+    using Store::write;
+
+    /// Get the amount of blocks stored in the delta.
+    size_t getModifiedCount() const;
+
+    /**
+     * \brief Write the contents of the overlay to a standalone store.
+     *
+     * If the target is the base store, only modified blocks are
+     * written, which merges the delta into the base. The delta is not
+     * changed; it should be formatted anew before further use.
+     *
+     * \param target a store with the same block size, at least as large as the base
+     * \param buffer a scratch buffer of at least one block
+     * \param size the size of the scratch buffer in bytes
+     */
+    StoreError squash(Store *target, void *buffer, size_t size);
+
+    /// Get the size in bytes of the header and allocation map buffer for a base store.
+    static size_t getMapSize(size_t blockCount, size_t blockSize = 512);
+
+    /// Get the minimum amount of blocks in a delta store for a base store.
+    static size_t getDeltaBlockCount(size_t blockCount, size_t blockSize = 512);
+
+    /**
+     * \brief OverlayStore constructor.
+     *
+     * \param base_ the read-only base store
+     * \param delta_ the delta store, with at least getDeltaBlockCount() blocks
+     * \param buffer the header and allocation map buffer
+     * \param size the size of the buffer in bytes, at least getMapSize()
+     * \param format whether to initialize the delta as empty, or open an existing delta
+     */
+    OverlayStore(Store *base_, Store *delta_, void *buffer, size_t size, bool format = false);
+
+    ~OverlayStore() = default;
+};
+
+}
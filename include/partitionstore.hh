@@ -0,0 +1,82 @@
+/**
+ * \file
+ * \brief     PartitionStore header.
+ * \author    Chris Smeele
+ * \copyright Copyright (c) 2016, Chris Smeele
+ *
+ * Distributed under the Boost Software License, Version 1.0.
+ * See accompanying file LICENSE or copy at
+ * http://www.boost.org/LICENSE_1_0.txt
+ */
+#pragma once
+
+#include "store.hh"
+#include "partitiontable.hh"
+
+namespace MuStore {
+
+/**
+ * \brief Store view of a range of blocks of another store.
+ *
+ * This exposes a partition (or any other contiguous range of blocks)
+ * of a store as a store of its own, with LBA 0 at the start of the
+ * range. All requests are bounds-checked against the range, offset,
+ * and passed on to the underlying store without copying.
+ *
+ * Requests use explicit LBAs on the underlying store, so multiple
+ * PartitionStores on one store can be used at the same time.
+ */
+class PartitionStore : public Store {
+
+private:
+    /// The store we pass calls to.
+    Store *store;
+
+    /// LBA of the first block of the partition on the underlying store.
+    size_t start;
+
+public:
+    StoreError seek(size_t lba);
+
+    StoreError read (void *buffer);
+    StoreError write(const void *buffer);
+
+    StoreError readBlocks (size_t lba, size_t count, void *buffer);
+    StoreError writeBlocks(size_t lba, size_t count, const void *buffer);
+
+    StoreError discard(size_t lba, size_t count);
+
+    StoreError flush();
+
+    const uint8_t *borrowBlock        (size_t lba, size_t count = 1);
+          uint8_t *borrowBlockWritable(size_t lba, size_t count = 1);
+    StoreError     commitBlock        (size_t lba, size_t count = 1);
+
+    using Store::read;
+    using Store::write;
+
+    /// Get the LBA of the first block of the partition on the underlying store.
+    size_t getStart() const { return start; }
+
+    /**
+     * \brief PartitionStore constructor.
+     *
+     * \param store_ the store containing the partition
+     * \param start_ the first block of the partition
+     * \param count the amount of blocks in the partition
+     */
+    PartitionStore(Store *store_, size_t start_, size_t count);
+
+    /**
+     * \brief PartitionStore constructor.
+     *
+     * \param store_ the store containing the partition
+     * \param partition a partition, as found by PartitionTable
+     */
+    PartitionStore(Store *store_, const Partition &partition)
+        : PartitionStore(store_, partition.lba, partition.blockCount) { }
+
+    ~PartitionStore() = default;
+};
+
+}
@@ -0,0 +1,88 @@
+/**
+ * \file
+ * \brief     PartitionTable header.
+ * \author    Chris Smeele
+ * \copyright Copyright (c) 2016, Chris Smeele
+ *
+ * Distributed under the Boost Software License, Version 1.0.
+ * See accompanying file LICENSE or copy at
+ * http://www.boost.org/LICENSE_1_0.txt
+ */
+#pragma once
+
+#include "store.hh"
+
+namespace MuStore {
+
+/// A partition found in a partition table.
+struct Partition {
+    size_t  lba;          ///< First block of the partition.
+    size_t  blockCount;   ///< Amount of blocks in the partition.
+    uint8_t type;         ///< MBR partition type, 0 for GPT partitions.
+    uint8_t typeGuid[16]; ///< GPT partition type GUID as stored on disk, zero for MBR partitions.
+    bool    bootable;     ///< Whether the MBR active flag is set.
+};
+
+/**
+ * \brief MBR and GPT partition table parser.
+ *
+ * This reads the partition table of a store on construction.
+ *
+ * MBR tables are supported including logical partitions in extended
+ * partitions. A protective MBR causes the GPT to be read instead. GPT
+ * headers and partition entry arrays are verified by their CRC32, the
+ * backup GPT is not used.
+ *
+ * Partitions that do not lie within the store are ignored. Block
+ * addresses are in blocks of the store, which must be at least 512
+ * bytes large.
+ */
+class PartitionTable {
+
+public:
+    /// The maximum amount of partitions that are recorded.
+    static const size_t MAX_PARTITIONS = 16;
+
+    enum class Scheme {
+        NONE, ///< No partition table was found.
+        MBR,
+        GPT,
+    };
+
+private:
+    Scheme     scheme;
+    StoreError error;
+
+    Partition partitions[MAX_PARTITIONS];
+    size_t    partitionCount;
+
+    void add(size_t lba, size_t count, uint8_t type, const uint8_t *typeGuid, bool bootable, Store *store);
+
+    StoreError readMbr(Store *store, uint8_t *buffer);
+    StoreError readEbr(Store *store, uint8_t *buffer, size_t extendedLba, size_t extendedCount);
+    StoreError readGpt(Store *store, uint8_t *buffer);
+
+public:
+    /// Get the partitioning scheme of the store.
+    Scheme getScheme() const { return scheme; }
+
+    /// Get the error that occurred while reading the table, if any.
+    StoreError getError() const { return error; }
+
+    /// Get the amount of partitions found.
+    size_t getCount() const { return partitionCount; }
+
+    /// Get a partition, in table order.
+    const Partition &operator[](size_t i) const { return partitions[i]; }
+
+    /**
+     * \brief Read the partition table of a store.
+     *
+     * \param store the store to read the partition table from
+     * \param buffer a scratch buffer of at least one block
+     * \param size the size of the scratch buffer in bytes
+     */
+    PartitionTable(Store *store, void *buffer, size_t size);
+};
+
+}
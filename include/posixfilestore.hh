@@ -0,0 +1,105 @@
+/**
+ * \file
+ * \brief     PosixFileStore header.
+ * \author    Chris Smeele
+ * \copyright Copyright (c) 2016, Chris Smeele
+ *
+ * Distributed under the Boost Software License, Version 1.0.
+ * See accompanying file LICENSE or copy at
+ * http://www.boost.org/LICENSE_1_0.txt
+ */
+#pragma once
+
+#include "store.hh"
+
+namespace MuStore {
+
+/**
+ * \brief Store file backend using POSIX positional I/O.
+ *
+ * Like FileStore, this uses a single file as a block storage backend,
+ * but it operates on a raw file descriptor using pread() and pwrite()
+ * instead of a stdio file handle.
+ *
+ * readAt() and writeAt() do not use or update the \ref pos "position",
+ * and can be called concurrently from multiple threads on a single
+ * PosixFileStore. The positional Store operations (read(size_t, void*),
+ * write(size_t, const void*), readBlocks() and writeBlocks()) are
+ * built on them and may be called concurrently as well. They set the
+ * position as usual, but the resulting position is then meaningless.
+ *
+ * The seek(), read(void*) and write(const void*) operations work on
+ * the current position and must not be used concurrently.
+ *
+ * \note Unlike FileStore, I/O errors do not close the file, as other
+ *       threads may still be using it.
+ */
+class PosixFileStore : public Store {
+
+protected:
+    /// The storage backend is a file descriptor, -1 if unusable.
+    int fd;
+
+    /**
+     * \brief Open the backing file and determine the block count.
+     *
+     * \param path path to the file that will be used as a storage backend
+     * \param flags extra flags to pass to open()
+     *
+     * \return whether the file was opened succesfully
+     */
+    bool openFile(const char *path, int flags);
+
+    /**
+     * \brief Constructor for subclasses that need different open() flags.
+     *
+     * \param path path to the file that will be used as a storage backend
+     * \param writable whether to allow write access to the file
+     * \param blockSize_ the block size in bytes
+     * \param flags extra flags to pass to open()
+     */
+    PosixFileStore(const char *path, bool writable, size_t blockSize_, int flags);
+
+public:
+    StoreError seek(size_t lba);
+
+    StoreError read (void *buffer);
+    StoreError write(const void *buffer);
+
+    StoreError read (size_t lba, void *buffer);
+    StoreError write(size_t lba, const void *buffer);
+
+    StoreError readBlocks (size_t lba, size_t count, void *buffer);
+    StoreError writeBlocks(size_t lba, size_t count, const void *buffer);
+
+    /// Read multiple blocks at the given LBA. Does not use or update the position.
+    virtual StoreError readAt (size_t lba, size_t count, void *buffer);
+    /// Write multiple blocks at the given LBA. Does not use or update the position.
+    virtual StoreError writeAt(size_t lba, size_t count, const void *buffer);
+
+    /// Punch a hole in the file or block device where supported (Linux).
+    StoreError discard(size_t lba, size_t count);
+
+    /// Sync the file to disk.
+    StoreError flush();
+
+    /**
+     * Any bytes past the last whole block are not accessible.
+     *
+     * \param path path to the file that will be used as a storage backend
+     * \param writable_ whether to allow write access to the file
+     * \param blockSize_ the block size in bytes, a power of two
+     */
+    PosixFileStore(const char *path, bool writable_ = true, size_t blockSize_ = 512)
+        : PosixFileStore(path, writable_, blockSize_, 0) { }
+
+    /// Move constructor, takes over the file descriptor of `other`.
+    PosixFileStore(PosixFileStore &&other);
+
+    PosixFileStore(const PosixFileStore&) = delete;
+    PosixFileStore &operator=(const PosixFileStore&) = delete;
+
+    ~PosixFileStore();
+};
+
+}
@@ -0,0 +1,113 @@
+/**
+ * \file
+ * \brief     ReadaheadStore header.
+ * \author    Chris Smeele
+ * \copyright Copyright (c) 2016, Chris Smeele
+ *
+ * Distributed under the Boost Software License, Version 1.0.
+ * See accompanying file LICENSE or copy at
+ * http://www.boost.org/LICENSE_1_0.txt
+ */
+#pragma once
+
+#include "store.hh"
+
+namespace MuStore {
+
+/**
+ * \brief Store decorator for sequential readahead.
+ *
+ * This detects sequential reads and then prefetches a window of
+ * blocks with a single multi-block request on the underlying store.
+ * Subsequent reads are served from the window.
+ *
+ * The window starts out small and doubles on every sequential
+ * readahead, up to the size of a caller-provided buffer. Any
+ * non-sequential read resets the window, and reads are passed through
+ * without readahead until a sequential pattern is detected again.
+ *
+ * Writes are passed through to the underlying store immediately, and
+ * update blocks that are in the window.
+ */
+class ReadaheadStore : public Store {
+
+public:
+    /// Readahead statistics.
+    struct Stats {
+        size_t hits;            ///< Blocks served from the readahead window.
+        size_t misses;          ///< Blocks read from the underlying store without readahead.
+        size_t readaheads;      ///< Readahead requests issued to the underlying store.
+        size_t readaheadBlocks; ///< Blocks read by readahead requests.
+        size_t wastedBlocks;    ///< Blocks read ahead but dropped before they were read.
+        size_t resets;          ///< Times the window was reset by a non-sequential read.
+        size_t maxWindow;       ///< The largest window used, in blocks.
+    };
+
+private:
+    /// The store we pass calls to.
+    Store *store;
+
+    uint8_t *buffer;     ///< Readahead buffer, `maxWindow` blocks.
+    size_t   maxWindow;  ///< In blocks.
+    size_t   initialWindow;
+    size_t   window;     ///< Current window size in blocks, 0 when not reading ahead.
+
+    size_t bufferLba;    ///< First block in the buffer.
+    size_t bufferCount;  ///< Amount of blocks in the buffer.
+    size_t bufferUsed;   ///< Amount of blocks in the buffer that were read, counted from the start.
+
+    /// The last block that was read, used to detect sequential access.
+    /// Starts out past the end of the store so the first read is never sequential.
+    size_t lastLba;
+
+    Stats stats;
+
+    bool inBuffer(size_t lba) const {
+        return lba >= bufferLba && lba - bufferLba < bufferCount;
+    }
+
+    /// Drop the buffer contents, accounting for blocks that were never read.
+    void dropBuffer();
+
+public:
+    StoreError seek(size_t lba);
+
+    StoreError read (void *buffer_);
+    StoreError write(const void *buffer_);
+
+    StoreError readBlocks (size_t lba, size_t count, void *buffer_);
+    StoreError writeBlocks(size_t lba, size_t count, const void *buffer_);
+
+    StoreError discard(size_t lba, size_t count);
+
+    StoreError flush();
+
+    using Store::read;
+    using Store::write;
+
+    /// Get the current readahead window size in blocks, 0 when not reading ahead.
+    size_t getWindow() const { return window; }
+
+    /// Get the maximum readahead window size in blocks.
+    size_t getMaxWindow() const { return maxWindow; }
+
+    /// Get readahead statistics.
+    const Stats &getStats() const { return stats; }
+
+    /// Reset readahead statistics.
+    void resetStats() { stats = Stats(); }
+
+    /**
+     * \brief ReadaheadStore constructor.
+     *
+     * \param store_ the store to read ahead on
+     * \param buffer_ the readahead buffer. Its size determines the maximum window size
+     * \param size the size of the readahead buffer in bytes
+     * \param initialWindow_ the window size in blocks when a sequential pattern is first detected
+     */
+    ReadaheadStore(Store *store_, void *buffer_, size_t size, size_t initialWindow_ = 8);
+
+    ~ReadaheadStore() = default;
+};
+
+}
@@ -15,11 +15,22 @@
 namespace MuStore {
 
 /**
- * \brief Store decorator for upscaling block sizes.
+ * \brief Store decorator for scaling block sizes.
  *
  * This allows one to access stores with smaller block sizes as if
- * they have a larger block size. A single read or write call results
- * in multiple operations of that type on the underlying store.
+ * they have a larger block size. Every read or write is passed on to
+ * the underlying store as a single multi-block request. When a request
+ * fails, the position is left unchanged, although part of the range
+ * may have been written.
+ *
+ * It can also scale down, to access stores with larger block sizes as
+ * if they have a smaller block size (for example, to use FatFs on a
+ * store with 4K blocks). In that case the most recently accessed block
+ * of the underlying store is kept in a caller-provided buffer, so that
+ * consecutive reads and writes within one underlying block need only a
+ * single read. Writes that do not cover a whole underlying block are
+ * written back when a different underlying block is accessed, on
+ * flush() and on destruction.
  */
 class ScaleStore : public Store {
 
@@ -28,21 +39,61 @@ private:
     Store *store;
 
     /// Block size scale. The block size of this store must be a
-    /// multiple of that of the underlying block store.
+    /// multiple of that of the underlying block store, or the other
+    /// way around when scaling down.
     size_t scale;
 
+    /// Whether the block size of this store is smaller than that of the underlying store.
+    bool down;
+
+    // Down-scaling state {{{
+    uint8_t *buffer;      ///< Buffered underlying block.
+    size_t   bufferLba;   ///< LBA of the buffered block on the underlying store.
+    bool     bufferValid;
+    bool     bufferDirty; ///< Whether the buffered block must be written back.
+    // }}}
+
+    /// Write back the buffered block if it was modified.
+    StoreError writeBack();
+
+    /// Make the given underlying block the buffered block.
+    StoreError load(size_t lba);
+
+    StoreError readDown (size_t lba, size_t count, uint8_t *dest);
+    StoreError writeDown(size_t lba, size_t count, const uint8_t *src);
+
 public:
     StoreError seek(size_t lba);
 
-    StoreError read (void *buffer);
-    StoreError write(const void *buffer);
+    StoreError read (void *buffer_);
+    StoreError write(const void *buffer_);
+
+    StoreError readBlocks (size_t lba, size_t count, void *buffer_);
+    StoreError writeBlocks(size_t lba, size_t count, const void *buffer_);
+
+    /// When scaling down, only whole blocks of the underlying store are discarded.
+    StoreError discard(size_t lba, size_t count);
+
+    StoreError flush();
+
+    const uint8_t *borrowBlock        (size_t lba, size_t count = 1);
+          uint8_t *borrowBlockWritable(size_t lba, size_t count = 1);
+    StoreError     commitBlock        (size_t lba, size_t count = 1);
 
     using Store::read;
     using Store::write;
 
-    ScaleStore(Store *store_, size_t blockSize);
+    /**
+     * \brief ScaleStore constructor.
+     *
+     * \param store_ the store to pass calls to
+     * \param blockSize the block size of this store, a multiple or divisor of that of `store_`
+     * \param buffer_ when scaling down, a buffer that can hold a block of `store_`
+     */
+    ScaleStore(Store *store_, size_t blockSize, void *buffer_ = nullptr);
 
-    ~ScaleStore() = default;
+    /// Writes back the buffered block when scaling down.
+    ~ScaleStore();
 };
 
 }
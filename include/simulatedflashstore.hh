@@ -0,0 +1,184 @@
+/**
+ * \file
+ * \brief     SimulatedFlashStore header.
+ * \author    Chris Smeele
+ * \copyright Copyright (c) 2016, Chris Smeele
+ *
+ * Distributed under the Boost Software License, Version 1.0.
+ * See accompanying file LICENSE or copy at
+ * http://www.boost.org/LICENSE_1_0.txt
+ */
+#pragma once
+
+#include "store.hh"
+
+#include <memory>
+
+namespace MuStore {
+
+/**
+ * \brief Store decorator that models the timing of a flash medium, such as an SD card.
+ *
+ * Requests are passed on to the wrapped store unchanged, and their
+ * cost on the simulated device is added to a virtual clock. Nothing
+ * sleeps: the clock only advances by the simulated time of each
+ * operation, so benchmarks on a fast host show how an access pattern
+ * would perform on the device.
+ *
+ * The model:
+ *
+ * - Every read(), write(), readBlocks() and writeBlocks() call is one
+ *   command, with a fixed cost plus the transfer time over the bus.
+ *   Multi-block requests therefore pay the command cost only once.
+ * - Flash is erased in erase units, which are much larger than a
+ *   block. Written blocks are collected in a write buffer that can
+ *   hold a few erase units open at once.
+ * - A unit that is written completely is programmed right away.
+ * - When a partially written unit is closed, the device must read the
+ *   rest of the unit, erase it and program all of it (read-modify-write).
+ *   Units are closed when the buffer needs room for another unit (the
+ *   least recently written is closed first), and on flush().
+ *
+ * The cost of programming and read-modify-write is charged to the
+ * operation that caused it, as the device would stall that command.
+ *
+ * Blocks can not be borrowed, so that all access is accounted for.
+ */
+class SimulatedFlashStore : public Store {
+
+public:
+    /**
+     * \brief Device timing. Times are in nanoseconds, rates in bytes per second.
+     *
+     * The defaults approximate an SD card on a 20 MHz SPI bus.
+     */
+    struct Timing {
+        uint64_t readCommand;   ///< Fixed cost of a read command (100 us).
+        uint64_t writeCommand;  ///< Fixed cost of a write command (250 us).
+        uint64_t busRate;       ///< Host transfer rate (2.5 MB/s).
+        uint64_t flashReadRate; ///< Internal read rate, for read-modify-write (40 MB/s).
+        uint64_t programRate;   ///< Flash programming rate (8 MB/s).
+        uint64_t erase;         ///< Time to erase one erase unit (3 ms).
+
+        size_t eraseUnitSize;   ///< In bytes, a multiple of the block size (64 KiB).
+        size_t bufferUnits;     ///< Erase units the write buffer can hold open (2).
+
+        Timing();
+    };
+
+    /// Simulated time spent on one kind of operation.
+    struct OpStats {
+        size_t   count;
+        uint64_t time;    ///< Total simulated time in nanoseconds.
+        uint64_t maxTime; ///< Longest single operation in nanoseconds.
+    };
+
+    /// Simulation statistics.
+    struct Stats {
+        OpStats reads;    ///< Single and multi-block reads.
+        OpStats writes;   ///< Single and multi-block writes.
+        OpStats flushes;
+        OpStats discards;
+
+        size_t blocksRead;
+        size_t blocksWritten;
+        size_t unitPrograms; ///< Erase units programmed after being written completely.
+        size_t unitRmws;     ///< Erase units closed after a partial write.
+    };
+
+private:
+    /// An erase unit held open in the write buffer.
+    struct OpenUnit {
+        size_t   unit;
+        size_t   written;  ///< Blocks written since the unit was opened.
+        uint64_t lastUse;
+        bool     open;
+    };
+
+    /// The store we pass calls to.
+    Store *store;
+
+    Timing timing;
+    Stats  stats;
+
+    size_t unitBlocks; ///< Blocks per erase unit.
+
+    std::unique_ptr<OpenUnit[]> units;   ///< `timing.bufferUnits` entries.
+    std::unique_ptr<uint8_t[]>  written; ///< Per open unit, a bitmap of written blocks.
+    uint64_t useCount;
+
+    uint64_t now;         ///< The virtual clock.
+    uint64_t lastLatency; ///< Simulated time of the last operation.
+
+    /// Time to move `bytes` at `rate` bytes per second.
+    static uint64_t transfer(size_t bytes, uint64_t rate) {
+        return (uint64_t)bytes * 1000000000ull / rate;
+    }
+
+    uint8_t *bitmapOf(const OpenUnit *slot) const {
+        return written.get() + (size_t)(slot - units.get()) * ((unitBlocks + 7) / 8);
+    }
+
+    /// Program an open unit to flash and close it. Returns the time taken.
+    uint64_t close(OpenUnit *slot);
+
+    /// Put a written block in the write buffer. Returns the time spent making room or programming.
+    uint64_t buffer(size_t lba);
+
+    /// Advance the clock by the time of an operation.
+    void account(OpStats &op, uint64_t time);
+
+public:
+    StoreError seek(size_t lba);
+
+    StoreError read (void *buffer_);
+    StoreError write(const void *buffer_);
+
+    StoreError readBlocks (size_t lba, size_t count, void *buffer_);
+    StoreError writeBlocks(size_t lba, size_t count, const void *buffer_);
+
+    /// Costs a write command. Open erase units covered by the range are dropped from the buffer unprogrammed.
+    StoreError discard(size_t lba, size_t count);
+
+    /// Close all open erase units, then flush the underlying store.
+    StoreError flush();
+
+    using Store::read;
+    using Store::write;
+
+    /// Get the virtual clock, the total simulated time in nanoseconds.
+    uint64_t getTime() const { return now; }
+
+    /// Get the simulated time of the last operation in nanoseconds.
+    uint64_t getLastLatency() const { return lastLatency; }
+
+    /// Get the device timing.
+    const Timing &getTiming() const { return timing; }
+
+    /// Get simulation statistics.
+    const Stats &getStats() const { return stats; }
+
+    /// Reset simulation statistics. The clock keeps running.
+    void resetStats() { stats = Stats(); }
+
+    /**
+     * \brief SimulatedFlashStore constructor.
+     *
+     * An erase unit size that is not a multiple of the block size, or a
+     * write buffer without room for any units, results in a store
+     * without blocks.
+     *
+     * \param store_ the store holding the data
+     * \param timing_ the device timing
+     */
+    SimulatedFlashStore(Store *store_, const Timing &timing_ = Timing());
+
+    SimulatedFlashStore(SimulatedFlashStore &&other);
+
+    SimulatedFlashStore(const SimulatedFlashStore&) = delete;
+    SimulatedFlashStore &operator=(const SimulatedFlashStore&) = delete;
+
+    ~SimulatedFlashStore() = default;
+};
+
+}
@@ -0,0 +1,117 @@
+/**
+ * \file
+ * \brief     SparseMemStore header.
+ * \author    Chris Smeele
+ * \copyright Copyright (c) 2016, Chris Smeele
+ *
+ * Distributed under the Boost Software License, Version 1.0.
+ * See accompanying file LICENSE or copy at
+ * http://www.boost.org/LICENSE_1_0.txt
+ */
+#pragma once
+
+#include "store.hh"
+
+#include <memory>
+
+namespace MuStore {
+
+/**
+ * \brief Sparse, lazily allocated memory backend.
+ *
+ * The medium is divided into fixed-size pages, which are allocated on
+ * the heap when first written. Untouched blocks read as zeroes.
+ *
+ * Writes of all-zero data are not stored: they do not allocate a page,
+ * and a page that becomes all zeroes is freed. Memory use is therefore
+ * proportional to the amount of non-zero data on the medium.
+ *
+ * Pages are found through a two-level page table, whose second-level
+ * tables are allocated and freed along with their pages.
+ *
+ * A failed page allocation fails the write with STORE_ERR_IO.
+ *
+ * Only allocated pages can be borrowed from. Borrowing pins a page:
+ * it is no longer freed when it becomes all zeroes or is discarded,
+ * so that the pointer stays valid for the lifetime of the store.
+ */
+class SparseMemStore : public Store {
+
+public:
+    /// The amount of page pointers in a second-level page table.
+    static const size_t TABLE_SIZE = 512;
+
+private:
+    struct Table;
+
+    /// The first-level page table, nullptr if unusable.
+    std::unique_ptr<std::unique_ptr<Table>[]> tables;
+
+    size_t pageSize;
+    size_t pageCount;  ///< Allocated pages.
+    size_t tableCount; ///< Allocated second-level tables.
+
+    /// Get a page, or nullptr if it is not allocated.
+    uint8_t *getPage(size_t page) const;
+
+    /// Get a page, allocating it if needed. Returns nullptr on allocation failure.
+    uint8_t *allocPage(size_t page);
+
+    /// Free a page, and its table if that becomes empty. Pinned pages are kept.
+    void freePage(size_t page);
+
+    /// Keep an allocated page for the lifetime of the store, as it has been borrowed.
+    void pinPage(size_t page);
+    bool isPinned(size_t page) const;
+
+    /// Get the page and in-page offset of a block.
+    size_t pageOf  (size_t lba) const { return lba * blockSize / pageSize; }
+    size_t offsetOf(size_t lba) const { return lba * blockSize % pageSize; }
+
+public:
+    StoreError seek(size_t lba);
+
+    StoreError read (void *buffer);
+    StoreError write(const void *buffer);
+
+    StoreError readBlocks (size_t lba, size_t count, void *buffer);
+    StoreError writeBlocks(size_t lba, size_t count, const void *buffer);
+
+    /// Free the pages in the range, or zero them if pinned. Discarded blocks read as zeroes.
+    StoreError discard(size_t lba, size_t count);
+
+    const uint8_t *borrowBlock        (size_t lba, size_t count = 1);
+          uint8_t *borrowBlockWritable(size_t lba, size_t count = 1);
+
+    using Store::read;
+    using Store::write;
+
+    /// Get the page size in bytes.
+    size_t getPageSize() const { return pageSize; }
+
+    /// Get the amount of allocated pages.
+    size_t getPageCount() const { return pageCount; }
+
+    /// Get the amount of heap memory used for pages and page tables, in bytes.
+    size_t getMemoryUsage() const;
+
+    /**
+     * \brief SparseMemStore constructor.
+     *
+     * An invalid block or page size results in a store without blocks.
+     *
+     * \param size the size of the medium in bytes
+     * \param blockSize_ the block size in bytes, a power of two
+     * \param pageSize_ the page size in bytes, a power of two no smaller than the block size
+     */
+    SparseMemStore(size_t size, size_t blockSize_ = 512, size_t pageSize_ = 64 * 1024);
+
+    SparseMemStore(SparseMemStore &&other);
+
+    SparseMemStore(const SparseMemStore&) = delete;
+    SparseMemStore &operator=(const SparseMemStore&) = delete;
+
+    ~SparseMemStore();
+};
+
+}
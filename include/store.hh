@@ -25,6 +25,7 @@ enum StoreError : int {
     STORE_ERR_IO,            ///< Generic I/O error.
     STORE_ERR_NOT_WRITABLE,  ///< Write to read-only medium attempted.
     STORE_ERR_OUT_OF_BOUNDS, ///< Attempted I/O operation exceeded medium size.
+    STORE_ERR_CHECKSUM,      ///< Data read did not match its checksum.
 };
 
 /**
@@ -43,6 +44,16 @@ protected:
     size_t pos;        ///< Current block number (LBA), incremented on read/write ops.
     // }}}
 
+    /// Check whether `x` is a power of two, as required for block sizes.
+    static bool isPowerOfTwo(size_t x) {
+        return x && !(x & (x - 1));
+    }
+
+    /// Check whether `count` blocks starting at `lba` lie within the medium.
+    bool isRangeValid(size_t lba, size_t count) const {
+        return count <= blockCount && lba <= blockCount - count;
+    }
+
 public:
     /// \name Accessors
     /// @{
@@ -113,6 +124,23 @@ public:
      */
     virtual StoreError write(const void *buffer) = 0;
 
+    /**
+     * \brief Write back any buffered data to the medium.
+     *
+     * Stores that buffer or cache written blocks must write them to
+     * the medium before returning, decorators must also flush the
+     * store they wrap. Once flush() returns succesfully, all blocks
+     * written before the call have reached the medium, as far as the
+     * backend can tell.
+     *
+     * The default implementation does nothing, for stores that write
+     * blocks to the medium immediately.
+     *
+     * \retval STORE_ERR_OK
+     * \retval STORE_ERR_IO for backend errors
+     */
+    virtual StoreError flush() { return STORE_ERR_OK; }
+
     /// @}
 
     /// \name I/O Convenience Functions
@@ -136,6 +164,174 @@ public:
 
     /// @}
 
+    /// \name Multi-block I/O Operations
+    /// @{
+
+    /**
+     * \brief Read a range of consecutive blocks into the specified buffer.
+     *
+     * This is equivalent to a seek() to `lba` followed by `count`
+     * read() calls, but allows backends to transfer the entire range
+     * in a single request. The default implementation does exactly
+     * that, backends should override it where they can do better.
+     *
+     * The \ref pos "position" is set to `lba + count` after succesful completion.
+     * On error, the position is unspecified.
+     *
+     * \warning The caller must make sure the buffer can hold at least
+     * `count * getBlockSize()` bytes.
+     *
+     * \param lba the first block to read
+     * \param count the amount of blocks to read
+     * \param buffer the destination buffer
+     *
+     * \retval STORE_ERR_OK
+     * \retval STORE_ERR_OUT_OF_BOUNDS when the range exceeds getBlockCount()
+     * \retval STORE_ERR_IO for other backend errors
+     */
+    virtual StoreError readBlocks(size_t lba, size_t count, void *buffer) {
+        if (!isRangeValid(lba, count))
+            return STORE_ERR_OUT_OF_BOUNDS;
+        if (!count)
+            return STORE_ERR_OK;
+
+        StoreError err = seek(lba);
+        for (size_t i = 0; !err && i < count; i++)
+            err = read((uint8_t*)buffer + i * blockSize);
+        return err;
+    }
+
+    /**
+     * \brief Write a range of consecutive blocks from the specified buffer.
+     *
+     * This is equivalent to a seek() to `lba` followed by `count`
+     * write() calls, see readBlocks().
+     *
+     * The \ref pos "position" is set to `lba + count` after succesful completion.
+     * On error, the position is unspecified and any number of blocks
+     * in the range may have been written.
+     *
+     * \warning The caller must make sure the buffer holds at least
+     * `count * getBlockSize()` bytes.
+     *
+     * \param lba the first block to write
+     * \param count the amount of blocks to write
+     * \param buffer the source buffer
+     *
+     * \retval STORE_ERR_OK
+     * \retval STORE_ERR_NOT_WRITABLE when attempting to write to a read-only medium (check isWritable() first)
+     * \retval STORE_ERR_OUT_OF_BOUNDS when the range exceeds getBlockCount()
+     * \retval STORE_ERR_IO for other backend errors
+     */
+    virtual StoreError writeBlocks(size_t lba, size_t count, const void *buffer) {
+        if (!isRangeValid(lba, count))
+            return STORE_ERR_OUT_OF_BOUNDS;
+        if (!count)
+            return STORE_ERR_OK;
+
+        StoreError err = seek(lba);
+        for (size_t i = 0; !err && i < count; i++)
+            err = write((const uint8_t*)buffer + i * blockSize);
+        return err;
+    }
+
+    /**
+     * \brief Tell the store that a range of blocks is no longer in use.
+     *
+     * Backends may release the space held by the blocks, for example by
+     * punching holes in an image file or by freeing memory. Decorators
+     * drop their cached copies of the blocks and pass the request on.
+     *
+     * Discarded blocks have unspecified contents until they are written
+     * again: they may read as zeroes, or still hold their old data.
+     * The \ref pos "position" is not used or updated.
+     *
+     * The default implementation does nothing, discards are only hints.
+     *
+     * \param lba the first block to discard
+     * \param count the amount of blocks to discard
+     *
+     * \retval STORE_ERR_OK
+     * \retval STORE_ERR_NOT_WRITABLE when attempting to discard blocks of a read-only medium
+     * \retval STORE_ERR_OUT_OF_BOUNDS when the range exceeds getBlockCount()
+     * \retval STORE_ERR_IO for other backend errors
+     */
+    virtual StoreError discard(size_t lba, size_t count) {
+        if (!isRangeValid(lba, count))
+            return STORE_ERR_OUT_OF_BOUNDS;
+        if (!writable)
+            return STORE_ERR_NOT_WRITABLE;
+        return STORE_ERR_OK;
+    }
+
+    /// @}
+
+    /// \name Zero-copy Access
+    /// @{
+
+    /**
+     * \brief Get direct read access to a range of blocks.
+     *
+     * Stores that hold their blocks in addressable memory can return
+     * a pointer to the data, so that callers can read it in place
+     * instead of copying it into a buffer. The pointer remains valid
+     * for as long as the store exists, and reflects later writes.
+     *
+     * This is optional, the default implementation returns `nullptr`.
+     * Callers must fall back to read() or readBlocks() in that case.
+     * The \ref pos "position" is not used or updated.
+     *
+     * \param lba the first block
+     * \param count the amount of blocks
+     *
+     * \return a pointer to `count * getBlockSize()` bytes, or `nullptr`
+     */
+    virtual const uint8_t *borrowBlock(size_t lba, size_t count = 1) {
+        (void)lba;
+        (void)count;
+        return nullptr;
+    }
+
+    /**
+     * \brief Get direct write access to a range of blocks.
+     *
+     * Like borrowBlock(), but the data may be modified in place. After
+     * modifying it, the caller must call commitBlock() with the same
+     * range, to allow the store to persist the change.
+     *
+     * The default implementation returns `nullptr`, as do read-only
+     * stores. Callers must fall back to write() or writeBlocks() in
+     * that case.
+     *
+     * \param lba the first block
+     * \param count the amount of blocks
+     *
+     * \return a pointer to `count * getBlockSize()` bytes, or `nullptr`
+     */
+    virtual uint8_t *borrowBlockWritable(size_t lba, size_t count = 1) {
+        (void)lba;
+        (void)count;
+        return nullptr;
+    }
+
+    /**
+     * \brief Commit in-place modifications made through borrowBlockWritable().
+     *
+     * \param lba the first block
+     * \param count the amount of blocks
+     *
+     * \retval STORE_ERR_OK
+     * \retval STORE_ERR_OUT_OF_BOUNDS when the range exceeds getBlockCount()
+     * \retval STORE_ERR_IO for other backend errors
+     */
+    virtual StoreError commitBlock(size_t lba, size_t count = 1) {
+        if (!isRangeValid(lba, count))
+            return STORE_ERR_OUT_OF_BOUNDS;
+        return STORE_ERR_OK;
+    }
+
+    /// @}
+
     Store(size_t blockSize_ = 512, size_t blockCount_ = 0, bool writable_ = false)
         : blockSize(blockSize_),
           blockCount(blockCount_),
@@ -0,0 +1,102 @@
+/**
+ * \file
+ * \brief     StripeStore header.
+ * \author    Chris Smeele
+ * \copyright Copyright (c) 2016, Chris Smeele
+ *
+ * Distributed under the Boost Software License, Version 1.0.
+ * See accompanying file LICENSE or copy at
+ * http://www.boost.org/LICENSE_1_0.txt
+ */
+#pragma once
+
+#include "store.hh"
+
+#include <memory>
+
+namespace MuStore {
+
+/**
+ * \brief Stripes blocks across multiple stores (RAID-0).
+ *
+ * The volume is divided into stripe units of a fixed amount of blocks,
+ * which are distributed over the member stores round-robin. Multi-block
+ * requests are split into one sub-request per stripe unit, which are
+ * read into or written from the caller's buffer directly.
+ *
+ * In parallel mode, each member store has a worker thread, so that
+ * the sub-requests of different members are in flight at the same
+ * time. The calling thread handles the sub-requests of the first member
+ * it touches itself. Requests that touch only one member are never
+ * handed to a worker. A member store is only ever accessed by one
+ * thread at a time, so members need not be thread-safe.
+ *
+ * All members must have the same block size. The usable size of each
+ * member is that of the smallest member, rounded down to a whole stripe
+ * unit. The volume is writable if all members are writable.
+ */
+class StripeStore : public Store {
+
+    struct Members;
+
+    /// Member stores and their workers, nullptr if unusable.
+    std::unique_ptr<Members> members;
+
+    /// Amount of blocks per stripe unit.
+    size_t stripeUnit;
+
+    /**
+     * \brief Find the member containing a range of blocks.
+     *
+     * Borrowed blocks must be contiguous in memory, which is only the
+     * case for ranges within a single stripe unit.
+     *
+     * \return the member store, or nullptr if the range spans stripe units
+     */
+    Store *locate(size_t lba, size_t count, size_t &memberLba) const;
+
+public:
+    StoreError seek(size_t lba);
+
+    StoreError read (void *buffer);
+    StoreError write(const void *buffer);
+
+    StoreError readBlocks (size_t lba, size_t count, void *buffer);
+    StoreError writeBlocks(size_t lba, size_t count, const void *buffer);
+
+    StoreError discard(size_t lba, size_t count);
+
+    StoreError flush();
+
+    const uint8_t *borrowBlock        (size_t lba, size_t count = 1);
+          uint8_t *borrowBlockWritable(size_t lba, size_t count = 1);
+    StoreError     commitBlock        (size_t lba, size_t count = 1);
+
+    using Store::read;
+    using Store::write;
+
+    /// Get the amount of member stores.
+    size_t getMemberCount() const;
+
+    /// Get the amount of blocks per stripe unit.
+    size_t getStripeUnit() const { return stripeUnit; }
+
+    /**
+     * \brief StripeStore constructor.
+     *
+     * \param stores the member stores, in stripe order
+     * \param count the amount of member stores
+     * \param stripeUnit_ the amount of consecutive blocks stored on one member
+     * \param parallel whether to access members from worker threads in parallel
+     */
+    StripeStore(Store *const *stores, size_t count, size_t stripeUnit_ = 16, bool parallel = true);
+
+    StripeStore(StripeStore &&other);
+
+    StripeStore(const StripeStore&) = delete;
+    StripeStore &operator=(const StripeStore&) = delete;
+
+    ~StripeStore();
+};
+
+}
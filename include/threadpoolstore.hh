@@ -0,0 +1,91 @@
+/**
+ * \file
+ * \brief     ThreadPoolStore header.
+ * \author    Chris Smeele
+ * \copyright Copyright (c) 2016, Chris Smeele
+ *
+ * Distributed under the Boost Software License, Version 1.0.
+ * See accompanying file LICENSE or copy at
+ * http://www.boost.org/LICENSE_1_0.txt
+ */
+#pragma once
+
+#include "store.hh"
+#include "asyncstore.hh"
+
+#include <memory>
+
+namespace MuStore {
+
+/**
+ * \brief Asynchronous I/O for any Store using a pool of worker threads.
+ *
+ * Submitted requests are queued and executed by worker threads as
+ * readBlocks() and writeBlocks() calls on the wrapped store.
+ *
+ * Most stores can not be used from multiple threads at once, so by
+ * default the workers take turns accessing the wrapped store. That
+ * still frees the submitting thread, but does not put more than one
+ * request in flight on the medium. Stores whose readBlocks(),
+ * writeBlocks() and flush() can be called concurrently (such as
+ * PosixFileStore) can be marked thread-safe, so that each worker can
+ * have a request in flight.
+ *
+ * The synchronous Store operations are passed through to the wrapped
+ * store and can be mixed with asynchronous requests. flush() waits for
+ * all submitted requests to finish before flushing the wrapped store.
+ *
+ * The destructor waits for outstanding requests to finish.
+ */
+class ThreadPoolStore : public Store, public AsyncStore {
+
+    struct Pool;
+
+    /// Shared state of the worker threads, nullptr if unusable.
+    std::unique_ptr<Pool> pool;
+
+public:
+    StoreError seek(size_t lba);
+
+    StoreError read (void *buffer);
+    StoreError write(const void *buffer);
+
+    StoreError readBlocks (size_t lba, size_t count, void *buffer);
+    StoreError writeBlocks(size_t lba, size_t count, const void *buffer);
+
+    /// Wait for submitted requests to finish, then pass the discard on.
+    StoreError discard(size_t lba, size_t count);
+
+    StoreError flush();
+
+    using Store::read;
+    using Store::write;
+
+    StoreError submitRead (size_t lba, size_t count, void *buffer, void *cookie);
+    StoreError submitWrite(size_t lba, size_t count, const void *buffer, void *cookie);
+
+    size_t poll(Completion *completions, size_t max, size_t min = 0);
+
+    size_t getOutstanding() const;
+
+    /// Get the amount of worker threads.
+    size_t getThreadCount() const;
+
+    /**
+     * \brief ThreadPoolStore constructor.
+     *
+     * \param store the store to submit requests to
+     * \param threads the amount of worker threads, at least one
+     * \param threadSafe whether the store may be accessed from multiple threads at once
+     */
+    ThreadPoolStore(Store *store, size_t threads = 4, bool threadSafe = false);
+
+    ThreadPoolStore(ThreadPoolStore &&other);
+
+    ThreadPoolStore(const ThreadPoolStore&) = delete;
+    ThreadPoolStore &operator=(const ThreadPoolStore&) = delete;
+
+    ~ThreadPoolStore();
+};
+
+}
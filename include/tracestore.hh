@@ -0,0 +1,162 @@
+/**
+ * \file
+ * \brief     TraceStore header.
+ * \author    Chris Smeele
+ * \copyright Copyright (c) 2016, Chris Smeele
+ *
+ * Distributed under the Boost Software License, Version 1.0.
+ * See accompanying file LICENSE or copy at
+ * http://www.boost.org/LICENSE_1_0.txt
+ */
+#pragma once
+
+#include "store.hh"
+
+#include <cstdio>
+#include <memory>
+
+namespace MuStore {
+
+/// A traced operation.
+enum class TraceOp : uint8_t {
+    SEEK,    ///< seek(), `lba` only.
+    READ,    ///< read() or readBlocks().
+    WRITE,   ///< write() or writeBlocks().
+    FLUSH,   ///< flush(), no `lba` or `count`.
+    DISCARD, ///< discard().
+};
+
+/// One traced operation, see TraceStore.
+struct TraceRecord {
+    TraceOp    op;
+    StoreError err;      ///< Result of the operation.
+    size_t     lba;
+    size_t     count;
+    uint64_t   time;     ///< Start time in nanoseconds since the trace started.
+    uint64_t   duration; ///< Time taken in nanoseconds.
+};
+
+/**
+ * \brief Store decorator that records a trace of all operations.
+ *
+ * Every seek, read, write, flush and discard is passed on to the
+ * wrapped store and recorded with its LBA, block count, result,
+ * start time and duration. Traces hold no block data, so they can be
+ * shared where images can not. Read them with TraceReader, or replay
+ * them against any backend with `mureplay`.
+ *
+ * Records are delta encoded into variable length integers: a
+ * sequential access costs about four bytes plus its timing. They are
+ * buffered in memory and appended to the trace file when the buffer
+ * is full, on flush() and on destruction.
+ *
+ * Blocks can not be borrowed, so that all access shows up in the trace
+ * as reads and writes.
+ */
+class TraceStore : public Store {
+
+    /// The store we pass calls to.
+    Store *store;
+
+    FILE *fh;
+
+    std::unique_ptr<uint8_t[]> buffer;
+    size_t used;
+
+    size_t   records;
+    size_t   lastEnd;  ///< LBA following the last recorded operation.
+    uint64_t start;    ///< Clock value at the start of the trace.
+    uint64_t lastTime;
+
+    /// Append a record to the buffer, writing out the buffer when needed.
+    void record(TraceOp op, StoreError err, size_t lba, size_t count, uint64_t begin);
+
+    /// Write buffered records to the trace file.
+    bool writeOut();
+
+    void close();
+
+public:
+    StoreError seek(size_t lba);
+
+    StoreError read (void *buffer_);
+    StoreError write(const void *buffer_);
+
+    StoreError readBlocks (size_t lba, size_t count, void *buffer_);
+    StoreError writeBlocks(size_t lba, size_t count, const void *buffer_);
+
+    StoreError discard(size_t lba, size_t count);
+
+    /// Flush the underlying store, then write buffered records to the trace file.
+    StoreError flush();
+
+    using Store::read;
+    using Store::write;
+
+    /// Get the amount of operations recorded.
+    size_t getRecordCount() const { return records; }
+
+    /// Check whether the trace is being recorded, i.e. no trace file errors occurred.
+    bool isTracing() const { return fh != nullptr; }
+
+    /**
+     * \brief TraceStore constructor.
+     *
+     * The trace file is created or truncated. When it can not be
+     * opened, the store has no blocks.
+     *
+     * \param store_ the store to trace
+     * \param path the trace file
+     */
+    TraceStore(Store *store_, const char *path);
+
+    TraceStore(TraceStore &&other);
+
+    TraceStore(const TraceStore&) = delete;
+    TraceStore &operator=(const TraceStore&) = delete;
+
+    /// Writes out buffered records and closes the trace file.
+    ~TraceStore();
+};
+
+/**
+ * \brief Reads traces recorded by TraceStore.
+ */
+class TraceReader {
+
+    FILE *fh;
+
+    size_t   blockSize;
+    size_t   blockCount;
+    size_t   lastEnd;
+    uint64_t lastTime;
+
+    bool readVarint(uint64_t &value);
+
+public:
+    /// Check whether the trace was opened and its header is valid.
+    bool isValid() const { return fh != nullptr; }
+
+    /// Get the block size of the traced store.
+    size_t getBlockSize()  const { return blockSize;  }
+
+    /// Get the block count of the traced store.
+    size_t getBlockCount() const { return blockCount; }
+
+    /**
+     * \brief Read the next record.
+     *
+     * \return false at the end of the trace, or when it is truncated or corrupt
+     */
+    bool next(TraceRecord &rec);
+
+    /// Open a trace file.
+    TraceReader(const char *path);
+
+    TraceReader(const TraceReader&) = delete;
+    TraceReader &operator=(const TraceReader&) = delete;
+
+    ~TraceReader();
+};
+
+}
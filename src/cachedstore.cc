@@ -0,0 +1,443 @@
+/**
+ * \file
+ * \author    Chris Smeele
+ * \copyright Copyright (c) 2016, Chris Smeele
+ *
+ * Distributed under the Boost Software License, Version 1.0.
+ * See accompanying file LICENSE or copy at
+ * http://www.boost.org/LICENSE_1_0.txt
+ */
+#include "cachedstore.hh"
+
+#include <algorithm>
+#include <cstring>
+
+namespace MuStore {
+
+static size_t alignUp(size_t x, size_t alignment) {
+    return (x + alignment - 1) / alignment * alignment;
+}
+
+CachedStore::Line *CachedStore::lookup(size_t lba) {
+    Line *set = lines + (lba % setCount) * ways;
+
+    for (size_t i = 0; i < ways; i++) {
+        if (set[i].valid && set[i].lba == lba)
+            return &set[i];
+    }
+    return nullptr;
+}
+
+CachedStore::Line *CachedStore::allocate(size_t lba, uint8_t refs) {
+    Line *set = lines + (lba % setCount) * ways;
+    Line *victim = nullptr;
+
+    // Prefer an empty line.
+    for (size_t i = 0; i < ways && !victim; i++) {
+        if (!set[i].valid)
+            victim = &set[i];
+    }
+
+    // Otherwise take the first line without priority, aging the
+    // entire set until one exists.
+    while (!victim) {
+        for (size_t i = 0; i < ways && !victim; i++) {
+            if (!set[i].refs)
+                victim = &set[i];
+        }
+        if (!victim) {
+            for (size_t i = 0; i < ways; i++)
+                set[i].refs--;
+        }
+    }
+
+    if (victim->valid) {
+        // Keep the block cached if we cannot write it back, flush()
+        // will report the error.
+        if (victim->dirty && writeBackLine(victim))
+            return nullptr;
+
+        stats.evictions++;
+    }
+
+    victim->lba   = lba;
+    victim->valid = true;
+    victim->dirty = false;
+    victim->refs  = refs;
+
+    return victim;
+}
+
+StoreError CachedStore::writeBackLine(Line *line) {
+    auto err = store->write(line->lba, lineData(line));
+    if (err)
+        return err;
+
+    line->dirty = false;
+    dirtyCount--;
+    stats.writebacks++;
+
+    return STORE_ERR_OK;
+}
+
+StoreError CachedStore::writeBack() {
+    if (!dirtyCount)
+        return STORE_ERR_OK;
+
+    size_t n = 0;
+    for (size_t i = 0; i < lineCount; i++) {
+        if (lines[i].valid && lines[i].dirty)
+            order[n++] = &lines[i];
+    }
+
+    std::sort(order, order + n, [](const Line *a, const Line *b) {
+        return a->lba < b->lba;
+    });
+
+    // Write back as much as we can, report the first error.
+    StoreError result = STORE_ERR_OK;
+    for (size_t i = 0; i < n; i++) {
+        auto err = writeBackLine(order[i]);
+        if (err && !result)
+            result = err;
+    }
+
+    return result;
+}
+
+void CachedStore::drop(size_t lba, size_t count) {
+    auto dropLine = [this](Line *line) {
+        if (line->dirty)
+            dirtyCount--;
+        line->valid = false;
+        line->dirty = false;
+    };
+
+    if (count < lineCount) {
+        for (size_t i = 0; i < count; i++) {
+            Line *line = lookup(lba + i);
+            if (line)
+                dropLine(line);
+        }
+    } else {
+        // Cheaper to check every line than every block.
+        for (size_t i = 0; i < lineCount; i++) {
+            if (lines[i].valid && lines[i].lba >= lba && lines[i].lba - lba < count)
+                dropLine(&lines[i]);
+        }
+    }
+}
+
+StoreError CachedStore::readCached(size_t lba, void *buffer) {
+    Line *line = lookup(lba);
+
+    if (line) {
+        stats.hits++;
+        if (line->refs < MAX_REFS)
+            line->refs++;
+
+        memcpy(buffer, lineData(line), blockSize);
+
+    } else {
+        stats.misses++;
+
+        auto err = store->read(lba, buffer);
+        if (err)
+            return err;
+
+        // Sequentially read blocks are probably part of a scan,
+        // give them the lowest priority.
+        line = allocate(lba, lba == lastLba + 1 ? 0 : 1);
+        if (line)
+            memcpy(lineData(line), buffer, blockSize);
+    }
+
+    lastLba = lba;
+
+    return STORE_ERR_OK;
+}
+
+void CachedStore::updateCached(size_t lba, size_t count, const void *buffer) {
+    for (size_t i = 0; i < count; i++) {
+        Line *line = lookup(lba + i);
+        if (line) {
+            memcpy(lineData(line), (const uint8_t*)buffer + i * blockSize, blockSize);
+            if (line->dirty) {
+                line->dirty = false;
+                dirtyCount--;
+            }
+        }
+    }
+}
+
+StoreError CachedStore::writeCached(size_t lba, const void *buffer) {
+    Line *line = lookup(lba);
+
+    if (line) {
+        if (line->refs < MAX_REFS)
+            line->refs++;
+    } else {
+        line = allocate(lba, lba == lastLba + 1 ? 0 : 1);
+        if (!line)
+            // No room, write this block through instead.
+            return store->write(lba, buffer);
+    }
+
+    memcpy(lineData(line), buffer, blockSize);
+
+    if (!line->dirty) {
+        line->dirty = true;
+        dirtyCount++;
+    }
+
+    lastLba = lba;
+
+    return STORE_ERR_OK;
+}
+
+StoreError CachedStore::seek(size_t lba) {
+    if (!store)
+        return STORE_ERR_IO;
+    if (lba >= blockCount)
+        return STORE_ERR_OUT_OF_BOUNDS;
+
+    pos = lba;
+
+    return STORE_ERR_OK;
+}
+
+StoreError CachedStore::read(void *buffer) {
+    return readBlocks(pos, 1, buffer);
+}
+
+StoreError CachedStore::write(const void *buffer) {
+    return writeBlocks(pos, 1, buffer);
+}
+
+StoreError CachedStore::readBlocks(size_t lba, size_t count, void *buffer) {
+    if (!store)
+        return STORE_ERR_IO;
+    if (!isRangeValid(lba, count))
+        return STORE_ERR_OUT_OF_BOUNDS;
+
+    if (count == 1) {
+        auto err = readCached(lba, buffer);
+        if (!err)
+            pos = lba + 1;
+        return err;
+    }
+
+    // Serve the request from the cache if all blocks are present.
+    size_t cached = 0;
+    for (size_t i = 0; i < count && lookup(lba + i); i++)
+        cached++;
+
+    if (cached == count) {
+        for (size_t i = 0; i < count; i++)
+            readCached(lba + i, (uint8_t*)buffer + i * blockSize);
+
+        pos = lba + count;
+        return STORE_ERR_OK;
+    }
+
+    // Otherwise, pass the entire request on in one go.
+    auto err = store->readBlocks(lba, count, buffer);
+    if (err)
+        return err;
+
+    // Dirty blocks are newer than what the underlying store returned.
+    // Apply them before allocating lines, which may write back and
+    // replace some of them.
+    for (size_t i = 0; i < count; i++) {
+        Line *line = lookup(lba + i);
+        if (line) {
+            stats.hits++;
+            if (line->dirty)
+                memcpy((uint8_t*)buffer + i * blockSize, lineData(line), blockSize);
+        } else {
+            stats.misses++;
+        }
+    }
+
+    if (count <= scanThreshold) {
+        for (size_t i = 0; i < count; i++) {
+            if (lookup(lba + i))
+                continue;
+
+            Line *line = allocate(lba + i, 0);
+            if (line)
+                memcpy(lineData(line), (uint8_t*)buffer + i * blockSize, blockSize);
+        }
+    }
+
+    lastLba = lba + count - 1;
+    pos     = lba + count;
+
+    return STORE_ERR_OK;
+}
+
+StoreError CachedStore::writeBlocks(size_t lba, size_t count, const void *buffer) {
+    if (!store)
+        return STORE_ERR_IO;
+    if (!isRangeValid(lba, count))
+        return STORE_ERR_OUT_OF_BOUNDS;
+
+    if (writePolicy == WritePolicy::WRITE_THROUGH || count > scanThreshold) {
+        auto err = store->writeBlocks(lba, count, buffer);
+        if (err) {
+            // We do not know which blocks made it, drop them all.
+            drop(lba, count);
+            return err;
+        }
+
+        updateCached(lba, count, buffer);
+
+    } else {
+        if (!writable)
+            return STORE_ERR_NOT_WRITABLE;
+
+        for (size_t i = 0; i < count; i++) {
+            auto err = writeCached(lba + i, (const uint8_t*)buffer + i * blockSize);
+            if (err)
+                return err;
+        }
+
+        if (maxDirtyBytes && dirtyCount * blockSize >= maxDirtyBytes) {
+            auto err = writeBack();
+            if (err)
+                return err;
+        }
+    }
+
+    pos = lba + count;
+
+    return STORE_ERR_OK;
+}
+
+StoreError CachedStore::discard(size_t lba, size_t count) {
+    if (!store)
+        return STORE_ERR_IO;
+    if (!isRangeValid(lba, count))
+        return STORE_ERR_OUT_OF_BOUNDS;
+    if (!writable)
+        return STORE_ERR_NOT_WRITABLE;
+
+    // Dirty blocks in the range need not be written back.
+    drop(lba, count);
+
+    return store->discard(lba, count);
+}
+
+StoreError CachedStore::flush() {
+    if (!store)
+        return STORE_ERR_IO;
+
+    auto err = writeBack();
+    auto flushErr = store->flush();
+
+    return err ? err : flushErr;
+}
+
+StoreError CachedStore::setWritePolicy(WritePolicy policy, size_t maxDirtyBytes_) {
+    if (!store)
+        return STORE_ERR_IO;
+
+    writePolicy   = policy;
+    maxDirtyBytes = maxDirtyBytes_;
+
+    if (policy == WritePolicy::WRITE_THROUGH)
+        return writeBack();
+
+    return STORE_ERR_OK;
+}
+
+void CachedStore::invalidate() {
+    for (size_t i = 0; i < lineCount; i++) {
+        lines[i].valid = false;
+        lines[i].dirty = false;
+    }
+    dirtyCount = 0;
+}
+
+size_t CachedStore::getMemorySize(size_t blockSize_, size_t lineCount_) {
+    return alignUp(lineCount_ * blockSize_, alignof(Line))
+         + lineCount_ * (sizeof(Line) + sizeof(Line*));
+}
+
+CachedStore::CachedStore(Store *store_,
+                         void *memory,
+                         size_t size,
+                         size_t ways_,
+                         size_t scanThreshold_)
+    : Store(store_->getBlockSize(),
+            store_->getBlockCount(),
+            store_->isWritable()),
+      store(store_),
+      lines(nullptr),
+      data((uint8_t*)memory),
+      order(nullptr),
+      lineCount(0),
+      ways(ways_),
+      setCount(0),
+      scanThreshold(scanThreshold_),
+      lastLba(~(size_t)0),
+      writePolicy(WritePolicy::WRITE_THROUGH),
+      maxDirtyBytes(0),
+      dirtyCount(0),
+      stats() {
+
+    if (!ways || !memory) {
+        store = nullptr; // Fail.
+        return;
+    }
+
+    // Data goes first, so that it has the alignment of the memory
+    // region. Line metadata and the sort array follow.
+    lineCount = size / (blockSize + sizeof(Line) + sizeof(Line*));
+    while (lineCount) {
+        uintptr_t linesAddr = alignUp((uintptr_t)memory + lineCount * blockSize, alignof(Line));
+        if (linesAddr + lineCount * (sizeof(Line) + sizeof(Line*)) <= (uintptr_t)memory + size) {
+            lines = (Line*)linesAddr;
+            order = (Line**)(lines + lineCount);
+            break;
+        }
+        lineCount--;
+    }
+
+    lineCount -= lineCount % ways;
+    setCount   = lineCount / ways;
+
+    if (!setCount) {
+        store = nullptr; // Fail.
+        return;
+    }
+
+    invalidate();
+}
+
+CachedStore::CachedStore(CachedStore &&other)
+    : Store(other),
+      store(other.store),
+      lines(other.lines),
+      data(other.data),
+      order(other.order),
+      lineCount(other.lineCount),
+      ways(other.ways),
+      setCount(other.setCount),
+      scanThreshold(other.scanThreshold),
+      lastLba(other.lastLba),
+      writePolicy(other.writePolicy),
+      maxDirtyBytes(other.maxDirtyBytes),
+      dirtyCount(other.dirtyCount),
+      stats(other.stats) {
+
+    other.store      = nullptr;
+    other.dirtyCount = 0;
+}
+
+CachedStore::~CachedStore() {
+    if (store)
+        writeBack();
+}
+
+}
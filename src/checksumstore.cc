@@ -0,0 +1,235 @@
+/**
+ * \file
+ * \author    Chris Smeele
+ * \copyright Copyright (c) 2016, Chris Smeele
+ *
+ * Distributed under the Boost Software License, Version 1.0.
+ * See accompanying file LICENSE or copy at
+ * http://www.boost.org/LICENSE_1_0.txt
+ */
+#include "checksumstore.hh"
+#include "crc32c.hh"
+
+#include <memory>
+#include <new>
+
+namespace MuStore {
+
+StoreError ChecksumStore::verify(size_t lba, size_t count, const uint8_t *data) {
+    for (size_t i = 0; i < count; i++) {
+        stats.verified++;
+
+        if (crc32c(data + i * blockSize, blockSize) != sums[lba + i]) {
+            stats.mismatches++;
+            stats.lastMismatch = lba + i;
+            return STORE_ERR_CHECKSUM;
+        }
+    }
+
+    return STORE_ERR_OK;
+}
+
+StoreError ChecksumStore::update(size_t lba, size_t count, const uint8_t *data) {
+    for (size_t i = 0; i < count; i++)
+        sums[lba + i] = crc32c(data + i * blockSize, blockSize);
+
+    if (!sumStore)
+        return STORE_ERR_OK;
+
+    size_t perBlock = sumStore->getBlockSize() / sizeof(uint32_t);
+    size_t first    = lba / perBlock;
+    size_t last     = (lba + count - 1) / perBlock;
+
+    return sumStore->writeBlocks(first, last - first + 1, sums + first * perBlock);
+}
+
+StoreError ChecksumStore::seek(size_t lba) {
+    if (!store)
+        return STORE_ERR_IO;
+    if (lba >= blockCount)
+        return STORE_ERR_OUT_OF_BOUNDS;
+
+    pos = lba;
+
+    return STORE_ERR_OK;
+}
+
+StoreError ChecksumStore::read(void *buffer) {
+    return readBlocks(pos, 1, buffer);
+}
+
+StoreError ChecksumStore::write(const void *buffer) {
+    return writeBlocks(pos, 1, buffer);
+}
+
+StoreError ChecksumStore::readBlocks(size_t lba, size_t count, void *buffer) {
+    if (!store)
+        return STORE_ERR_IO;
+    if (!isRangeValid(lba, count))
+        return STORE_ERR_OUT_OF_BOUNDS;
+
+    auto err = store->readBlocks(lba, count, buffer);
+    if (!err)
+        err = verify(lba, count, (const uint8_t*)buffer);
+    if (!err)
+        pos = lba + count;
+
+    return err;
+}
+
+StoreError ChecksumStore::writeBlocks(size_t lba, size_t count, const void *buffer) {
+    if (!store)
+        return STORE_ERR_IO;
+    if (!writable)
+        return STORE_ERR_NOT_WRITABLE;
+    if (!isRangeValid(lba, count))
+        return STORE_ERR_OUT_OF_BOUNDS;
+
+    auto err = store->writeBlocks(lba, count, buffer);
+    if (!err)
+        err = update(lba, count, (const uint8_t*)buffer);
+    if (!err)
+        pos = lba + count;
+
+    return err;
+}
+
+StoreError ChecksumStore::discard(size_t lba, size_t count) {
+    if (!store)
+        return STORE_ERR_IO;
+    if (!writable)
+        return STORE_ERR_NOT_WRITABLE;
+    if (!isRangeValid(lba, count))
+        return STORE_ERR_OUT_OF_BOUNDS;
+    if (!count)
+        return STORE_ERR_OK;
+
+    auto err = store->discard(lba, count);
+    if (err)
+        return err;
+
+    // Discarded blocks may read as zeroes or as their old data, whichever the store chose.
+    return rebuild(lba, count);
+}
+
+StoreError ChecksumStore::flush() {
+    if (!store)
+        return STORE_ERR_IO;
+
+    auto err = store->flush();
+    if (!err && sumStore)
+        err = sumStore->flush();
+
+    return err;
+}
+
+const uint8_t *ChecksumStore::borrowBlock(size_t lba, size_t count) {
+    if (!store || !isRangeValid(lba, count))
+        return nullptr;
+
+    const uint8_t *blocks = store->borrowBlock(lba, count);
+
+    // Corrupt blocks are not lent out. Callers fall back to reading, which reports the error.
+    if (!blocks || verify(lba, count, blocks))
+        return nullptr;
+
+    return blocks;
+}
+
+uint8_t *ChecksumStore::borrowBlockWritable(size_t lba, size_t count) {
+    if (!store || !writable || !isRangeValid(lba, count))
+        return nullptr;
+
+    uint8_t *blocks = store->borrowBlockWritable(lba, count);
+    if (!blocks || verify(lba, count, blocks))
+        return nullptr;
+
+    return blocks;
+}
+
+StoreError ChecksumStore::commitBlock(size_t lba, size_t count) {
+    if (!store)
+        return STORE_ERR_IO;
+    if (!isRangeValid(lba, count))
+        return STORE_ERR_OUT_OF_BOUNDS;
+
+    auto err = store->commitBlock(lba, count);
+    if (err)
+        return err;
+
+    const uint8_t *blocks = store->borrowBlock(lba, count);
+    if (!blocks)
+        return STORE_ERR_IO;
+
+    return update(lba, count, blocks);
+}
+
+StoreError ChecksumStore::rebuild(size_t lba, size_t count) {
+    const size_t chunk = 64;
+    std::unique_ptr<uint8_t[]> buffer(new (std::nothrow) uint8_t[chunk * blockSize]);
+    if (!buffer)
+        return STORE_ERR_IO;
+
+    for (size_t end = lba + count; lba < end; lba += chunk) {
+        size_t n = end - lba < chunk ? end - lba : chunk;
+
+        auto err = store->readBlocks(lba, n, buffer.get());
+        if (!err)
+            err = update(lba, n, buffer.get());
+        if (err)
+            return err;
+    }
+
+    return STORE_ERR_OK;
+}
+
+StoreError ChecksumStore::rebuild() {
+    if (!store)
+        return STORE_ERR_IO;
+
+    return rebuild(0, blockCount);
+}
+
+size_t ChecksumStore::getTableSize(size_t blockCount, size_t sumBlockSize) {
+    if (!sumBlockSize)
+        return blockCount;
+
+    size_t perBlock = sumBlockSize / sizeof(uint32_t);
+    return (blockCount + perBlock - 1) / perBlock * perBlock;
+}
+
+ChecksumStore::ChecksumStore(Store *store_, uint32_t *sums_, size_t count, Store *sumStore_, bool build)
+    : Store(store_->getBlockSize(), store_->getBlockCount(), store_->isWritable()),
+      store(store_),
+      sums(sums_),
+      sumStore(sumStore_),
+      stats() {
+
+    size_t sumBlockSize = sumStore ? sumStore->getBlockSize() : 0;
+    size_t entries      = getTableSize(blockCount, sumBlockSize);
+
+    if (count < entries
+        || (sumStore && sumStore->getBlockCount() < entries / (sumBlockSize / sizeof(uint32_t)))
+        || (sumStore && build && !sumStore->isWritable())) {
+        store      = nullptr; // Fail.
+        blockCount = 0;
+        return;
+    }
+
+    // A read-only table can not be kept up to date.
+    if (sumStore && !sumStore->isWritable())
+        writable = false;
+
+    for (size_t i = blockCount; i < entries; i++)
+        sums[i] = 0;
+
+    StoreError err = sumStore && !build
+                   ? sumStore->readBlocks(0, entries / (sumBlockSize / sizeof(uint32_t)), sums)
+                   : rebuild();
+    if (err) {
+        store      = nullptr; // Fail.
+        blockCount = 0;
+    }
+}
+
+}
@@ -0,0 +1,354 @@
+/**
+ * \file
+ * \author    Chris Smeele
+ * \copyright Copyright (c) 2016, Chris Smeele
+ *
+ * Distributed under the Boost Software License, Version 1.0.
+ * See accompanying file LICENSE or copy at
+ * http://www.boost.org/LICENSE_1_0.txt
+ */
+#include "compressedstore.hh"
+#include "lz.hh"
+
+#include <cstring>
+#include <new>
+
+namespace MuStore {
+
+static const char     CONTAINER_MAGIC[8] = { 'M', 'U', 'C', 'O', 'M', 'P', 'R', 'S' };
+static const uint64_t CONTAINER_VERSION  = 1;
+
+/// Upper limit on the size of a group in bytes, to reject corrupt headers.
+static const size_t MAX_GROUP_SIZE = 16 * 1024 * 1024;
+
+static const size_t INDEX_ENTRY_SIZE = 16;
+
+enum GroupEncoding : uint32_t {
+    GROUP_ZERO = 0, ///< All zeroes, no data stored.
+    GROUP_RAW  = 1, ///< Stored uncompressed.
+    GROUP_LZ   = 2, ///< Compressed with lzCompress().
+};
+
+static uint64_t le64(const uint8_t *p) {
+    uint64_t x = 0;
+    for (size_t i = 0; i < 8; i++)
+        x |= (uint64_t)p[i] << (i * 8);
+    return x;
+}
+
+static uint32_t le32(const uint8_t *p) {
+    return (uint32_t)p[0]       | (uint32_t)p[1] << 8
+         | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static void putLe64(uint8_t *p, uint64_t x) {
+    for (size_t i = 0; i < 8; i++)
+        p[i] = (uint8_t)(x >> (i * 8));
+}
+
+static void putLe32(uint8_t *p, uint32_t x) {
+    for (size_t i = 0; i < 4; i++)
+        p[i] = (uint8_t)(x >> (i * 8));
+}
+
+static bool isZero(const uint8_t *data, size_t size) {
+    return !size || (!data[0] && !memcmp(data, data + 1, size - 1));
+}
+
+static size_t divCeil(size_t x, size_t y) {
+    return (x + y - 1) / y;
+}
+
+size_t CompressedStore::groupSize(size_t group) const {
+    size_t left = blockCount - group * groupBlocks;
+    return left < groupBlocks ? left : groupBlocks;
+}
+
+StoreError CompressedStore::loadGroup(size_t group, uint8_t *buffer) {
+    const uint8_t *entry = &index[group * INDEX_ENTRY_SIZE];
+
+    size_t lba      = (size_t)le64(entry);
+    size_t size     = le32(entry + 8);
+    auto   encoding = le32(entry + 12);
+    size_t blocks   = groupSize(group);
+    size_t bytes    = blocks * blockSize;
+
+    switch (encoding) {
+    case GROUP_ZERO:
+        memset(buffer, 0, bytes);
+        return STORE_ERR_OK;
+
+    case GROUP_RAW:
+        if (size != bytes)
+            return STORE_ERR_IO;
+        return container->readBlocks(lba, blocks, buffer) ? STORE_ERR_IO : STORE_ERR_OK;
+
+    case GROUP_LZ:
+        if (!size || size > bytes)
+            return STORE_ERR_IO;
+        if (container->readBlocks(lba, divCeil(size, blockSize), input.get()))
+            return STORE_ERR_IO;
+        return lzDecompress(input.get(), size, buffer, bytes) ? STORE_ERR_OK : STORE_ERR_IO;
+
+    default:
+        return STORE_ERR_IO;
+    }
+}
+
+const uint8_t *CompressedStore::getGroup(size_t group, StoreError &err) {
+    size_t groupBytes = groupBlocks * blockSize;
+    size_t victim     = 0;
+
+    for (size_t i = 0; i < slotCount; i++) {
+        if (slots[i].group == group) {
+            slots[i].lastUse = ++useClock;
+            stats.hits++;
+            return &cache[i * groupBytes];
+        }
+        if (slots[i].lastUse < slots[victim].lastUse)
+            victim = i;
+    }
+
+    uint8_t *data = &cache[victim * groupBytes];
+
+    err = loadGroup(group, data);
+    if (err) {
+        slots[victim] = Slot { groupCount, 0 };
+        return nullptr;
+    }
+
+    slots[victim] = Slot { group, ++useClock };
+    stats.misses++;
+
+    return data;
+}
+
+StoreError CompressedStore::seek(size_t lba) {
+    if (!container)
+        return STORE_ERR_IO;
+    if (lba >= blockCount)
+        return STORE_ERR_OUT_OF_BOUNDS;
+
+    pos = lba;
+
+    return STORE_ERR_OK;
+}
+
+StoreError CompressedStore::read(void *buffer) {
+    return readBlocks(pos, 1, buffer);
+}
+
+StoreError CompressedStore::write(const void *buffer) {
+    return writeBlocks(pos, 1, buffer);
+}
+
+StoreError CompressedStore::readBlocks(size_t lba, size_t count, void *buffer) {
+    if (!container)
+        return STORE_ERR_IO;
+    if (!isRangeValid(lba, count))
+        return STORE_ERR_OUT_OF_BOUNDS;
+
+    uint8_t *dst = (uint8_t*)buffer;
+
+    for (size_t i = 0; i < count; ) {
+        size_t group  = (lba + i) / groupBlocks;
+        size_t offset = (lba + i) % groupBlocks;
+        size_t blocks = groupSize(group) - offset;
+        if (blocks > count - i)
+            blocks = count - i;
+
+        bool cached = false;
+        for (size_t j = 0; j < slotCount; j++)
+            cached = cached || slots[j].group == group;
+
+        StoreError err = STORE_ERR_OK;
+
+        if (!offset && blocks == groupSize(group) && !cached) {
+            // Whole groups need not pass through the cache.
+            err = loadGroup(group, dst + i * blockSize);
+            stats.directGroups++;
+        } else {
+            const uint8_t *data = getGroup(group, err);
+            if (data)
+                memcpy(dst + i * blockSize, data + offset * blockSize, blocks * blockSize);
+        }
+        if (err)
+            return err;
+
+        i += blocks;
+    }
+
+    pos = lba + count;
+
+    return STORE_ERR_OK;
+}
+
+StoreError CompressedStore::writeBlocks(size_t lba, size_t count, const void *buffer) {
+    (void)buffer;
+
+    if (!container)
+        return STORE_ERR_IO;
+    if (!isRangeValid(lba, count))
+        return STORE_ERR_OUT_OF_BOUNDS;
+
+    return STORE_ERR_NOT_WRITABLE;
+}
+
+size_t CompressedStore::getMaxContainerBlockCount(size_t blockCount, size_t blockSize, size_t groupBlocks) {
+    size_t groups = divCeil(blockCount, groupBlocks);
+
+    return 1 + divCeil(groups * INDEX_ENTRY_SIZE, blockSize) + blockCount;
+}
+
+StoreError CompressedStore::pack(Store *image, Store *container, size_t groupBlocks, size_t *usedBlocks) {
+    size_t blockSize  = image->getBlockSize();
+    size_t blockCount = image->getBlockCount();
+
+    if (!container->isWritable())
+        return STORE_ERR_NOT_WRITABLE;
+    if (container->getBlockSize() != blockSize
+        || !groupBlocks
+        || groupBlocks > MAX_GROUP_SIZE / blockSize
+        || container->getBlockCount() < getMaxContainerBlockCount(blockCount, blockSize, groupBlocks))
+        return STORE_ERR_OUT_OF_BOUNDS;
+
+    size_t groupBytes  = groupBlocks * blockSize;
+    size_t groupCount  = divCeil(blockCount, groupBlocks);
+    size_t indexBlocks = divCeil(groupCount * INDEX_ENTRY_SIZE, blockSize);
+
+    // Header and index, followed by an uncompressed and a compressed group.
+    std::unique_ptr<uint8_t[]> buffer(new (std::nothrow) uint8_t[(1 + indexBlocks) * blockSize + 2 * groupBytes]());
+    if (!buffer)
+        return STORE_ERR_IO;
+
+    uint8_t *header     = buffer.get();
+    uint8_t *index      = header + blockSize;
+    uint8_t *group      = index + indexBlocks * blockSize;
+    uint8_t *compressed = group + groupBytes;
+
+    size_t lba = 1 + indexBlocks;
+
+    for (size_t g = 0; g < groupCount; g++) {
+        size_t blocks = blockCount - g * groupBlocks < groupBlocks ? blockCount - g * groupBlocks : groupBlocks;
+        size_t bytes  = blocks * blockSize;
+
+        auto err = image->readBlocks(g * groupBlocks, blocks, group);
+        if (err)
+            return err;
+
+        uint8_t *entry = index + g * INDEX_ENTRY_SIZE;
+
+        if (isZero(group, bytes)) {
+            putLe64(entry,      0);
+            putLe32(entry +  8, 0);
+            putLe32(entry + 12, GROUP_ZERO);
+            continue;
+        }
+
+        // Only keep the compressed group if it saves at least one block.
+        size_t size = lzCompress(group, bytes, compressed, bytes - blockSize);
+        if (size) {
+            size_t padded = divCeil(size, blockSize) * blockSize;
+            memset(compressed + size, 0, padded - size);
+
+            err = container->writeBlocks(lba, padded / blockSize, compressed);
+            putLe32(entry + 8,  (uint32_t)size);
+            putLe32(entry + 12, GROUP_LZ);
+        } else {
+            err = container->writeBlocks(lba, blocks, group);
+            putLe32(entry + 8,  (uint32_t)bytes);
+            putLe32(entry + 12, GROUP_RAW);
+        }
+        if (err)
+            return err;
+
+        putLe64(entry, lba);
+        lba += divCeil(le32(entry + 8), blockSize);
+    }
+
+    memcpy(header, CONTAINER_MAGIC, sizeof(CONTAINER_MAGIC));
+    putLe64(header +  8, CONTAINER_VERSION);
+    putLe64(header + 16, blockSize);
+    putLe64(header + 24, blockCount);
+    putLe64(header + 32, groupBlocks);
+
+    auto err = container->writeBlocks(0, 1 + indexBlocks, header);
+    if (!err)
+        err = container->flush();
+    if (!err && usedBlocks)
+        *usedBlocks = lba;
+
+    return err;
+}
+
+CompressedStore::CompressedStore(Store *container_, size_t cacheGroups)
+    : Store(container_->getBlockSize(), 0, false),
+      container(container_),
+      groupBlocks(0),
+      groupCount(0),
+      slotCount(cacheGroups),
+      useClock(0),
+      stats() {
+
+    std::unique_ptr<uint8_t[]> header(new (std::nothrow) uint8_t[blockSize]);
+
+    if (!cacheGroups
+        || !header
+        || container->readBlocks(0, 1, header.get())
+        || memcmp(header.get(), CONTAINER_MAGIC, sizeof(CONTAINER_MAGIC))
+        || le64(header.get() +  8) != CONTAINER_VERSION
+        || le64(header.get() + 16) != blockSize) {
+        container = nullptr; // Fail.
+        return;
+    }
+
+    size_t count = (size_t)le64(header.get() + 24);
+    groupBlocks  = (size_t)le64(header.get() + 32);
+
+    if (!groupBlocks || groupBlocks > MAX_GROUP_SIZE / blockSize) {
+        container = nullptr; // Fail.
+        return;
+    }
+
+    groupCount = divCeil(count, groupBlocks);
+    size_t indexBlocks = divCeil(groupCount * INDEX_ENTRY_SIZE, blockSize);
+    size_t groupBytes  = groupBlocks * blockSize;
+
+    if (indexBlocks >= container->getBlockCount()) {
+        container = nullptr; // Fail.
+        return;
+    }
+
+    index.reset(new (std::nothrow) uint8_t[indexBlocks * blockSize]);
+    input.reset(new (std::nothrow) uint8_t[groupBytes]);
+    cache.reset(new (std::nothrow) uint8_t[cacheGroups * groupBytes]);
+    slots.reset(new (std::nothrow) Slot[cacheGroups]);
+
+    if (!index || !input || !cache || !slots
+        || container->readBlocks(1, indexBlocks, index.get())) {
+        container = nullptr; // Fail.
+        return;
+    }
+
+    for (size_t i = 0; i < slotCount; i++)
+        slots[i] = Slot { groupCount, 0 };
+
+    blockCount = count;
+}
+
+CompressedStore::CompressedStore(CompressedStore &&other)
+    : Store(other),
+      container  (other.container),
+      groupBlocks(other.groupBlocks),
+      groupCount (other.groupCount),
+      index      (std::move(other.index)),
+      input      (std::move(other.input)),
+      cache      (std::move(other.cache)),
+      slots      (std::move(other.slots)),
+      slotCount  (other.slotCount),
+      useClock   (other.useClock),
+      stats      (other.stats) {
+    other.container  = nullptr;
+}
+
+}
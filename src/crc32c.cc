@@ -0,0 +1,254 @@
+/**
+ * \file
+ * \author    Chris Smeele
+ * \copyright Copyright (c) 2016, Chris Smeele
+ *
+ * Distributed under the Boost Software License, Version 1.0.
+ * See accompanying file LICENSE or copy at
+ * http://www.boost.org/LICENSE_1_0.txt
+ *
+ * The interleaved hardware CRC and the zeros operators used to combine
+ * its parts follow Mark Adler's crc32c.c.
+ */
+#include "crc32c.hh"
+
+#include <cstring>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define MUSTORE_CRC32C_SSE42
+#include <nmmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#define MUSTORE_CRC32C_ARM
+#include <arm_acle.h>
+#endif
+
+namespace MuStore {
+
+/// CRC32C polynomial, reversed.
+static const uint32_t POLY = 0x82f63b78;
+
+struct SliceTable {
+    uint32_t t[8][256];
+
+    SliceTable() {
+        for (uint32_t n = 0; n < 256; n++) {
+            uint32_t crc = n;
+            for (size_t k = 0; k < 8; k++)
+                crc = crc & 1 ? (crc >> 1) ^ POLY : crc >> 1;
+            t[0][n] = crc;
+        }
+        for (size_t n = 0; n < 256; n++) {
+            for (size_t k = 1; k < 8; k++)
+                t[k][n] = (t[k - 1][n] >> 8) ^ t[0][t[k - 1][n] & 0xff];
+        }
+    }
+};
+
+static const SliceTable &sliceTable() {
+    static const SliceTable table;
+    return table;
+}
+
+uint32_t crc32cPortable(const void *data, size_t size, uint32_t crc) {
+    const auto    &t    = sliceTable().t;
+    const uint8_t *next = (const uint8_t*)data;
+
+    crc = ~crc;
+
+    while (size && ((uintptr_t)next & 7)) {
+        crc = t[0][(crc ^ *next++) & 0xff] ^ (crc >> 8);
+        size--;
+    }
+    while (size >= 8) {
+        uint64_t word;
+        memcpy(&word, next, sizeof(word));
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        word = __builtin_bswap64(word);
+#endif
+        word ^= crc;
+        crc = t[7][ word        & 0xff] ^ t[6][(word >>  8) & 0xff]
+            ^ t[5][(word >> 16) & 0xff] ^ t[4][(word >> 24) & 0xff]
+            ^ t[3][(word >> 32) & 0xff] ^ t[2][(word >> 40) & 0xff]
+            ^ t[1][(word >> 48) & 0xff] ^ t[0][ word >> 56        ];
+        next += 8;
+        size -= 8;
+    }
+    while (size--)
+        crc = t[0][(crc ^ *next++) & 0xff] ^ (crc >> 8);
+
+    return ~crc;
+}
+
+#if defined(MUSTORE_CRC32C_SSE42) || defined(MUSTORE_CRC32C_ARM)
+
+/// Part sizes for the interleaved CRC, chosen to fit 512 and 4096 byte blocks.
+/// These must be powers of two, see zerosOperator().
+static const size_t LONG  = 1024;
+static const size_t SHORT = 128;
+
+/// Multiply a vector by a GF(2) matrix.
+static uint32_t gf2MatrixTimes(const uint32_t *mat, uint32_t vec) {
+    uint32_t sum = 0;
+    for (; vec; vec >>= 1, mat++) {
+        if (vec & 1)
+            sum ^= *mat;
+    }
+    return sum;
+}
+
+static void gf2MatrixSquare(uint32_t *square, const uint32_t *mat) {
+    for (size_t n = 0; n < 32; n++)
+        square[n] = gf2MatrixTimes(mat, mat[n]);
+}
+
+/// Build the operator that appends len zero bytes to a CRC, len must be a power of two.
+static void zerosOperator(uint32_t *even, size_t len) {
+    uint32_t odd[32];
+
+    // The operator for one zero bit.
+    odd[0] = POLY;
+    for (size_t n = 1; n < 32; n++)
+        odd[n] = (uint32_t)1 << (n - 1);
+
+    gf2MatrixSquare(even, odd); // Two zero bits.
+    gf2MatrixSquare(odd, even); // Four zero bits.
+
+    // Square until the operator for len bytes is reached.
+    do {
+        gf2MatrixSquare(even, odd);
+        len >>= 1;
+        if (!len)
+            return;
+        gf2MatrixSquare(odd, even);
+        len >>= 1;
+    } while (len);
+
+    memcpy(even, odd, sizeof(odd));
+}
+
+struct ShiftTables {
+    uint32_t longZeros [4][256];
+    uint32_t shortZeros[4][256];
+
+    static void build(uint32_t zeros[4][256], size_t len) {
+        uint32_t op[32];
+        zerosOperator(op, len);
+
+        for (uint32_t n = 0; n < 256; n++) {
+            zeros[0][n] = gf2MatrixTimes(op, n);
+            zeros[1][n] = gf2MatrixTimes(op, n << 8);
+            zeros[2][n] = gf2MatrixTimes(op, n << 16);
+            zeros[3][n] = gf2MatrixTimes(op, n << 24);
+        }
+    }
+
+    ShiftTables() {
+        build(longZeros,  LONG);
+        build(shortZeros, SHORT);
+    }
+};
+
+static const ShiftTables &shiftTables() {
+    static const ShiftTables tables;
+    return tables;
+}
+
+/// Append the zeros of a shift table to a CRC.
+static uint32_t shift(const uint32_t zeros[4][256], uint32_t crc) {
+    return zeros[0][crc & 0xff]         ^ zeros[1][(crc >> 8) & 0xff]
+         ^ zeros[2][(crc >> 16) & 0xff] ^ zeros[3][crc >> 24];
+}
+
+#if defined(MUSTORE_CRC32C_SSE42)
+#define MUSTORE_CRC32C_TARGET __attribute__((target("sse4.2")))
+static inline MUSTORE_CRC32C_TARGET uint64_t crcWord(uint64_t crc, uint64_t word) { return _mm_crc32_u64(crc, word); }
+static inline MUSTORE_CRC32C_TARGET uint32_t crcByte(uint32_t crc, uint8_t  byte) { return _mm_crc32_u8 (crc, byte); }
+#else
+#define MUSTORE_CRC32C_TARGET
+static inline uint64_t crcWord(uint64_t crc, uint64_t word) { return __crc32cd((uint32_t)crc, word); }
+static inline uint32_t crcByte(uint32_t crc, uint8_t  byte) { return __crc32cb(crc, byte); }
+#endif
+
+static inline uint64_t load64(const uint8_t *p) {
+    uint64_t x;
+    memcpy(&x, p, sizeof(x));
+    return x;
+}
+
+/// Run three interleaved CRCs over parts of len bytes, while the buffer allows.
+static inline MUSTORE_CRC32C_TARGET
+uint64_t crcTriple(const uint8_t *&data, size_t &size, uint64_t crc0, size_t len, const uint32_t zeros[4][256]) {
+    // Work on copies, so that the loop does not go through memory.
+    const uint8_t *next = data;
+    size_t         left = size;
+
+    while (left >= 3 * len) {
+        uint64_t crc1 = 0;
+        uint64_t crc2 = 0;
+
+        const uint8_t *end = next + len;
+        do {
+            crc0 = crcWord(crc0, load64(next));
+            crc1 = crcWord(crc1, load64(next + len));
+            crc2 = crcWord(crc2, load64(next + 2 * len));
+            next += 8;
+        } while (next < end);
+
+        crc0 = shift(zeros, (uint32_t)crc0) ^ crc1;
+        crc0 = shift(zeros, (uint32_t)crc0) ^ crc2;
+
+        next += 2 * len;
+        left -= 3 * len;
+    }
+
+    data = next;
+    size = left;
+
+    return crc0;
+}
+
+static MUSTORE_CRC32C_TARGET uint32_t crc32cHardware(const void *data, size_t size, uint32_t crc) {
+    const ShiftTables &tables = shiftTables();
+    const uint8_t     *next   = (const uint8_t*)data;
+
+    uint64_t crc0 = ~crc;
+
+    while (size && ((uintptr_t)next & 7)) {
+        crc0 = crcByte((uint32_t)crc0, *next++);
+        size--;
+    }
+
+    crc0 = crcTriple(next, size, crc0, LONG,  tables.longZeros);
+    crc0 = crcTriple(next, size, crc0, SHORT, tables.shortZeros);
+
+    for (; size >= 8; size -= 8, next += 8)
+        crc0 = crcWord(crc0, load64(next));
+    while (size--)
+        crc0 = crcByte((uint32_t)crc0, *next++);
+
+    return ~(uint32_t)crc0;
+}
+
+#endif
+
+bool crc32cIsAccelerated() {
+#if defined(MUSTORE_CRC32C_SSE42)
+    static const bool accelerated = __builtin_cpu_supports("sse4.2");
+    return accelerated;
+#elif defined(MUSTORE_CRC32C_ARM)
+    return true;
+#else
+    return false;
+#endif
+}
+
+uint32_t crc32c(const void *data, size_t size, uint32_t crc) {
+#if defined(MUSTORE_CRC32C_SSE42) || defined(MUSTORE_CRC32C_ARM)
+    if (crc32cIsAccelerated())
+        return crc32cHardware(data, size, crc);
+#endif
+    return crc32cPortable(data, size, crc);
+}
+
+}
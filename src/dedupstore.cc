@@ -0,0 +1,418 @@
+/**
+ * \file
+ * \author    Chris Smeele
+ * \copyright Copyright (c) 2016, Chris Smeele
+ *
+ * Distributed under the Boost Software License, Version 1.0.
+ * See accompanying file LICENSE or copy at
+ * http://www.boost.org/LICENSE_1_0.txt
+ */
+#include "dedupstore.hh"
+
+#include <cstring>
+#include <new>
+
+namespace MuStore {
+
+/// Check whether a region contains only zero bytes.
+static bool isZero(const uint8_t *data, size_t size) {
+    return !size || (!data[0] && !memcmp(data, data + 1, size - 1));
+}
+
+void DedupStore::indexInsert(uint32_t chunk) {
+    size_t slot = slotOf(chunks[chunk].hash);
+
+    while (index[slot])
+        slot = (slot + 1) & indexMask;
+
+    index[slot] = chunk + 1;
+}
+
+void DedupStore::indexRemove(uint32_t chunk) {
+    size_t slot = slotOf(chunks[chunk].hash);
+
+    while (index[slot] != chunk + 1) {
+        if (!index[slot])
+            return; // Not indexed.
+        slot = (slot + 1) & indexMask;
+    }
+
+    // Shift back entries that would otherwise become unreachable.
+    for (size_t next = (slot + 1) & indexMask; index[next]; next = (next + 1) & indexMask) {
+        size_t home = slotOf(chunks[index[next] - 1].hash);
+
+        // Entries whose home lies cyclically in (slot, next] can stay.
+        bool stays = slot <= next
+                   ? slot < home && home <= next
+                   : slot < home || home <= next;
+        if (stays)
+            continue;
+
+        index[slot] = index[next];
+        slot        = next;
+    }
+
+    index[slot] = 0;
+}
+
+uint32_t DedupStore::find(const Hash128 &hash, const uint8_t *data) {
+    for (size_t slot = slotOf(hash); index[slot]; slot = (slot + 1) & indexMask) {
+        uint32_t id = index[slot];
+        if (chunks[id - 1].hash != hash)
+            continue;
+
+        if (!verify)
+            return id;
+
+        // Colliding chunks are simply not shared.
+        if (!chunkStore->read(id - 1, scratch.get())
+            && !memcmp(scratch.get(), data, blockSize))
+            return id;
+    }
+
+    return 0;
+}
+
+bool DedupStore::release(uint32_t id) {
+    Chunk &chunk = chunks[id - 1];
+
+    if (--chunk.refs)
+        return false;
+
+    indexRemove(id - 1);
+
+    chunk.next = (uint32_t)freeList;
+    freeList   = id;
+    usedChunks--;
+
+    return true;
+}
+
+StoreError DedupStore::writeBlock(size_t lba, const uint8_t *data) {
+    uint32_t old = map[lba];
+    uint32_t id  = 0;
+
+    if (!isZero(data, blockSize)) {
+        Hash128 hash = hash128(data, blockSize);
+
+        id = find(hash, data);
+        if (id) {
+            if (id == old)
+                return STORE_ERR_OK;
+
+            chunks[id - 1].refs++;
+
+        } else if (old && chunks[old - 1].refs == 1) {
+            // The old chunk is not shared: overwrite it in place. It
+            // stays indexed under its old hash if the write fails.
+            if (chunkStore->write(old - 1, data))
+                return STORE_ERR_IO;
+
+            indexRemove(old - 1);
+            chunks[old - 1].hash = hash;
+            indexInsert(old - 1);
+
+            return STORE_ERR_OK;
+
+        } else {
+            if (!freeList)
+                return STORE_ERR_IO; // The chunk store is full.
+
+            id = (uint32_t)freeList;
+
+            if (chunkStore->write(id - 1, data))
+                return STORE_ERR_IO;
+
+            freeList = chunks[id - 1].next;
+            chunks[id - 1].hash = hash;
+            chunks[id - 1].refs = 1;
+            indexInsert(id - 1);
+            usedChunks++;
+        }
+    }
+
+    // Freed chunks are discarded as a hint only, errors do not matter.
+    if (old && old != id && release(old))
+        chunkStore->discard(old - 1, 1);
+
+    map[lba] = id;
+
+    return STORE_ERR_OK;
+}
+
+StoreError DedupStore::writeMap(size_t lba, size_t count) {
+    if (!mapStore)
+        return STORE_ERR_OK;
+
+    size_t perBlock = mapStore->getBlockSize() / sizeof(uint32_t);
+    size_t first    = lba / perBlock;
+    size_t last     = (lba + count - 1) / perBlock;
+
+    return mapStore->writeBlocks(first, last - first + 1, map.get() + first * perBlock);
+}
+
+StoreError DedupStore::seek(size_t lba) {
+    if (!chunkStore)
+        return STORE_ERR_IO;
+    if (lba >= blockCount)
+        return STORE_ERR_OUT_OF_BOUNDS;
+
+    pos = lba;
+
+    return STORE_ERR_OK;
+}
+
+StoreError DedupStore::read(void *buffer) {
+    return readBlocks(pos, 1, buffer);
+}
+
+StoreError DedupStore::write(const void *buffer) {
+    return writeBlocks(pos, 1, buffer);
+}
+
+StoreError DedupStore::readBlocks(size_t lba, size_t count, void *buffer) {
+    if (!chunkStore)
+        return STORE_ERR_IO;
+    if (!isRangeValid(lba, count))
+        return STORE_ERR_OUT_OF_BOUNDS;
+
+    uint8_t *dst = (uint8_t*)buffer;
+
+    for (size_t i = 0; i < count; ) {
+        uint32_t first = map[lba + i];
+
+        // Find a run of zero blocks, or of consecutive chunks.
+        size_t n = 1;
+        if (first) {
+            while (i + n < count && map[lba + i + n] == first + n)
+                n++;
+
+            if (chunkStore->readBlocks(first - 1, n, dst + i * blockSize))
+                return STORE_ERR_IO;
+        } else {
+            while (i + n < count && !map[lba + i + n])
+                n++;
+
+            memset(dst + i * blockSize, 0, n * blockSize);
+        }
+
+        i += n;
+    }
+
+    pos = lba + count;
+
+    return STORE_ERR_OK;
+}
+
+StoreError DedupStore::writeBlocks(size_t lba, size_t count, const void *buffer) {
+    if (!chunkStore)
+        return STORE_ERR_IO;
+    if (!writable)
+        return STORE_ERR_NOT_WRITABLE;
+    if (!isRangeValid(lba, count))
+        return STORE_ERR_OUT_OF_BOUNDS;
+
+    const uint8_t *src = (const uint8_t*)buffer;
+
+    StoreError err = STORE_ERR_OK;
+    size_t     done = 0;
+
+    for (; done < count && !err; done++)
+        err = writeBlock(lba + done, src + done * blockSize);
+
+    // Persist the map for the blocks that were written, even after a failure.
+    StoreError mapErr = done ? writeMap(lba, done) : STORE_ERR_OK;
+    if (!err)
+        err = mapErr;
+    if (!err)
+        pos = lba + count;
+
+    return err;
+}
+
+StoreError DedupStore::discard(size_t lba, size_t count) {
+    if (!chunkStore)
+        return STORE_ERR_IO;
+    if (!writable)
+        return STORE_ERR_NOT_WRITABLE;
+    if (!isRangeValid(lba, count))
+        return STORE_ERR_OUT_OF_BOUNDS;
+    if (!count)
+        return STORE_ERR_OK;
+
+    // Discard freed chunks in runs of consecutive chunks.
+    size_t runStart = 0;
+    size_t runCount = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        uint32_t id = map[lba + i];
+        if (!id)
+            continue;
+
+        map[lba + i] = 0;
+
+        if (!release(id))
+            continue;
+
+        if (runCount && runStart + runCount == id - 1) {
+            runCount++;
+        } else {
+            if (runCount)
+                chunkStore->discard(runStart, runCount);
+            runStart = id - 1;
+            runCount = 1;
+        }
+    }
+    if (runCount)
+        chunkStore->discard(runStart, runCount);
+
+    return writeMap(lba, count);
+}
+
+StoreError DedupStore::flush() {
+    if (!chunkStore)
+        return STORE_ERR_IO;
+
+    auto err = chunkStore->flush();
+    if (!err && mapStore)
+        err = mapStore->flush();
+
+    return err;
+}
+
+size_t DedupStore::getMappedCount() const {
+    size_t mapped = 0;
+
+    for (size_t i = 0; i < blockCount; i++)
+        mapped += !!map[i];
+
+    return mapped;
+}
+
+size_t DedupStore::getMemoryUsage() const {
+    if (!chunkStore)
+        return 0;
+
+    size_t mapEntries = mapStore
+                      ? getMapSize(blockCount, mapStore->getBlockSize())
+                        * (mapStore->getBlockSize() / sizeof(uint32_t))
+                      : blockCount;
+
+    return mapEntries * sizeof(uint32_t)
+         + chunkCount * sizeof(Chunk)
+         + (indexMask + 1) * sizeof(uint32_t)
+         + blockSize;
+}
+
+size_t DedupStore::getMapSize(size_t blockCount, size_t mapBlockSize) {
+    size_t perBlock = mapBlockSize / sizeof(uint32_t);
+
+    return (blockCount + perBlock - 1) / perBlock;
+}
+
+bool DedupStore::load() {
+    if (mapStore && mapStore->readBlocks(0, getMapSize(blockCount, mapStore->getBlockSize()), map.get()))
+        return false;
+
+    for (size_t i = 0; i < blockCount; i++) {
+        uint32_t id = map[i];
+        if (!id)
+            continue;
+        if (id > chunkCount)
+            return false;
+
+        if (!chunks[id - 1].refs++)
+            usedChunks++;
+    }
+
+    // Free chunks are chained in ascending order, used chunks are hashed.
+    for (size_t i = chunkCount; i > 0; i--) {
+        Chunk &chunk = chunks[i - 1];
+
+        if (!chunk.refs) {
+            chunk.next = (uint32_t)freeList;
+            freeList   = i;
+            continue;
+        }
+
+        if (chunkStore->read(i - 1, scratch.get()))
+            return false;
+
+        chunk.hash = hash128(scratch.get(), blockSize);
+        indexInsert((uint32_t)(i - 1));
+    }
+
+    return true;
+}
+
+DedupStore::DedupStore(Store *chunkStore_, size_t blockCount_, Store *mapStore_, bool verify_)
+    : Store(chunkStore_->getBlockSize(), blockCount_, chunkStore_->isWritable()),
+      chunkStore(chunkStore_),
+      mapStore(mapStore_),
+      verify(verify_),
+      indexMask(0),
+      chunkCount(chunkStore_->getBlockCount()),
+      usedChunks(0),
+      freeList(0) {
+
+    size_t mapEntries = blockCount;
+
+    if (mapStore) {
+        size_t mapBlockSize = mapStore->getBlockSize();
+
+        if (mapBlockSize < sizeof(uint32_t)
+            || mapStore->getBlockCount() < getMapSize(blockCount, mapBlockSize)) {
+            chunkStore = nullptr; // Fail.
+            blockCount = 0;
+            return;
+        }
+
+        mapEntries = getMapSize(blockCount, mapBlockSize) * (mapBlockSize / sizeof(uint32_t));
+
+        // A read-only map can not be kept up to date.
+        if (!mapStore->isWritable())
+            writable = false;
+    }
+
+    if (!chunkCount || chunkCount > UINT32_MAX) {
+        chunkStore = nullptr; // Fail.
+        blockCount = 0;
+        return;
+    }
+
+    // Keep the index at most half full.
+    size_t indexSize = 1;
+    while (indexSize < chunkCount * 2)
+        indexSize *= 2;
+    indexMask = indexSize - 1;
+
+    map    .reset(new (std::nothrow) uint32_t[mapEntries]());
+    chunks .reset(new (std::nothrow) Chunk[chunkCount]());
+    index  .reset(new (std::nothrow) uint32_t[indexSize]());
+    scratch.reset(new (std::nothrow) uint8_t[blockSize]);
+
+    if (!map || !chunks || !index || !scratch || !load()) {
+        chunkStore = nullptr; // Fail.
+        blockCount = 0;
+    }
+}
+
+DedupStore::DedupStore(DedupStore &&other)
+    : Store(other),
+      chunkStore(other.chunkStore),
+      mapStore  (other.mapStore),
+      verify    (other.verify),
+      map       (std::move(other.map)),
+      chunks    (std::move(other.chunks)),
+      index     (std::move(other.index)),
+      indexMask (other.indexMask),
+      chunkCount(other.chunkCount),
+      usedChunks(other.usedChunks),
+      freeList  (other.freeList),
+      scratch   (std::move(other.scratch)) {
+    other.chunkStore = nullptr;
+}
+
+DedupStore::~DedupStore() = default;
+
+}
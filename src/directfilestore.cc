@@ -0,0 +1,123 @@
+/**
+ * \file
+ * \author    Chris Smeele
+ * \copyright Copyright (c) 2016, Chris Smeele
+ *
+ * Distributed under the Boost Software License, Version 1.0.
+ * See accompanying file LICENSE or copy at
+ * http://www.boost.org/LICENSE_1_0.txt
+ */
+
+/// For 64-bit file offsets. Note: this is not portable outside of *nix platforms.
+#define _FILE_OFFSET_BITS 64
+
+#include "directfilestore.hh"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#endif
+
+namespace MuStore {
+
+StoreError DirectFileStore::readAt(size_t lba, size_t count, void *buffer) {
+    if ((uintptr_t)buffer % blockSize == 0)
+        return PosixFileStore::readAt(lba, count, buffer);
+
+    if (fd < 0)
+        return STORE_ERR_IO;
+    if (!isRangeValid(lba, count))
+        return STORE_ERR_OUT_OF_BOUNDS;
+
+    // Allocated per request: a shared bounce buffer would make
+    // concurrent positional I/O unsafe.
+    size_t chunk = std::min(count, std::max(MAX_BOUNCE_SIZE / blockSize, (size_t)1));
+    void *bounce = nullptr;
+    if (posix_memalign(&bounce, blockSize, chunk * blockSize))
+        return STORE_ERR_IO;
+
+    StoreError err = STORE_ERR_OK;
+    for (size_t done = 0; !err && done < count; done += chunk) {
+        size_t n = std::min(chunk, count - done);
+        err = PosixFileStore::readAt(lba + done, n, bounce);
+        if (!err)
+            memcpy((uint8_t*)buffer + done * blockSize, bounce, n * blockSize);
+    }
+
+    free(bounce);
+
+    return err;
+}
+
+StoreError DirectFileStore::writeAt(size_t lba, size_t count, const void *buffer) {
+    if ((uintptr_t)buffer % blockSize == 0)
+        return PosixFileStore::writeAt(lba, count, buffer);
+
+    if (fd < 0)
+        return STORE_ERR_IO;
+    if (!isRangeValid(lba, count))
+        return STORE_ERR_OUT_OF_BOUNDS;
+    if (!writable)
+        return STORE_ERR_NOT_WRITABLE;
+
+    size_t chunk = std::min(count, std::max(MAX_BOUNCE_SIZE / blockSize, (size_t)1));
+    void *bounce = nullptr;
+    if (posix_memalign(&bounce, blockSize, chunk * blockSize))
+        return STORE_ERR_IO;
+
+    StoreError err = STORE_ERR_OK;
+    for (size_t done = 0; !err && done < count; done += chunk) {
+        size_t n = std::min(chunk, count - done);
+        memcpy(bounce, (const uint8_t*)buffer + done * blockSize, n * blockSize);
+        err = PosixFileStore::writeAt(lba + done, n, bounce);
+    }
+
+    free(bounce);
+
+    return err;
+}
+
+DirectFileStore::DirectFileStore(const char *path, bool writable_, size_t blockSize_)
+    : PosixFileStore(path, writable_, blockSize_, O_DIRECT),
+      direct(true),
+      preferredIoSize(blockSize_) {
+
+    if (fd < 0 && errno == EINVAL && isPowerOfTwo(blockSize)) {
+        // The file system does not support O_DIRECT, fall back to regular I/O.
+        direct = false;
+        openFile(path, 0);
+    }
+
+    if (fd < 0)
+        return;
+
+    if (blockSize < 512 || !isPowerOfTwo(blockSize)) {
+        ::close(fd);
+        fd = -1;
+        return;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st))
+        return;
+
+    if (st.st_blksize > 0)
+        preferredIoSize = std::max(blockSize, (size_t)st.st_blksize);
+
+#if defined(__linux__) && defined(BLKIOOPT)
+    if (S_ISBLK(st.st_mode)) {
+        unsigned int ioOpt = 0;
+        if (!ioctl(fd, BLKIOOPT, &ioOpt) && ioOpt)
+            preferredIoSize = std::max(blockSize, (size_t)ioOpt);
+    }
+#endif
+}
+
+}
@@ -192,6 +192,46 @@ StoreError FatFs::writeCacheBlock(size_t lba, const void *buffer, void *cache, s
     return STORE_ERR_OK;
 }
 
+StoreError FatFs::borrowCacheBlock(size_t lba, void *cache, size_t &cacheLba, const void **buffer) {
+    // Read in place if possible.
+    const uint8_t *block = store->borrowBlock(lba);
+    if (block) {
+        *buffer = block;
+        return STORE_ERR_OK;
+    }
+
+    auto err = readCacheBlock(lba, cache, cacheLba);
+    if (!err)
+        *buffer = cache;
+    return err;
+}
+
+StoreError FatFs::borrowFatBlock(size_t blockNo, const void **buffer) {
+    return borrowCacheBlock(fatLba + blockNo, fatCache, fatCacheLba, buffer);
+}
+
+StoreError FatFs::editFatBlock(size_t blockNo, void **buffer) {
+    // Modify in place if possible.
+    uint8_t *block = store->borrowBlockWritable(fatLba + blockNo);
+    if (block) {
+        *buffer = block;
+        return STORE_ERR_OK;
+    }
+
+    return readFatBlock(blockNo, buffer);
+}
+
+StoreError FatFs::commitFatBlock(size_t blockNo, void *buffer) {
+    if (buffer == fatCache)
+        return writeFatBlock(blockNo, buffer);
+
+    // The block was modified in place, the cached copy is stale.
+    if (fatCacheLba == fatLba + blockNo)
+        fatCacheLba = 0;
+
+    return store->commitBlock(fatLba + blockNo);
+}
+
 StoreError FatFs::readFatBlock(size_t blockNo, void **buffer) {
     auto err = readCacheBlock(fatLba + blockNo, fatCache, fatCacheLba);
     if (!err)
@@ -222,11 +262,43 @@ StoreError FatFs::writeDataBlock(size_t blockNo, const void *buffer) {
     return writeCacheBlock(dataLba + blockNo, buffer, dataCache, dataCacheLba);
 }
 
+void FatFs::discardDataBlocks(size_t blockNo, size_t count) {
+    if (dataCacheLba >= dataLba + blockNo && dataCacheLba - (dataLba + blockNo) < count)
+        dataCacheLba = 0; // Invalidate the cache.
+
+    // Discards are only hints, a failure does not affect the filesystem.
+    store->discard(dataLba + blockNo, count);
+}
+
 // Note: not valid for FAT32.
 StoreError FatFs::writeRootBlock(size_t blockNo, const void *buffer) {
     return writeCacheBlock(rootLba + blockNo, buffer, dataCache, dataCacheLba);
 }
 
+FsError FatFs::getNodeBlockLba(FsNode &node, size_t &lba) {
+    NodeContext *ctx = static_cast<NodeContext*>(getNodeContext(node));
+
+    if (!strcmp(node.getName(), "/") && (subType == SubType::FAT12 || subType == SubType::FAT16)) {
+        // Special handling for the root directory region in FAT1x.
+
+        if (ctx->currentBlock >= rootDirEntryCount * sizeof(DirEntry) / logicalSectorSize)
+            // Hard limit of root directory reached.
+            return FS_EOF;
+
+        lba = rootLba + ctx->currentBlock;
+
+        return FS_ERR_OK;
+
+    } else {
+        if (ctx->currentBlock == BLOCK_EOC)
+            return FS_EOF;
+
+        lba = dataLba + ctx->currentBlock;
+
+        return FS_ERR_OK;
+    }
+}
+
 FsError FatFs::readNodeBlock(FsNode &node, void **buffer) {
     NodeContext *ctx = static_cast<NodeContext*>(getNodeContext(node));
 
@@ -255,6 +327,19 @@ FsError FatFs::readNodeBlock(FsNode &node, void **buffer) {
     }
 }
 
+FsError FatFs::borrowNodeBlock(FsNode &node, const void **buffer) {
+    size_t lba;
+    auto err = getNodeBlockLba(node, lba);
+    if (err)
+        return err;
+
+    auto blockErr = borrowCacheBlock(lba, dataCache, dataCacheLba, buffer);
+    if (blockErr)
+        return FS_ERR_IO;
+
+    return FS_ERR_OK;
+}
+
 FsError FatFs::writeNodeBlock(FsNode &node, const void *buffer) {
     NodeContext *ctx = static_cast<NodeContext*>(getNodeContext(node));
 
@@ -286,34 +371,34 @@ FsError FatFs::writeNodeBlock(FsNode &node, const void *buffer) {
 FsError FatFs::getFatEntry(size_t clusterNo, size_t &entry) {
     size_t currentCluster = clusterNo;
     size_t nextCluster    = 0;
-    void  *buffer;
+    const void *buffer;
 
     if (subType == SubType::FAT12) {
         // Ugh.
 
         size_t byteOff = currentCluster * 3 / 2; // N 1-and-a-half bytes.
 
-        auto err = readFatBlock(byteOff / logicalSectorSize, &buffer);
+        auto err = borrowFatBlock(byteOff / logicalSectorSize, &buffer);
         if (err)
             return FS_ERR_IO;
 
         nextCluster |=
             currentCluster & 1
-            ? ((uint8_t*)buffer)[byteOff % 512] >> 4
-            : ((uint8_t*)buffer)[byteOff % 512];
+            ? ((const uint8_t*)buffer)[byteOff % 512] >> 4
+            : ((const uint8_t*)buffer)[byteOff % 512];
 
         byteOff++;
 
         // It seems FAT12 cluster numbers can be spread over multiple FAT sectors.
         // I do not like this.
-        err = readFatBlock(byteOff / logicalSectorSize, &buffer);
+        err = borrowFatBlock(byteOff / logicalSectorSize, &buffer);
         if (err)
             return FS_ERR_IO;
 
         nextCluster |=
             currentCluster & 1
-            ? (uint32_t)((uint8_t*)buffer)[byteOff % 512] << 4
-            : ((uint32_t)((uint8_t*)buffer)[byteOff % 512] & 0x0f) << 8;
+            ? (uint32_t)((const uint8_t*)buffer)[byteOff % 512] << 4
+            : ((uint32_t)((const uint8_t*)buffer)[byteOff % 512] & 0x0f) << 8;
 
     } else {
         // Yay.
@@ -322,14 +407,14 @@ FsError FatFs::getFatEntry(size_t clusterNo, size_t &entry) {
             ? logicalSectorSize / 2
             : logicalSectorSize / 4;
 
-        auto err = readFatBlock(currentCluster / clustersPerFatSector, &buffer);
+        auto err = borrowFatBlock(currentCluster / clustersPerFatSector, &buffer);
         if (err)
             return FS_ERR_IO;
 
         if (subType == SubType::FAT16) {
-            nextCluster = ((uint16_t*)buffer)[currentCluster % clustersPerFatSector];
+            nextCluster = ((const uint16_t*)buffer)[currentCluster % clustersPerFatSector];
         } else if (subType == SubType::FAT32) {
-            nextCluster = ((uint32_t*)buffer)[currentCluster % clustersPerFatSector];
+            nextCluster = ((const uint32_t*)buffer)[currentCluster % clustersPerFatSector];
         }
     }
 
@@ -346,7 +431,7 @@ FsError FatFs::setFatEntry(size_t clusterNo, size_t nextCluster) {
 
         size_t byteOff = clusterNo * 3 / 2; // N 1-and-a-half bytes.
 
-        auto err = readFatBlock(byteOff / logicalSectorSize, &buffer);
+        auto err = editFatBlock(byteOff / logicalSectorSize, &buffer);
         if (err)
             return FS_ERR_IO;
 
@@ -356,7 +441,7 @@ FsError FatFs::setFatEntry(size_t clusterNo, size_t nextCluster) {
                | (uint8_t)((nextCluster & 0x0f)<<4))
             : (uint8_t)nextCluster;
 
-        err = writeFatBlock(byteOff / logicalSectorSize, buffer);
+        err = commitFatBlock(byteOff / logicalSectorSize, buffer);
         if (err)
             return FS_ERR_IO;
 
@@ -364,7 +449,7 @@ FsError FatFs::setFatEntry(size_t clusterNo, size_t nextCluster) {
 
         if (byteOff % logicalSectorSize == 0) {
             // We crossed a sector boundary.
-            err = readFatBlock(byteOff / logicalSectorSize, &buffer);
+            err = editFatBlock(byteOff / logicalSectorSize, &buffer);
             if (err)
                 return FS_ERR_IO;
         }
@@ -375,7 +460,7 @@ FsError FatFs::setFatEntry(size_t clusterNo, size_t nextCluster) {
             : (uint8_t)((((uint8_t*)buffer)[byteOff % 512] & 0xf0)
                | (uint8_t)(nextCluster >> 8));
 
-        err = writeFatBlock(byteOff / logicalSectorSize, buffer);
+        err = commitFatBlock(byteOff / logicalSectorSize, buffer);
         if (err)
             return FS_ERR_IO;
 
@@ -386,7 +471,7 @@ FsError FatFs::setFatEntry(size_t clusterNo, size_t nextCluster) {
             ? logicalSectorSize / 2
             : logicalSectorSize / 4;
 
-        auto err = readFatBlock(clusterNo / clustersPerFatSector, &buffer);
+        auto err = editFatBlock(clusterNo / clustersPerFatSector, &buffer);
         if (err)
             return FS_ERR_IO;
 
@@ -396,7 +481,7 @@ FsError FatFs::setFatEntry(size_t clusterNo, size_t nextCluster) {
             ((uint32_t*)buffer)[clusterNo % clustersPerFatSector] = (uint32_t)nextCluster;
         }
 
-        err = writeFatBlock(clusterNo / clustersPerFatSector, buffer);
+        err = commitFatBlock(clusterNo / clustersPerFatSector, buffer);
         if (err)
             return FS_ERR_IO;
     }
@@ -523,13 +608,13 @@ FsNode FatFs::readDir(FsNode &parent, FsError &err) {
         return {this};
     }
 
-    void    *buffer = nullptr;
-    DirEntry *entry = nullptr;
+    const void     *buffer = nullptr;
+    const DirEntry *entry  = nullptr;
 
     // Fetch the next regular direntry, skip 'disk' and 'volume label' types.
     bool gotEntry = false;
     do {
-        err = readNodeBlock(parent, &buffer);
+        err = borrowNodeBlock(parent, &buffer);
         if (err)
             return {this};
         if ((ctx->currentEntry + 1) % (logicalSectorSize / sizeof(DirEntry)) == 0) {
@@ -539,7 +624,7 @@ FsNode FatFs::readDir(FsNode &parent, FsError &err) {
         }
 
         // Adjust pointer to current directory entry.
-        entry = static_cast<DirEntry*>(buffer)
+        entry = static_cast<const DirEntry*>(buffer)
               + ctx->currentEntry % (logicalSectorSize / sizeof(DirEntry));
 
         if (!entry->name[0]) {
@@ -652,6 +737,10 @@ FsError FatFs::truncate(FsNode &file) {
     // Round down to cluster start.
     ctx->currentBlock -= ctx->currentBlock % clusterSize;
 
+    // Freed clusters are discarded in runs of contiguous clusters.
+    size_t discardStart = 0;
+    size_t discardCount = 0;
+
     // Truncate the cluster chain.
     for (size_t i = 0; ; i++) {
         size_t currentBlock   = ctx->currentBlock;
@@ -678,10 +767,23 @@ FsError FatFs::truncate(FsNode &file) {
             err = setFatEntry(currentCluster, CLUSTER_FREE);
             if (err)
                 return err;
+
+            size_t freedBlock = clusterToBlock(currentCluster);
+            if (discardCount && discardStart + discardCount == freedBlock) {
+                discardCount += clusterSize;
+            } else {
+                if (discardCount)
+                    discardDataBlocks(discardStart, discardCount);
+                discardStart = freedBlock;
+                discardCount = clusterSize;
+            }
         }
 
         if (ctx->currentBlock == BLOCK_EOC) {
             // This was the last entry.
+            if (discardCount)
+                discardDataBlocks(discardStart, discardCount);
+
             nodeUpdateSize(file, newSize);
             file.rewind();
             file.seek(newSize);
@@ -754,8 +856,10 @@ size_t FatFs::read(FsNode &file, void *dest, size_t size, FsError &err) {
         return 0;
     }
 
+    NodeContext *ctx = static_cast<NodeContext*>(getNodeContext(file));
+
     size_t bytesRead = 0;
-    void *buffer;
+    const void *buffer;
 
     if (file.getPos() >= file.getSize()) {
         err = FS_EOF;
@@ -764,26 +868,55 @@ size_t FatFs::read(FsNode &file, void *dest, size_t size, FsError &err) {
 
     // Read block-by-block until we fill the buffer or reach EOF.
     while (bytesRead < size) {
-        err = readNodeBlock(file, &buffer);
-        if (err)
-            return bytesRead;
-
         size_t sectorOffset = file.getPos() % logicalSectorSize;
-        size_t toCopy = std::min({
-            (size_t)(size - bytesRead),               // Requested read size.
-            (size_t)(file.getSize() - file.getPos()), // Remaining file size.
-            (size_t)logicalSectorSize - sectorOffset  // Remaining bytes in current sector.
-        });
+        size_t toCopy;
+
+        // Whole sectors are read straight into the destination
+        // buffer, as many as we can get from the current cluster.
+        size_t blocks = 0;
+        if (!sectorOffset && ctx->currentBlock != BLOCK_EOC)
+            blocks = std::min({
+                (size_t)(size - bytesRead) / logicalSectorSize,
+                (size_t)(file.getSize() - file.getPos()) / logicalSectorSize,
+                (size_t)(clusterSize - ctx->currentBlock % clusterSize)
+            });
+
+        if (blocks) {
+            auto blockErr = store->readBlocks(dataLba + ctx->currentBlock,
+                                              blocks,
+                                              (uint8_t*)dest + bytesRead);
+            if (blockErr) {
+                err = FS_ERR_IO;
+                return bytesRead;
+            }
 
-        memcpy(
-            (uint8_t*)dest   + bytesRead,
-            (uint8_t*)buffer + sectorOffset,
-            toCopy
-        );
+            toCopy = blocks * logicalSectorSize;
+
+            // Skip to the last block we read, the increment below
+            // takes us past it.
+            ctx->currentBlock += blocks - 1;
+
+        } else {
+            err = borrowNodeBlock(file, &buffer);
+            if (err)
+                return bytesRead;
+
+            toCopy = std::min({
+                (size_t)(size - bytesRead),               // Requested read size.
+                (size_t)(file.getSize() - file.getPos()), // Remaining file size.
+                (size_t)logicalSectorSize - sectorOffset  // Remaining bytes in current sector.
+            });
+
+            memcpy(
+                (uint8_t*)dest   + bytesRead,
+                (const uint8_t*)buffer + sectorOffset,
+                toCopy
+            );
+        }
 
         bytesRead += toCopy;
 
-        if ((file.getPos() % logicalSectorSize + toCopy) == logicalSectorSize) {
+        if ((sectorOffset + toCopy) % logicalSectorSize == 0) {
             // XXX: If EOF is reached at the end of the last sector, a
             //      new block is allocated after the last block. This
             //      makes append-writes easier, but can be slightly
@@ -13,6 +13,15 @@
 
 #include "filestore.hh"
 
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <cerrno>
+#include <fcntl.h>
+#endif
+
 namespace MuStore {
 
 void FileStore::close() {
@@ -72,8 +81,105 @@ StoreError FileStore::write(const void *buffer) {
     return STORE_ERR_OK;
 }
 
-FileStore::FileStore(const char *path, bool writable_)
-    : Store(512, 0, writable_) {
+StoreError FileStore::readBlocks(size_t lba, size_t count, void *buffer) {
+    if (!fh)
+        return STORE_ERR_IO;
+    if (!isRangeValid(lba, count))
+        return STORE_ERR_OUT_OF_BOUNDS;
+    if (!count)
+        return STORE_ERR_OK;
+
+    auto err = seek(lba);
+    if (err)
+        return err;
+
+    if (fread(buffer, blockSize, count, fh) != count) {
+        close();
+        return STORE_ERR_IO;
+    }
+
+    pos = lba + count;
+
+    return STORE_ERR_OK;
+}
+
+StoreError FileStore::writeBlocks(size_t lba, size_t count, const void *buffer) {
+    if (!fh)
+        return STORE_ERR_IO;
+    if (!isRangeValid(lba, count))
+        return STORE_ERR_OUT_OF_BOUNDS;
+    if (!writable)
+        return STORE_ERR_NOT_WRITABLE;
+    if (!count)
+        return STORE_ERR_OK;
+
+    auto err = seek(lba);
+    if (err)
+        return err;
+
+    if (fwrite(buffer, blockSize, count, fh) != count) {
+        close();
+        return STORE_ERR_IO;
+    }
+
+    pos = lba + count;
+
+    return STORE_ERR_OK;
+}
+
+StoreError FileStore::discard(size_t lba, size_t count) {
+    if (!fh)
+        return STORE_ERR_IO;
+    if (!isRangeValid(lba, count))
+        return STORE_ERR_OUT_OF_BOUNDS;
+    if (!writable)
+        return STORE_ERR_NOT_WRITABLE;
+    if (!count)
+        return STORE_ERR_OK;
+
+#ifdef __linux__
+    // Buffered writes to the range must not land after the hole is punched.
+    if (fflush(fh)) {
+        close();
+        return STORE_ERR_IO;
+    }
+
+    // Filesystems without hole punching simply keep the data.
+    if (fallocate(fileno(fh),
+                  FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+                  (off_t)(lba * blockSize),
+                  (off_t)(count * blockSize))
+        && errno != EOPNOTSUPP
+        && errno != ENOSYS)
+        return STORE_ERR_IO;
+#endif
+
+    return STORE_ERR_OK;
+}
+
+StoreError FileStore::flush() {
+    if (!fh)
+        return STORE_ERR_IO;
+
+    if (fflush(fh)) {
+        close();
+        return STORE_ERR_IO;
+    }
+
+#if defined(__unix__) || defined(__APPLE__)
+    if (fsync(fileno(fh)))
+        return STORE_ERR_IO;
+#endif
+
+    return STORE_ERR_OK;
+}
+
+FileStore::FileStore(const char *path, bool writable_, size_t blockSize_)
+    : Store(blockSize_, 0, writable_),
+      fh(nullptr) {
+
+    if (!isPowerOfTwo(blockSize_))
+        return;
 
     if (writable_)
         fh = fopen(path, "r+b");
@@ -0,0 +1,91 @@
+/**
+ * \file
+ * \author    Chris Smeele
+ * \copyright Copyright (c) 2016, Chris Smeele
+ *
+ * Distributed under the Boost Software License, Version 1.0.
+ * See accompanying file LICENSE or copy at
+ * http://www.boost.org/LICENSE_1_0.txt
+ *
+ * This is MurmurHash3_x64_128 by Austin Appleby (public domain), with
+ * the 64-bit seed applied to both halves of the state.
+ */
+#include "hash128.hh"
+
+#include <cstring>
+
+namespace MuStore {
+
+static const uint64_t C1 = 0x87c37b91114253d5ull;
+static const uint64_t C2 = 0x4cf5ad432745937full;
+
+static inline uint64_t rotl(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t load64(const uint8_t *p) {
+    uint64_t x;
+    memcpy(&x, p, sizeof(x));
+    return x;
+}
+
+/// Final avalanche of a state half.
+static inline uint64_t fmix(uint64_t k) {
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdull;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ull;
+    k ^= k >> 33;
+    return k;
+}
+
+Hash128 hash128(const void *data, size_t size, uint64_t seed) {
+    const uint8_t *p = (const uint8_t*)data;
+
+    uint64_t h1 = seed;
+    uint64_t h2 = seed;
+
+    for (size_t i = 0; i < size / 16; i++, p += 16) {
+        uint64_t k1 = load64(p);
+        uint64_t k2 = load64(p + 8);
+
+        k1 *= C1; k1 = rotl(k1, 31); k1 *= C2; h1 ^= k1;
+        h1  = rotl(h1, 27); h1 += h2; h1 = h1 * 5 + 0x52dce729;
+
+        k2 *= C2; k2 = rotl(k2, 33); k2 *= C1; h2 ^= k2;
+        h2  = rotl(h2, 31); h2 += h1; h2 = h2 * 5 + 0x38495ab5;
+    }
+
+    // Tail: up to 15 remaining bytes, little-endian.
+    uint64_t k1 = 0;
+    uint64_t k2 = 0;
+    size_t   tail = size & 15;
+
+    for (size_t i = tail; i > 8; i--)
+        k2 = (k2 << 8) | p[i - 1];
+    for (size_t i = tail < 8 ? tail : 8; i > 0; i--)
+        k1 = (k1 << 8) | p[i - 1];
+
+    if (tail > 8) {
+        k2 *= C2; k2 = rotl(k2, 33); k2 *= C1; h2 ^= k2;
+    }
+    if (tail) {
+        k1 *= C1; k1 = rotl(k1, 31); k1 *= C2; h1 ^= k1;
+    }
+
+    h1 ^= size;
+    h2 ^= size;
+
+    h1 += h2;
+    h2 += h1;
+
+    h1 = fmix(h1);
+    h2 = fmix(h2);
+
+    h1 += h2;
+    h2 += h1;
+
+    return { h1, h2 };
+}
+
+}
@@ -0,0 +1,475 @@
+/**
+ * \file
+ * \author    Chris Smeele
+ * \copyright Copyright (c) 2016, Chris Smeele
+ *
+ * Distributed under the Boost Software License, Version 1.0.
+ * See accompanying file LICENSE or copy at
+ * http://www.boost.org/LICENSE_1_0.txt
+ */
+
+/// For 64-bit file offsets. Note: this is not portable outside of *nix platforms.
+#define _FILE_OFFSET_BITS 64
+
+#include "iouringstore.hh"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+#if defined(__linux__) && defined(__NR_io_uring_setup)
+#define MUSTORE_HAVE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+namespace MuStore {
+
+struct IoUringStore::Ring {
+
+    /// Completions that have not been returned by poll() yet.
+    std::deque<Completion> ready;
+
+    size_t queueDepth;
+
+    /// The io_uring file descriptor, -1 when falling back to pread() / pwrite().
+    int fd = -1;
+
+#ifdef MUSTORE_HAVE_IO_URING
+    /// State of a request in flight.
+    struct Request {
+        void    *cookie;
+        uint8_t *buffer;
+        off_t    offset;    ///< In bytes.
+        size_t   remaining; ///< In bytes.
+        int      bufIndex;  ///< Index of the registered buffer, -1 if none.
+        bool     isWrite;
+        iovec    iov;       ///< Read by the kernel until completion, for unregistered buffers.
+    };
+
+    std::vector<Request>  requests;
+    std::vector<uint32_t> freeSlots;
+
+    /// Registered buffers.
+    std::vector<iovec> buffers;
+
+    /// The file that requests are performed on.
+    int  fileFd;
+    bool fileRegistered = false;
+
+    // Ring mappings.
+    void   *sqRing = MAP_FAILED;
+    void   *cqRing = MAP_FAILED;
+    size_t  sqRingSize = 0;
+    size_t  cqRingSize = 0;
+    io_uring_sqe *sqes = (io_uring_sqe*)MAP_FAILED;
+    size_t  sqesSize = 0;
+
+    uint32_t *sqHead, *sqTail, *sqMask, *sqArray;
+    uint32_t *cqHead, *cqTail, *cqMask;
+    io_uring_cqe *cqes;
+
+    /// Submission entries queued, but not yet passed to the kernel.
+    uint32_t toSubmit = 0;
+
+    size_t inFlight() const { return requests.size() - freeSlots.size(); }
+
+    template<typename T>
+    static T *at(void *base, uint32_t offset) {
+        return (T*)((uint8_t*)base + offset);
+    }
+
+    bool setup(int fileFd_) {
+        fileFd = fileFd_;
+
+        io_uring_params params;
+        memset(&params, 0, sizeof(params));
+
+        fd = (int)syscall(__NR_io_uring_setup, (unsigned)queueDepth, &params);
+        if (fd < 0)
+            return false;
+
+        sqRingSize = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+        cqRingSize = params.cq_off.cqes  + params.cq_entries * sizeof(io_uring_cqe);
+
+        if (params.features & IORING_FEAT_SINGLE_MMAP)
+            sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+
+        sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+        if (sqRing == MAP_FAILED)
+            return false;
+
+        if (params.features & IORING_FEAT_SINGLE_MMAP) {
+            cqRing = sqRing;
+        } else {
+            cqRing = mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+            if (cqRing == MAP_FAILED)
+                return false;
+        }
+
+        sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        sqes = (io_uring_sqe*)mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE,
+                                   MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+        if (sqes == MAP_FAILED)
+            return false;
+
+        sqHead  = at<uint32_t>(sqRing, params.sq_off.head);
+        sqTail  = at<uint32_t>(sqRing, params.sq_off.tail);
+        sqMask  = at<uint32_t>(sqRing, params.sq_off.ring_mask);
+        sqArray = at<uint32_t>(sqRing, params.sq_off.array);
+        cqHead  = at<uint32_t>(cqRing, params.cq_off.head);
+        cqTail  = at<uint32_t>(cqRing, params.cq_off.tail);
+        cqMask  = at<uint32_t>(cqRing, params.cq_off.ring_mask);
+        cqes    = at<io_uring_cqe>(cqRing, params.cq_off.cqes);
+
+        // The kernel may round up the amount of entries, but we never
+        // have more requests in flight than we asked for, so neither
+        // ring can overflow.
+        requests.resize(queueDepth);
+        for (size_t i = queueDepth; i > 0; i--)
+            freeSlots.push_back((uint32_t)(i - 1));
+
+        // A registered file saves a file table lookup on every request.
+        fileRegistered = !syscall(__NR_io_uring_register, fd,
+                                  IORING_REGISTER_FILES, &fileFd, 1);
+
+        return true;
+    }
+
+    /// Queue a submission entry for the remainder of a request.
+    void queue(uint32_t slot) {
+        Request &req = requests[slot];
+
+        uint32_t tail  = *sqTail;
+        uint32_t index = tail & *sqMask;
+
+        io_uring_sqe *sqe = &sqes[index];
+        memset(sqe, 0, sizeof(*sqe));
+
+        uint32_t len = (uint32_t)std::min(req.remaining, (size_t)1 << 30);
+
+        if (req.bufIndex >= 0) {
+            sqe->opcode    = req.isWrite ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+            sqe->buf_index = (uint16_t)req.bufIndex;
+            sqe->addr      = (uint64_t)(uintptr_t)req.buffer;
+            sqe->len       = len;
+        } else {
+            // Vectored I/O, as plain IORING_OP_READ / IORING_OP_WRITE
+            // are rejected by kernels before 5.6.
+            req.iov.iov_base = req.buffer;
+            req.iov.iov_len  = len;
+
+            sqe->opcode    = req.isWrite ? IORING_OP_WRITEV : IORING_OP_READV;
+            sqe->addr      = (uint64_t)(uintptr_t)&req.iov;
+            sqe->len       = 1;
+        }
+        if (fileRegistered) {
+            sqe->fd    = 0;
+            sqe->flags = IOSQE_FIXED_FILE;
+        } else {
+            sqe->fd    = fileFd;
+        }
+        sqe->off       = (uint64_t)req.offset;
+        sqe->user_data = slot;
+
+        sqArray[index] = index;
+        __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+
+        toSubmit++;
+    }
+
+    /// Pass queued entries to the kernel, and wait for `minComplete` completions.
+    bool enter(uint32_t minComplete) {
+        while (toSubmit || minComplete) {
+            int ret = (int)syscall(__NR_io_uring_enter, fd, toSubmit, minComplete,
+                                   minComplete ? IORING_ENTER_GETEVENTS : 0,
+                                   nullptr, 0);
+            if (ret < 0) {
+                if (errno == EINTR)
+                    continue;
+                return false;
+            }
+
+            toSubmit -= std::min(toSubmit, (uint32_t)ret);
+            if (minComplete || !ret)
+                break;
+        }
+        return true;
+    }
+
+    void complete(uint32_t slot, StoreError err) {
+        ready.push_back(Completion { requests[slot].cookie, err });
+        freeSlots.push_back(slot);
+    }
+
+    /// Process all available completion entries.
+    void reap() {
+        uint32_t head = *cqHead;
+        uint32_t tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+
+        for (; head != tail; head++) {
+            const io_uring_cqe &cqe = cqes[head & *cqMask];
+            uint32_t slot = (uint32_t)cqe.user_data;
+            Request &req  = requests[slot];
+
+            if (cqe.res == -EAGAIN || cqe.res == -EINTR) {
+                queue(slot);
+            } else if (cqe.res <= 0) {
+                // Errors, or end of file.
+                complete(slot, STORE_ERR_IO);
+            } else {
+                req.buffer    += cqe.res;
+                req.offset    += cqe.res;
+                req.remaining -= (size_t)cqe.res;
+
+                // Resubmit short transfers.
+                if (req.remaining)
+                    queue(slot);
+                else
+                    complete(slot, STORE_ERR_OK);
+            }
+        }
+
+        __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+    }
+
+    /// Find the registered buffer containing the given range, -1 if none.
+    int findBuffer(const uint8_t *buffer, size_t size) const {
+        for (size_t i = 0; i < buffers.size(); i++) {
+            const uint8_t *base = (const uint8_t*)buffers[i].iov_base;
+            if (buffer >= base && size <= buffers[i].iov_len
+                && (size_t)(buffer - base) <= buffers[i].iov_len - size)
+                return (int)i;
+        }
+        return -1;
+    }
+
+    /// Wait for all requests in flight.
+    void drain() {
+        while (inFlight()) {
+            if (!enter(1))
+                break;
+            reap();
+        }
+    }
+
+    /// Unmap and close the ring, falling back to pread() / pwrite().
+    void teardown() {
+        if (sqes != MAP_FAILED)
+            munmap(sqes, sqesSize);
+        if (cqRing != MAP_FAILED && cqRing != sqRing)
+            munmap(cqRing, cqRingSize);
+        if (sqRing != MAP_FAILED)
+            munmap(sqRing, sqRingSize);
+        if (fd >= 0)
+            close(fd);
+
+        sqes   = (io_uring_sqe*)MAP_FAILED;
+        cqRing = sqRing = MAP_FAILED;
+        fd     = -1;
+    }
+
+    ~Ring() {
+        drain();
+        teardown();
+    }
+#endif
+
+    Ring(int fileFd_, size_t queueDepth_)
+        : queueDepth(queueDepth_) {
+
+#ifdef MUSTORE_HAVE_IO_URING
+        if (!setup(fileFd_))
+            teardown();
+#else
+        (void)fileFd_;
+#endif
+    }
+};
+
+StoreError IoUringStore::submitRequest(bool isWrite, size_t lba, size_t count, void *buffer, void *cookie) {
+    if (!ring || fd < 0)
+        return STORE_ERR_IO;
+    if (isWrite && !writable)
+        return STORE_ERR_NOT_WRITABLE;
+    if (!isRangeValid(lba, count))
+        return STORE_ERR_OUT_OF_BOUNDS;
+
+#ifdef MUSTORE_HAVE_IO_URING
+    if (ring->fd >= 0) {
+        if (!count) {
+            ring->ready.push_back(Completion { cookie, STORE_ERR_OK });
+            return STORE_ERR_OK;
+        }
+
+        // Wait for a free slot if the queue is full.
+        while (ring->freeSlots.empty()) {
+            if (!ring->enter(1))
+                return STORE_ERR_IO;
+            ring->reap();
+        }
+
+        uint32_t slot = ring->freeSlots.back();
+        ring->freeSlots.pop_back();
+
+        Ring::Request &req = ring->requests[slot];
+        req.cookie    = cookie;
+        req.buffer    = (uint8_t*)buffer;
+        req.offset    = (off_t)(lba * blockSize);
+        req.remaining = count * blockSize;
+        req.bufIndex  = ring->findBuffer(req.buffer, req.remaining);
+        req.isWrite   = isWrite;
+
+        ring->queue(slot);
+
+        return STORE_ERR_OK;
+    }
+#endif
+
+    // Like native requests, these do not move the position.
+    StoreError err = isWrite
+                   ? writeAt(lba, count, buffer)
+                   : readAt (lba, count, buffer);
+
+    ring->ready.push_back(Completion { cookie, err });
+
+    return STORE_ERR_OK;
+}
+
+StoreError IoUringStore::submitRead(size_t lba, size_t count, void *buffer, void *cookie) {
+    return submitRequest(false, lba, count, buffer, cookie);
+}
+
+StoreError IoUringStore::submitWrite(size_t lba, size_t count, const void *buffer, void *cookie) {
+    return submitRequest(true, lba, count, const_cast<void*>(buffer), cookie);
+}
+
+StoreError IoUringStore::submit() {
+    if (!ring)
+        return STORE_ERR_IO;
+
+#ifdef MUSTORE_HAVE_IO_URING
+    if (ring->fd >= 0 && !ring->enter(0))
+        return STORE_ERR_IO;
+#endif
+
+    return STORE_ERR_OK;
+}
+
+size_t IoUringStore::poll(Completion *completions, size_t max, size_t min) {
+    if (!ring)
+        return 0;
+
+    if (min > max)
+        min = max;
+
+#ifdef MUSTORE_HAVE_IO_URING
+    if (ring->fd >= 0) {
+        ring->reap();
+
+        while (true) {
+            size_t want = ring->ready.size() < min
+                        ? std::min(min - ring->ready.size(), ring->inFlight())
+                        : 0;
+
+            if (!ring->enter((uint32_t)want))
+                break;
+            ring->reap();
+
+            if (ring->ready.size() >= min || !ring->inFlight())
+                break;
+        }
+    }
+#endif
+
+    size_t n = 0;
+    for (; n < max && !ring->ready.empty(); n++) {
+        completions[n] = ring->ready.front();
+        ring->ready.pop_front();
+    }
+
+    return n;
+}
+
+size_t IoUringStore::getOutstanding() const {
+    if (!ring)
+        return 0;
+
+#ifdef MUSTORE_HAVE_IO_URING
+    return ring->ready.size() + (ring->fd >= 0 ? ring->inFlight() : 0);
+#else
+    return ring->ready.size();
+#endif
+}
+
+StoreError IoUringStore::registerBuffers(void *const *buffers, const size_t *sizes, size_t count) {
+    if (!isNative())
+        return STORE_ERR_IO;
+
+#ifdef MUSTORE_HAVE_IO_URING
+    if (ring->inFlight())
+        return STORE_ERR_IO;
+
+    if (ring->buffers.size()) {
+        syscall(__NR_io_uring_register, ring->fd, IORING_UNREGISTER_BUFFERS, nullptr, 0);
+        ring->buffers.clear();
+    }
+    if (!count)
+        return STORE_ERR_OK;
+
+    std::vector<iovec> iov(count);
+    for (size_t i = 0; i < count; i++) {
+        iov[i].iov_base = buffers[i];
+        iov[i].iov_len  = sizes[i];
+    }
+
+    if (syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_BUFFERS,
+                iov.data(), (unsigned)count))
+        return STORE_ERR_IO;
+
+    ring->buffers = std::move(iov);
+
+    return STORE_ERR_OK;
+#else
+    (void)buffers;
+    (void)sizes;
+    (void)count;
+    return STORE_ERR_IO;
+#endif
+}
+
+bool IoUringStore::isNative() const {
+    return ring && ring->fd >= 0;
+}
+
+size_t IoUringStore::getQueueDepth() const {
+    return ring ? ring->queueDepth : 0;
+}
+
+IoUringStore::IoUringStore(const char *path, bool writable_, size_t queueDepth)
+    : PosixFileStore(path, writable_) {
+
+    if (fd >= 0 && queueDepth)
+        ring.reset(new Ring(fd, queueDepth));
+}
+
+IoUringStore::IoUringStore(IoUringStore &&other)
+    : PosixFileStore(std::move(other)),
+      ring(std::move(other.ring)) { }
+
+IoUringStore::~IoUringStore() {
+    // Wait for requests in flight before the file is closed.
+    ring.reset();
+}
+
+}
@@ -0,0 +1,192 @@
+/**
+ * \file
+ * \author    Chris Smeele
+ * \copyright Copyright (c) 2016, Chris Smeele
+ *
+ * Distributed under the Boost Software License, Version 1.0.
+ * See accompanying file LICENSE or copy at
+ * http://www.boost.org/LICENSE_1_0.txt
+ */
+#include "lz.hh"
+
+#include <cstring>
+
+namespace MuStore {
+
+static const size_t MIN_MATCH  = 4;
+static const size_t MAX_OFFSET = 65535;
+static const size_t HASH_BITS  = 12;
+
+static uint32_t load32(const uint8_t *p) {
+    uint32_t x;
+    memcpy(&x, p, sizeof(x));
+    return x;
+}
+
+static size_t hash(uint32_t x) {
+    return (size_t)((x * 2654435761u) >> (32 - HASH_BITS));
+}
+
+/// Write an extended length (the part that did not fit in a token nibble).
+static uint8_t *putLength(uint8_t *out, const uint8_t *end, size_t length) {
+    for (; length >= 255; length -= 255) {
+        if (out >= end)
+            return nullptr;
+        *out++ = 255;
+    }
+    if (out >= end)
+        return nullptr;
+    *out++ = (uint8_t)length;
+
+    return out;
+}
+
+/// Write a sequence. A match length of 0 marks the last sequence.
+static uint8_t *putSequence(uint8_t *out,
+                            const uint8_t *end,
+                            const uint8_t *literals,
+                            size_t literalLength,
+                            size_t matchLength,
+                            size_t offset) {
+    if (out >= end)
+        return nullptr;
+
+    size_t matchCode = matchLength ? matchLength - MIN_MATCH : 0;
+
+    *out++ = (uint8_t)((literalLength < 15 ? literalLength : 15) << 4
+                     | (matchCode     < 15 ? matchCode     : 15));
+
+    if (literalLength >= 15 && !(out = putLength(out, end, literalLength - 15)))
+        return nullptr;
+
+    if ((size_t)(end - out) < literalLength)
+        return nullptr;
+    if (literalLength)
+        memcpy(out, literals, literalLength);
+    out += literalLength;
+
+    if (!matchLength)
+        return out;
+
+    if (end - out < 2)
+        return nullptr;
+    *out++ = (uint8_t)offset;
+    *out++ = (uint8_t)(offset >> 8);
+
+    if (matchCode >= 15 && !(out = putLength(out, end, matchCode - 15)))
+        return nullptr;
+
+    return out;
+}
+
+size_t lzCompress(const uint8_t *src, size_t size, uint8_t *dst, size_t capacity) {
+    uint32_t table[1 << HASH_BITS] = { };
+
+    const uint8_t *end     = dst + capacity;
+    uint8_t       *out     = dst;
+    size_t         literal = 0; // Start of pending literals.
+    size_t         i       = 0;
+
+    // The table stores positions plus one, so that zero means empty.
+    while (size >= MIN_MATCH && i <= size - MIN_MATCH) {
+        uint32_t x = load32(src + i);
+        size_t   h = hash(x);
+        size_t   candidate = table[h];
+        table[h] = (uint32_t)(i + 1);
+
+        if (!candidate
+            || i - (candidate - 1) > MAX_OFFSET
+            || load32(src + candidate - 1) != x) {
+            i++;
+            continue;
+        }
+
+        size_t match  = candidate - 1;
+        size_t length = MIN_MATCH;
+        while (i + length < size && src[match + length] == src[i + length])
+            length++;
+
+        out = putSequence(out, end, src + literal, i - literal, length, i - match);
+        if (!out)
+            return 0;
+
+        i      += length;
+        literal = i;
+    }
+
+    out = putSequence(out, end, src + literal, size - literal, 0, 0);
+    if (!out)
+        return 0;
+
+    return (size_t)(out - dst);
+}
+
+/// Read an extended length. Returns false on truncated input or overflow.
+static bool getLength(const uint8_t *&in, const uint8_t *end, size_t &length) {
+    uint8_t b;
+    do {
+        if (in >= end)
+            return false;
+        b = *in++;
+        length += b;
+        if (length < b)
+            return false;
+    } while (b == 255);
+
+    return true;
+}
+
+bool lzDecompress(const uint8_t *src, size_t size, uint8_t *dst, size_t dstSize) {
+    const uint8_t *in     = src;
+    const uint8_t *inEnd  = src + size;
+    uint8_t       *out    = dst;
+    uint8_t       *outEnd = dst + dstSize;
+
+    while (true) {
+        // The stream must end with a literals-only sequence.
+        if (in >= inEnd)
+            return false;
+
+        uint8_t token = *in++;
+
+        size_t literalLength = token >> 4;
+        if (literalLength == 15 && !getLength(in, inEnd, literalLength))
+            return false;
+
+        if ((size_t)(inEnd - in) < literalLength || (size_t)(outEnd - out) < literalLength)
+            return false;
+        if (literalLength)
+            memcpy(out, in, literalLength);
+        in  += literalLength;
+        out += literalLength;
+
+        // The last sequence has no match.
+        if (in == inEnd)
+            return out == outEnd;
+
+        if (inEnd - in < 2)
+            return false;
+        size_t offset = (size_t)in[0] | (size_t)in[1] << 8;
+        in += 2;
+
+        size_t matchLength = token & 15;
+        if (matchLength == 15 && !getLength(in, inEnd, matchLength))
+            return false;
+        matchLength += MIN_MATCH;
+
+        if (!offset || offset > (size_t)(out - dst) || (size_t)(outEnd - out) < matchLength)
+            return false;
+
+        // Matches may overlap their own output, then they must be copied bytewise.
+        const uint8_t *match = out - offset;
+        if (offset >= matchLength) {
+            memcpy(out, match, matchLength);
+        } else {
+            for (size_t i = 0; i < matchLength; i++)
+                out[i] = match[i];
+        }
+        out += matchLength;
+    }
+}
+
+}
@@ -45,14 +45,52 @@ StoreError MemStore::write(const void *buffer) {
     return STORE_ERR_OK;
 }
 
-MemStore::MemStore(void *store_, size_t size)
-    : Store(512, size / 512, true),
+StoreError MemStore::readBlocks(size_t lba, size_t count, void *buffer) {
+    if (!isRangeValid(lba, count))
+        return STORE_ERR_OUT_OF_BOUNDS;
+
+    memcpy(buffer, roStore+lba*blockSize, count*blockSize);
+
+    pos = lba + count;
+
+    return STORE_ERR_OK;
+}
+
+StoreError MemStore::writeBlocks(size_t lba, size_t count, const void *buffer) {
+    if (!isRangeValid(lba, count))
+        return STORE_ERR_OUT_OF_BOUNDS;
+    if (!writable || !store)
+        return STORE_ERR_NOT_WRITABLE;
+
+    memcpy(store+lba*blockSize, buffer, count*blockSize);
+
+    pos = lba + count;
+
+    return STORE_ERR_OK;
+}
+
+const uint8_t *MemStore::borrowBlock(size_t lba, size_t count) {
+    if (!isRangeValid(lba, count))
+        return nullptr;
+
+    return roStore+lba*blockSize;
+}
+
+uint8_t *MemStore::borrowBlockWritable(size_t lba, size_t count) {
+    if (!isRangeValid(lba, count) || !writable || !store)
+        return nullptr;
+
+    return store+lba*blockSize;
+}
+
+MemStore::MemStore(void *store_, size_t size, size_t blockSize_)
+    : Store(blockSize_, isPowerOfTwo(blockSize_) ? size / blockSize_ : 0, true),
       roStore((uint8_t*)store_),
         store((uint8_t*)store_)
 { }
 
-MemStore::MemStore(const void *store_, size_t size)
-    : Store(512, size / 512, false),
+MemStore::MemStore(const void *store_, size_t size, size_t blockSize_)
+    : Store(blockSize_, isPowerOfTwo(blockSize_) ? size / blockSize_ : 0, false),
       roStore((const uint8_t*)store_),
         store(nullptr)
 { }
@@ -0,0 +1,341 @@
+/**
+ * \file
+ * \author    Chris Smeele
+ * \copyright Copyright (c) 2016, Chris Smeele
+ *
+ * Distributed under the Boost Software License, Version 1.0.
+ * See accompanying file LICENSE or copy at
+ * http://www.boost.org/LICENSE_1_0.txt
+ */
+#include "mirrorstore.hh"
+
+#include <atomic>
+#include <mutex>
+#include <new>
+
+namespace MuStore {
+
+struct MirrorStore::Members {
+
+    struct Member {
+        Store *store;
+
+        /// Serializes access to the store if it is not thread-safe.
+        std::mutex lock;
+
+        /// Requests currently in flight on this member.
+        std::atomic<size_t> outstanding { 0 };
+
+        /// The LBA following the last request, used to keep streams on one member.
+        std::atomic<size_t> nextLba { 0 };
+
+        std::atomic<size_t> reads      { 0 };
+        std::atomic<size_t> readBlocks { 0 };
+        std::atomic<size_t> writes     { 0 };
+        std::atomic<size_t> errors     { 0 };
+    };
+
+    std::unique_ptr<Member[]> members;
+    size_t count;
+    bool   threadSafe;
+
+    StoreError execute(Member &member, bool isWrite, size_t lba, size_t n, void *buffer) {
+        std::unique_lock<std::mutex> guard(member.lock, std::defer_lock);
+        if (!threadSafe)
+            guard.lock();
+
+        StoreError err = isWrite
+                       ? member.store->writeBlocks(lba, n, buffer)
+                       : member.store->readBlocks (lba, n, buffer);
+
+        member.nextLba = lba + n;
+        if (err)
+            member.errors++;
+
+        return err;
+    }
+
+    /**
+     * \brief Pick the member to read from.
+     *
+     * \param tried bitmap of members that already failed this request
+     *
+     * \return the member index, or count if all members were tried
+     */
+    size_t pick(size_t lba, uint64_t tried) const {
+        size_t best         = count;
+        size_t bestLoad     = 0;
+        size_t bestDistance = 0;
+
+        for (size_t i = 0; i < count; i++) {
+            if (tried & ((uint64_t)1 << i))
+                continue;
+
+            size_t load     = members[i].outstanding;
+            size_t next     = members[i].nextLba;
+            size_t distance = lba >= next ? lba - next : next - lba;
+
+            if (best == count
+                || load < bestLoad
+                || (load == bestLoad && distance < bestDistance)) {
+                best         = i;
+                bestLoad     = load;
+                bestDistance = distance;
+            }
+        }
+
+        return best;
+    }
+
+    StoreError read(size_t lba, size_t n, void *buffer) {
+        uint64_t   tried = 0;
+        StoreError err   = STORE_ERR_IO;
+
+        while (true) {
+            size_t i = pick(lba, tried);
+            if (i == count)
+                return err;
+
+            Member &member = members[i];
+            member.outstanding++;
+            err = execute(member, false, lba, n, buffer);
+            member.outstanding--;
+
+            if (!err) {
+                member.reads++;
+                member.readBlocks += n;
+                return err;
+            }
+            if (err != STORE_ERR_IO && err != STORE_ERR_CHECKSUM)
+                return err;
+
+            // Fail over to another member.
+            tried |= (uint64_t)1 << i;
+        }
+    }
+
+    StoreError write(size_t lba, size_t n, const void *buffer) {
+        StoreError err = STORE_ERR_OK;
+
+        for (size_t i = 0; i < count; i++) {
+            Member &member = members[i];
+            member.outstanding++;
+            auto err2 = execute(member, true, lba, n, const_cast<void*>(buffer));
+            member.outstanding--;
+
+            member.writes++;
+            if (!err)
+                err = err2;
+        }
+
+        return err;
+    }
+
+    Members(Store *const *stores, size_t count_, size_t blockCount, bool threadSafe_)
+        : members(new Member[count_]),
+          count(count_),
+          threadSafe(threadSafe_) {
+
+        for (size_t i = 0; i < count; i++) {
+            members[i].store   = stores[i];
+            members[i].nextLba = blockCount / count * i;
+        }
+    }
+};
+
+StoreError MirrorStore::seek(size_t lba) {
+    if (!members)
+        return STORE_ERR_IO;
+    if (lba >= blockCount)
+        return STORE_ERR_OUT_OF_BOUNDS;
+
+    pos = lba;
+
+    return STORE_ERR_OK;
+}
+
+StoreError MirrorStore::read(void *buffer) {
+    return readBlocks(pos, 1, buffer);
+}
+
+StoreError MirrorStore::write(const void *buffer) {
+    return writeBlocks(pos, 1, buffer);
+}
+
+StoreError MirrorStore::readBlocks(size_t lba, size_t count, void *buffer) {
+    if (!members)
+        return STORE_ERR_IO;
+    if (!isRangeValid(lba, count))
+        return STORE_ERR_OUT_OF_BOUNDS;
+
+    auto err = members->read(lba, count, buffer);
+    if (!err)
+        pos = lba + count;
+
+    return err;
+}
+
+StoreError MirrorStore::writeBlocks(size_t lba, size_t count, const void *buffer) {
+    if (!members)
+        return STORE_ERR_IO;
+    if (!writable)
+        return STORE_ERR_NOT_WRITABLE;
+    if (!isRangeValid(lba, count))
+        return STORE_ERR_OUT_OF_BOUNDS;
+
+    auto err = members->write(lba, count, buffer);
+    if (!err)
+        pos = lba + count;
+
+    return err;
+}
+
+StoreError MirrorStore::discard(size_t lba, size_t count) {
+    if (!members)
+        return STORE_ERR_IO;
+    if (!writable)
+        return STORE_ERR_NOT_WRITABLE;
+    if (!isRangeValid(lba, count))
+        return STORE_ERR_OUT_OF_BOUNDS;
+
+    StoreError err = STORE_ERR_OK;
+    for (size_t i = 0; i < members->count; i++) {
+        auto &member = members->members[i];
+
+        std::unique_lock<std::mutex> guard(member.lock, std::defer_lock);
+        if (!members->threadSafe)
+            guard.lock();
+
+        auto err2 = member.store->discard(lba, count);
+        if (!err)
+            err = err2;
+    }
+
+    return err;
+}
+
+StoreError MirrorStore::flush() {
+    if (!members)
+        return STORE_ERR_IO;
+
+    StoreError err = STORE_ERR_OK;
+    for (size_t i = 0; i < members->count; i++) {
+        auto &member = members->members[i];
+
+        std::unique_lock<std::mutex> guard(member.lock, std::defer_lock);
+        if (!members->threadSafe)
+            guard.lock();
+
+        auto err2 = member.store->flush();
+        if (!err)
+            err = err2;
+    }
+
+    return err;
+}
+
+const uint8_t *MirrorStore::borrowBlock(size_t lba, size_t count) {
+    if (!members || !isRangeValid(lba, count))
+        return nullptr;
+
+    for (size_t i = 0; i < members->count; i++) {
+        auto block = members->members[i].store->borrowBlock(lba, count);
+        if (block)
+            return block;
+    }
+
+    return nullptr;
+}
+
+uint8_t *MirrorStore::borrowBlockWritable(size_t lba, size_t count) {
+    if (!members || !writable || !isRangeValid(lba, count))
+        return nullptr;
+
+    return members->members[0].store->borrowBlockWritable(lba, count);
+}
+
+StoreError MirrorStore::commitBlock(size_t lba, size_t count) {
+    if (!members)
+        return STORE_ERR_IO;
+    if (!isRangeValid(lba, count))
+        return STORE_ERR_OUT_OF_BOUNDS;
+
+    Store *first = members->members[0].store;
+
+    auto err = first->commitBlock(lba, count);
+    if (err)
+        return err;
+
+    // Copy the modified blocks to the other members.
+    const uint8_t *block = first->borrowBlock(lba, count);
+    if (!block)
+        return STORE_ERR_IO;
+
+    for (size_t i = 1; i < members->count; i++) {
+        auto &member = members->members[i];
+        auto err2 = members->execute(member, true, lba, count, const_cast<uint8_t*>(block));
+        member.writes++;
+        if (!err)
+            err = err2;
+    }
+
+    return err;
+}
+
+size_t MirrorStore::getMemberCount() const {
+    return members ? members->count : 0;
+}
+
+MirrorStore::MemberStats MirrorStore::getMemberStats(size_t i) const {
+    if (!members || i >= members->count)
+        return MemberStats { 0, 0, 0, 0 };
+
+    auto &member = members->members[i];
+    return MemberStats { member.reads, member.readBlocks, member.writes, member.errors };
+}
+
+void MirrorStore::resetStats() {
+    if (!members)
+        return;
+
+    for (size_t i = 0; i < members->count; i++) {
+        auto &member = members->members[i];
+        member.reads      = 0;
+        member.readBlocks = 0;
+        member.writes     = 0;
+        member.errors     = 0;
+    }
+}
+
+MirrorStore::MirrorStore(Store *const *stores, size_t count, bool threadSafe)
+    : Store(count ? stores[0]->getBlockSize() : 512, 0, count > 0) {
+
+    if (!count || count > MAX_MEMBERS)
+        return; // Fail.
+
+    size_t memberBlocks = stores[0]->getBlockCount();
+
+    for (size_t i = 0; i < count; i++) {
+        if (stores[i]->getBlockSize() != blockSize)
+            return; // Fail.
+        if (stores[i]->getBlockCount() < memberBlocks)
+            memberBlocks = stores[i]->getBlockCount();
+        if (!stores[i]->isWritable())
+            writable = false;
+    }
+
+    if (!memberBlocks)
+        return; // Fail.
+
+    members.reset(new (std::nothrow) Members(stores, count, memberBlocks, threadSafe));
+    if (members)
+        blockCount = memberBlocks;
+}
+
+MirrorStore::MirrorStore(MirrorStore &&other)
+    : Store(other),
+      members(std::move(other.members)) { }
+
+MirrorStore::~MirrorStore() = default;
+
+}
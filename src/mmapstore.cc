@@ -0,0 +1,221 @@
+/**
+ * \file
+ * \author    Chris Smeele
+ * \copyright Copyright (c) 2016, Chris Smeele
+ *
+ * Distributed under the Boost Software License, Version 1.0.
+ * See accompanying file LICENSE or copy at
+ * http://www.boost.org/LICENSE_1_0.txt
+ */
+
+/// For 64-bit file sizes. Note: this is not portable outside of *nix platforms.
+#define _FILE_OFFSET_BITS 64
+
+#include "mmapstore.hh"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace MuStore {
+
+StoreError MmapStore::seek(size_t lba) {
+    if (!map)
+        return STORE_ERR_IO;
+    if (lba >= blockCount)
+        return STORE_ERR_OUT_OF_BOUNDS;
+
+    pos = lba;
+
+    return STORE_ERR_OK;
+}
+
+StoreError MmapStore::read(void *buffer) {
+    if (!map)
+        return STORE_ERR_IO;
+    if (pos >= blockCount)
+        return STORE_ERR_OUT_OF_BOUNDS;
+
+    memcpy(buffer, map+pos*blockSize, blockSize);
+
+    pos++;
+
+    return STORE_ERR_OK;
+}
+
+StoreError MmapStore::write(const void *buffer) {
+    if (!map)
+        return STORE_ERR_IO;
+    if (pos >= blockCount)
+        return STORE_ERR_OUT_OF_BOUNDS;
+    if (!writable)
+        return STORE_ERR_NOT_WRITABLE;
+
+    memcpy(map+pos*blockSize, buffer, blockSize);
+
+    pos++;
+
+    return STORE_ERR_OK;
+}
+
+StoreError MmapStore::readBlocks(size_t lba, size_t count, void *buffer) {
+    if (!map)
+        return STORE_ERR_IO;
+    if (!isRangeValid(lba, count))
+        return STORE_ERR_OUT_OF_BOUNDS;
+
+    memcpy(buffer, map+lba*blockSize, count*blockSize);
+
+    pos = lba + count;
+
+    return STORE_ERR_OK;
+}
+
+StoreError MmapStore::writeBlocks(size_t lba, size_t count, const void *buffer) {
+    if (!map)
+        return STORE_ERR_IO;
+    if (!isRangeValid(lba, count))
+        return STORE_ERR_OUT_OF_BOUNDS;
+    if (!writable)
+        return STORE_ERR_NOT_WRITABLE;
+
+    memcpy(map+lba*blockSize, buffer, count*blockSize);
+
+    pos = lba + count;
+
+    return STORE_ERR_OK;
+}
+
+StoreError MmapStore::discard(size_t lba, size_t count) {
+    if (!map)
+        return STORE_ERR_IO;
+    if (!isRangeValid(lba, count))
+        return STORE_ERR_OUT_OF_BOUNDS;
+    if (!writable)
+        return STORE_ERR_NOT_WRITABLE;
+
+#ifdef MADV_REMOVE
+    // Only whole pages can be released.
+    size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+    size_t start    = (lba * blockSize + pageSize - 1) / pageSize * pageSize;
+    size_t end      = (lba + count) * blockSize / pageSize * pageSize;
+
+    // Filesystems without hole punching simply keep the data.
+    if (start < end
+        && madvise(map + start, end - start, MADV_REMOVE)
+        && errno != EOPNOTSUPP)
+        return STORE_ERR_IO;
+#endif
+
+    return STORE_ERR_OK;
+}
+
+const uint8_t *MmapStore::borrowBlock(size_t lba, size_t count) {
+    if (!map || !isRangeValid(lba, count))
+        return nullptr;
+
+    return map+lba*blockSize;
+}
+
+uint8_t *MmapStore::borrowBlockWritable(size_t lba, size_t count) {
+    if (!map || !isRangeValid(lba, count) || !writable)
+        return nullptr;
+
+    return map+lba*blockSize;
+}
+
+StoreError MmapStore::advise(Advice advice, size_t lba, size_t count) {
+    if (!map)
+        return STORE_ERR_IO;
+    if (!count && lba <= blockCount)
+        count = blockCount - lba;
+    if (!isRangeValid(lba, count))
+        return STORE_ERR_OUT_OF_BOUNDS;
+    if (!count)
+        return STORE_ERR_OK;
+
+    int adv = MADV_NORMAL;
+    switch (advice) {
+        case Advice::NORMAL:     adv = MADV_NORMAL;     break;
+        case Advice::SEQUENTIAL: adv = MADV_SEQUENTIAL; break;
+        case Advice::RANDOM:     adv = MADV_RANDOM;     break;
+        case Advice::WILLNEED:   adv = MADV_WILLNEED;   break;
+    }
+
+    // madvise() needs a page-aligned start address.
+    size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+    size_t start    = lba * blockSize;
+    size_t end      = (lba + count) * blockSize;
+    start -= start % pageSize;
+
+    if (madvise(map + start, end - start, adv))
+        return STORE_ERR_IO;
+
+    return STORE_ERR_OK;
+}
+
+StoreError MmapStore::flush() {
+    if (!map)
+        return STORE_ERR_IO;
+    if (!writable)
+        return STORE_ERR_OK;
+
+    if (msync(map, mapSize, MS_SYNC))
+        return STORE_ERR_IO;
+
+    return STORE_ERR_OK;
+}
+
+MmapStore::MmapStore(const char *path, bool writable_, size_t blockSize_)
+    : Store(blockSize_, 0, writable_),
+      map(nullptr),
+      mapSize(0) {
+
+    if (!isPowerOfTwo(blockSize_))
+        return;
+
+    int fd = open(path, (writable_ ? O_RDWR : O_RDONLY) | O_CLOEXEC);
+    if (fd < 0)
+        return;
+
+    struct stat st;
+    if (fstat(fd, &st) || st.st_size <= 0) {
+        close(fd);
+        return;
+    }
+
+    void *p = mmap(nullptr,
+                   (size_t)st.st_size,
+                   writable_ ? PROT_READ | PROT_WRITE : PROT_READ,
+                   MAP_SHARED,
+                   fd,
+                   0);
+
+    // The mapping stays valid after closing the file.
+    close(fd);
+
+    if (p == MAP_FAILED)
+        return;
+
+    map        = (uint8_t*)p;
+    mapSize    = (size_t)st.st_size;
+    blockCount = mapSize / blockSize;
+}
+
+MmapStore::MmapStore(MmapStore &&other)
+    : Store(other),
+      map(other.map),
+      mapSize(other.mapSize) {
+    other.map     = nullptr;
+    other.mapSize = 0;
+}
+
+MmapStore::~MmapStore() {
+    if (map)
+        munmap(map, mapSize);
+}
+
+}
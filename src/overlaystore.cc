@@ -0,0 +1,291 @@
+/**
+ * \file
+ * \author    Chris Smeele
+ * \copyright Copyright (c) 2016, Chris Smeele
+ *
+ * Distributed under the Boost Software License, Version 1.0.
+ * See accompanying file LICENSE or copy at
+ * http://www.boost.org/LICENSE_1_0.txt
+ */
+#include "overlaystore.hh"
+
+#include <cstring>
+
+namespace MuStore {
+
+static const char     OVERLAY_MAGIC[8] = { 'M', 'U', 'O', 'V', 'R', 'L', 'A', 'Y' };
+static const uint32_t OVERLAY_VERSION  = 1;
+
+static uint64_t le64(const uint8_t *p) {
+    uint64_t x = 0;
+    for (size_t i = 0; i < 8; i++)
+        x |= (uint64_t)p[i] << (i * 8);
+    return x;
+}
+
+static void putLe64(uint8_t *p, uint64_t x) {
+    for (size_t i = 0; i < 8; i++)
+        p[i] = (uint8_t)(x >> (i * 8));
+}
+
+/// Get the size of the allocation map in blocks.
+static size_t mapBlockCount(size_t blockCount, size_t blockSize) {
+    size_t bitsPerBlock = blockSize * 8;
+    return (blockCount + bitsPerBlock - 1) / bitsPerBlock;
+}
+
+size_t OverlayStore::getMapSize(size_t blockCount, size_t blockSize) {
+    return (1 + mapBlockCount(blockCount, blockSize)) * blockSize;
+}
+
+size_t OverlayStore::getDeltaBlockCount(size_t blockCount, size_t blockSize) {
+    return 1 + mapBlockCount(blockCount, blockSize) + blockCount;
+}
+
+size_t OverlayStore::runLength(size_t lba, size_t count) const {
+    bool   modified = isModified(lba);
+    size_t n        = 1;
+
+    while (n < count && isModified(lba + n) == modified)
+        n++;
+
+    return n;
+}
+
+StoreError OverlayStore::markModified(size_t lba, size_t count) {
+    size_t bitsPerBlock = blockSize * 8;
+    size_t first = blockCount; // First and last changed map block.
+    size_t last  = 0;
+
+    for (size_t i = lba; i < lba + count; i++) {
+        if (isModified(i))
+            continue;
+
+        map[i / 8] = (uint8_t)(map[i / 8] | (1 << (i % 8)));
+
+        if (first == blockCount)
+            first = i / bitsPerBlock;
+        last = i / bitsPerBlock;
+    }
+
+    if (first == blockCount)
+        return STORE_ERR_OK;
+
+    return delta->writeBlocks(1 + first, last - first + 1, map + first * blockSize);
+}
+
+StoreError OverlayStore::seek(size_t lba) {
+    if (!base)
+        return STORE_ERR_IO;
+    if (lba >= blockCount)
+        return STORE_ERR_OUT_OF_BOUNDS;
+
+    pos = lba;
+
+    return STORE_ERR_OK;
+}
+
+StoreError OverlayStore::read(void *buffer) {
+    return readBlocks(pos, 1, buffer);
+}
+
+StoreError OverlayStore::write(const void *buffer) {
+    return writeBlocks(pos, 1, buffer);
+}
+
+StoreError OverlayStore::readBlocks(size_t lba, size_t count, void *buffer) {
+    if (!base)
+        return STORE_ERR_IO;
+    if (!isRangeValid(lba, count))
+        return STORE_ERR_OUT_OF_BOUNDS;
+
+    for (size_t i = 0; i < count; ) {
+        size_t n = runLength(lba + i, count - i);
+
+        auto err = isModified(lba + i)
+                 ? delta->readBlocks(dataStart() + lba + i, n, (uint8_t*)buffer + i * blockSize)
+                 : base ->readBlocks(lba + i,               n, (uint8_t*)buffer + i * blockSize);
+        if (err)
+            return err;
+
+        i += n;
+    }
+
+    pos = lba + count;
+
+    return STORE_ERR_OK;
+}
+
+StoreError OverlayStore::writeBlocks(size_t lba, size_t count, const void *buffer) {
+    if (!base)
+        return STORE_ERR_IO;
+    if (!writable)
+        return STORE_ERR_NOT_WRITABLE;
+    if (!isRangeValid(lba, count))
+        return STORE_ERR_OUT_OF_BOUNDS;
+
+    // Write the blocks before the map, so that the map never points at garbage.
+    auto err = delta->writeBlocks(dataStart() + lba, count, buffer);
+    if (err)
+        return err;
+
+    err = markModified(lba, count);
+    if (!err)
+        pos = lba + count;
+
+    return err;
+}
+
+StoreError OverlayStore::flush() {
+    if (!base)
+        return STORE_ERR_IO;
+
+    return delta->flush();
+}
+
+const uint8_t *OverlayStore::borrowBlock(size_t lba, size_t count) {
+    if (!base || !isRangeValid(lba, count))
+        return nullptr;
+
+    // Borrowed blocks must come from a single store.
+    if (runLength(lba, count) != count)
+        return nullptr;
+
+    if (isModified(lba))
+        return delta->borrowBlock(dataStart() + lba, count);
+
+    // A later write copies the blocks up, the base pointer would not reflect it.
+    return writable ? nullptr : base->borrowBlock(lba, count);
+}
+
+uint8_t *OverlayStore::borrowBlockWritable(size_t lba, size_t count) {
+    if (!base || !writable || !isRangeValid(lba, count))
+        return nullptr;
+
+    uint8_t *blocks = delta->borrowBlockWritable(dataStart() + lba, count);
+    if (!blocks)
+        return nullptr;
+
+    // Copy unmodified blocks up from the base.
+    bool copied = false;
+    for (size_t i = 0; i < count; ) {
+        size_t n = runLength(lba + i, count - i);
+
+        if (!isModified(lba + i)) {
+            if (base->readBlocks(lba + i, n, blocks + i * blockSize))
+                return nullptr;
+            copied = true;
+        }
+        i += n;
+    }
+
+    if (copied) {
+        if (delta->commitBlock(dataStart() + lba, count))
+            return nullptr;
+        if (markModified(lba, count))
+            return nullptr;
+    }
+
+    return blocks;
+}
+
+StoreError OverlayStore::commitBlock(size_t lba, size_t count) {
+    if (!base)
+        return STORE_ERR_IO;
+    if (!isRangeValid(lba, count))
+        return STORE_ERR_OUT_OF_BOUNDS;
+
+    // Only blocks borrowed writable, and thus copied up, can be committed.
+    if (!isModified(lba) || runLength(lba, count) != count)
+        return STORE_ERR_IO;
+
+    return delta->commitBlock(dataStart() + lba, count);
+}
+
+size_t OverlayStore::getModifiedCount() const {
+    if (!base)
+        return 0;
+
+    size_t n = 0;
+    for (size_t i = 0; i < (blockCount + 7) / 8; i++) {
+        for (uint8_t bits = map[i]; bits; bits = (uint8_t)(bits & (bits - 1)))
+            n++;
+    }
+
+    return n;
+}
+
+StoreError OverlayStore::squash(Store *target, void *buffer, size_t size) {
+    if (!base)
+        return STORE_ERR_IO;
+    if (!target->isWritable())
+        return STORE_ERR_NOT_WRITABLE;
+    if (target->getBlockSize() != blockSize || target->getBlockCount() < blockCount)
+        return STORE_ERR_OUT_OF_BOUNDS;
+    if (size < blockSize)
+        return STORE_ERR_IO;
+
+    size_t chunk = size / blockSize;
+
+    for (size_t lba = 0; lba < blockCount; ) {
+        size_t n = runLength(lba, blockCount - lba < chunk ? blockCount - lba : chunk);
+
+        // Unmodified blocks are already in place when merging into the base.
+        if (target != base || isModified(lba)) {
+            auto err = readBlocks(lba, n, buffer);
+            if (!err)
+                err = target->writeBlocks(lba, n, buffer);
+            if (err)
+                return err;
+        }
+        lba += n;
+    }
+
+    return target->flush();
+}
+
+OverlayStore::OverlayStore(Store *base_, Store *delta_, void *buffer, size_t size, bool format)
+    : Store(base_->getBlockSize(), base_->getBlockCount(), delta_->isWritable()),
+      base(base_),
+      delta(delta_),
+      header((uint8_t*)buffer),
+      map((uint8_t*)buffer + base_->getBlockSize()),
+      mapBlocks(mapBlockCount(base_->getBlockCount(), base_->getBlockSize())) {
+
+    if (delta->getBlockSize()  != blockSize
+        || delta->getBlockCount() < getDeltaBlockCount(blockCount, blockSize)
+        || size < getMapSize(blockCount, blockSize)
+        || !blockCount) {
+
+        base       = nullptr; // Fail.
+        blockCount = 0;
+        return;
+    }
+
+    if (format) {
+        memset(header, 0, getMapSize(blockCount, blockSize));
+        memcpy(header, OVERLAY_MAGIC, sizeof(OVERLAY_MAGIC));
+        putLe64(header +  8, OVERLAY_VERSION);
+        putLe64(header + 16, blockSize);
+        putLe64(header + 24, blockCount);
+
+        if (delta->writeBlocks(0, 1 + mapBlocks, header)) {
+            base       = nullptr; // Fail.
+            blockCount = 0;
+        }
+        return;
+    }
+
+    // Open an existing delta, which must belong to a base of the same geometry.
+    if (delta->readBlocks(0, 1 + mapBlocks, header)
+        || memcmp(header, OVERLAY_MAGIC, sizeof(OVERLAY_MAGIC))
+        || le64(header +  8) != OVERLAY_VERSION
+        || le64(header + 16) != blockSize
+        || le64(header + 24) != blockCount) {
+
+        base       = nullptr; // Fail.
+        blockCount = 0;
+    }
+}
+
+}
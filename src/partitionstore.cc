@@ -0,0 +1,109 @@
+/**
+ * \file
+ * \author    Chris Smeele
+ * \copyright Copyright (c) 2016, Chris Smeele
+ *
+ * Distributed under the Boost Software License, Version 1.0.
+ * See accompanying file LICENSE or copy at
+ * http://www.boost.org/LICENSE_1_0.txt
+ */
+#include "partitionstore.hh"
+
+namespace MuStore {
+
+StoreError PartitionStore::seek(size_t lba) {
+    if (!store)
+        return STORE_ERR_IO;
+    if (lba >= blockCount)
+        return STORE_ERR_OUT_OF_BOUNDS;
+
+    pos = lba;
+
+    return STORE_ERR_OK;
+}
+
+StoreError PartitionStore::read(void *buffer) {
+    return readBlocks(pos, 1, buffer);
+}
+
+StoreError PartitionStore::write(const void *buffer) {
+    return writeBlocks(pos, 1, buffer);
+}
+
+StoreError PartitionStore::readBlocks(size_t lba, size_t count, void *buffer) {
+    if (!store)
+        return STORE_ERR_IO;
+    if (!isRangeValid(lba, count))
+        return STORE_ERR_OUT_OF_BOUNDS;
+
+    auto err = store->readBlocks(start + lba, count, buffer);
+    if (!err)
+        pos = lba + count;
+    return err;
+}
+
+StoreError PartitionStore::writeBlocks(size_t lba, size_t count, const void *buffer) {
+    if (!store)
+        return STORE_ERR_IO;
+    if (!isRangeValid(lba, count))
+        return STORE_ERR_OUT_OF_BOUNDS;
+
+    auto err = store->writeBlocks(start + lba, count, buffer);
+    if (!err)
+        pos = lba + count;
+    return err;
+}
+
+StoreError PartitionStore::discard(size_t lba, size_t count) {
+    if (!store)
+        return STORE_ERR_IO;
+    if (!isRangeValid(lba, count))
+        return STORE_ERR_OUT_OF_BOUNDS;
+
+    return store->discard(start + lba, count);
+}
+
+StoreError PartitionStore::flush() {
+    if (!store)
+        return STORE_ERR_IO;
+
+    return store->flush();
+}
+
+const uint8_t *PartitionStore::borrowBlock(size_t lba, size_t count) {
+    if (!store || !isRangeValid(lba, count))
+        return nullptr;
+
+    return store->borrowBlock(start + lba, count);
+}
+
+uint8_t *PartitionStore::borrowBlockWritable(size_t lba, size_t count) {
+    if (!store || !isRangeValid(lba, count))
+        return nullptr;
+
+    return store->borrowBlockWritable(start + lba, count);
+}
+
+StoreError PartitionStore::commitBlock(size_t lba, size_t count) {
+    if (!store)
+        return STORE_ERR_IO;
+    if (!isRangeValid(lba, count))
+        return STORE_ERR_OUT_OF_BOUNDS;
+
+    return store->commitBlock(start + lba, count);
+}
+
+PartitionStore::PartitionStore(Store *store_, size_t start_, size_t count)
+    : Store(store_->getBlockSize(), count, store_->isWritable()),
+      store(store_),
+      start(start_) {
+
+    // The partition must lie within the underlying store.
+    if (!count || start_ >= store_->getBlockCount()
+        || count > store_->getBlockCount() - start_) {
+        store      = nullptr; // Fail.
+        blockCount = 0;
+    }
+}
+
+}
@@ -0,0 +1,252 @@
+/**
+ * \file
+ * \author    Chris Smeele
+ * \copyright Copyright (c) 2016, Chris Smeele
+ *
+ * Distributed under the Boost Software License, Version 1.0.
+ * See accompanying file LICENSE or copy at
+ * http://www.boost.org/LICENSE_1_0.txt
+ */
+#include "partitiontable.hh"
+
+#include <cstring>
+
+namespace MuStore {
+
+static uint32_t le32(const uint8_t *p) {
+    return (uint32_t)p[0]
+         | (uint32_t)p[1] << 8
+         | (uint32_t)p[2] << 16
+         | (uint32_t)p[3] << 24;
+}
+
+static uint64_t le64(const uint8_t *p) {
+    return (uint64_t)le32(p) | (uint64_t)le32(p + 4) << 32;
+}
+
+/// Update a CRC32 (as used by GPT) with the given data.
+static uint32_t crc32Update(uint32_t crc, const uint8_t *data, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        crc ^= data[i];
+        for (size_t j = 0; j < 8; j++)
+            crc = (crc >> 1) ^ (0xedb88320 & (0 - (crc & 1)));
+    }
+    return crc;
+}
+
+static bool isExtendedType(uint8_t type) {
+    return type == 0x05 || type == 0x0f || type == 0x85;
+}
+
+/// MBR partition entry offsets.
+static const size_t MBR_ENTRIES    = 446;
+static const size_t MBR_ENTRY_SIZE = 16;
+
+/// The GPT protective MBR partition type.
+static const uint8_t MBR_TYPE_GPT = 0xee;
+
+/// Limit on the amount of EBRs followed, to protect against loops.
+static const size_t MAX_EBRS = 128;
+
+void PartitionTable::add(size_t lba, size_t count, uint8_t type, const uint8_t *typeGuid, bool bootable, Store *store) {
+    if (partitionCount >= MAX_PARTITIONS)
+        return;
+
+    // Ignore partitions that do not fit in the store.
+    if (!count || lba >= store->getBlockCount() || count > store->getBlockCount() - lba)
+        return;
+
+    Partition &p = partitions[partitionCount++];
+    p.lba        = lba;
+    p.blockCount = count;
+    p.type       = type;
+    p.bootable   = bootable;
+
+    if (typeGuid)
+        memcpy(p.typeGuid, typeGuid, sizeof(p.typeGuid));
+    else
+        memset(p.typeGuid, 0, sizeof(p.typeGuid));
+}
+
+StoreError PartitionTable::readMbr(Store *store, uint8_t *buffer) {
+    auto err = store->readBlocks(0, 1, buffer);
+    if (err)
+        return err;
+
+    if (buffer[510] != 0x55 || buffer[511] != 0xaa)
+        return STORE_ERR_OK;
+
+    // A FAT boot sector carries the same signature, make sure the
+    // entries look sane before treating this as an MBR.
+    bool any = false;
+    for (size_t i = 0; i < 4; i++) {
+        const uint8_t *entry = buffer + MBR_ENTRIES + i * MBR_ENTRY_SIZE;
+
+        if (entry[0] != 0x00 && entry[0] != 0x80)
+            return STORE_ERR_OK;
+
+        if (entry[4] == MBR_TYPE_GPT)
+            return readGpt(store, buffer);
+
+        if (entry[4] && le32(entry + 12)) {
+            if (!le32(entry + 8))
+                return STORE_ERR_OK;
+            any = true;
+        }
+    }
+    if (!any)
+        return STORE_ERR_OK;
+
+    scheme = Scheme::MBR;
+
+    size_t extendedLba   = 0;
+    size_t extendedCount = 0;
+
+    for (size_t i = 0; i < 4; i++) {
+        const uint8_t *entry = buffer + MBR_ENTRIES + i * MBR_ENTRY_SIZE;
+
+        uint8_t type  = entry[4];
+        size_t  start = le32(entry + 8);
+        size_t  count = le32(entry + 12);
+
+        if (!type || !count)
+            continue;
+
+        if (isExtendedType(type)) {
+            // Logical partitions are read after the primary partitions.
+            if (!extendedLba) {
+                extendedLba   = start;
+                extendedCount = count;
+            }
+        } else {
+            add(start, count, type, nullptr, entry[0] == 0x80, store);
+        }
+    }
+
+    if (extendedLba)
+        return readEbr(store, buffer, extendedLba, extendedCount);
+
+    return STORE_ERR_OK;
+}
+
+StoreError PartitionTable::readEbr(Store *store, uint8_t *buffer, size_t extendedLba, size_t extendedCount) {
+    size_t ebrLba = extendedLba;
+
+    for (size_t i = 0; i < MAX_EBRS; i++) {
+        if (ebrLba >= store->getBlockCount())
+            break;
+
+        auto err = store->readBlocks(ebrLba, 1, buffer);
+        if (err)
+            return err;
+
+        if (buffer[510] != 0x55 || buffer[511] != 0xaa)
+            break;
+
+        // The first entry describes a logical partition, relative to this EBR.
+        const uint8_t *entry = buffer + MBR_ENTRIES;
+        if (entry[4] && le32(entry + 12))
+            add(ebrLba + le32(entry + 8), le32(entry + 12), entry[4], nullptr, entry[0] == 0x80, store);
+
+        // The second entry points to the next EBR, relative to the extended partition.
+        entry += MBR_ENTRY_SIZE;
+        size_t next = le32(entry + 8);
+        if (!isExtendedType(entry[4]) || !next || next >= extendedCount)
+            break;
+
+        if (extendedLba + next <= ebrLba)
+            break; // Refuse to go backwards.
+
+        ebrLba = extendedLba + next;
+    }
+
+    return STORE_ERR_OK;
+}
+
+StoreError PartitionTable::readGpt(Store *store, uint8_t *buffer) {
+    const size_t blockSize = store->getBlockSize();
+
+    auto err = store->readBlocks(1, 1, buffer);
+    if (err)
+        return err;
+
+    if (memcmp(buffer, "EFI PART", 8))
+        return STORE_ERR_OK;
+
+    uint32_t headerSize = le32(buffer + 12);
+    uint32_t headerCrc  = le32(buffer + 16);
+    if (headerSize < 92 || headerSize > blockSize)
+        return STORE_ERR_OK;
+
+    memset(buffer + 16, 0, 4);
+    if (~crc32Update(~(uint32_t)0, buffer, headerSize) != headerCrc)
+        return STORE_ERR_OK;
+
+    uint64_t entriesLba = le64(buffer + 72);
+    uint32_t entryCount = le32(buffer + 80);
+    uint32_t entrySize  = le32(buffer + 84);
+    uint32_t entriesCrc = le32(buffer + 88);
+
+    if (entrySize < 128 || (entrySize & (entrySize - 1)) || entrySize > blockSize)
+        return STORE_ERR_OK;
+
+    size_t   entriesPerBlock = blockSize / entrySize;
+    uint64_t entryBlocks     = (entryCount + entriesPerBlock - 1) / entriesPerBlock;
+
+    if (entriesLba >= store->getBlockCount()
+        || entryBlocks > store->getBlockCount() - entriesLba)
+        return STORE_ERR_OK;
+
+    scheme = Scheme::GPT;
+
+    uint32_t crc   = ~(uint32_t)0;
+    size_t   entry = 0;
+
+    for (size_t block = 0; block < entryBlocks; block++) {
+        err = store->readBlocks((size_t)entriesLba + block, 1, buffer);
+        if (err) {
+            partitionCount = 0;
+            return err;
+        }
+
+        for (size_t i = 0; i < entriesPerBlock && entry < entryCount; i++, entry++) {
+            const uint8_t *e = buffer + i * entrySize;
+
+            crc = crc32Update(crc, e, entrySize);
+
+            static const uint8_t unused[16] = { };
+            if (!memcmp(e, unused, sizeof(unused)))
+                continue;
+
+            uint64_t first = le64(e + 32);
+            uint64_t last  = le64(e + 40);
+            if (last < first || last >= store->getBlockCount())
+                continue;
+
+            add((size_t)first, (size_t)(last - first + 1), 0, e, false, store);
+        }
+    }
+
+    if (~crc != entriesCrc) {
+        // Corrupt entry array.
+        scheme         = Scheme::NONE;
+        partitionCount = 0;
+    }
+
+    return STORE_ERR_OK;
+}
+
+PartitionTable::PartitionTable(Store *store, void *buffer, size_t size)
+    : scheme(Scheme::NONE),
+      error(STORE_ERR_OK),
+      partitionCount(0) {
+
+    if (store->getBlockSize() < 512 || size < store->getBlockSize()) {
+        error = STORE_ERR_IO;
+        return;
+    }
+
+    error = readMbr(store, (uint8_t*)buffer);
+}
+
+}
@@ -0,0 +1,208 @@
+/**
+ * \file
+ * \author    Chris Smeele
+ * \copyright Copyright (c) 2016, Chris Smeele
+ *
+ * Distributed under the Boost Software License, Version 1.0.
+ * See accompanying file LICENSE or copy at
+ * http://www.boost.org/LICENSE_1_0.txt
+ */
+
+/// For 64-bit pread()/pwrite() offsets. Note: this is not portable outside of *nix platforms.
+#define _FILE_OFFSET_BITS 64
+
+#include "posixfilestore.hh"
+
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#endif
+
+namespace MuStore {
+
+/// pread() until the full size is transferred. Returns false on error or EOF.
+static bool preadAll(int fd, void *buffer, size_t size, off_t offset) {
+    while (size) {
+        ssize_t ret = pread(fd, buffer, size, offset);
+        if (ret < 0 && errno == EINTR)
+            continue;
+        if (ret <= 0)
+            return false;
+
+        buffer  = (uint8_t*)buffer + ret;
+        size   -= (size_t)ret;
+        offset += ret;
+    }
+    return true;
+}
+
+/// pwrite() until the full size is transferred. Returns false on error.
+static bool pwriteAll(int fd, const void *buffer, size_t size, off_t offset) {
+    while (size) {
+        ssize_t ret = pwrite(fd, buffer, size, offset);
+        if (ret < 0 && errno == EINTR)
+            continue;
+        if (ret <= 0)
+            return false;
+
+        buffer  = (const uint8_t*)buffer + ret;
+        size   -= (size_t)ret;
+        offset += ret;
+    }
+    return true;
+}
+
+StoreError PosixFileStore::seek(size_t lba) {
+    if (fd < 0)
+        return STORE_ERR_IO;
+    if (lba >= blockCount)
+        return STORE_ERR_OUT_OF_BOUNDS;
+
+    pos = lba;
+
+    return STORE_ERR_OK;
+}
+
+StoreError PosixFileStore::read(void *buffer) {
+    return readBlocks(pos, 1, buffer);
+}
+
+StoreError PosixFileStore::write(const void *buffer) {
+    return writeBlocks(pos, 1, buffer);
+}
+
+StoreError PosixFileStore::read(size_t lba, void *buffer) {
+    return readBlocks(lba, 1, buffer);
+}
+
+StoreError PosixFileStore::write(size_t lba, const void *buffer) {
+    return writeBlocks(lba, 1, buffer);
+}
+
+StoreError PosixFileStore::readBlocks(size_t lba, size_t count, void *buffer) {
+    auto err = readAt(lba, count, buffer);
+    if (!err) // Atomic, as positional reads may be concurrent.
+        __atomic_store_n(&pos, lba + count, __ATOMIC_RELAXED);
+    return err;
+}
+
+StoreError PosixFileStore::writeBlocks(size_t lba, size_t count, const void *buffer) {
+    auto err = writeAt(lba, count, buffer);
+    if (!err)
+        __atomic_store_n(&pos, lba + count, __ATOMIC_RELAXED);
+    return err;
+}
+
+StoreError PosixFileStore::readAt(size_t lba, size_t count, void *buffer) {
+    if (fd < 0)
+        return STORE_ERR_IO;
+    if (!isRangeValid(lba, count))
+        return STORE_ERR_OUT_OF_BOUNDS;
+
+    if (!preadAll(fd, buffer, count * blockSize, (off_t)(lba * blockSize)))
+        return STORE_ERR_IO;
+
+    return STORE_ERR_OK;
+}
+
+StoreError PosixFileStore::writeAt(size_t lba, size_t count, const void *buffer) {
+    if (fd < 0)
+        return STORE_ERR_IO;
+    if (!isRangeValid(lba, count))
+        return STORE_ERR_OUT_OF_BOUNDS;
+    if (!writable)
+        return STORE_ERR_NOT_WRITABLE;
+
+    if (!pwriteAll(fd, buffer, count * blockSize, (off_t)(lba * blockSize)))
+        return STORE_ERR_IO;
+
+    return STORE_ERR_OK;
+}
+
+StoreError PosixFileStore::discard(size_t lba, size_t count) {
+    if (fd < 0)
+        return STORE_ERR_IO;
+    if (!isRangeValid(lba, count))
+        return STORE_ERR_OUT_OF_BOUNDS;
+    if (!writable)
+        return STORE_ERR_NOT_WRITABLE;
+    if (!count)
+        return STORE_ERR_OK;
+
+#ifdef __linux__
+    // On block devices this discards or zeroes the range. Files on
+    // filesystems without hole punching simply keep the data.
+    if (fallocate(fd,
+                  FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+                  (off_t)(lba * blockSize),
+                  (off_t)(count * blockSize))
+        && errno != EOPNOTSUPP
+        && errno != ENOSYS)
+        return STORE_ERR_IO;
+#endif
+
+    return STORE_ERR_OK;
+}
+
+StoreError PosixFileStore::flush() {
+    if (fd < 0)
+        return STORE_ERR_IO;
+
+    if (fsync(fd))
+        return STORE_ERR_IO;
+
+    return STORE_ERR_OK;
+}
+
+bool PosixFileStore::openFile(const char *path, int flags) {
+    fd = open(path, (writable ? O_RDWR : O_RDONLY) | O_CLOEXEC | flags);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+
+    if (fstat(fd, &st)) {
+        ::close(fd);
+        fd = -1;
+        return false;
+    }
+
+    uint64_t size = (uint64_t)st.st_size;
+#ifdef __linux__
+    // Block devices report a zero file size.
+    if (S_ISBLK(st.st_mode) && ioctl(fd, BLKGETSIZE64, &size)) {
+        ::close(fd);
+        fd = -1;
+        return false;
+    }
+#endif
+    blockCount = (size_t)(size / blockSize);
+
+    return true;
+}
+
+PosixFileStore::PosixFileStore(const char *path, bool writable_, size_t blockSize_, int flags)
+    : Store(blockSize_, 0, writable_),
+      fd(-1) {
+
+    if (isPowerOfTwo(blockSize_))
+        openFile(path, flags);
+}
+
+PosixFileStore::PosixFileStore(PosixFileStore &&other)
+    : Store(other),
+      fd(other.fd) {
+    other.fd = -1;
+}
+
+PosixFileStore::~PosixFileStore() {
+    if (fd >= 0)
+        ::close(fd);
+}
+
+}
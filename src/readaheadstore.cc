@@ -0,0 +1,190 @@
+/**
+ * \file
+ * \author    Chris Smeele
+ * \copyright Copyright (c) 2016, Chris Smeele
+ *
+ * Distributed under the Boost Software License, Version 1.0.
+ * See accompanying file LICENSE or copy at
+ * http://www.boost.org/LICENSE_1_0.txt
+ */
+#include "readaheadstore.hh"
+
+#include <algorithm>
+#include <cstring>
+
+namespace MuStore {
+
+void ReadaheadStore::dropBuffer() {
+    stats.wastedBlocks += bufferCount - bufferUsed;
+    bufferCount = 0;
+    bufferUsed  = 0;
+}
+
+StoreError ReadaheadStore::seek(size_t lba) {
+    if (!store)
+        return STORE_ERR_IO;
+    if (lba >= blockCount)
+        return STORE_ERR_OUT_OF_BOUNDS;
+
+    pos = lba;
+
+    return STORE_ERR_OK;
+}
+
+StoreError ReadaheadStore::read(void *buffer_) {
+    return readBlocks(pos, 1, buffer_);
+}
+
+StoreError ReadaheadStore::write(const void *buffer_) {
+    return writeBlocks(pos, 1, buffer_);
+}
+
+StoreError ReadaheadStore::readBlocks(size_t lba, size_t count, void *buffer_) {
+    if (!store)
+        return STORE_ERR_IO;
+    if (!isRangeValid(lba, count))
+        return STORE_ERR_OUT_OF_BOUNDS;
+
+    uint8_t *dest = (uint8_t*)buffer_;
+
+    while (count) {
+        size_t n;
+
+        if (inBuffer(lba)) {
+            // Serve what we can from the window.
+            size_t offset = lba - bufferLba;
+            n = std::min(count, bufferCount - offset);
+
+            memcpy(dest, buffer + offset * blockSize, n * blockSize);
+
+            bufferUsed = std::max(bufferUsed, offset + n);
+            stats.hits += n;
+
+        } else if (lba != lastLba + 1) {
+            // Random access, stop reading ahead.
+            if (window) {
+                window = 0;
+                stats.resets++;
+            }
+
+            n = count;
+            auto err = store->readBlocks(lba, n, dest);
+            if (err)
+                return err;
+
+            stats.misses += n;
+
+        } else {
+            // Sequential access, grow the window.
+            window = window
+                   ? std::min(window * 2, maxWindow)
+                   : std::min(initialWindow, maxWindow);
+
+            stats.maxWindow = std::max(stats.maxWindow, window);
+
+            if (count >= window) {
+                // The request is at least as large as the window,
+                // read it directly.
+                n = count;
+                auto err = store->readBlocks(lba, n, dest);
+                if (err)
+                    return err;
+
+                stats.misses += n;
+
+            } else {
+                dropBuffer();
+
+                size_t ahead = std::min(window, blockCount - lba);
+                auto err = store->readBlocks(lba, ahead, buffer);
+                if (err)
+                    return err;
+
+                bufferLba   = lba;
+                bufferCount = ahead;
+
+                stats.readaheads++;
+                stats.readaheadBlocks += ahead;
+
+                // The next iteration serves the request from the window.
+                continue;
+            }
+        }
+
+        lba     += n;
+        count   -= n;
+        dest    += n * blockSize;
+        lastLba  = lba - 1;
+    }
+
+    pos = lba;
+
+    return STORE_ERR_OK;
+}
+
+StoreError ReadaheadStore::writeBlocks(size_t lba, size_t count, const void *buffer_) {
+    if (!store)
+        return STORE_ERR_IO;
+    if (!isRangeValid(lba, count))
+        return STORE_ERR_OUT_OF_BOUNDS;
+
+    auto err = store->writeBlocks(lba, count, buffer_);
+    if (err) {
+        // We do not know which blocks made it.
+        if (bufferCount && lba < bufferLba + bufferCount && bufferLba < lba + count)
+            dropBuffer();
+        return err;
+    }
+
+    // Update the overlapping part of the window.
+    size_t start = std::max(lba, bufferLba);
+    size_t end   = std::min(lba + count, bufferLba + bufferCount);
+    if (bufferCount && start < end)
+        memcpy(buffer + (start - bufferLba) * blockSize,
+               (const uint8_t*)buffer_ + (start - lba) * blockSize,
+               (end - start) * blockSize);
+
+    pos = lba + count;
+
+    return STORE_ERR_OK;
+}
+
+StoreError ReadaheadStore::discard(size_t lba, size_t count) {
+    if (!store)
+        return STORE_ERR_IO;
+    if (!isRangeValid(lba, count))
+        return STORE_ERR_OUT_OF_BOUNDS;
+
+    if (bufferCount && lba < bufferLba + bufferCount && bufferLba < lba + count)
+        dropBuffer();
+
+    return store->discard(lba, count);
+}
+
+StoreError ReadaheadStore::flush() {
+    if (!store)
+        return STORE_ERR_IO;
+
+    return store->flush();
+}
+
+ReadaheadStore::ReadaheadStore(Store *store_, void *buffer_, size_t size, size_t initialWindow_)
+    : Store(store_->getBlockSize(),
+            store_->getBlockCount(),
+            store_->isWritable()),
+      store(store_),
+      buffer((uint8_t*)buffer_),
+      maxWindow(size / store_->getBlockSize()),
+      initialWindow(initialWindow_ ? initialWindow_ : 1),
+      window(0),
+      bufferLba(0),
+      bufferCount(0),
+      bufferUsed(0),
+      lastLba(store_->getBlockCount()),
+      stats() {
+
+    if (!buffer || !maxWindow)
+        store = nullptr; // Fail.
+}
+
+}
@@ -9,10 +9,124 @@
  */
 #include "scalestore.hh"
 
+#include <cstring>
+
 namespace MuStore {
 
+StoreError ScaleStore::writeBack() {
+    if (!bufferValid || !bufferDirty)
+        return STORE_ERR_OK;
+
+    auto err = store->write(bufferLba, buffer);
+    if (!err)
+        bufferDirty = false;
+    return err;
+}
+
+StoreError ScaleStore::load(size_t lba) {
+    if (bufferValid && bufferLba == lba)
+        return STORE_ERR_OK;
+
+    auto err = writeBack();
+    if (err)
+        return err;
+
+    bufferValid = false;
+
+    err = store->read(lba, buffer);
+    if (err)
+        return err;
+
+    bufferLba   = lba;
+    bufferValid = true;
+
+    return STORE_ERR_OK;
+}
+
+StoreError ScaleStore::readDown(size_t lba, size_t count, uint8_t *dest) {
+    while (count) {
+        size_t physical = lba / scale;
+        size_t offset   = lba % scale;
+        size_t n;
+
+        if (!offset && count >= scale
+            && !(bufferValid && bufferLba == physical)) {
+            // Read whole underlying blocks directly, up to the buffered one.
+            size_t blocks = count / scale;
+            if (bufferValid && bufferLba > physical && bufferLba < physical + blocks)
+                blocks = bufferLba - physical;
+
+            auto err = store->readBlocks(physical, blocks, dest);
+            if (err)
+                return err;
+
+            n = blocks * scale;
+
+        } else {
+            auto err = load(physical);
+            if (err)
+                return err;
+
+            n = count < scale - offset ? count : scale - offset;
+            memcpy(dest, buffer + offset * blockSize, n * blockSize);
+        }
+
+        lba   += n;
+        count -= n;
+        dest  += n * blockSize;
+    }
+
+    return STORE_ERR_OK;
+}
+
+StoreError ScaleStore::writeDown(size_t lba, size_t count, const uint8_t *src) {
+    while (count) {
+        size_t physical = lba / scale;
+        size_t offset   = lba % scale;
+        size_t n;
+
+        if (!offset && count >= scale) {
+            // Write whole underlying blocks directly.
+            size_t blocks = count / scale;
+
+            auto err = store->writeBlocks(physical, blocks, src);
+            if (err)
+                return err;
+
+            // The buffered block may have been overwritten.
+            if (bufferValid && bufferLba >= physical && bufferLba < physical + blocks) {
+                memcpy(buffer, src + (bufferLba - physical) * scale * blockSize, scale * blockSize);
+                bufferDirty = false;
+            }
+
+            n = blocks * scale;
+
+        } else {
+            auto err = load(physical);
+            if (err)
+                return err;
+
+            n = count < scale - offset ? count : scale - offset;
+            memcpy(buffer + offset * blockSize, src, n * blockSize);
+            bufferDirty = true;
+        }
+
+        lba   += n;
+        count -= n;
+        src   += n * blockSize;
+    }
+
+    return STORE_ERR_OK;
+}
+
 StoreError ScaleStore::seek(size_t lba) {
     if (store && scale) {
+        if (down) {
+            if (lba >= blockCount)
+                return STORE_ERR_OUT_OF_BOUNDS;
+            pos = lba;
+            return STORE_ERR_OK;
+        }
         auto err = store->seek(lba * scale);
         if (!err)
             pos = lba;
@@ -22,50 +136,160 @@ StoreError ScaleStore::seek(size_t lba) {
     }
 }
 
-StoreError ScaleStore::read(void *buffer) {
+StoreError ScaleStore::read(void *buffer_) {
+    return readBlocks(pos, 1, buffer_);
+}
+
+StoreError ScaleStore::write(const void *buffer_) {
+    return writeBlocks(pos, 1, buffer_);
+}
+
+StoreError ScaleStore::readBlocks(size_t lba, size_t count, void *buffer_) {
     if (store && scale) {
-        for (size_t i = 0; i < scale; i++) {
-            auto err = store->read((uint8_t*)buffer + i * store->getBlockSize());
-            if (err) {
-                seek(pos); // Try to return.
-                return err;
-            }
+        if (!isRangeValid(lba, count))
+            return STORE_ERR_OUT_OF_BOUNDS;
+
+        if (down) {
+            auto err = readDown(lba, count, (uint8_t*)buffer_);
+            if (!err)
+                pos = lba + count;
+            return err;
         }
-        pos++;
-        return STORE_ERR_OK;
+
+        // Pass the whole range on in a single request.
+        auto err = store->readBlocks(lba * scale, count * scale, buffer_);
+        if (err)
+            seek(pos); // Try to return.
+        else
+            pos = lba + count;
+        return err;
+    } else {
+        return STORE_ERR_IO;
+    }
+}
+
+StoreError ScaleStore::writeBlocks(size_t lba, size_t count, const void *buffer_) {
+    if (store && scale) {
+        if (!isRangeValid(lba, count))
+            return STORE_ERR_OUT_OF_BOUNDS;
+        if (down && !writable)
+            return STORE_ERR_NOT_WRITABLE;
+
+        if (down) {
+            auto err = writeDown(lba, count, (const uint8_t*)buffer_);
+            if (!err)
+                pos = lba + count;
+            return err;
+        }
+
+        // Pass the whole range on in a single request.
+        auto err = store->writeBlocks(lba * scale, count * scale, buffer_);
+        if (err)
+            seek(pos); // Try to return.
+        else
+            pos = lba + count;
+        return err;
     } else {
         return STORE_ERR_IO;
     }
 }
 
-StoreError ScaleStore::write(const void *buffer) {
+StoreError ScaleStore::discard(size_t lba, size_t count) {
     if (store && scale) {
-        for (size_t i = 0; i < scale; i++) {
-            auto err = store->write((const uint8_t*)buffer + i * store->getBlockSize());
-            if (err) {
-                seek(pos); // Try to return.
+        if (!isRangeValid(lba, count))
+            return STORE_ERR_OUT_OF_BOUNDS;
+
+        if (!down)
+            return store->discard(lba * scale, count * scale);
+
+        if (!writable)
+            return STORE_ERR_NOT_WRITABLE;
+
+        // Underlying blocks that are only partly discarded keep their data.
+        size_t first = (lba + scale - 1) / scale;
+        size_t end   = (lba + count) / scale;
+        if (first >= end)
+            return STORE_ERR_OK;
+
+        if (bufferValid && bufferLba >= first && bufferLba < end) {
+            bufferValid = false;
+            bufferDirty = false;
+        }
+
+        return store->discard(first, end - first);
+    } else {
+        return STORE_ERR_IO;
+    }
+}
+
+StoreError ScaleStore::flush() {
+    if (store && scale) {
+        if (down) {
+            auto err = writeBack();
+            if (err)
                 return err;
-            }
         }
-        pos++;
-        return STORE_ERR_OK;
+        return store->flush();
     } else {
         return STORE_ERR_IO;
     }
 }
 
-ScaleStore::ScaleStore(Store *store_, size_t blockSize_)
-    : Store(
-        blockSize_,
-        store_->getBlockCount() / (blockSize_ / store_->getBlockSize())
-      ),
+const uint8_t *ScaleStore::borrowBlock(size_t lba, size_t count) {
+    // Blocks of the underlying store are only contiguous when scaling up.
+    if (!store || !scale || down || !isRangeValid(lba, count))
+        return nullptr;
+
+    return store->borrowBlock(lba * scale, count * scale);
+}
+
+uint8_t *ScaleStore::borrowBlockWritable(size_t lba, size_t count) {
+    if (!store || !scale || down || !isRangeValid(lba, count))
+        return nullptr;
+
+    return store->borrowBlockWritable(lba * scale, count * scale);
+}
+
+StoreError ScaleStore::commitBlock(size_t lba, size_t count) {
+    if (!store || !scale || down)
+        return STORE_ERR_IO;
+    if (!isRangeValid(lba, count))
+        return STORE_ERR_OUT_OF_BOUNDS;
+
+    return store->commitBlock(lba * scale, count * scale);
+}
+
+ScaleStore::ScaleStore(Store *store_, size_t blockSize_, void *buffer_)
+    : Store(blockSize_, 0, store_->isWritable()),
       store(store_),
-      scale(blockSize_ / store_->getBlockSize())
+      scale(0),
+      down(blockSize_ < store_->getBlockSize()),
+      buffer((uint8_t*)buffer_),
+      bufferLba(0),
+      bufferValid(false),
+      bufferDirty(false)
 {
-    if (blockSize % store->getBlockSize())
-        store = nullptr; // Fail.
-    else
+    if (down) {
+        if (!blockSize || store->getBlockSize() % blockSize || !buffer) {
+            store = nullptr; // Fail.
+            return;
+        }
+        scale      = store->getBlockSize() / blockSize;
+        blockCount = store->getBlockCount() * scale;
+    } else {
+        if (blockSize % store->getBlockSize()) {
+            store = nullptr; // Fail.
+            return;
+        }
+        scale      = blockSize / store->getBlockSize();
+        blockCount = store->getBlockCount() / scale;
         store->seek(0);
+    }
+}
+
+ScaleStore::~ScaleStore() {
+    if (store && scale && down)
+        writeBack();
 }
 
 }
@@ -0,0 +1,255 @@
+/**
+ * \file
+ * \author    Chris Smeele
+ * \copyright Copyright (c) 2016, Chris Smeele
+ *
+ * Distributed under the Boost Software License, Version 1.0.
+ * See accompanying file LICENSE or copy at
+ * http://www.boost.org/LICENSE_1_0.txt
+ */
+#include "simulatedflashstore.hh"
+
+#include <cstring>
+#include <new>
+
+namespace MuStore {
+
+SimulatedFlashStore::Timing::Timing()
+    : readCommand  (100000),
+      writeCommand (250000),
+      busRate      (2500000),
+      flashReadRate(40000000),
+      programRate  (8000000),
+      erase        (3000000),
+      eraseUnitSize(64 * 1024),
+      bufferUnits  (2) { }
+
+uint64_t SimulatedFlashStore::close(OpenUnit *slot) {
+    size_t   unitSize = unitBlocks * blockSize;
+    uint64_t time     = timing.erase + transfer(unitSize, timing.programRate);
+
+    if (slot->written < unitBlocks) {
+        // Read the blocks we did not get from the host back from flash first.
+        time += transfer((unitBlocks - slot->written) * blockSize, timing.flashReadRate);
+        stats.unitRmws++;
+    } else {
+        stats.unitPrograms++;
+    }
+
+    slot->open = false;
+
+    return time;
+}
+
+uint64_t SimulatedFlashStore::buffer(size_t lba) {
+    size_t   unit   = lba / unitBlocks;
+    uint64_t time   = 0;
+    OpenUnit *slot  = nullptr;
+    OpenUnit *empty = nullptr;
+    OpenUnit *lru   = nullptr;
+
+    for (size_t i = 0; i < timing.bufferUnits; i++) {
+        OpenUnit *u = &units[i];
+
+        if (!u->open) {
+            if (!empty)
+                empty = u;
+        } else if (u->unit == unit) {
+            slot = u;
+            break;
+        } else if (!lru || u->lastUse < lru->lastUse) {
+            lru = u;
+        }
+    }
+
+    if (!slot) {
+        if (!empty) {
+            // The buffer is full, the least recently written unit has to go.
+            time += close(lru);
+            empty = lru;
+        }
+
+        slot          = empty;
+        slot->unit    = unit;
+        slot->written = 0;
+        slot->open    = true;
+        memset(bitmapOf(slot), 0, (unitBlocks + 7) / 8);
+    }
+
+    slot->lastUse = ++useCount;
+
+    uint8_t *bitmap = bitmapOf(slot);
+    size_t   bit    = lba % unitBlocks;
+
+    if (!(bitmap[bit / 8] & (1 << bit % 8))) {
+        bitmap[bit / 8] |= (uint8_t)(1 << bit % 8);
+
+        if (++slot->written == unitBlocks)
+            time += close(slot);
+    }
+
+    return time;
+}
+
+void SimulatedFlashStore::account(OpStats &op, uint64_t time) {
+    op.count++;
+    op.time += time;
+    if (time > op.maxTime)
+        op.maxTime = time;
+
+    now        += time;
+    lastLatency = time;
+}
+
+StoreError SimulatedFlashStore::seek(size_t lba) {
+    if (!store)
+        return STORE_ERR_IO;
+    if (lba >= blockCount)
+        return STORE_ERR_OUT_OF_BOUNDS;
+
+    pos = lba;
+
+    return STORE_ERR_OK;
+}
+
+StoreError SimulatedFlashStore::read(void *buffer_) {
+    return readBlocks(pos, 1, buffer_);
+}
+
+StoreError SimulatedFlashStore::write(const void *buffer_) {
+    return writeBlocks(pos, 1, buffer_);
+}
+
+StoreError SimulatedFlashStore::readBlocks(size_t lba, size_t count, void *buffer_) {
+    if (!store)
+        return STORE_ERR_IO;
+    if (!isRangeValid(lba, count))
+        return STORE_ERR_OUT_OF_BOUNDS;
+    if (!count)
+        return STORE_ERR_OK;
+
+    auto err = store->readBlocks(lba, count, buffer_);
+    if (err)
+        return err;
+
+    account(stats.reads, timing.readCommand + transfer(count * blockSize, timing.busRate));
+    stats.blocksRead += count;
+
+    pos = lba + count;
+
+    return STORE_ERR_OK;
+}
+
+StoreError SimulatedFlashStore::writeBlocks(size_t lba, size_t count, const void *buffer_) {
+    if (!store)
+        return STORE_ERR_IO;
+    if (!writable)
+        return STORE_ERR_NOT_WRITABLE;
+    if (!isRangeValid(lba, count))
+        return STORE_ERR_OUT_OF_BOUNDS;
+    if (!count)
+        return STORE_ERR_OK;
+
+    auto err = store->writeBlocks(lba, count, buffer_);
+    if (err)
+        return err;
+
+    uint64_t time = timing.writeCommand + transfer(count * blockSize, timing.busRate);
+    for (size_t i = 0; i < count; i++)
+        time += buffer(lba + i);
+
+    account(stats.writes, time);
+    stats.blocksWritten += count;
+
+    pos = lba + count;
+
+    return STORE_ERR_OK;
+}
+
+StoreError SimulatedFlashStore::discard(size_t lba, size_t count) {
+    if (!store)
+        return STORE_ERR_IO;
+    if (!writable)
+        return STORE_ERR_NOT_WRITABLE;
+    if (!isRangeValid(lba, count))
+        return STORE_ERR_OUT_OF_BOUNDS;
+    if (!count)
+        return STORE_ERR_OK;
+
+    auto err = store->discard(lba, count);
+    if (err)
+        return err;
+
+    for (size_t i = 0; i < timing.bufferUnits; i++) {
+        OpenUnit &u = units[i];
+        if (u.open
+            && u.unit * unitBlocks >= lba
+            && (u.unit + 1) * unitBlocks <= lba + count)
+            u.open = false;
+    }
+
+    account(stats.discards, timing.writeCommand);
+
+    return STORE_ERR_OK;
+}
+
+StoreError SimulatedFlashStore::flush() {
+    if (!store)
+        return STORE_ERR_IO;
+
+    uint64_t time = 0;
+    for (size_t i = 0; i < timing.bufferUnits; i++) {
+        if (units[i].open)
+            time += close(&units[i]);
+    }
+
+    account(stats.flushes, time);
+
+    return store->flush();
+}
+
+SimulatedFlashStore::SimulatedFlashStore(Store *store_, const Timing &timing_)
+    : Store(store_->getBlockSize(), store_->getBlockCount(), store_->isWritable()),
+      store(store_),
+      timing(timing_),
+      stats(),
+      unitBlocks(timing.eraseUnitSize / blockSize),
+      useCount(0),
+      now(0),
+      lastLatency(0) {
+
+    if (!unitBlocks
+        || timing.eraseUnitSize % blockSize
+        || !timing.bufferUnits
+        || !timing.busRate
+        || !timing.flashReadRate
+        || !timing.programRate) {
+        store      = nullptr; // Fail.
+        blockCount = 0;
+        return;
+    }
+
+    units.reset(new (std::nothrow) OpenUnit[timing.bufferUnits]());
+    written.reset(new (std::nothrow) uint8_t[timing.bufferUnits * ((unitBlocks + 7) / 8)]);
+
+    if (!units || !written) {
+        store      = nullptr; // Fail.
+        blockCount = 0;
+    }
+}
+
+SimulatedFlashStore::SimulatedFlashStore(SimulatedFlashStore &&other)
+    : Store(other),
+      store      (other.store),
+      timing     (other.timing),
+      stats      (other.stats),
+      unitBlocks (other.unitBlocks),
+      units      (std::move(other.units)),
+      written    (std::move(other.written)),
+      useCount   (other.useCount),
+      now        (other.now),
+      lastLatency(other.lastLatency) {
+    other.store = nullptr;
+}
+
+}
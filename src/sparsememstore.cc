@@ -0,0 +1,263 @@
+/**
+ * \file
+ * \author    Chris Smeele
+ * \copyright Copyright (c) 2016, Chris Smeele
+ *
+ * Distributed under the Boost Software License, Version 1.0.
+ * See accompanying file LICENSE or copy at
+ * http://www.boost.org/LICENSE_1_0.txt
+ */
+#include "sparsememstore.hh"
+
+#include <cstring>
+#include <new>
+
+namespace MuStore {
+
+struct SparseMemStore::Table {
+    std::unique_ptr<uint8_t[]> pages[TABLE_SIZE];
+
+    /// Pages that have been borrowed, and must not be freed.
+    bool pinned[TABLE_SIZE] = { };
+
+    /// Allocated pages in this table.
+    size_t used = 0;
+};
+
+/// Check whether a region contains only zero bytes.
+static bool isZero(const uint8_t *data, size_t size) {
+    return !size || (!data[0] && !memcmp(data, data + 1, size - 1));
+}
+
+uint8_t *SparseMemStore::getPage(size_t page) const {
+    auto &table = tables[page / TABLE_SIZE];
+    if (!table)
+        return nullptr;
+
+    return table->pages[page % TABLE_SIZE].get();
+}
+
+uint8_t *SparseMemStore::allocPage(size_t page) {
+    auto &table = tables[page / TABLE_SIZE];
+    if (!table) {
+        table.reset(new (std::nothrow) Table());
+        if (!table)
+            return nullptr;
+        tableCount++;
+    }
+
+    auto &slot = table->pages[page % TABLE_SIZE];
+    if (!slot) {
+        slot.reset(new (std::nothrow) uint8_t[pageSize]());
+        if (!slot)
+            return nullptr;
+        table->used++;
+        pageCount++;
+    }
+
+    return slot.get();
+}
+
+void SparseMemStore::freePage(size_t page) {
+    if (isPinned(page))
+        return;
+
+    auto &table = tables[page / TABLE_SIZE];
+
+    table->pages[page % TABLE_SIZE].reset();
+    pageCount--;
+
+    if (!--table->used) {
+        table.reset();
+        tableCount--;
+    }
+}
+
+void SparseMemStore::pinPage(size_t page) {
+    tables[page / TABLE_SIZE]->pinned[page % TABLE_SIZE] = true;
+}
+
+bool SparseMemStore::isPinned(size_t page) const {
+    auto &table = tables[page / TABLE_SIZE];
+    return table && table->pinned[page % TABLE_SIZE];
+}
+
+StoreError SparseMemStore::seek(size_t lba) {
+    if (!tables)
+        return STORE_ERR_IO;
+    if (lba >= blockCount)
+        return STORE_ERR_OUT_OF_BOUNDS;
+
+    pos = lba;
+
+    return STORE_ERR_OK;
+}
+
+StoreError SparseMemStore::read(void *buffer) {
+    return readBlocks(pos, 1, buffer);
+}
+
+StoreError SparseMemStore::write(const void *buffer) {
+    return writeBlocks(pos, 1, buffer);
+}
+
+StoreError SparseMemStore::readBlocks(size_t lba, size_t count, void *buffer) {
+    if (!tables)
+        return STORE_ERR_IO;
+    if (!isRangeValid(lba, count))
+        return STORE_ERR_OUT_OF_BOUNDS;
+
+    uint8_t *dst  = (uint8_t*)buffer;
+    size_t   left = count * blockSize;
+
+    for (size_t page = pageOf(lba), offset = offsetOf(lba); left; page++, offset = 0) {
+        size_t n = pageSize - offset < left ? pageSize - offset : left;
+
+        const uint8_t *src = getPage(page);
+        if (src)
+            memcpy(dst, src + offset, n);
+        else
+            memset(dst, 0, n);
+
+        dst  += n;
+        left -= n;
+    }
+
+    pos = lba + count;
+
+    return STORE_ERR_OK;
+}
+
+StoreError SparseMemStore::writeBlocks(size_t lba, size_t count, const void *buffer) {
+    if (!tables)
+        return STORE_ERR_IO;
+    if (!isRangeValid(lba, count))
+        return STORE_ERR_OUT_OF_BOUNDS;
+
+    const uint8_t *src  = (const uint8_t*)buffer;
+    size_t         left = count * blockSize;
+
+    for (size_t page = pageOf(lba), offset = offsetOf(lba); left; page++, offset = 0) {
+        size_t n    = pageSize - offset < left ? pageSize - offset : left;
+        bool   zero = isZero(src, n);
+
+        uint8_t *dst = getPage(page);
+        if (dst) {
+            memcpy(dst + offset, src, n);
+
+            // Free pages that were zeroed out.
+            if (zero && isZero(dst, pageSize))
+                freePage(page);
+
+        } else if (!zero) {
+            dst = allocPage(page);
+            if (!dst)
+                return STORE_ERR_IO;
+
+            memcpy(dst + offset, src, n);
+        }
+
+        src  += n;
+        left -= n;
+    }
+
+    pos = lba + count;
+
+    return STORE_ERR_OK;
+}
+
+StoreError SparseMemStore::discard(size_t lba, size_t count) {
+    if (!tables)
+        return STORE_ERR_IO;
+    if (!isRangeValid(lba, count))
+        return STORE_ERR_OUT_OF_BOUNDS;
+
+    size_t left = count * blockSize;
+
+    for (size_t page = pageOf(lba), offset = offsetOf(lba); left; page++, offset = 0) {
+        size_t n = pageSize - offset < left ? pageSize - offset : left;
+
+        uint8_t *data = getPage(page);
+        if (data) {
+            // Partially discarded and pinned pages are zeroed, and freed if nothing else remains.
+            if (n < pageSize || isPinned(page))
+                memset(data + offset, 0, n);
+            if (n == pageSize || isZero(data, pageSize))
+                freePage(page);
+        }
+
+        left -= n;
+    }
+
+    return STORE_ERR_OK;
+}
+
+const uint8_t *SparseMemStore::borrowBlock(size_t lba, size_t count) {
+    if (!tables || !isRangeValid(lba, count))
+        return nullptr;
+
+    // Borrowed blocks must be contiguous in memory.
+    if (offsetOf(lba) + count * blockSize > pageSize)
+        return nullptr;
+
+    // Untouched blocks have no memory to point at that would reflect later writes.
+    const uint8_t *page = getPage(pageOf(lba));
+    if (!page)
+        return nullptr;
+
+    pinPage(pageOf(lba));
+
+    return page + offsetOf(lba);
+}
+
+uint8_t *SparseMemStore::borrowBlockWritable(size_t lba, size_t count) {
+    if (!tables || !isRangeValid(lba, count))
+        return nullptr;
+
+    if (offsetOf(lba) + count * blockSize > pageSize)
+        return nullptr;
+
+    uint8_t *page = allocPage(pageOf(lba));
+    if (!page)
+        return nullptr;
+
+    pinPage(pageOf(lba));
+
+    return page + offsetOf(lba);
+}
+
+size_t SparseMemStore::getMemoryUsage() const {
+    if (!tables)
+        return 0;
+
+    return pageCount  * pageSize
+         + tableCount * sizeof(Table);
+}
+
+SparseMemStore::SparseMemStore(size_t size, size_t blockSize_, size_t pageSize_)
+    : Store(blockSize_, 0, true),
+      pageSize(pageSize_),
+      pageCount(0),
+      tableCount(0) {
+
+    if (!isPowerOfTwo(blockSize_) || !isPowerOfTwo(pageSize_) || pageSize_ < blockSize_)
+        return; // Fail.
+
+    blockCount = size / blockSize;
+
+    size_t pages = (blockCount * blockSize + pageSize - 1) / pageSize;
+    tables.reset(new (std::nothrow) std::unique_ptr<Table>[(pages + TABLE_SIZE - 1) / TABLE_SIZE]);
+    if (!tables)
+        blockCount = 0; // Fail.
+}
+
+SparseMemStore::SparseMemStore(SparseMemStore &&other)
+    : Store(other),
+      tables    (std::move(other.tables)),
+      pageSize  (other.pageSize),
+      pageCount (other.pageCount),
+      tableCount(other.tableCount) { }
+
+SparseMemStore::~SparseMemStore() = default;
+
+}
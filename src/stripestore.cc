@@ -0,0 +1,383 @@
+/**
+ * \file
+ * \author    Chris Smeele
+ * \copyright Copyright (c) 2016, Chris Smeele
+ *
+ * Distributed under the Boost Software License, Version 1.0.
+ * See accompanying file LICENSE or copy at
+ * http://www.boost.org/LICENSE_1_0.txt
+ */
+#include "stripestore.hh"
+
+#include <condition_variable>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <vector>
+
+namespace MuStore {
+
+struct StripeStore::Members {
+
+    /// A contiguous range of blocks on one member.
+    struct Segment {
+        size_t   lba;
+        size_t   count;
+        uint8_t *buffer;
+    };
+
+    struct Member {
+        Store *store;
+
+        /// Sub-requests of the current request for this member.
+        std::vector<Segment> segments;
+
+        StoreError err     = STORE_ERR_OK;
+        bool       pending = false;
+
+        std::thread worker;
+    };
+
+    std::vector<Member> members;
+
+    /// Whether the current request is a write.
+    bool isWrite = false;
+
+    /// Protects pending, busy and stopping.
+    std::mutex lock;
+    std::condition_variable submitted;
+    std::condition_variable completed;
+
+    /// Amount of members with a pending sub-request.
+    size_t busy     = 0;
+    bool   stopping = false;
+
+    void run(Member &member) {
+        member.err = STORE_ERR_OK;
+
+        for (auto &seg : member.segments) {
+            member.err = isWrite
+                       ? member.store->writeBlocks(seg.lba, seg.count, seg.buffer)
+                       : member.store->readBlocks (seg.lba, seg.count, seg.buffer);
+            if (member.err)
+                break;
+        }
+    }
+
+    void work(size_t i) {
+        Member &member = members[i];
+        std::unique_lock<std::mutex> guard(lock);
+
+        while (true) {
+            submitted.wait(guard, [&]{ return stopping || member.pending; });
+            if (!member.pending)
+                break;
+
+            guard.unlock();
+            run(member);
+            guard.lock();
+
+            member.pending = false;
+            busy--;
+            completed.notify_all();
+        }
+    }
+
+    /**
+     * \brief Split a request into per-member segments.
+     *
+     * \return the member of the first block
+     */
+    size_t split(size_t stripeUnit, size_t blockSize, size_t lba, size_t count, uint8_t *buffer) {
+        size_t n     = members.size();
+        size_t first = (lba / stripeUnit) % n;
+
+        while (count) {
+            size_t stripe = lba / stripeUnit;
+            size_t offset = lba % stripeUnit;
+            size_t chunk  = stripeUnit - offset;
+            if (chunk > count)
+                chunk = count;
+
+            auto  &segments  = members[stripe % n].segments;
+            size_t memberLba = (stripe / n) * stripeUnit + offset;
+
+            // Merge with the previous segment if contiguous on both sides (single-member volumes).
+            if (!segments.empty()
+                && segments.back().lba + segments.back().count == memberLba
+                && segments.back().buffer + segments.back().count * blockSize == buffer) {
+                segments.back().count += chunk;
+            } else {
+                segments.push_back(Segment { memberLba, chunk, buffer });
+            }
+
+            lba    += chunk;
+            count  -= chunk;
+            buffer += chunk * blockSize;
+        }
+
+        return first;
+    }
+
+    /**
+     * \brief Execute the segments of all members.
+     *
+     * \param first the member to handle on the calling thread
+     */
+    StoreError execute(size_t first) {
+        size_t others = 0;
+        for (size_t i = 0; i < members.size(); i++) {
+            if (i != first && !members[i].segments.empty())
+                others++;
+        }
+
+        if (others && members[0].worker.joinable()) {
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                for (size_t i = 0; i < members.size(); i++) {
+                    if (i != first && !members[i].segments.empty()) {
+                        members[i].pending = true;
+                        busy++;
+                    }
+                }
+            }
+            submitted.notify_all();
+
+            run(members[first]);
+
+            std::unique_lock<std::mutex> guard(lock);
+            completed.wait(guard, [this]{ return !busy; });
+
+        } else {
+            for (auto &member : members) {
+                if (!member.segments.empty())
+                    run(member);
+            }
+        }
+
+        StoreError err = STORE_ERR_OK;
+        for (auto &member : members) {
+            if (!err && !member.segments.empty())
+                err = member.err;
+            member.segments.clear();
+        }
+
+        return err;
+    }
+
+    Members(Store *const *stores, size_t count, bool parallel)
+        : members(count) {
+
+        for (size_t i = 0; i < count; i++)
+            members[i].store = stores[i];
+
+        if (parallel && count > 1) {
+            for (size_t i = 0; i < count; i++)
+                members[i].worker = std::thread(&Members::work, this, i);
+        }
+    }
+
+    ~Members() {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            stopping = true;
+        }
+        submitted.notify_all();
+
+        for (auto &member : members) {
+            if (member.worker.joinable())
+                member.worker.join();
+        }
+    }
+};
+
+StoreError StripeStore::seek(size_t lba) {
+    if (!members)
+        return STORE_ERR_IO;
+    if (lba >= blockCount)
+        return STORE_ERR_OUT_OF_BOUNDS;
+
+    pos = lba;
+
+    return STORE_ERR_OK;
+}
+
+StoreError StripeStore::read(void *buffer) {
+    return readBlocks(pos, 1, buffer);
+}
+
+StoreError StripeStore::write(const void *buffer) {
+    return writeBlocks(pos, 1, buffer);
+}
+
+StoreError StripeStore::readBlocks(size_t lba, size_t count, void *buffer) {
+    if (!members)
+        return STORE_ERR_IO;
+    if (!isRangeValid(lba, count))
+        return STORE_ERR_OUT_OF_BOUNDS;
+
+    members->isWrite = false;
+    size_t first = members->split(stripeUnit, blockSize, lba, count, (uint8_t*)buffer);
+
+    auto err = members->execute(first);
+    if (!err)
+        pos = lba + count;
+
+    return err;
+}
+
+StoreError StripeStore::writeBlocks(size_t lba, size_t count, const void *buffer) {
+    if (!members)
+        return STORE_ERR_IO;
+    if (!writable)
+        return STORE_ERR_NOT_WRITABLE;
+    if (!isRangeValid(lba, count))
+        return STORE_ERR_OUT_OF_BOUNDS;
+
+    members->isWrite = true;
+    size_t first = members->split(stripeUnit, blockSize, lba, count,
+                                  (uint8_t*)const_cast<void*>(buffer));
+
+    auto err = members->execute(first);
+    if (!err)
+        pos = lba + count;
+
+    return err;
+}
+
+StoreError StripeStore::discard(size_t lba, size_t count) {
+    if (!members)
+        return STORE_ERR_IO;
+    if (!writable)
+        return STORE_ERR_NOT_WRITABLE;
+    if (!isRangeValid(lba, count))
+        return STORE_ERR_OUT_OF_BOUNDS;
+
+    size_t n = members->members.size();
+
+    // The part of the range on one member is contiguous on that member.
+    // Find the member LBA at or after a volume LBA.
+    auto memberLba = [&](size_t volumeLba, size_t member) {
+        size_t stripe = volumeLba / stripeUnit;
+        size_t row    = stripe / n * stripeUnit;
+
+        if (member == stripe % n)
+            return row + volumeLba % stripeUnit;
+        return member < stripe % n ? row + stripeUnit : row;
+    };
+
+    StoreError err = STORE_ERR_OK;
+    for (size_t i = 0; i < n; i++) {
+        size_t start = memberLba(lba, i);
+        size_t end   = memberLba(lba + count, i);
+        if (start >= end)
+            continue;
+
+        auto err2 = members->members[i].store->discard(start, end - start);
+        if (!err)
+            err = err2;
+    }
+
+    return err;
+}
+
+StoreError StripeStore::flush() {
+    if (!members)
+        return STORE_ERR_IO;
+
+    StoreError err = STORE_ERR_OK;
+    for (auto &member : members->members) {
+        auto err2 = member.store->flush();
+        if (!err)
+            err = err2;
+    }
+
+    return err;
+}
+
+Store *StripeStore::locate(size_t lba, size_t count, size_t &memberLba) const {
+    size_t stripe = lba / stripeUnit;
+    size_t offset = lba % stripeUnit;
+
+    if (offset + count > stripeUnit)
+        return nullptr;
+
+    size_t n  = members->members.size();
+    memberLba = (stripe / n) * stripeUnit + offset;
+
+    return members->members[stripe % n].store;
+}
+
+const uint8_t *StripeStore::borrowBlock(size_t lba, size_t count) {
+    if (!members || !isRangeValid(lba, count))
+        return nullptr;
+
+    size_t memberLba;
+    Store *member = locate(lba, count, memberLba);
+
+    return member ? member->borrowBlock(memberLba, count) : nullptr;
+}
+
+uint8_t *StripeStore::borrowBlockWritable(size_t lba, size_t count) {
+    if (!members || !writable || !isRangeValid(lba, count))
+        return nullptr;
+
+    size_t memberLba;
+    Store *member = locate(lba, count, memberLba);
+
+    return member ? member->borrowBlockWritable(memberLba, count) : nullptr;
+}
+
+StoreError StripeStore::commitBlock(size_t lba, size_t count) {
+    if (!members)
+        return STORE_ERR_IO;
+    if (!isRangeValid(lba, count))
+        return STORE_ERR_OUT_OF_BOUNDS;
+
+    size_t memberLba;
+    Store *member = locate(lba, count, memberLba);
+    if (!member)
+        return STORE_ERR_OUT_OF_BOUNDS;
+
+    return member->commitBlock(memberLba, count);
+}
+
+size_t StripeStore::getMemberCount() const {
+    return members ? members->members.size() : 0;
+}
+
+StripeStore::StripeStore(Store *const *stores, size_t count, size_t stripeUnit_, bool parallel)
+    : Store(count ? stores[0]->getBlockSize() : 512, 0, count > 0),
+      stripeUnit(stripeUnit_) {
+
+    if (!count || !stripeUnit_)
+        return; // Fail.
+
+    size_t memberBlocks = stores[0]->getBlockCount();
+
+    for (size_t i = 0; i < count; i++) {
+        if (stores[i]->getBlockSize() != blockSize)
+            return; // Fail.
+        if (stores[i]->getBlockCount() < memberBlocks)
+            memberBlocks = stores[i]->getBlockCount();
+        if (!stores[i]->isWritable())
+            writable = false;
+    }
+
+    memberBlocks -= memberBlocks % stripeUnit;
+    if (!memberBlocks)
+        return; // Fail.
+
+    members.reset(new (std::nothrow) Members(stores, count, parallel));
+    if (members)
+        blockCount = memberBlocks * count;
+}
+
+StripeStore::StripeStore(StripeStore &&other)
+    : Store(other),
+      members(std::move(other.members)),
+      stripeUnit(other.stripeUnit) { }
+
+StripeStore::~StripeStore() = default;
+
+}
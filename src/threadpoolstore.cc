@@ -0,0 +1,271 @@
+/**
+ * \file
+ * \author    Chris Smeele
+ * \copyright Copyright (c) 2016, Chris Smeele
+ *
+ * Distributed under the Boost Software License, Version 1.0.
+ * See accompanying file LICENSE or copy at
+ * http://www.boost.org/LICENSE_1_0.txt
+ */
+#include "threadpoolstore.hh"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <vector>
+
+namespace MuStore {
+
+struct ThreadPoolStore::Pool {
+
+    struct Request {
+        bool    isWrite;
+        size_t  lba;
+        size_t  count;
+        void   *buffer;
+        void   *cookie;
+    };
+
+    Store *store;
+    bool   threadSafe;
+
+    /// Serializes access to the store if it is not thread-safe.
+    std::mutex storeLock;
+
+    /// Protects everything below.
+    std::mutex lock;
+    std::condition_variable submitted;
+    std::condition_variable completed;
+
+    std::deque<Request>    queue;
+    std::deque<Completion> done;
+
+    /// Requests that were submitted, but have not completed yet.
+    size_t inFlight = 0;
+    bool   stopping = false;
+
+    std::vector<std::thread> workers;
+
+    StoreError execute(bool isWrite, size_t lba, size_t count, void *buffer) {
+        std::unique_lock<std::mutex> guard(storeLock, std::defer_lock);
+        if (!threadSafe)
+            guard.lock();
+
+        return isWrite
+             ? store->writeBlocks(lba, count, buffer)
+             : store->readBlocks (lba, count, buffer);
+    }
+
+    void work() {
+        std::unique_lock<std::mutex> guard(lock);
+
+        while (true) {
+            submitted.wait(guard, [this]{ return stopping || !queue.empty(); });
+
+            // Finish queued requests before stopping.
+            if (queue.empty())
+                break;
+
+            Request req = queue.front();
+            queue.pop_front();
+
+            guard.unlock();
+            StoreError err = execute(req.isWrite, req.lba, req.count, req.buffer);
+            guard.lock();
+
+            done.push_back(Completion { req.cookie, err });
+            inFlight--;
+            completed.notify_all();
+        }
+    }
+
+    StoreError submit(const Request &req) {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            queue.push_back(req);
+            inFlight++;
+        }
+        submitted.notify_one();
+
+        return STORE_ERR_OK;
+    }
+
+    /// Wait until all submitted requests have completed.
+    void drain() {
+        std::unique_lock<std::mutex> guard(lock);
+        completed.wait(guard, [this]{ return !inFlight; });
+    }
+
+    Pool(Store *store_, size_t threads, bool threadSafe_)
+        : store(store_),
+          threadSafe(threadSafe_) {
+
+        for (size_t i = 0; i < threads; i++)
+            workers.emplace_back(&Pool::work, this);
+    }
+
+    ~Pool() {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            stopping = true;
+        }
+        submitted.notify_all();
+
+        for (auto &worker : workers)
+            worker.join();
+    }
+};
+
+StoreError ThreadPoolStore::seek(size_t lba) {
+    if (!pool)
+        return STORE_ERR_IO;
+    if (lba >= blockCount)
+        return STORE_ERR_OUT_OF_BOUNDS;
+
+    pos = lba;
+
+    return STORE_ERR_OK;
+}
+
+StoreError ThreadPoolStore::read(void *buffer) {
+    return readBlocks(pos, 1, buffer);
+}
+
+StoreError ThreadPoolStore::write(const void *buffer) {
+    return writeBlocks(pos, 1, buffer);
+}
+
+StoreError ThreadPoolStore::readBlocks(size_t lba, size_t count, void *buffer) {
+    if (!pool)
+        return STORE_ERR_IO;
+    if (!isRangeValid(lba, count))
+        return STORE_ERR_OUT_OF_BOUNDS;
+
+    auto err = pool->execute(false, lba, count, buffer);
+    if (!err)
+        pos = lba + count;
+
+    return err;
+}
+
+StoreError ThreadPoolStore::writeBlocks(size_t lba, size_t count, const void *buffer) {
+    if (!pool)
+        return STORE_ERR_IO;
+    if (!writable)
+        return STORE_ERR_NOT_WRITABLE;
+    if (!isRangeValid(lba, count))
+        return STORE_ERR_OUT_OF_BOUNDS;
+
+    auto err = pool->execute(true, lba, count, const_cast<void*>(buffer));
+    if (!err)
+        pos = lba + count;
+
+    return err;
+}
+
+StoreError ThreadPoolStore::discard(size_t lba, size_t count) {
+    if (!pool)
+        return STORE_ERR_IO;
+    if (!writable)
+        return STORE_ERR_NOT_WRITABLE;
+    if (!isRangeValid(lba, count))
+        return STORE_ERR_OUT_OF_BOUNDS;
+
+    // Submitted writes to the range must not land after the discard.
+    pool->drain();
+
+    std::unique_lock<std::mutex> guard(pool->storeLock, std::defer_lock);
+    if (!pool->threadSafe)
+        guard.lock();
+
+    return pool->store->discard(lba, count);
+}
+
+StoreError ThreadPoolStore::flush() {
+    if (!pool)
+        return STORE_ERR_IO;
+
+    pool->drain();
+
+    std::unique_lock<std::mutex> guard(pool->storeLock, std::defer_lock);
+    if (!pool->threadSafe)
+        guard.lock();
+
+    return pool->store->flush();
+}
+
+StoreError ThreadPoolStore::submitRead(size_t lba, size_t count, void *buffer, void *cookie) {
+    if (!pool)
+        return STORE_ERR_IO;
+    if (!isRangeValid(lba, count))
+        return STORE_ERR_OUT_OF_BOUNDS;
+
+    return pool->submit(Pool::Request { false, lba, count, buffer, cookie });
+}
+
+StoreError ThreadPoolStore::submitWrite(size_t lba, size_t count, const void *buffer, void *cookie) {
+    if (!pool)
+        return STORE_ERR_IO;
+    if (!writable)
+        return STORE_ERR_NOT_WRITABLE;
+    if (!isRangeValid(lba, count))
+        return STORE_ERR_OUT_OF_BOUNDS;
+
+    return pool->submit(Pool::Request { true, lba, count, const_cast<void*>(buffer), cookie });
+}
+
+size_t ThreadPoolStore::poll(Completion *completions, size_t max, size_t min) {
+    if (!pool)
+        return 0;
+
+    std::unique_lock<std::mutex> guard(pool->lock);
+
+    if (min > max)
+        min = max;
+
+    pool->completed.wait(guard, [&]{
+        return pool->done.size() >= min || !pool->inFlight;
+    });
+
+    size_t n = 0;
+    for (; n < max && !pool->done.empty(); n++) {
+        completions[n] = pool->done.front();
+        pool->done.pop_front();
+    }
+
+    return n;
+}
+
+size_t ThreadPoolStore::getOutstanding() const {
+    if (!pool)
+        return 0;
+
+    std::lock_guard<std::mutex> guard(pool->lock);
+    return pool->inFlight + pool->done.size();
+}
+
+size_t ThreadPoolStore::getThreadCount() const {
+    return pool ? pool->workers.size() : 0;
+}
+
+ThreadPoolStore::ThreadPoolStore(Store *store, size_t threads, bool threadSafe)
+    : Store(store->getBlockSize(),
+            store->getBlockCount(),
+            store->isWritable()) {
+
+    if (threads)
+        pool.reset(new (std::nothrow) Pool(store, threads, threadSafe));
+
+    if (!pool)
+        blockCount = 0; // Fail.
+}
+
+ThreadPoolStore::ThreadPoolStore(ThreadPoolStore &&other)
+    : Store(other),
+      pool(std::move(other.pool)) { }
+
+ThreadPoolStore::~ThreadPoolStore() = default;
+
+}
@@ -0,0 +1,325 @@
+/**
+ * \file
+ * \author    Chris Smeele
+ * \copyright Copyright (c) 2016, Chris Smeele
+ *
+ * Distributed under the Boost Software License, Version 1.0.
+ * See accompanying file LICENSE or copy at
+ * http://www.boost.org/LICENSE_1_0.txt
+ */
+#include "tracestore.hh"
+
+#include <chrono>
+#include <cstring>
+#include <new>
+
+namespace MuStore {
+
+// Trace format {{{
+//
+// A trace starts with the magic below, followed by the block size and
+// block count of the traced store as varints. Each record is:
+//
+//   uint8  op, with bit 7 set when the operation failed
+//   uint8  error, only if bit 7 of op is set
+//   varint start time - start time of the previous record
+//   varint duration
+//   varint zigzag(lba - end of the previous operation), unless op is FLUSH
+//   varint count, for READ, WRITE and DISCARD
+//
+// Varints are little endian base 128, so traces are portable.
+
+static const char   TRACE_MAGIC[8]  = { 'M', 'U', 'T', 'R', 'A', 'C', 'E', 1 };
+static const size_t TRACE_BUFFER    = 4096;
+static const size_t MAX_RECORD_SIZE = 2 + 4 * 10;
+
+static uint64_t clockNs() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static uint8_t *putVarint(uint8_t *p, uint64_t value) {
+    while (value >= 0x80) {
+        *p++ = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    *p++ = (uint8_t)value;
+    return p;
+}
+
+static bool hasLba(TraceOp op)   { return op != TraceOp::FLUSH; }
+static bool hasCount(TraceOp op) { return op != TraceOp::FLUSH && op != TraceOp::SEEK; }
+
+// }}}
+
+void TraceStore::record(TraceOp op, StoreError err, size_t lba, size_t count, uint64_t begin) {
+    uint64_t end = clockNs();
+
+    records++;
+
+    if (!fh)
+        return;
+
+    if (used + MAX_RECORD_SIZE > TRACE_BUFFER && !writeOut())
+        return;
+
+    uint8_t *p = buffer.get() + used;
+
+    *p++ = (uint8_t)((uint8_t)op | (err ? 0x80 : 0));
+    if (err)
+        *p++ = (uint8_t)err;
+
+    p = putVarint(p, begin - start - lastTime);
+    p = putVarint(p, end - begin);
+
+    if (hasLba(op)) {
+        int64_t delta = (int64_t)(lba - lastEnd);
+        p = putVarint(p, ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63));
+
+        lastEnd = lba + (hasCount(op) ? count : 0);
+    }
+    if (hasCount(op))
+        p = putVarint(p, count);
+
+    used     = (size_t)(p - buffer.get());
+    lastTime = begin - start;
+}
+
+bool TraceStore::writeOut() {
+    if (!fh)
+        return false;
+
+    if (used && fwrite(buffer.get(), used, 1, fh) != 1) {
+        close(); // Stop tracing, but keep passing calls on.
+        return false;
+    }
+    used = 0;
+
+    return true;
+}
+
+void TraceStore::close() {
+    if (fh) {
+        fclose(fh);
+        fh = nullptr;
+    }
+}
+
+StoreError TraceStore::seek(size_t lba) {
+    if (!store)
+        return STORE_ERR_IO;
+
+    uint64_t begin = clockNs();
+    auto     err   = store->seek(lba);
+    record(TraceOp::SEEK, err, lba, 0, begin);
+
+    if (!err)
+        pos = lba;
+
+    return err;
+}
+
+StoreError TraceStore::read(void *buffer_) {
+    return readBlocks(pos, 1, buffer_);
+}
+
+StoreError TraceStore::write(const void *buffer_) {
+    return writeBlocks(pos, 1, buffer_);
+}
+
+StoreError TraceStore::readBlocks(size_t lba, size_t count, void *buffer_) {
+    if (!store)
+        return STORE_ERR_IO;
+
+    uint64_t begin = clockNs();
+    auto     err   = store->readBlocks(lba, count, buffer_);
+    record(TraceOp::READ, err, lba, count, begin);
+
+    if (!err)
+        pos = lba + count;
+
+    return err;
+}
+
+StoreError TraceStore::writeBlocks(size_t lba, size_t count, const void *buffer_) {
+    if (!store)
+        return STORE_ERR_IO;
+
+    uint64_t begin = clockNs();
+    auto     err   = store->writeBlocks(lba, count, buffer_);
+    record(TraceOp::WRITE, err, lba, count, begin);
+
+    if (!err)
+        pos = lba + count;
+
+    return err;
+}
+
+StoreError TraceStore::discard(size_t lba, size_t count) {
+    if (!store)
+        return STORE_ERR_IO;
+
+    uint64_t begin = clockNs();
+    auto     err   = store->discard(lba, count);
+    record(TraceOp::DISCARD, err, lba, count, begin);
+
+    return err;
+}
+
+StoreError TraceStore::flush() {
+    if (!store)
+        return STORE_ERR_IO;
+
+    uint64_t begin = clockNs();
+    auto     err   = store->flush();
+    record(TraceOp::FLUSH, err, 0, 0, begin);
+
+    if (writeOut())
+        fflush(fh);
+
+    return err;
+}
+
+TraceStore::TraceStore(Store *store_, const char *path)
+    : Store(store_->getBlockSize(), store_->getBlockCount(), store_->isWritable()),
+      store(store_),
+      fh(fopen(path, "wb")),
+      buffer(new (std::nothrow) uint8_t[TRACE_BUFFER]),
+      used(0),
+      records(0),
+      lastEnd(0),
+      start(clockNs()),
+      lastTime(0) {
+
+    if (!fh || !buffer) {
+        close();
+        store      = nullptr; // Fail.
+        blockCount = 0;
+        return;
+    }
+
+    memcpy(buffer.get(), TRACE_MAGIC, sizeof(TRACE_MAGIC));
+
+    uint8_t *p = buffer.get() + sizeof(TRACE_MAGIC);
+    p = putVarint(p, blockSize);
+    p = putVarint(p, blockCount);
+    used = (size_t)(p - buffer.get());
+}
+
+TraceStore::TraceStore(TraceStore &&other)
+    : Store(other),
+      store   (other.store),
+      fh      (other.fh),
+      buffer  (std::move(other.buffer)),
+      used    (other.used),
+      records (other.records),
+      lastEnd (other.lastEnd),
+      start   (other.start),
+      lastTime(other.lastTime) {
+    other.store = nullptr;
+    other.fh    = nullptr;
+}
+
+TraceStore::~TraceStore() {
+    writeOut();
+    close();
+}
+
+bool TraceReader::readVarint(uint64_t &value) {
+    value = 0;
+
+    for (unsigned shift = 0; shift < 64; shift += 7) {
+        int c = fgetc(fh);
+        if (c == EOF)
+            return false;
+
+        value |= (uint64_t)(c & 0x7f) << shift;
+        if (!(c & 0x80))
+            return true;
+    }
+
+    return false;
+}
+
+bool TraceReader::next(TraceRecord &rec) {
+    if (!fh)
+        return false;
+
+    int c = fgetc(fh);
+    if (c == EOF)
+        return false;
+
+    rec.op  = (TraceOp)(c & 0x7f);
+    rec.err = STORE_ERR_OK;
+
+    if (rec.op > TraceOp::DISCARD)
+        return false;
+
+    if (c & 0x80) {
+        int e = fgetc(fh);
+        if (e == EOF)
+            return false;
+        rec.err = (StoreError)e;
+    }
+
+    uint64_t delta, duration;
+    if (!readVarint(delta) || !readVarint(duration))
+        return false;
+
+    rec.time     = lastTime + delta;
+    rec.duration = duration;
+    rec.lba      = 0;
+    rec.count    = 0;
+
+    if (hasLba(rec.op)) {
+        uint64_t zigzag;
+        if (!readVarint(zigzag))
+            return false;
+        rec.lba = lastEnd + (size_t)(int64_t)((zigzag >> 1) ^ (~(zigzag & 1) + 1));
+    }
+    if (hasCount(rec.op)) {
+        uint64_t count;
+        if (!readVarint(count))
+            return false;
+        rec.count = (size_t)count;
+    }
+
+    if (hasLba(rec.op))
+        lastEnd = rec.lba + rec.count;
+    lastTime = rec.time;
+
+    return true;
+}
+
+TraceReader::TraceReader(const char *path)
+    : fh(fopen(path, "rb")),
+      blockSize(0),
+      blockCount(0),
+      lastEnd(0),
+      lastTime(0) {
+
+    char     magic[sizeof(TRACE_MAGIC)];
+    uint64_t size, count;
+
+    if (!fh)
+        return;
+
+    if (fread(magic, sizeof(magic), 1, fh) != 1
+        || memcmp(magic, TRACE_MAGIC, sizeof(magic))
+        || !readVarint(size)
+        || !readVarint(count)) {
+        fclose(fh);
+        fh = nullptr; // Fail.
+        return;
+    }
+
+    blockSize  = (size_t)size;
+    blockCount = (size_t)count;
+}
+
+TraceReader::~TraceReader() {
+    if (fh)
+        fclose(fh);
+}
+
+}
@@ -11,6 +11,22 @@
 #include <array>
 #include <memstore.hh>
 
+TEST(geometry) {
+    static std::array<uint8_t, 4 * 65536 + 1000> region;
+
+    for (size_t blockSize : { 512, 1024, 2048, 4096, 65536 }) {
+        MemStore memStore(&region, region.size(), blockSize);
+        ASSERT(memStore.getBlockSize() == blockSize,
+               "block size should be %lu, is %lu", blockSize, memStore.getBlockSize());
+        ASSERT(memStore.getBlockCount() == region.size() / blockSize,
+               "block count should be %lu, is %lu", region.size() / blockSize, memStore.getBlockCount());
+    }
+
+    MemStore badStore(&region, region.size(), 3000);
+    ASSERT(badStore.getBlockCount() == 0, "block size that is not a power of two should be rejected");
+    ASSERT(badStore.seek(0) == STORE_ERR_OUT_OF_BOUNDS, "seek on store without blocks should fail");
+}
+
 TEST_MAIN() {
     TEST_START();
 
@@ -23,10 +39,25 @@ TEST_MAIN() {
     TEST_STORE_WITH(MemStore(&image, image.size()), seek  );
     TEST_STORE_WITH(MemStore(&image, image.size()), read  );
     TEST_STORE_WITH(MemStore(&image, image.size()), write );
+    TEST_STORE_WITH(MemStore(&image, image.size()), read_blocks );
+    TEST_STORE_WITH(MemStore(&image, image.size()), write_blocks);
+    TEST_STORE_WITH(MemStore(&image, image.size()), flush );
+    TEST_STORE_WITH(MemStore(&image, image.size()), borrow);
 
     auto const image_ro = image;
 
     TEST_STORE_WITH(MemStore(&image_ro, image_ro.size()), write_ro);
+    TEST_STORE_WITH(MemStore(&image_ro, image_ro.size()), borrow  );
+
+    TEST_STORE_WITH(MemStore(&image, image.size(), 4096), create);
+    TEST_STORE_WITH(MemStore(&image, image.size(), 4096), seek  );
+    TEST_STORE_WITH(MemStore(&image, image.size(), 4096), read  );
+    TEST_STORE_WITH(MemStore(&image, image.size(), 4096), write );
+    TEST_STORE_WITH(MemStore(&image, image.size(), 4096), read_blocks );
+    TEST_STORE_WITH(MemStore(&image, image.size(), 4096), write_blocks);
+    TEST_STORE_WITH(MemStore(&image_ro, image_ro.size(), 4096), write_ro);
+
+    RUN_TEST(geometry);
 
     TEST_END();
 }
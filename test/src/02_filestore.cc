@@ -17,7 +17,18 @@ TEST_MAIN() {
     TEST_STORE_WITH(FileStore(MUTEST_FAT12FILE), seek  );
     TEST_STORE_WITH(FileStore(MUTEST_FAT12FILE), read  );
     TEST_STORE_WITH(FileStore(MUTEST_FAT12FILE), write );
+    TEST_STORE_WITH(FileStore(MUTEST_FAT12FILE), read_blocks );
+    TEST_STORE_WITH(FileStore(MUTEST_FAT12FILE), write_blocks);
+    TEST_STORE_WITH(FileStore(MUTEST_FAT12FILE), flush );
     TEST_STORE_WITH(FileStore(MUTEST_FAT12FILE, false), write_ro);
 
+    TEST_STORE_WITH(FileStore(MUTEST_FAT12FILE, true, 4096), create);
+    TEST_STORE_WITH(FileStore(MUTEST_FAT12FILE, true, 4096), seek  );
+    TEST_STORE_WITH(FileStore(MUTEST_FAT12FILE, true, 4096), read  );
+    TEST_STORE_WITH(FileStore(MUTEST_FAT12FILE, true, 4096), write );
+    TEST_STORE_WITH(FileStore(MUTEST_FAT12FILE, true, 4096), read_blocks );
+    TEST_STORE_WITH(FileStore(MUTEST_FAT12FILE, true, 4096), write_blocks);
+    TEST_STORE_WITH(FileStore(MUTEST_FAT12FILE, false, 4096), write_ro);
+
     TEST_END();
 }
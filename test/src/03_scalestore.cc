@@ -1,4 +1,3 @@
-
 /**
  * \file
  * \brief     Tests for ScaleStore.
@@ -9,9 +8,166 @@
 #include "test.hh"
 #include "store.hh"
 
+#include <array>
 #include <filestore.hh>
+#include <memstore.hh>
 #include <scalestore.hh>
 
+static uint8_t scaleBuffer[4096];
+
+/// A MemStore that counts the requests made to it.
+struct CountingStore : public MemStore {
+    size_t reads  = 0;
+    size_t writes = 0;
+
+    StoreError read(void *buffer) {
+        reads++;
+        return MemStore::read(buffer);
+    }
+    StoreError write(const void *buffer) {
+        writes++;
+        return MemStore::write(buffer);
+    }
+    StoreError readBlocks(size_t lba, size_t count, void *buffer) {
+        reads++;
+        return MemStore::readBlocks(lba, count, buffer);
+    }
+    StoreError writeBlocks(size_t lba, size_t count, const void *buffer) {
+        writes++;
+        return MemStore::writeBlocks(lba, count, buffer);
+    }
+    using MemStore::read;
+    using MemStore::write;
+
+    CountingStore(void *store_, size_t size, size_t blockSize_)
+        : MemStore(store_, size, blockSize_) { }
+};
+
+/// A MemStore that fails requests touching a single bad block.
+struct FailingStore : public MemStore {
+    size_t badLba;
+
+    StoreError readBlocks(size_t lba, size_t count, void *buffer) {
+        if (badLba >= lba && badLba < lba + count) {
+            // Transfer up to the bad block, then fail.
+            MemStore::readBlocks(lba, badLba - lba, buffer);
+            return STORE_ERR_IO;
+        }
+        return MemStore::readBlocks(lba, count, buffer);
+    }
+    StoreError writeBlocks(size_t lba, size_t count, const void *buffer) {
+        if (badLba >= lba && badLba < lba + count) {
+            MemStore::writeBlocks(lba, badLba - lba, buffer);
+            return STORE_ERR_IO;
+        }
+        return MemStore::writeBlocks(lba, count, buffer);
+    }
+    using MemStore::read;
+    using MemStore::write;
+
+    FailingStore(void *store_, size_t size, size_t badLba_)
+        : MemStore(store_, size), badLba(badLba_) { }
+};
+
+TEST(partial_failure) {
+    static std::array<uint8_t, 64 * 512> image;
+    FailingStore backend(&image, image.size(), 21);
+    ScaleStore scaled(&backend, 4096);
+    StoreError err;
+
+    uint8_t buffer[4096];
+
+    err = scaled.seek(2);
+    ASSERT(err == STORE_ERR_OK, "seek (err=%d)", err);
+
+    // Block 2 contains the bad block 21.
+    err = scaled.read(buffer);
+    ASSERT(err == STORE_ERR_IO, "read of bad block should fail (err=%d)", err);
+    ASSERT(scaled.getPos() == 2, "pos should be 2 after a failed read (pos=%lu)", scaled.getPos());
+    ASSERT(backend.getPos() == 16, "underlying pos should be 16 after a failed read (pos=%lu)", backend.getPos());
+
+    err = scaled.write(buffer);
+    ASSERT(err == STORE_ERR_IO, "write of bad block should fail (err=%d)", err);
+    ASSERT(scaled.getPos() == 2, "pos should be 2 after a failed write (pos=%lu)", scaled.getPos());
+
+    // Reads continue at the same position after a failure.
+    backend.badLba = 1000;
+    err = scaled.read(buffer);
+    ASSERT(err == STORE_ERR_OK, "read block (err=%d)", err);
+    ASSERT(scaled.getPos() == 3, "pos should be 3 (pos=%lu)", scaled.getPos());
+    ASSERT(backend.getPos() == 24, "underlying pos should be 24 (pos=%lu)", backend.getPos());
+}
+
+TEST(downscale_buffering) {
+    static std::array<uint8_t, 64 * 4096> image;
+    for (size_t i = 0; i < image.size(); i++)
+        image[i] = rand();
+    auto original = image;
+
+    CountingStore backend(&image, image.size(), 4096);
+    StoreError err;
+
+    static uint8_t range[512 * 32];
+
+    {
+        ScaleStore scaled(&backend, 512, scaleBuffer);
+        ASSERT(scaled.getBlockSize()  == 512,     "block size should be 512, is %lu", scaled.getBlockSize());
+        ASSERT(scaled.getBlockCount() == 64 * 8, "block count should be %d, is %lu", 64 * 8, scaled.getBlockCount());
+
+        uint8_t buffer[512];
+
+        // Consecutive sub-block reads cost a single underlying read.
+        err = scaled.seek(16);
+        ASSERT(err == STORE_ERR_OK, "seek (err=%d)", err);
+        for (size_t i = 0; i < 8; i++) {
+            err = scaled.read(buffer);
+            ASSERT(err == STORE_ERR_OK, "read block (err=%d)", err);
+            ASSERT(!memcmp(buffer, &original[(16 + i) * 512], sizeof(buffer)), "block %lu differs", 16 + i);
+        }
+        ASSERT(backend.reads == 1, "expected 1 underlying read, got %lu", backend.reads);
+
+        // Consecutive sub-block writes cost a single read-modify-write cycle.
+        memset(buffer, 0xa5, sizeof(buffer));
+        for (size_t i = 0; i < 8; i++) {
+            err = scaled.write(40 + i, buffer);
+            ASSERT(err == STORE_ERR_OK, "write block (err=%d)", err);
+        }
+        ASSERT(backend.reads  == 2, "expected 2 underlying reads, got %lu",  backend.reads);
+        ASSERT(backend.writes == 0, "expected no underlying writes, got %lu", backend.writes);
+
+        err = scaled.read(43, buffer);
+        ASSERT(err == STORE_ERR_OK, "read block (err=%d)", err);
+        ASSERT(buffer[0] == 0xa5, "buffered write not returned on read");
+
+        err = scaled.flush();
+        ASSERT(err == STORE_ERR_OK, "flush (err=%d)", err);
+        ASSERT(backend.writes == 1, "expected 1 underlying write, got %lu", backend.writes);
+        ASSERT(image[40 * 512] == 0xa5 && image[47 * 512 + 511] == 0xa5, "block not written back");
+
+        // Whole underlying blocks are passed through in one request.
+        backend.reads = 0;
+        err = scaled.readBlocks(8, 32, range);
+        ASSERT(err == STORE_ERR_OK, "read blocks (err=%d)", err);
+        ASSERT(backend.reads == 1, "expected 1 underlying read, got %lu", backend.reads);
+        ASSERT(!memcmp(range, &original[8 * 512], sizeof(range)), "multi-block read differs");
+
+        // Unaligned multi-block writes.
+        for (size_t i = 0; i < sizeof(range); i++)
+            range[i] = rand();
+        err = scaled.writeBlocks(101, 30, range);
+        ASSERT(err == STORE_ERR_OK, "write blocks (err=%d)", err);
+        memset(buffer, 0x3c, sizeof(buffer));
+        err = scaled.write(131, buffer);
+        ASSERT(err == STORE_ERR_OK, "write block (err=%d)", err);
+
+        // Left dirty, to be written back on destruction.
+    }
+
+    ASSERT(!memcmp(&image[101 * 512], range, 30 * 512), "multi-block write differs");
+    ASSERT(image[131 * 512] == 0x3c, "dirty block not written back on destruction");
+    ASSERT(!memcmp(&image[132 * 512], &original[132 * 512], 4 * 512), "write-back clobbered neighbouring blocks");
+}
+
 TEST_MAIN() {
     TEST_START();
 
@@ -20,9 +176,31 @@ TEST_MAIN() {
     TEST_STORE_WITH(ScaleStore(&fileStore, 4096), seek  );
     TEST_STORE_WITH(ScaleStore(&fileStore, 4096), read  );
     TEST_STORE_WITH(ScaleStore(&fileStore, 4096), write );
+    TEST_STORE_WITH(ScaleStore(&fileStore, 4096), read_blocks );
+    TEST_STORE_WITH(ScaleStore(&fileStore, 4096), write_blocks);
+    TEST_STORE_WITH(ScaleStore(&fileStore, 4096), flush );
 
     auto roFileStore = FileStore(MUTEST_FAT12FILE, false);
     TEST_STORE_WITH(ScaleStore(&roFileStore, 4096), write_ro);
 
+    auto fileStore4k = FileStore(MUTEST_FAT12FILE, true, 4096);
+    TEST_STORE_WITH(ScaleStore(&fileStore4k, 512, scaleBuffer), create);
+    TEST_STORE_WITH(ScaleStore(&fileStore4k, 512, scaleBuffer), seek  );
+    TEST_STORE_WITH(ScaleStore(&fileStore4k, 512, scaleBuffer), read  );
+    TEST_STORE_WITH(ScaleStore(&fileStore4k, 512, scaleBuffer), write );
+    TEST_STORE_WITH(ScaleStore(&fileStore4k, 512, scaleBuffer), read_blocks );
+    TEST_STORE_WITH(ScaleStore(&fileStore4k, 512, scaleBuffer), write_blocks);
+    TEST_STORE_WITH(ScaleStore(&fileStore4k, 512, scaleBuffer), flush );
+
+    auto roFileStore4k = FileStore(MUTEST_FAT12FILE, false, 4096);
+    TEST_STORE_WITH(ScaleStore(&roFileStore4k, 512, scaleBuffer), write_ro);
+
+    static std::array<uint8_t, 64 * 4096> image;
+    auto memStore = MemStore(&image, image.size());
+    TEST_STORE_WITH(ScaleStore(&memStore, 4096), borrow);
+
+    RUN_TEST(partial_failure);
+    RUN_TEST(downscale_buffering);
+
     TEST_END();
 }
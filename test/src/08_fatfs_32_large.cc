@@ -20,6 +20,7 @@ TEST_MAIN() {
     TEST_FS_WITH(FatFs(&store), metadata);
     TEST_FS_WITH(FatFs(&store), large_root_readdir);
     TEST_FS_WITH(FatFs(&store), large_file_read);
+    TEST_FS_WITH(FatFs(&store), large_file_read_bulk);
 
     TEST_END();
 }
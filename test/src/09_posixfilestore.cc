@@ -0,0 +1,122 @@
+/**
+ * \file
+ * \brief     Tests for PosixFileStore.
+ * \author    Chris Smeele
+ * \copyright Copyright (c) 2016, Chris Smeele
+ * \license   Boost, see LICENSE
+ */
+#include "test.hh"
+#include "store.hh"
+
+#include <posixfilestore.hh>
+
+#include <thread>
+#include <vector>
+
+TEST(positional_io) {
+    ASSERT(store, "store was not created");
+    StoreError err;
+
+    size_t bs    = store->getBlockSize();
+    size_t start = store->getBlockCount() - 3;
+    uint8_t buffer1[512 * 3];
+    uint8_t buffer2[512 * 3] = { };
+
+    ASSERT(bs == 512, "block size should be 512, is %lu", bs);
+
+    for (size_t i = 0; i < sizeof(buffer1); i++)
+        buffer1[i] = rand();
+
+    err = store->seek(1);
+    ASSERT(err == STORE_ERR_OK, "seek (err=%d)", err);
+
+    err = store->writeBlocks(start, 3, buffer1);
+    ASSERT(err == STORE_ERR_OK, "write blocks (err=%d)", err);
+
+    for (size_t i = 0; i < 3; i++) {
+        err = store->read(start + i, buffer2 + i * bs);
+        ASSERT(err == STORE_ERR_OK, "read block %lu (err=%d)", start + i, err);
+    }
+
+    ASSERT(memcmp(buffer1, buffer2, sizeof(buffer1)) == 0,
+           "single block reads differ from multi-block write");
+
+    ASSERT(store->getPos() == start + 3, "bad pos after positional reads (pos=%lu)", store->getPos());
+
+    // readAt() and writeAt() leave the position alone.
+    auto posix = (PosixFileStore*)store;
+
+    err = store->seek(1);
+    ASSERT(err == STORE_ERR_OK, "seek (err=%d)", err);
+
+    memset(buffer2, 0, sizeof(buffer2));
+    err = posix->readAt(start, 3, buffer2);
+    ASSERT(err == STORE_ERR_OK, "read at (err=%d)", err);
+    ASSERT(memcmp(buffer1, buffer2, sizeof(buffer1)) == 0, "readAt() differs from multi-block write");
+
+    err = posix->writeAt(start, 3, buffer1);
+    ASSERT(err == STORE_ERR_OK, "write at (err=%d)", err);
+    ASSERT(store->getPos() == 1, "readAt() / writeAt() must not move the position (pos=%lu)", store->getPos());
+
+    err = store->readBlocks(start, 4, buffer2);
+    ASSERT(err == STORE_ERR_OUT_OF_BOUNDS, "read blocks past end should fail (err=%d)", err);
+}
+
+TEST(positional_write_ro) {
+    ASSERT(store, "store was not created");
+
+    uint8_t buffer[512] = { };
+
+    StoreError err = store->write(store->getBlockCount()-1, buffer);
+    ASSERT(err == STORE_ERR_NOT_WRITABLE, "write to read-only medium should fail (err=%d)", err);
+
+    err = ((PosixFileStore*)store)->writeAt(store->getBlockCount()-1, 1, buffer);
+    ASSERT(err == STORE_ERR_NOT_WRITABLE, "write at on read-only medium should fail (err=%d)", err);
+}
+
+TEST(concurrent_read) {
+    ASSERT(store, "store was not created");
+
+    const size_t blocks = std::min((size_t)64, store->getBlockCount());
+    std::vector<uint8_t> expected(blocks * 512);
+
+    StoreError err = store->readBlocks(0, blocks, expected.data());
+    ASSERT(err == STORE_ERR_OK, "read reference blocks (err=%d)", err);
+
+    const size_t threadCount = 8;
+    std::vector<std::thread> threads;
+    std::vector<size_t> failures(threadCount);
+
+    for (size_t t = 0; t < threadCount; t++) {
+        threads.emplace_back([&, t]() {
+            uint8_t buffer[512];
+            for (size_t i = 0; i < 2000; i++) {
+                size_t lba = (i * 7 + t) % blocks;
+                if (store->read(lba, buffer)
+                    || memcmp(buffer, &expected[lba * 512], 512))
+                    failures[t]++;
+            }
+        });
+    }
+    for (auto &thread : threads)
+        thread.join();
+
+    for (size_t t = 0; t < threadCount; t++)
+        ASSERT(!failures[t], "thread %lu got %lu bad reads", t, failures[t]);
+}
+
+TEST_MAIN() {
+    TEST_START();
+
+    TEST_STORE_WITH(PosixFileStore(MUTEST_FAT12FILE), create);
+    TEST_STORE_WITH(PosixFileStore(MUTEST_FAT12FILE), seek  );
+    TEST_STORE_WITH(PosixFileStore(MUTEST_FAT12FILE), read  );
+    TEST_STORE_WITH(PosixFileStore(MUTEST_FAT12FILE, true, 4096), seek);
+    TEST_STORE_WITH(PosixFileStore(MUTEST_FAT12FILE, true, 4096), read);
+    TEST_STORE_WITH(PosixFileStore(MUTEST_FAT12FILE), positional_io);
+    TEST_STORE_WITH(PosixFileStore(MUTEST_FAT12FILE), concurrent_read);
+    TEST_STORE_WITH(PosixFileStore(MUTEST_FAT12FILE), flush );
+    TEST_STORE_WITH(PosixFileStore(MUTEST_FAT12FILE, false), positional_write_ro);
+
+    TEST_END();
+}
@@ -0,0 +1,63 @@
+/**
+ * \file
+ * \brief     Tests for MmapStore.
+ * \author    Chris Smeele
+ * \copyright Copyright (c) 2016, Chris Smeele
+ * \license   Boost, see LICENSE
+ */
+#include "test.hh"
+#include "store.hh"
+
+#include <filestore.hh>
+#include <mmapstore.hh>
+
+TEST(advise_flush) {
+    ASSERT(store, "store was not created");
+    MmapStore *mstore = static_cast<MmapStore*>(store);
+    StoreError err;
+
+    err = mstore->advise(MmapStore::Advice::SEQUENTIAL);
+    ASSERT(err == STORE_ERR_OK, "advise on entire medium (err=%d)", err);
+    err = mstore->advise(MmapStore::Advice::WILLNEED, 3, 5);
+    ASSERT(err == STORE_ERR_OK, "advise on unaligned range (err=%d)", err);
+    err = mstore->advise(MmapStore::Advice::RANDOM, store->getBlockCount(), 1);
+    ASSERT(err == STORE_ERR_OUT_OF_BOUNDS, "advise past end should fail (err=%d)", err);
+
+    uint8_t buffer1[512];
+    uint8_t buffer2[512] = { };
+    for (size_t i = 0; i < sizeof(buffer1); i++)
+        buffer1[i] = rand();
+
+    size_t lba = store->getBlockCount() - 2;
+    err = store->write(lba, buffer1);
+    ASSERT(err == STORE_ERR_OK, "write block (err=%d)", err);
+
+    err = mstore->flush();
+    ASSERT(err == STORE_ERR_OK, "flush (err=%d)", err);
+
+    // The written block must now be visible through regular file I/O.
+    auto fileStore = FileStore(MUTEST_FAT12FILE, false);
+    err = fileStore.read(lba, buffer2);
+    ASSERT(err == STORE_ERR_OK, "read block through FileStore (err=%d)", err);
+    ASSERT(memcmp(buffer1, buffer2, sizeof(buffer1)) == 0,
+           "flushed block differs when read through FileStore");
+}
+
+TEST_MAIN() {
+    TEST_START();
+
+    TEST_STORE_WITH(MmapStore(MUTEST_FAT12FILE), create);
+    TEST_STORE_WITH(MmapStore(MUTEST_FAT12FILE), seek  );
+    TEST_STORE_WITH(MmapStore(MUTEST_FAT12FILE), read  );
+    TEST_STORE_WITH(MmapStore(MUTEST_FAT12FILE), write );
+    TEST_STORE_WITH(MmapStore(MUTEST_FAT12FILE), read_blocks );
+    TEST_STORE_WITH(MmapStore(MUTEST_FAT12FILE), write_blocks);
+    TEST_STORE_WITH(MmapStore(MUTEST_FAT12FILE), advise_flush);
+    TEST_STORE_WITH(MmapStore(MUTEST_FAT12FILE), borrow);
+    TEST_STORE_WITH(MmapStore(MUTEST_FAT12FILE, false), borrow);
+    TEST_STORE_WITH(MmapStore(MUTEST_FAT12FILE, false), write_ro);
+    TEST_STORE_WITH(MmapStore(MUTEST_FAT12FILE, true, 4096), read_blocks );
+    TEST_STORE_WITH(MmapStore(MUTEST_FAT12FILE, true, 4096), write_blocks);
+
+    TEST_END();
+}
@@ -0,0 +1,80 @@
+/**
+ * \file
+ * \brief     Tests for DirectFileStore.
+ * \author    Chris Smeele
+ * \copyright Copyright (c) 2016, Chris Smeele
+ * \license   Boost, see LICENSE
+ */
+#include "test.hh"
+#include "store.hh"
+
+#include <directfilestore.hh>
+#include <filestore.hh>
+
+TEST(geometry) {
+    ASSERT(store, "store was not created");
+    DirectFileStore *dstore = static_cast<DirectFileStore*>(store);
+
+    LOG("direct: %d, block size: %lu, preferred I/O size: %lu",
+        dstore->isDirect(), dstore->getBlockSize(), dstore->getPreferredIoSize());
+
+    ASSERT(store->getBlockCount() == 128 * 1024 / store->getBlockSize(),
+           "block count should be %lu, is %lu",
+           128 * 1024 / store->getBlockSize(), store->getBlockCount());
+
+    ASSERT(dstore->getPreferredIoSize() >= store->getBlockSize(),
+           "preferred I/O size (%lu) should be at least the block size (%lu)",
+           dstore->getPreferredIoSize(), store->getBlockSize());
+}
+
+TEST(unaligned_io) {
+    ASSERT(store, "store was not created");
+    StoreError err;
+
+    size_t bs    = store->getBlockSize();
+    size_t start = store->getBlockCount() - 2;
+
+    // One byte off from an aligned address.
+    alignas(4096) static uint8_t buffer1[4096 * 2 + 1];
+    alignas(4096) static uint8_t buffer2[4096 * 2 + 1];
+
+    for (size_t i = 0; i < sizeof(buffer1); i++)
+        buffer1[i] = rand();
+
+    err = store->writeBlocks(start, 2, buffer1 + 1);
+    ASSERT(err == STORE_ERR_OK, "unaligned write (err=%d)", err);
+
+    err = store->readBlocks(start, 2, buffer2);
+    ASSERT(err == STORE_ERR_OK, "aligned read (err=%d)", err);
+    ASSERT(memcmp(buffer1 + 1, buffer2, 2 * bs) == 0, "aligned read differs from unaligned write");
+
+    err = store->readBlocks(start, 2, buffer2 + 1);
+    ASSERT(err == STORE_ERR_OK, "unaligned read (err=%d)", err);
+    ASSERT(memcmp(buffer1 + 1, buffer2 + 1, 2 * bs) == 0, "unaligned read differs from unaligned write");
+
+    // Direct writes must be visible to other readers of the file.
+    auto fileStore = FileStore(MUTEST_FAT12FILE, false);
+    ASSERT(bs % fileStore.getBlockSize() == 0, "unexpected FileStore block size");
+
+    err = fileStore.readBlocks(start * (bs / fileStore.getBlockSize()),
+                               2 * bs / fileStore.getBlockSize(),
+                               buffer2);
+    ASSERT(err == STORE_ERR_OK, "read through FileStore (err=%d)", err);
+    ASSERT(memcmp(buffer1 + 1, buffer2, 2 * bs) == 0, "FileStore read differs from direct write");
+}
+
+TEST_MAIN() {
+    TEST_START();
+
+    TEST_STORE_WITH(DirectFileStore(MUTEST_FAT12FILE), create);
+    TEST_STORE_WITH(DirectFileStore(MUTEST_FAT12FILE), seek  );
+    TEST_STORE_WITH(DirectFileStore(MUTEST_FAT12FILE), read  );
+    TEST_STORE_WITH(DirectFileStore(MUTEST_FAT12FILE), geometry);
+    TEST_STORE_WITH(DirectFileStore(MUTEST_FAT12FILE), unaligned_io);
+
+    TEST_STORE_WITH(DirectFileStore(MUTEST_FAT12FILE, true, 4096), read    );
+    TEST_STORE_WITH(DirectFileStore(MUTEST_FAT12FILE, true, 4096), geometry);
+    TEST_STORE_WITH(DirectFileStore(MUTEST_FAT12FILE, true, 4096), unaligned_io);
+
+    TEST_END();
+}
@@ -0,0 +1,228 @@
+/**
+ * \file
+ * \brief     Tests for CachedStore.
+ * \author    Chris Smeele
+ * \copyright Copyright (c) 2016, Chris Smeele
+ * \license   Boost, see LICENSE
+ */
+#include "test.hh"
+#include "store.hh"
+
+#include <array>
+#include <cachedstore.hh>
+#include <filestore.hh>
+#include <memstore.hh>
+#include <vector>
+
+static uint8_t cacheMemory[64 * 1024];
+
+TEST(cache_hits) {
+    ASSERT(store, "store was not created");
+    CachedStore *cache = static_cast<CachedStore*>(store);
+    StoreError err;
+
+    uint8_t buffer1[512];
+    uint8_t buffer2[512];
+
+    cache->invalidate();
+    cache->resetStats();
+
+    err = store->read(5, buffer1);
+    ASSERT(err == STORE_ERR_OK, "read block (err=%d)", err);
+    err = store->read(5, buffer2);
+    ASSERT(err == STORE_ERR_OK, "read block (err=%d)", err);
+
+    ASSERT(!memcmp(buffer1, buffer2, sizeof(buffer1)), "cached block differs from original");
+    ASSERT(cache->getStats().misses == 1, "expected 1 miss, got %lu", cache->getStats().misses);
+    ASSERT(cache->getStats().hits   == 1, "expected 1 hit, got %lu",  cache->getStats().hits);
+
+    // Writes must update the cached copy.
+    for (size_t i = 0; i < sizeof(buffer1); i++)
+        buffer1[i] = rand();
+    err = store->write(5, buffer1);
+    ASSERT(err == STORE_ERR_OK, "write block (err=%d)", err);
+    err = store->read(5, buffer2);
+    ASSERT(err == STORE_ERR_OK, "read block (err=%d)", err);
+    ASSERT(!memcmp(buffer1, buffer2, sizeof(buffer1)), "cached block not updated on write");
+    ASSERT(cache->getStats().hits == 2, "expected 2 hits, got %lu", cache->getStats().hits);
+}
+
+TEST(scan_resistance) {
+    ASSERT(store, "store was not created");
+    CachedStore *cache = static_cast<CachedStore*>(store);
+    StoreError err;
+
+    static uint8_t buffer[512 * 256];
+
+    const size_t hotCount = cache->getLineCount() / 2;
+    ASSERT(store->getBlockCount() >= 1024, "can't test, medium too small");
+
+    cache->invalidate();
+
+    // Make a set of blocks hot.
+    for (size_t round = 0; round < 3; round++) {
+        for (size_t i = 0; i < hotCount; i++) {
+            err = store->read(i * 3, buffer);
+            ASSERT(err == STORE_ERR_OK, "read hot block (err=%d)", err);
+        }
+    }
+
+    // Large multi-block read.
+    err = store->readBlocks(300, 256, buffer);
+    ASSERT(err == STORE_ERR_OK, "read blocks (err=%d)", err);
+
+    // Single-block sequential scan, much larger than the cache.
+    for (size_t i = 0; i < cache->getLineCount() * 4; i++) {
+        err = store->read(600 + i, buffer);
+        ASSERT(err == STORE_ERR_OK, "read scan block (err=%d)", err);
+    }
+
+    cache->resetStats();
+
+    for (size_t i = 0; i < hotCount; i++) {
+        err = store->read(i * 3, buffer);
+        ASSERT(err == STORE_ERR_OK, "read hot block (err=%d)", err);
+    }
+
+    ASSERT(cache->getStats().hits == hotCount,
+           "hot blocks should have survived the scan (%lu hits, %lu misses)",
+           cache->getStats().hits, cache->getStats().misses);
+}
+
+/// A MemStore that remembers the order in which blocks were written.
+struct RecordingStore : public MemStore {
+    size_t writes[64];
+    size_t writeCount = 0;
+
+    StoreError write(const void *buffer) {
+        if (writeCount < 64)
+            writes[writeCount++] = pos;
+        return MemStore::write(buffer);
+    }
+    using MemStore::write;
+
+    RecordingStore(void *store_, size_t size)
+        : MemStore(store_, size) { }
+};
+
+TEST(write_back) {
+    static std::array<uint8_t, 256 * 512> image;
+    image.fill(0);
+    RecordingStore backend(&image, image.size());
+
+    std::vector<uint8_t> memory(CachedStore::getMemorySize(512, 16));
+    CachedStore cache(&backend, memory.data(), memory.size());
+    StoreError err;
+
+    err = cache.setWritePolicy(CachedStore::WritePolicy::WRITE_BACK);
+    ASSERT(err == STORE_ERR_OK, "set write policy (err=%d)", err);
+
+    uint8_t buffer1[512];
+    uint8_t buffer2[512];
+
+    // Repeated writes to the same block are coalesced.
+    for (size_t i = 0; i < 10; i++) {
+        memset(buffer1, (int)i + 1, sizeof(buffer1));
+        err = cache.write(20, buffer1);
+        ASSERT(err == STORE_ERR_OK, "write block (err=%d)", err);
+    }
+    ASSERT(backend.writeCount == 0, "dirty block written back early");
+    ASSERT(image[20 * 512] == 0, "underlying store modified before flush");
+    ASSERT(cache.getDirtyBytes() == 512, "expected 512 dirty bytes, got %lu", cache.getDirtyBytes());
+
+    err = cache.read(20, buffer2);
+    ASSERT(err == STORE_ERR_OK, "read block (err=%d)", err);
+    ASSERT(!memcmp(buffer1, buffer2, sizeof(buffer1)), "dirty block not returned on read");
+
+    // Multi-block reads that pass the cache must see dirty blocks too.
+    static uint8_t range[512 * 16];
+    err = cache.readBlocks(16, 16, range);
+    ASSERT(err == STORE_ERR_OK, "read blocks (err=%d)", err);
+    ASSERT(!memcmp(buffer1, range + 4 * 512, sizeof(buffer1)), "dirty block not returned on multi-block read");
+
+    // Writes are written back in LBA order.
+    memset(buffer1, 0xaa, sizeof(buffer1));
+    for (size_t lba : { 9, 3, 40, 7 }) {
+        err = cache.write(lba, buffer1);
+        ASSERT(err == STORE_ERR_OK, "write block (err=%d)", err);
+    }
+
+    err = cache.flush();
+    ASSERT(err == STORE_ERR_OK, "flush (err=%d)", err);
+    ASSERT(cache.getDirtyBytes() == 0, "dirty bytes left after flush");
+    ASSERT(backend.writeCount == 5, "expected 5 writes, got %lu", backend.writeCount);
+
+    const size_t expected[] = { 3, 7, 9, 20, 40 };
+    for (size_t i = 0; i < 5; i++)
+        ASSERT(backend.writes[i] == expected[i],
+               "write %lu went to block %lu, expected %lu", i, backend.writes[i], expected[i]);
+
+    ASSERT(image[20 * 512] == 10, "block 20 not written back");
+    ASSERT(image[40 * 512] == 0xaa, "block 40 not written back");
+    ASSERT(cache.getStats().writebacks == 5, "expected 5 write-backs, got %lu", cache.getStats().writebacks);
+}
+
+TEST(write_back_threshold) {
+    static std::array<uint8_t, 256 * 512> image;
+    image.fill(0);
+    RecordingStore backend(&image, image.size());
+
+    std::vector<uint8_t> memory(CachedStore::getMemorySize(512, 16));
+    CachedStore cache(&backend, memory.data(), memory.size());
+    StoreError err;
+
+    err = cache.setWritePolicy(CachedStore::WritePolicy::WRITE_BACK, 4 * 512);
+    ASSERT(err == STORE_ERR_OK, "set write policy (err=%d)", err);
+
+    uint8_t buffer[512];
+    memset(buffer, 0x55, sizeof(buffer));
+
+    for (size_t lba : { 12, 11, 10 }) {
+        err = cache.write(lba, buffer);
+        ASSERT(err == STORE_ERR_OK, "write block (err=%d)", err);
+    }
+    ASSERT(backend.writeCount == 0, "dirty blocks written back before reaching threshold");
+
+    err = cache.write(13, buffer);
+    ASSERT(err == STORE_ERR_OK, "write block (err=%d)", err);
+    ASSERT(backend.writeCount == 4, "expected 4 writes after reaching threshold, got %lu", backend.writeCount);
+    ASSERT(backend.writes[0] == 10 && backend.writes[3] == 13, "dirty blocks not written in LBA order");
+
+    // Evicted dirty blocks are written back.
+    for (size_t lba = 100; lba < 200; lba++) {
+        err = cache.write(lba, buffer);
+        ASSERT(err == STORE_ERR_OK, "write block (err=%d)", err);
+    }
+    err = cache.setWritePolicy(CachedStore::WritePolicy::WRITE_THROUGH);
+    ASSERT(err == STORE_ERR_OK, "set write policy (err=%d)", err);
+
+    for (size_t lba = 100; lba < 200; lba++)
+        ASSERT(image[lba * 512] == 0x55, "block %lu not written back", lba);
+}
+
+TEST_MAIN() {
+    TEST_START();
+
+    auto fileStore = FileStore(MUTEST_FAT12FILE);
+    TEST_STORE_WITH(CachedStore(&fileStore, cacheMemory, sizeof(cacheMemory)), create);
+    TEST_STORE_WITH(CachedStore(&fileStore, cacheMemory, sizeof(cacheMemory)), seek  );
+    TEST_STORE_WITH(CachedStore(&fileStore, cacheMemory, sizeof(cacheMemory)), read  );
+    TEST_STORE_WITH(CachedStore(&fileStore, cacheMemory, sizeof(cacheMemory)), write );
+    TEST_STORE_WITH(CachedStore(&fileStore, cacheMemory, sizeof(cacheMemory)), read_blocks );
+    TEST_STORE_WITH(CachedStore(&fileStore, cacheMemory, sizeof(cacheMemory)), write_blocks);
+    TEST_STORE_WITH(CachedStore(&fileStore, cacheMemory, sizeof(cacheMemory)), cache_hits);
+    TEST_STORE_WITH(CachedStore(&fileStore, cacheMemory, sizeof(cacheMemory)), flush );
+
+    auto roFileStore = FileStore(MUTEST_FAT12FILE, false);
+    TEST_STORE_WITH(CachedStore(&roFileStore, cacheMemory, sizeof(cacheMemory)), write_ro);
+
+    static std::array<uint8_t, 2048 * 512> image;
+    auto memStore = MemStore(&image, image.size());
+    std::vector<uint8_t> smallCacheMemory(CachedStore::getMemorySize(512, 32));
+    TEST_STORE_WITH(CachedStore(&memStore, smallCacheMemory.data(), smallCacheMemory.size()), scan_resistance);
+
+    RUN_TEST(write_back);
+    RUN_TEST(write_back_threshold);
+
+    TEST_END();
+}
@@ -0,0 +1,55 @@
+/**
+ * \file
+ * \brief     Tests for FatFs on a CachedStore.
+ * \author    Chris Smeele
+ * \copyright Copyright (c) 2016, Chris Smeele
+ * \license   Boost, see LICENSE
+ */
+#include "test.hh"
+#include "fs.hh"
+
+#include <cachedstore.hh>
+#include <filestore.hh>
+#include <fatfs.hh>
+
+static uint8_t cacheMemory[64 * 1024];
+
+TEST_MAIN() {
+    TEST_START();
+
+    auto store = FileStore(MUTEST_FAT16FILE);
+    auto cache = CachedStore(&store, cacheMemory, sizeof(cacheMemory));
+
+    TEST_FS_WITH(FatFs(&cache), create);
+    TEST_FS_WITH(FatFs(&cache), metadata);
+    TEST_FS_WITH(FatFs(&cache), root_readdir);
+    TEST_FS_WITH(FatFs(&cache), get_file);
+    TEST_FS_WITH(FatFs(&cache), get_dir);
+    TEST_FS_WITH(FatFs(&cache), file_read);
+    TEST_FS_WITH(FatFs(&cache), file_write);
+
+    // Everything should still be there without the cache.
+    TEST_FS_WITH(FatFs(&store), root_readdir);
+    TEST_FS_WITH(FatFs(&store), file_read);
+
+    // Again, with write-back caching.
+    auto err = cache.setWritePolicy(CachedStore::WritePolicy::WRITE_BACK);
+    LOG("set write policy: err=%d", err);
+
+    TEST_FS_WITH(FatFs(&cache), root_readdir);
+    TEST_FS_WITH(FatFs(&cache), file_read);
+    TEST_FS_WITH(FatFs(&cache), file_write);
+
+    err = cache.flush();
+    LOG("flush: err=%d", err);
+
+    TEST_FS_WITH(FatFs(&store), root_readdir);
+    TEST_FS_WITH(FatFs(&store), file_read);
+    TEST_FS_WITH(FatFs(&store), file_write);
+
+    LOG("cache hits: %lu, misses: %lu, evictions: %lu, write-backs: %lu",
+        cache.getStats().hits, cache.getStats().misses,
+        cache.getStats().evictions, cache.getStats().writebacks);
+
+    TEST_END();
+}
@@ -0,0 +1,134 @@
+/**
+ * \file
+ * \brief     Tests for ReadaheadStore.
+ * \author    Chris Smeele
+ * \copyright Copyright (c) 2016, Chris Smeele
+ * \license   Boost, see LICENSE
+ */
+#include "test.hh"
+#include "store.hh"
+
+#include <array>
+#include <readaheadstore.hh>
+#include <filestore.hh>
+#include <memstore.hh>
+
+static uint8_t readaheadMemory[64 * 1024];
+
+TEST(sequential) {
+    static std::array<uint8_t, 2048 * 512> image;
+    for (size_t i = 0; i < image.size(); i++)
+        image[i] = rand();
+
+    auto memStore = MemStore(&image, image.size());
+    ReadaheadStore ra(&memStore, readaheadMemory, sizeof(readaheadMemory), 4);
+    StoreError err;
+
+    uint8_t buffer[512];
+
+    ASSERT(ra.getMaxWindow() == 128, "expected a max window of 128 blocks, got %lu", ra.getMaxWindow());
+
+    err = ra.seek(0);
+    ASSERT(err == STORE_ERR_OK, "seek (err=%d)", err);
+    for (size_t i = 0; i < 1024; i++) {
+        err = ra.read(buffer);
+        ASSERT(err == STORE_ERR_OK, "read block %lu (err=%d)", i, err);
+        ASSERT(!memcmp(buffer, &image[i * 512], sizeof(buffer)), "block %lu differs", i);
+    }
+
+    auto &stats = ra.getStats();
+
+    // Windows of 4, 8, 16, 32 and 64 blocks, followed by 8 windows of 128 blocks.
+    ASSERT(stats.misses     == 1,   "expected 1 miss, got %lu",        stats.misses);
+    ASSERT(stats.readaheads == 13,  "expected 13 readaheads, got %lu", stats.readaheads);
+    ASSERT(stats.hits       == 1023, "expected 1023 hits, got %lu",     stats.hits);
+    ASSERT(stats.maxWindow  == 128, "expected a max window of 128, got %lu", stats.maxWindow);
+    ASSERT(stats.resets     == 0,   "expected no resets, got %lu",     stats.resets);
+    ASSERT(ra.getWindow()   == 128, "window did not grow to its maximum");
+
+    // Multi-block reads continue the sequential stream.
+    static uint8_t range[512 * 16];
+    err = ra.readBlocks(1024, 16, range);
+    ASSERT(err == STORE_ERR_OK, "read blocks (err=%d)", err);
+    ASSERT(!memcmp(range, &image[1024 * 512], sizeof(range)), "multi-block read differs");
+    ASSERT(stats.resets == 0, "multi-block read reset the window");
+
+    // Reading ahead stops at the end of the store.
+    for (size_t i = 1040; i < 2048; i++) {
+        err = ra.read(buffer);
+        ASSERT(err == STORE_ERR_OK, "read block %lu (err=%d)", i, err);
+        ASSERT(!memcmp(buffer, &image[i * 512], sizeof(buffer)), "block %lu differs", i);
+    }
+    ASSERT(stats.wastedBlocks == 0, "readahead went past the end of the store");
+}
+
+TEST(random_reset) {
+    static std::array<uint8_t, 2048 * 512> image;
+    for (size_t i = 0; i < image.size(); i++)
+        image[i] = rand();
+
+    auto memStore = MemStore(&image, image.size());
+    ReadaheadStore ra(&memStore, readaheadMemory, sizeof(readaheadMemory), 4);
+    StoreError err;
+
+    uint8_t buffer[512];
+
+    for (size_t lba = 10; lba < 20; lba++) {
+        err = ra.read(lba, buffer);
+        ASSERT(err == STORE_ERR_OK, "read block (err=%d)", err);
+    }
+    ASSERT(ra.getWindow() > 0, "sequential reads did not start readahead");
+
+    // Random reads do not read ahead.
+    for (size_t lba : { 700, 300, 1500, 42 }) {
+        err = ra.read(lba, buffer);
+        ASSERT(err == STORE_ERR_OK, "read block (err=%d)", err);
+        ASSERT(!memcmp(buffer, &image[lba * 512], sizeof(buffer)), "block %lu differs", lba);
+    }
+
+    auto &stats = ra.getStats();
+    ASSERT(ra.getWindow() == 0, "random read did not reset the window");
+    ASSERT(stats.resets   == 1, "expected 1 reset, got %lu", stats.resets);
+    ASSERT(stats.misses   == 5, "expected 5 misses, got %lu", stats.misses);
+    ASSERT(stats.wastedBlocks == 0, "buffer dropped too early");
+
+    // Starting a new sequential stream drops the remainder of the old window.
+    err = ra.read(43, buffer);
+    ASSERT(err == STORE_ERR_OK, "read block (err=%d)", err);
+    ASSERT(stats.wastedBlocks > 0, "unused readahead was not accounted for");
+
+    // Writes update the window.
+    err = ra.read(44, buffer);
+    ASSERT(err == STORE_ERR_OK, "read block (err=%d)", err);
+    memset(buffer, 0x5a, sizeof(buffer));
+    err = ra.write(45, buffer);
+    ASSERT(err == STORE_ERR_OK, "write block (err=%d)", err);
+
+    size_t hits = stats.hits;
+    err = ra.read(45, buffer);
+    ASSERT(err == STORE_ERR_OK, "read block (err=%d)", err);
+    ASSERT(stats.hits == hits + 1, "block 45 was not in the window");
+    for (size_t i = 0; i < sizeof(buffer); i++)
+        ASSERT(buffer[i] == 0x5a, "window not updated on write");
+}
+
+TEST_MAIN() {
+    TEST_START();
+
+    auto fileStore = FileStore(MUTEST_FAT12FILE);
+    TEST_STORE_WITH(ReadaheadStore(&fileStore, readaheadMemory, sizeof(readaheadMemory)), create);
+    TEST_STORE_WITH(ReadaheadStore(&fileStore, readaheadMemory, sizeof(readaheadMemory)), seek  );
+    TEST_STORE_WITH(ReadaheadStore(&fileStore, readaheadMemory, sizeof(readaheadMemory)), read  );
+    TEST_STORE_WITH(ReadaheadStore(&fileStore, readaheadMemory, sizeof(readaheadMemory)), write );
+    TEST_STORE_WITH(ReadaheadStore(&fileStore, readaheadMemory, sizeof(readaheadMemory)), read_blocks );
+    TEST_STORE_WITH(ReadaheadStore(&fileStore, readaheadMemory, sizeof(readaheadMemory)), write_blocks);
+    TEST_STORE_WITH(ReadaheadStore(&fileStore, readaheadMemory, sizeof(readaheadMemory)), flush );
+
+    auto roFileStore = FileStore(MUTEST_FAT12FILE, false);
+    TEST_STORE_WITH(ReadaheadStore(&roFileStore, readaheadMemory, sizeof(readaheadMemory)), write_ro);
+
+    RUN_TEST(sequential);
+    RUN_TEST(random_reset);
+
+    TEST_END();
+}
@@ -0,0 +1,43 @@
+/**
+ * \file
+ * \brief     Tests for ThreadPoolStore.
+ * \author    Chris Smeele
+ * \copyright Copyright (c) 2016, Chris Smeele
+ * \license   Boost, see LICENSE
+ */
+#include "test.hh"
+#include "store.hh"
+#include "async.hh"
+
+#include <array>
+#include <threadpoolstore.hh>
+#include <filestore.hh>
+#include <memstore.hh>
+#include <posixfilestore.hh>
+
+TEST_MAIN() {
+    TEST_START();
+
+    auto fileStore = FileStore(MUTEST_FAT12FILE);
+    TEST_STORE_WITH(ThreadPoolStore(&fileStore), create);
+    TEST_STORE_WITH(ThreadPoolStore(&fileStore), seek  );
+    TEST_STORE_WITH(ThreadPoolStore(&fileStore), read  );
+    TEST_STORE_WITH(ThreadPoolStore(&fileStore), write );
+    TEST_STORE_WITH(ThreadPoolStore(&fileStore), read_blocks );
+    TEST_STORE_WITH(ThreadPoolStore(&fileStore), write_blocks);
+    TEST_STORE_WITH(ThreadPoolStore(&fileStore), flush );
+    TEST_STORE_WITH(ThreadPoolStore(&fileStore), async_io);
+
+    auto roFileStore = FileStore(MUTEST_FAT12FILE, false);
+    TEST_STORE_WITH(ThreadPoolStore(&roFileStore), write_ro);
+    TEST_STORE_WITH(ThreadPoolStore(&roFileStore), async_write_ro);
+
+    static std::array<uint8_t, 1024 * 512> image;
+    auto memStore = MemStore(&image, image.size());
+    TEST_STORE_WITH(ThreadPoolStore(&memStore, 1), async_io);
+
+    auto posixFileStore = PosixFileStore(MUTEST_FAT12FILE);
+    TEST_STORE_WITH(ThreadPoolStore(&posixFileStore, 8, true), async_io);
+
+    TEST_END();
+}
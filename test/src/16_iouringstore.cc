@@ -0,0 +1,86 @@
+/**
+ * \file
+ * \brief     Tests for IoUringStore.
+ * \author    Chris Smeele
+ * \copyright Copyright (c) 2016, Chris Smeele
+ * \license   Boost, see LICENSE
+ */
+#include "test.hh"
+#include "store.hh"
+#include "async.hh"
+
+#include <iouringstore.hh>
+
+TEST(registered_buffers) {
+    ASSERT(store, "store was not created");
+    IoUringStore *uring = static_cast<IoUringStore*>(store);
+    StoreError err;
+
+    LOG("Using %s", uring->isNative() ? "io_uring" : "pread / pwrite fallback");
+
+    // More requests than the queue depth, from a single registered buffer.
+    const size_t requests = uring->getQueueDepth() * 3;
+    const size_t start    = store->getBlockCount() - requests;
+
+    static uint8_t buffer1[512 * 256];
+    static uint8_t buffer2[512 * 256];
+    ASSERT(requests <= 256, "queue depth too large for test");
+
+    void  *buffers[] = { buffer1, buffer2 };
+    size_t sizes[]   = { sizeof(buffer1), sizeof(buffer2) };
+
+    err = uring->registerBuffers(buffers, sizes, 2);
+    ASSERT(err == STORE_ERR_OK || !uring->isNative(), "register buffers (err=%d)", err);
+
+    for (size_t i = 0; i < sizeof(buffer1); i++)
+        buffer1[i] = rand();
+    memset(buffer2, 0, sizeof(buffer2));
+
+    for (size_t i = 0; i < requests; i++) {
+        err = uring->submitWrite(start + i, 1, buffer1 + i * 512, nullptr);
+        ASSERT(err == STORE_ERR_OK, "submit write (err=%d)", err);
+    }
+
+    AsyncStore::Completion completions[16];
+    size_t completed = 0;
+    while (size_t n = uring->poll(completions, 16, 16)) {
+        for (size_t i = 0; i < n; i++)
+            ASSERT(completions[i].err == STORE_ERR_OK, "write failed (err=%d)", completions[i].err);
+        completed += n;
+    }
+    ASSERT(completed == requests, "expected %lu completions, got %lu", requests, completed);
+
+    // Registering is not allowed with requests outstanding.
+    err = uring->submitRead(start, requests, buffer2, nullptr);
+    ASSERT(err == STORE_ERR_OK, "submit read (err=%d)", err);
+    err = uring->submit();
+    ASSERT(err == STORE_ERR_OK, "submit (err=%d)", err);
+    err = uring->registerBuffers(nullptr, nullptr, 0);
+    ASSERT(err == STORE_ERR_IO, "unregister buffers with requests outstanding (err=%d)", err);
+
+    ASSERT(uring->poll(completions, 16, 1) == 1, "expected a single completion");
+    ASSERT(completions[0].err == STORE_ERR_OK, "read failed (err=%d)", completions[0].err);
+    ASSERT(!memcmp(buffer1, buffer2, requests * 512), "reads differ from writes");
+
+    err = uring->registerBuffers(nullptr, nullptr, 0);
+    ASSERT(err == STORE_ERR_OK || !uring->isNative(), "unregister buffers (err=%d)", err);
+}
+
+TEST_MAIN() {
+    TEST_START();
+
+    TEST_STORE_WITH(IoUringStore(MUTEST_FAT12FILE), create);
+    TEST_STORE_WITH(IoUringStore(MUTEST_FAT12FILE), seek  );
+    TEST_STORE_WITH(IoUringStore(MUTEST_FAT12FILE), read  );
+    TEST_STORE_WITH(IoUringStore(MUTEST_FAT12FILE), flush );
+    TEST_STORE_WITH(IoUringStore(MUTEST_FAT12FILE), async_io);
+    TEST_STORE_WITH(IoUringStore(MUTEST_FAT12FILE, true, 4), async_io);
+    TEST_STORE_WITH(IoUringStore(MUTEST_FAT12FILE, true, 16), registered_buffers);
+
+    // The kernel refuses rings this large, forcing the pread() / pwrite() fallback.
+    TEST_STORE_WITH(IoUringStore(MUTEST_FAT12FILE, true, 1 << 20), async_io);
+
+    TEST_STORE_WITH(IoUringStore(MUTEST_FAT12FILE, false), async_write_ro);
+
+    TEST_END();
+}
@@ -0,0 +1,40 @@
+/**
+ * \file
+ * \brief     Tests for FatFs on a store with 4K blocks, scaled down to 512 bytes.
+ * \author    Chris Smeele
+ * \copyright Copyright (c) 2016, Chris Smeele
+ * \license   Boost, see LICENSE
+ */
+#include "test.hh"
+#include "fs.hh"
+
+#include <filestore.hh>
+#include <scalestore.hh>
+#include <fatfs.hh>
+
+static uint8_t scaleBuffer[4096];
+
+TEST_MAIN() {
+    TEST_START();
+
+    auto store  = FileStore(MUTEST_FAT16FILE, true, 4096);
+    auto scaled = ScaleStore(&store, 512, scaleBuffer);
+
+    TEST_FS_WITH(FatFs(&scaled), create);
+    TEST_FS_WITH(FatFs(&scaled), metadata);
+    TEST_FS_WITH(FatFs(&scaled), root_readdir);
+    TEST_FS_WITH(FatFs(&scaled), get_file);
+    TEST_FS_WITH(FatFs(&scaled), get_dir);
+    TEST_FS_WITH(FatFs(&scaled), file_read);
+    TEST_FS_WITH(FatFs(&scaled), file_write);
+
+    auto err = scaled.flush();
+    LOG("flush: err=%d", err);
+
+    // Everything should still be there with 512-byte blocks.
+    auto plainStore = FileStore(MUTEST_FAT16FILE);
+    TEST_FS_WITH(FatFs(&plainStore), root_readdir);
+    TEST_FS_WITH(FatFs(&plainStore), file_read);
+
+    TEST_END();
+}
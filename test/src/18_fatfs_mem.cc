@@ -0,0 +1,70 @@
+/**
+ * \file
+ * \brief     Tests for FatFs on a MemStore, accessing blocks in place.
+ * \author    Chris Smeele
+ * \copyright Copyright (c) 2016, Chris Smeele
+ * \license   Boost, see LICENSE
+ */
+#include "test.hh"
+#include "fs.hh"
+
+#include <filestore.hh>
+#include <memstore.hh>
+#include <sparsememstore.hh>
+#include <fatfs.hh>
+
+#include <vector>
+
+/// Load an image file into memory.
+static std::vector<uint8_t> loadImage(const char *path) {
+    std::vector<uint8_t> image;
+
+    FILE *fh = fopen(path, "rb");
+    if (!fh)
+        return image;
+
+    uint8_t buffer[64 * 1024];
+    size_t  n;
+    while ((n = fread(buffer, 1, sizeof(buffer), fh)) > 0)
+        image.insert(image.end(), buffer, buffer + n);
+
+    fclose(fh);
+    return image;
+}
+
+TEST_MAIN() {
+    TEST_START();
+
+    for (const char *path : { MUTEST_FAT12FILE, MUTEST_FAT16FILE, MUTEST_FAT32FILE }) {
+        LOG("Image: %s", path);
+
+        auto image = loadImage(path);
+        auto store = MemStore(image.data(), image.size());
+
+        TEST_FS_WITH(FatFs(&store), create);
+        TEST_FS_WITH(FatFs(&store), metadata);
+        TEST_FS_WITH(FatFs(&store), root_readdir);
+        TEST_FS_WITH(FatFs(&store), get_file);
+        TEST_FS_WITH(FatFs(&store), get_dir);
+        TEST_FS_WITH(FatFs(&store), file_read);
+        TEST_FS_WITH(FatFs(&store), file_write);
+
+        const std::vector<uint8_t> &roImage = image;
+        auto roStore = MemStore((const void*)roImage.data(), roImage.size());
+
+        TEST_FS_WITH(FatFs(&roStore), root_readdir);
+        TEST_FS_WITH(FatFs(&roStore), file_read);
+
+        // The mostly empty image only takes up memory for its data.
+        auto sparse = SparseMemStore(image.size());
+        sparse.writeBlocks(0, sparse.getBlockCount(), image.data());
+        LOG("Sparse memory usage: %lu of %lu bytes", sparse.getMemoryUsage(), image.size());
+
+        TEST_FS_WITH(FatFs(&sparse), root_readdir);
+        TEST_FS_WITH(FatFs(&sparse), get_file);
+        TEST_FS_WITH(FatFs(&sparse), file_read);
+        TEST_FS_WITH(FatFs(&sparse), file_write);
+    }
+
+    TEST_END();
+}
@@ -0,0 +1,182 @@
+/**
+ * \file
+ * \brief     Tests for PartitionStore and PartitionTable.
+ * \author    Chris Smeele
+ * \copyright Copyright (c) 2016, Chris Smeele
+ * \license   Boost, see LICENSE
+ */
+#include "test.hh"
+#include "store.hh"
+
+#include <array>
+#include <filestore.hh>
+#include <memstore.hh>
+#include <partitionstore.hh>
+#include <partitiontable.hh>
+
+static std::array<uint8_t, 1024 * 512> image;
+static uint8_t tableBuffer[512];
+
+static void put32(uint8_t *p, uint32_t x) {
+    for (size_t i = 0; i < 4; i++)
+        p[i] = (uint8_t)(x >> (i * 8));
+}
+
+static void put64(uint8_t *p, uint64_t x) {
+    put32(p,     (uint32_t)x);
+    put32(p + 4, (uint32_t)(x >> 32));
+}
+
+static uint32_t crc32(const uint8_t *data, size_t size) {
+    uint32_t crc = ~(uint32_t)0;
+    for (size_t i = 0; i < size; i++) {
+        crc ^= data[i];
+        for (size_t j = 0; j < 8; j++)
+            crc = (crc >> 1) ^ (0xedb88320 & (0 - (crc & 1)));
+    }
+    return ~crc;
+}
+
+/// Write an MBR-style partition entry.
+static void putEntry(uint8_t *sector, size_t i, uint8_t status, uint8_t type, uint32_t lba, uint32_t count) {
+    uint8_t *entry = sector + 446 + i * 16;
+    entry[0] = status;
+    entry[4] = type;
+    put32(entry + 8,  lba);
+    put32(entry + 12, count);
+    sector[510] = 0x55;
+    sector[511] = 0xaa;
+}
+
+TEST(bounds) {
+    ASSERT(store, "store was not created");
+    StoreError err;
+
+    auto *partition = static_cast<PartitionStore*>(store);
+    uint8_t buffer[512];
+    memset(buffer, 0x77, sizeof(buffer));
+
+    size_t end = partition->getStart() + partition->getBlockCount();
+    uint8_t after = image[end * 512];
+
+    err = store->write(store->getBlockCount() - 1, buffer);
+    ASSERT(err == STORE_ERR_OK, "write last block (err=%d)", err);
+    ASSERT(image[(end - 1) * 512] == 0x77, "write did not end up at the right offset");
+
+    err = store->write(store->getBlockCount(), buffer);
+    ASSERT(err == STORE_ERR_OUT_OF_BOUNDS, "write past end should fail (err=%d)", err);
+    err = store->writeBlocks(store->getBlockCount() - 1, 2, buffer);
+    ASSERT(err == STORE_ERR_OUT_OF_BOUNDS, "write blocks past end should fail (err=%d)", err);
+    ASSERT(image[end * 512] == after, "block after the partition was modified");
+
+    // Blocks are borrowed from the underlying store.
+    ASSERT(store->borrowBlock(0) == &image[partition->getStart() * 512], "borrowed block at wrong offset");
+
+    auto memStore = MemStore(&image, image.size());
+    auto bad      = PartitionStore(&memStore, 1000, 100);
+    ASSERT(bad.getBlockCount() == 0, "partition past the end of the store should be rejected");
+    ASSERT(bad.seek(0) != STORE_ERR_OK, "seek in rejected partition should fail");
+}
+
+TEST(mbr) {
+    image.fill(0);
+    auto memStore = MemStore(&image, image.size());
+
+    putEntry(&image[0], 0, 0x80, 0x0c, 16,  64);  // FAT32 LBA, bootable.
+    putEntry(&image[0], 1, 0x00, 0x0f, 100, 400); // Extended.
+    putEntry(&image[0], 2, 0x00, 0x83, 600, 5000); // Past the end, ignored.
+
+    // Two logical partitions.
+    putEntry(&image[100 * 512], 0, 0x00, 0x06, 10, 90);
+    putEntry(&image[100 * 512], 1, 0x00, 0x05, 200, 200);
+    putEntry(&image[300 * 512], 0, 0x00, 0x0b, 5, 50);
+
+    PartitionTable table(&memStore, tableBuffer, sizeof(tableBuffer));
+    ASSERT(table.getError()  == STORE_ERR_OK, "read partition table (err=%d)", table.getError());
+    ASSERT(table.getScheme() == PartitionTable::Scheme::MBR, "scheme should be MBR");
+    ASSERT(table.getCount()  == 3, "expected 3 partitions, got %lu", table.getCount());
+
+    ASSERT(table[0].lba == 16  && table[0].blockCount == 64 && table[0].type == 0x0c && table[0].bootable,
+           "bad primary partition (lba=%lu, count=%lu)", table[0].lba, table[0].blockCount);
+    ASSERT(table[1].lba == 110 && table[1].blockCount == 90 && table[1].type == 0x06 && !table[1].bootable,
+           "bad first logical partition (lba=%lu, count=%lu)", table[1].lba, table[1].blockCount);
+    ASSERT(table[2].lba == 305 && table[2].blockCount == 50 && table[2].type == 0x0b,
+           "bad second logical partition (lba=%lu, count=%lu)", table[2].lba, table[2].blockCount);
+
+    PartitionTable small(&memStore, tableBuffer, 256);
+    ASSERT(small.getError() != STORE_ERR_OK && !small.getCount(), "scratch buffer smaller than a block accepted");
+
+    // A FAT boot sector is not an MBR.
+    auto fileStore = FileStore(MUTEST_FAT12FILE, false);
+    PartitionTable fatTable(&fileStore, tableBuffer, sizeof(tableBuffer));
+    ASSERT(fatTable.getScheme() == PartitionTable::Scheme::NONE, "FAT boot sector mistaken for an MBR");
+}
+
+TEST(gpt) {
+    image.fill(0);
+    auto memStore = MemStore(&image, image.size());
+
+    putEntry(&image[0], 0, 0x00, 0xee, 1, 1023); // Protective MBR.
+
+    uint8_t *entries = &image[2 * 512];
+    const uint8_t typeGuid[16] = { 0xa2, 0xa0, 0xd0, 0xeb, 0xe5, 0xb9, 0x33, 0x44,
+                                   0x87, 0xc0, 0x68, 0xb6, 0xb7, 0x26, 0x99, 0xc7 };
+    memcpy(entries, typeGuid, 16);
+    put64(entries + 32, 40);
+    put64(entries + 40, 139);
+    memcpy(entries + 3 * 128, typeGuid, 16);
+    put64(entries + 3 * 128 + 32, 200);
+    put64(entries + 3 * 128 + 40, 999);
+
+    uint8_t *header = &image[512];
+    memcpy(header, "EFI PART", 8);
+    put32(header + 8,  0x00010000);
+    put32(header + 12, 92);
+    put64(header + 24, 1);
+    put64(header + 72, 2);
+    put32(header + 80, 128);
+    put32(header + 84, 128);
+    put32(header + 88, crc32(entries, 128 * 128));
+    put32(header + 16, crc32(header, 92));
+
+    PartitionTable table(&memStore, tableBuffer, sizeof(tableBuffer));
+    ASSERT(table.getError()  == STORE_ERR_OK, "read partition table (err=%d)", table.getError());
+    ASSERT(table.getScheme() == PartitionTable::Scheme::GPT, "scheme should be GPT");
+    ASSERT(table.getCount()  == 2, "expected 2 partitions, got %lu", table.getCount());
+    ASSERT(table[0].lba == 40  && table[0].blockCount == 100, "bad first partition");
+    ASSERT(table[1].lba == 200 && table[1].blockCount == 800, "bad second partition");
+    ASSERT(!memcmp(table[0].typeGuid, typeGuid, 16), "bad partition type GUID");
+
+    // A corrupt entry array is rejected.
+    entries[40]++;
+    PartitionTable corrupt(&memStore, tableBuffer, sizeof(tableBuffer));
+    ASSERT(corrupt.getScheme() == PartitionTable::Scheme::NONE, "corrupt GPT entries accepted");
+    ASSERT(corrupt.getCount() == 0, "corrupt GPT yielded partitions");
+}
+
+TEST_MAIN() {
+    TEST_START();
+
+    image.fill(0);
+    image[64 * 512 + 510] = 0x55; // Insert boot sector signature.
+    image[64 * 512 + 511] = 0xaa;
+
+    auto memStore = MemStore(&image, image.size());
+    TEST_STORE_WITH(PartitionStore(&memStore, 64, 512), create);
+    TEST_STORE_WITH(PartitionStore(&memStore, 64, 512), seek  );
+    TEST_STORE_WITH(PartitionStore(&memStore, 64, 512), read  );
+    TEST_STORE_WITH(PartitionStore(&memStore, 64, 512), write );
+    TEST_STORE_WITH(PartitionStore(&memStore, 64, 512), read_blocks );
+    TEST_STORE_WITH(PartitionStore(&memStore, 64, 512), write_blocks);
+    TEST_STORE_WITH(PartitionStore(&memStore, 64, 512), flush );
+    TEST_STORE_WITH(PartitionStore(&memStore, 64, 512), borrow);
+    TEST_STORE_WITH(PartitionStore(&memStore, 64, 512), bounds);
+
+    auto roMemStore = MemStore((const void*)&image, image.size());
+    TEST_STORE_WITH(PartitionStore(&roMemStore, 64, 512), write_ro);
+
+    RUN_TEST(mbr);
+    RUN_TEST(gpt);
+
+    TEST_END();
+}
@@ -0,0 +1,96 @@
+/**
+ * \file
+ * \brief     Tests for FatFs on partitions of a single image.
+ * \author    Chris Smeele
+ * \copyright Copyright (c) 2016, Chris Smeele
+ * \license   Boost, see LICENSE
+ */
+#include "test.hh"
+#include "fs.hh"
+
+#include <filestore.hh>
+#include <memstore.hh>
+#include <partitionstore.hh>
+#include <partitiontable.hh>
+#include <fatfs.hh>
+
+#include <vector>
+
+/// Copy an image file into a disk image at the given LBA, returns the amount of blocks copied.
+static size_t copyImage(std::vector<uint8_t> &disk, size_t lba, const char *path) {
+    auto store = FileStore(path, false);
+    size_t count = store.getBlockCount();
+
+    if (disk.size() < (lba + count) * 512)
+        disk.resize((lba + count) * 512);
+
+    if (store.readBlocks(0, count, &disk[lba * 512]))
+        return 0;
+
+    return count;
+}
+
+static void putEntry(uint8_t *sector, size_t i, uint8_t type, size_t lba, size_t count) {
+    uint8_t *entry = sector + 446 + i * 16;
+    entry[4] = type;
+    for (size_t j = 0; j < 4; j++) {
+        entry[8  + j] = (uint8_t)(lba   >> (j * 8));
+        entry[12 + j] = (uint8_t)(count >> (j * 8));
+    }
+    sector[510] = 0x55;
+    sector[511] = 0xaa;
+}
+
+TEST_MAIN() {
+    TEST_START();
+
+    // Build a disk with a FAT12 and a FAT16 partition.
+    std::vector<uint8_t> disk(2048 * 512);
+
+    size_t count12 = copyImage(disk, 2048, MUTEST_FAT12FILE);
+    size_t lba16   = 2048 + count12;
+    size_t count16 = copyImage(disk, lba16, MUTEST_FAT16FILE);
+
+    putEntry(&disk[0], 0, 0x01, 2048,  count12);
+    putEntry(&disk[0], 1, 0x06, lba16, count16);
+
+    auto store = MemStore(disk.data(), disk.size());
+    uint8_t tableBuffer[512];
+    PartitionTable table(&store, tableBuffer, sizeof(tableBuffer));
+    LOG("partitions: %lu", table.getCount());
+
+    auto part12 = PartitionStore(&store, table[0]);
+    auto part16 = PartitionStore(&store, table[1]);
+
+    // Both file systems are mounted at the same time.
+    auto fs12 = FatFs(&part12);
+    auto fs16 = FatFs(&part16);
+
+    fs = &fs12;
+    RUN_TEST(create);
+    RUN_TEST(metadata);
+    fs = &fs16;
+    RUN_TEST(create);
+    RUN_TEST(metadata);
+
+    fs = &fs12;
+    RUN_TEST(root_readdir);
+    fs = &fs16;
+    RUN_TEST(root_readdir);
+
+    fs = &fs12;
+    RUN_TEST(file_read);
+    RUN_TEST(file_write);
+    fs = &fs16;
+    RUN_TEST(file_read);
+    RUN_TEST(file_write);
+
+    fs = &fs12;
+    RUN_TEST(get_file);
+    RUN_TEST(get_dir);
+    fs = &fs16;
+    RUN_TEST(get_file);
+    RUN_TEST(get_dir);
+
+    TEST_END();
+}
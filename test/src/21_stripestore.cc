@@ -0,0 +1,179 @@
+/**
+ * \file
+ * \brief     Tests for StripeStore.
+ * \author    Chris Smeele
+ * \copyright Copyright (c) 2016, Chris Smeele
+ * \license   Boost, see LICENSE
+ */
+#include "test.hh"
+#include "store.hh"
+
+#include <array>
+#include <memstore.hh>
+#include <stripestore.hh>
+
+static const size_t MEMBERS      = 3;
+static const size_t MEMBER_SIZE  = 64 * 512;
+
+static std::array<std::array<uint8_t, MEMBER_SIZE>, MEMBERS> images;
+
+/// Fails every request that touches a given block.
+struct FailingStore : public MemStore {
+    size_t badLba;
+
+    StoreError readBlocks(size_t lba, size_t count, void *buffer) {
+        if (badLba >= lba && badLba < lba + count)
+            return STORE_ERR_IO;
+        return MemStore::readBlocks(lba, count, buffer);
+    }
+    StoreError writeBlocks(size_t lba, size_t count, const void *buffer) {
+        if (badLba >= lba && badLba < lba + count)
+            return STORE_ERR_IO;
+        return MemStore::writeBlocks(lba, count, buffer);
+    }
+    using MemStore::read;
+    using MemStore::write;
+
+    FailingStore(void *store_, size_t size, size_t badLba_)
+        : MemStore(store_, size), badLba(badLba_) { }
+};
+
+/// Whether the layout test uses worker threads.
+static bool parallel;
+
+TEST(layout) {
+    StoreError err;
+
+    MemStore members[MEMBERS] = {
+        MemStore(&images[0], images[0].size()),
+        MemStore(&images[1], images[1].size()),
+        MemStore(&images[2], images[2].size()),
+    };
+    Store *stores[MEMBERS] = { &members[0], &members[1], &members[2] };
+
+    auto stripe = StripeStore(stores, MEMBERS, 4, parallel);
+    ASSERT(stripe.getBlockCount() == MEMBERS * 64, "bad block count (%lu)", stripe.getBlockCount());
+
+    // Tag each block with its LBA, in a single request spanning all members.
+    static uint8_t buffer[MEMBERS * 64 * 512];
+    for (size_t lba = 0; lba < stripe.getBlockCount(); lba++)
+        memset(buffer + lba * 512, (int)(lba & 0xff), 512);
+
+    err = stripe.writeBlocks(0, stripe.getBlockCount(), buffer);
+    ASSERT(err == STORE_ERR_OK, "write whole volume (err=%d)", err);
+
+    // LBA 4 * (stripe) + i lives on member stripe % 3 at 4 * (stripe / 3) + i.
+    for (size_t lba = 0; lba < stripe.getBlockCount(); lba++) {
+        size_t unit      = lba / 4;
+        size_t memberLba = (unit / MEMBERS) * 4 + lba % 4;
+        uint8_t value    = images[unit % MEMBERS][memberLba * 512 + 100];
+        ASSERT(value == (uint8_t)lba, "block %lu not at member %lu block %lu",
+               lba, unit % MEMBERS, memberLba);
+    }
+
+    // Unaligned reads spanning several stripe units.
+    static uint8_t buffer2[MEMBERS * 64 * 512];
+    for (size_t lba : { 1, 3, 6, 11 }) {
+        for (size_t count : { 1, 2, 5, 13, 40 }) {
+            memset(buffer2, 0, count * 512);
+            err = stripe.readBlocks(lba, count, buffer2);
+            ASSERT(err == STORE_ERR_OK, "read %lu blocks at %lu (err=%d)", count, lba, err);
+            ASSERT(!memcmp(buffer2, buffer + lba * 512, count * 512),
+                   "read %lu blocks at %lu differs", count, lba);
+            ASSERT(stripe.getPos() == lba + count, "bad pos after read (pos=%lu)", stripe.getPos());
+        }
+    }
+
+    // Borrowing only works within a stripe unit.
+    ASSERT(stripe.borrowBlock(5, 3) == &images[1][1 * 512], "borrow within stripe unit");
+    ASSERT(!stripe.borrowBlock(5, 4), "borrow across stripe units should fail");
+}
+
+TEST(member_failure) {
+    StoreError err;
+
+    MemStore     good0(&images[0], images[0].size());
+    FailingStore bad  (&images[1], images[1].size(), 9);
+    MemStore     good2(&images[2], images[2].size());
+    Store *stores[MEMBERS] = { &good0, &bad, &good2 };
+
+    auto stripe = StripeStore(stores, MEMBERS, 4);
+    static uint8_t buffer[64 * 512];
+
+    // Member 1 block 9 is in the third stripe unit of that member: volume block 4 * 7 + 1 = 29.
+    err = stripe.readBlocks(0, 28, buffer);
+    ASSERT(err == STORE_ERR_OK, "read without bad block (err=%d)", err);
+
+    stripe.seek(0);
+    err = stripe.readBlocks(10, 30, buffer);
+    ASSERT(err == STORE_ERR_IO, "read with bad block should fail (err=%d)", err);
+    ASSERT(stripe.getPos() == 0, "pos should be unchanged after failure (pos=%lu)", stripe.getPos());
+
+    err = stripe.writeBlocks(29, 1, buffer);
+    ASSERT(err == STORE_ERR_IO, "write to bad block should fail (err=%d)", err);
+}
+
+TEST(geometry) {
+    MemStore small(&images[0], 30 * 512);
+    MemStore large(&images[1], 64 * 512);
+    MemStore big4k(&images[2], images[2].size(), 4096);
+
+    Store *stores[] = { &small, &large };
+    auto stripe = StripeStore(stores, 2, 8);
+    ASSERT(stripe.getBlockCount() == 2 * 24, "members should be truncated to whole stripe units (count=%lu)",
+           stripe.getBlockCount());
+
+    Store *mixed[] = { &small, &big4k };
+    auto bad = StripeStore(mixed, 2, 8);
+    ASSERT(bad.getBlockCount() == 0, "mixed block sizes should be rejected");
+    ASSERT(bad.seek(0) != STORE_ERR_OK, "seek in rejected stripe should fail");
+
+    auto none = StripeStore(stores, 0, 8);
+    ASSERT(none.getBlockCount() == 0, "stripe without members should be rejected");
+}
+
+TEST_MAIN() {
+    TEST_START();
+
+    for (auto &image : images)
+        image.fill(0);
+    images[0][510] = 0x55; // Insert boot sector signature.
+    images[0][511] = 0xaa;
+
+    MemStore members[MEMBERS] = {
+        MemStore(&images[0], images[0].size()),
+        MemStore(&images[1], images[1].size()),
+        MemStore(&images[2], images[2].size()),
+    };
+    Store *stores[MEMBERS] = { &members[0], &members[1], &members[2] };
+
+    TEST_STORE_WITH(StripeStore(stores, MEMBERS, 4), create);
+    TEST_STORE_WITH(StripeStore(stores, MEMBERS, 4), seek  );
+    TEST_STORE_WITH(StripeStore(stores, MEMBERS, 4), read  );
+    TEST_STORE_WITH(StripeStore(stores, MEMBERS, 4), write );
+    TEST_STORE_WITH(StripeStore(stores, MEMBERS, 4), read_blocks );
+    TEST_STORE_WITH(StripeStore(stores, MEMBERS, 4), write_blocks);
+    TEST_STORE_WITH(StripeStore(stores, MEMBERS, 4), flush );
+    TEST_STORE_WITH(StripeStore(stores, MEMBERS, 4), borrow);
+
+    TEST_STORE_WITH(StripeStore(stores, MEMBERS, 4, false), read_blocks );
+    TEST_STORE_WITH(StripeStore(stores, MEMBERS, 4, false), write_blocks);
+
+    MemStore roMembers[MEMBERS] = {
+        MemStore((const void*)&images[0], images[0].size()),
+        MemStore((const void*)&images[1], images[1].size()),
+        MemStore((const void*)&images[2], images[2].size()),
+    };
+    Store *roStores[MEMBERS] = { &roMembers[0], &roMembers[1], &roMembers[2] };
+    TEST_STORE_WITH(StripeStore(roStores, MEMBERS, 4), write_ro);
+    TEST_STORE_WITH(StripeStore(roStores, MEMBERS, 4), borrow);
+
+    parallel = true;
+    RUN_TEST(layout);
+    parallel = false;
+    RUN_TEST(layout);
+    RUN_TEST(member_failure);
+    RUN_TEST(geometry);
+
+    TEST_END();
+}
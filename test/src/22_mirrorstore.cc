@@ -0,0 +1,221 @@
+/**
+ * \file
+ * \brief     Tests for MirrorStore.
+ * \author    Chris Smeele
+ * \copyright Copyright (c) 2016, Chris Smeele
+ * \license   Boost, see LICENSE
+ */
+#include "test.hh"
+#include "store.hh"
+
+#include <array>
+#include <memstore.hh>
+#include <mirrorstore.hh>
+#include <thread>
+#include <vector>
+
+static const size_t IMAGE_SIZE = 256 * 512;
+
+static std::array<uint8_t, IMAGE_SIZE> image0;
+static std::array<uint8_t, IMAGE_SIZE> image1;
+
+/// Fails every request that touches a given block.
+struct FailingStore : public MemStore {
+    size_t badLba;
+
+    StoreError readBlocks(size_t lba, size_t count, void *buffer) {
+        if (badLba >= lba && badLba < lba + count)
+            return STORE_ERR_IO;
+        return MemStore::readBlocks(lba, count, buffer);
+    }
+    StoreError writeBlocks(size_t lba, size_t count, const void *buffer) {
+        if (badLba >= lba && badLba < lba + count)
+            return STORE_ERR_IO;
+        return MemStore::writeBlocks(lba, count, buffer);
+    }
+    using MemStore::read;
+    using MemStore::write;
+
+    FailingStore(void *store_, size_t size, size_t badLba_)
+        : MemStore(store_, size), badLba(badLba_) { }
+};
+
+TEST(mirrored_write) {
+    StoreError err;
+
+    MemStore member0(&image0, image0.size());
+    MemStore member1(&image1, image1.size());
+    Store *stores[] = { &member0, &member1 };
+    auto mirror = MirrorStore(stores, 2);
+
+    uint8_t buffer[512 * 5];
+    for (size_t i = 0; i < sizeof(buffer); i++)
+        buffer[i] = (uint8_t)rand();
+
+    err = mirror.writeBlocks(100, 5, buffer);
+    ASSERT(err == STORE_ERR_OK, "write blocks (err=%d)", err);
+    ASSERT(!memcmp(&image0[100 * 512], buffer, sizeof(buffer)), "member 0 not written");
+    ASSERT(!memcmp(&image1[100 * 512], buffer, sizeof(buffer)), "member 1 not written");
+
+    auto stats0 = mirror.getMemberStats(0);
+    auto stats1 = mirror.getMemberStats(1);
+    ASSERT(stats0.writes == 1 && stats1.writes == 1, "bad write counters (%lu, %lu)", stats0.writes, stats1.writes);
+
+    // Writable borrows are copied to the other members on commit.
+    uint8_t *block = mirror.borrowBlockWritable(200);
+    ASSERT(block == &image0[200 * 512], "borrow from first member");
+    memset(block, 0x5a, 512);
+    err = mirror.commitBlock(200);
+    ASSERT(err == STORE_ERR_OK, "commit (err=%d)", err);
+    ASSERT(image1[200 * 512 + 511] == 0x5a, "committed block not mirrored");
+}
+
+TEST(failover) {
+    StoreError err;
+
+    FailingStore member0(&image0, image0.size(), 10);
+    MemStore     member1(&image1, image1.size());
+    Store *stores[] = { &member0, &member1 };
+    auto mirror = MirrorStore(stores, 2);
+
+    // Both members start out eligible. LBA 10 is closest to member 0's position.
+    uint8_t buffer[512 * 4];
+    err = mirror.readBlocks(8, 4, buffer);
+    ASSERT(err == STORE_ERR_OK, "read should fail over (err=%d)", err);
+    ASSERT(!memcmp(buffer, &image1[8 * 512], sizeof(buffer)), "failed over read differs");
+
+    auto stats0 = mirror.getMemberStats(0);
+    auto stats1 = mirror.getMemberStats(1);
+    ASSERT(stats0.errors == 1 && stats0.reads == 0, "member 0 should have failed (errors=%lu)", stats0.errors);
+    ASSERT(stats1.reads  == 1 && stats1.readBlocks == 4, "member 1 should have served the read");
+
+    // Writes go to all members, and fail if any member fails.
+    err = mirror.write(10, buffer);
+    ASSERT(err == STORE_ERR_IO, "write to failing member should fail (err=%d)", err);
+    ASSERT(mirror.getMemberStats(1).writes == 1, "other members should still be written");
+
+    // Reads fail if all members fail.
+    FailingStore bad1(&image1, image1.size(), 10);
+    Store *badStores[] = { &member0, &bad1 };
+    auto badMirror = MirrorStore(badStores, 2);
+    err = badMirror.read(10, buffer);
+    ASSERT(err == STORE_ERR_IO, "read should fail if all members fail (err=%d)", err);
+}
+
+TEST(balance) {
+    StoreError err;
+
+    MemStore member0(&image0, image0.size());
+    MemStore member1(&image1, image1.size());
+    Store *stores[] = { &member0, &member1 };
+    auto mirror = MirrorStore(stores, 2);
+
+    // Two interleaved sequential streams should each settle on a member.
+    uint8_t buffer[512];
+    for (size_t i = 0; i < 64; i++) {
+        err = mirror.read(i, buffer);
+        ASSERT(err == STORE_ERR_OK, "read stream 1 (err=%d)", err);
+        err = mirror.read(128 + i, buffer);
+        ASSERT(err == STORE_ERR_OK, "read stream 2 (err=%d)", err);
+    }
+
+    auto stats0 = mirror.getMemberStats(0);
+    auto stats1 = mirror.getMemberStats(1);
+    LOG("member reads: %lu, %lu", stats0.reads, stats1.reads);
+    ASSERT(stats0.reads == 64 && stats1.reads == 64, "streams not balanced (%lu, %lu)", stats0.reads, stats1.reads);
+
+    mirror.resetStats();
+    ASSERT(mirror.getMemberStats(0).reads == 0, "stats not reset");
+}
+
+TEST(concurrent) {
+    MemStore member0(&image0, image0.size());
+    MemStore member1(&image1, image1.size());
+    Store *stores[] = { &member0, &member1 };
+    auto mirror = MirrorStore(stores, 2);
+
+    // Give both members the same, recognizable contents.
+    for (size_t lba = 0; lba < mirror.getBlockCount(); lba++) {
+        uint8_t block[512];
+        memset(block, (int)lba, sizeof(block));
+        mirror.write(lba, block);
+    }
+
+    const size_t THREADS = 4;
+    const size_t READS   = 2000;
+    size_t mismatches[THREADS] = { };
+
+    std::vector<std::thread> readers;
+    for (size_t t = 0; t < THREADS; t++) {
+        readers.emplace_back([&, t]{
+            uint8_t block[512];
+            for (size_t i = 0; i < READS; i++) {
+                size_t lba = (t * 7919 + i * 31) % mirror.getBlockCount();
+                if (mirror.readBlocks(lba, 1, block) || block[0] != (uint8_t)lba || block[511] != (uint8_t)lba)
+                    mismatches[t]++;
+            }
+        });
+    }
+    for (auto &reader : readers)
+        reader.join();
+
+    for (size_t t = 0; t < THREADS; t++)
+        ASSERT(!mismatches[t], "reader %lu got %lu bad blocks", t, mismatches[t]);
+
+    auto stats0 = mirror.getMemberStats(0);
+    auto stats1 = mirror.getMemberStats(1);
+    LOG("member reads: %lu, %lu", stats0.reads, stats1.reads);
+    ASSERT(stats0.reads + stats1.reads == THREADS * READS, "reads not counted");
+}
+
+TEST(geometry) {
+    MemStore small(&image0, 30 * 512);
+    MemStore large(&image1, 64 * 512);
+    MemStore big4k(&image1, image1.size(), 4096);
+
+    Store *stores[] = { &small, &large };
+    auto mirror = MirrorStore(stores, 2);
+    ASSERT(mirror.getBlockCount() == 30, "volume should have the size of the smallest member (count=%lu)",
+           mirror.getBlockCount());
+
+    Store *mixed[] = { &small, &big4k };
+    auto bad = MirrorStore(mixed, 2);
+    ASSERT(bad.getBlockCount() == 0, "mixed block sizes should be rejected");
+    ASSERT(bad.seek(0) != STORE_ERR_OK, "seek in rejected mirror should fail");
+}
+
+TEST_MAIN() {
+    TEST_START();
+
+    image0.fill(0);
+    image0[510] = 0x55; // Insert boot sector signature.
+    image0[511] = 0xaa;
+    image1 = image0;
+
+    MemStore member0(&image0, image0.size());
+    MemStore member1(&image1, image1.size());
+    Store *stores[] = { &member0, &member1 };
+
+    TEST_STORE_WITH(MirrorStore(stores, 2), create);
+    TEST_STORE_WITH(MirrorStore(stores, 2), seek  );
+    TEST_STORE_WITH(MirrorStore(stores, 2), read  );
+    TEST_STORE_WITH(MirrorStore(stores, 2), write );
+    TEST_STORE_WITH(MirrorStore(stores, 2), read_blocks );
+    TEST_STORE_WITH(MirrorStore(stores, 2), write_blocks);
+    TEST_STORE_WITH(MirrorStore(stores, 2), flush );
+    TEST_STORE_WITH(MirrorStore(stores, 2), borrow);
+
+    MemStore roMember0((const void*)&image0, image0.size());
+    MemStore roMember1((const void*)&image1, image1.size());
+    Store *roStores[] = { &roMember0, &roMember1 };
+    TEST_STORE_WITH(MirrorStore(roStores, 2), write_ro);
+    TEST_STORE_WITH(MirrorStore(roStores, 2), borrow);
+
+    RUN_TEST(mirrored_write);
+    RUN_TEST(failover);
+    RUN_TEST(balance);
+    RUN_TEST(concurrent);
+    RUN_TEST(geometry);
+
+    TEST_END();
+}
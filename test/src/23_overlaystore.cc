@@ -0,0 +1,182 @@
+/**
+ * \file
+ * \brief     Tests for OverlayStore.
+ * \author    Chris Smeele
+ * \copyright Copyright (c) 2016, Chris Smeele
+ * \license   Boost, see LICENSE
+ */
+#include "test.hh"
+#include "store.hh"
+
+#include <memstore.hh>
+#include <overlaystore.hh>
+#include <vector>
+
+static const size_t BASE_BLOCKS = 256;
+
+static std::vector<uint8_t> baseImage(BASE_BLOCKS * 512);
+static std::vector<uint8_t> deltaImage (OverlayStore::getDeltaBlockCount(BASE_BLOCKS) * 512);
+static std::vector<uint8_t> deltaImage2(OverlayStore::getDeltaBlockCount(BASE_BLOCKS) * 512);
+
+static uint8_t mapBuffer [2048];
+static uint8_t mapBuffer2[2048];
+
+TEST(copy_on_write) {
+    StoreError err;
+
+    auto original = baseImage;
+    MemStore base ((const void*)baseImage.data(), baseImage.size());
+    MemStore delta(deltaImage.data(), deltaImage.size());
+
+    auto overlay = OverlayStore(&base, &delta, mapBuffer, sizeof(mapBuffer), true);
+    ASSERT(overlay.getBlockCount() == BASE_BLOCKS, "bad block count (%lu)", overlay.getBlockCount());
+    ASSERT(overlay.isWritable(), "overlay of read-only base should be writable");
+    ASSERT(overlay.getModifiedCount() == 0, "fresh overlay should have no modified blocks");
+
+    uint8_t buffer[512 * 8];
+    memset(buffer, 0xc3, sizeof(buffer));
+    err = overlay.writeBlocks(10, 3, buffer);
+    ASSERT(err == STORE_ERR_OK, "write blocks (err=%d)", err);
+    ASSERT(baseImage == original, "base was modified");
+    ASSERT(overlay.getModifiedCount() == 3, "expected 3 modified blocks (%lu)", overlay.getModifiedCount());
+
+    // A read spanning modified and unmodified blocks.
+    err = overlay.readBlocks(8, 8, buffer);
+    ASSERT(err == STORE_ERR_OK, "read blocks (err=%d)", err);
+    ASSERT(!memcmp(buffer, &baseImage[8 * 512], 2 * 512), "unmodified blocks should come from the base");
+    ASSERT(buffer[2 * 512] == 0xc3 && buffer[5 * 512 - 1] == 0xc3, "modified blocks should come from the delta");
+    ASSERT(!memcmp(buffer + 5 * 512, &baseImage[13 * 512], 3 * 512), "unmodified blocks should come from the base");
+
+    // Unmodified blocks of a writable overlay are not lent out, writes would move them.
+    ASSERT(!overlay.borrowBlock(20), "unmodified borrow of writable overlay should fail");
+    const uint8_t *modified = overlay.borrowBlock(10);
+    ASSERT(modified && modified[0] == 0xc3, "modified borrow should come from the delta");
+    memset(buffer, 0x3c, 512);
+    overlay.write(10, buffer);
+    ASSERT(modified[0] == 0x3c, "borrowed block should reflect later writes");
+    ASSERT(!overlay.borrowBlock(9, 2), "borrow spanning base and delta should fail");
+
+    uint8_t *block = overlay.borrowBlockWritable(20, 2);
+    ASSERT(block, "writable borrow");
+    ASSERT(!memcmp(block, &baseImage[20 * 512], 2 * 512), "copied up blocks differ from base");
+    block[0] = (uint8_t)~block[0];
+    err = overlay.commitBlock(20, 2);
+    ASSERT(err == STORE_ERR_OK, "commit (err=%d)", err);
+    ASSERT(baseImage == original, "base was modified by writable borrow");
+    ASSERT(overlay.getModifiedCount() == 5, "expected 5 modified blocks (%lu)", overlay.getModifiedCount());
+
+    // Reopen the delta.
+    auto reopened = OverlayStore(&base, &delta, mapBuffer2, sizeof(mapBuffer2));
+    ASSERT(reopened.getBlockCount() == BASE_BLOCKS, "reopen delta");
+    ASSERT(reopened.getModifiedCount() == 5, "reopened delta lost modified blocks");
+    err = reopened.read(11, buffer);
+    ASSERT(err == STORE_ERR_OK && buffer[0] == 0xc3, "reopened delta lost data");
+}
+
+TEST(clones) {
+    StoreError err;
+
+    MemStore base  ((const void*)baseImage.data(), baseImage.size());
+    MemStore delta1(deltaImage.data(),  deltaImage.size());
+    MemStore delta2(deltaImage2.data(), deltaImage2.size());
+
+    auto clone1 = OverlayStore(&base, &delta1, mapBuffer,  sizeof(mapBuffer),  true);
+    auto clone2 = OverlayStore(&base, &delta2, mapBuffer2, sizeof(mapBuffer2), true);
+
+    uint8_t buffer[512];
+    memset(buffer, 1, sizeof(buffer));
+    err = clone1.write(50, buffer);
+    ASSERT(err == STORE_ERR_OK, "write clone 1 (err=%d)", err);
+    memset(buffer, 2, sizeof(buffer));
+    err = clone2.write(50, buffer);
+    ASSERT(err == STORE_ERR_OK, "write clone 2 (err=%d)", err);
+
+    err = clone1.read(50, buffer);
+    ASSERT(err == STORE_ERR_OK && buffer[0] == 1, "clone 1 sees writes of clone 2");
+    err = clone2.read(50, buffer);
+    ASSERT(err == STORE_ERR_OK && buffer[0] == 2, "clone 2 sees writes of clone 1");
+
+    // Unformatted or mismatched deltas are rejected.
+    std::vector<uint8_t> blank(deltaImage.size());
+    MemStore blankDelta(blank.data(), blank.size());
+    auto bad = OverlayStore(&base, &blankDelta, mapBuffer2, sizeof(mapBuffer2));
+    ASSERT(bad.getBlockCount() == 0, "unformatted delta should be rejected");
+
+    MemStore smallBase((const void*)baseImage.data(), baseImage.size() / 2);
+    auto mismatch = OverlayStore(&smallBase, &delta1, mapBuffer2, sizeof(mapBuffer2));
+    ASSERT(mismatch.getBlockCount() == 0, "delta of another base should be rejected");
+    ASSERT(mismatch.seek(0) != STORE_ERR_OK, "seek in rejected overlay should fail");
+
+    auto tooSmall = OverlayStore(&base, &delta1, mapBuffer2, 512, true);
+    ASSERT(tooSmall.getBlockCount() == 0, "too small map buffer should be rejected");
+}
+
+TEST(squash) {
+    StoreError err;
+
+    MemStore base ((const void*)baseImage.data(), baseImage.size());
+    MemStore delta(deltaImage.data(), deltaImage.size());
+    auto overlay = OverlayStore(&base, &delta, mapBuffer, sizeof(mapBuffer), true);
+
+    uint8_t buffer[512 * 4];
+    for (size_t i = 0; i < sizeof(buffer); i++)
+        buffer[i] = (uint8_t)rand();
+    overlay.writeBlocks(0,   1, buffer);
+    overlay.writeBlocks(100, 4, buffer);
+    overlay.writeBlocks(255, 1, buffer);
+
+    std::vector<uint8_t> expected(baseImage.size());
+    err = overlay.readBlocks(0, BASE_BLOCKS, expected.data());
+    ASSERT(err == STORE_ERR_OK, "read overlay (err=%d)", err);
+
+    // Squash to a standalone image.
+    std::vector<uint8_t> standalone(baseImage.size());
+    MemStore target(standalone.data(), standalone.size());
+    uint8_t scratch[512 * 3];
+    err = overlay.squash(&target, scratch, sizeof(scratch));
+    ASSERT(err == STORE_ERR_OK, "squash (err=%d)", err);
+    ASSERT(standalone == expected, "squashed image differs from overlay");
+
+    // Merge into a writable base.
+    auto merged = baseImage;
+    MemStore writableBase(merged.data(), merged.size());
+    auto overlay2 = OverlayStore(&writableBase, &delta, mapBuffer2, sizeof(mapBuffer2));
+    err = overlay2.squash(&writableBase, scratch, sizeof(scratch));
+    ASSERT(err == STORE_ERR_OK, "squash into base (err=%d)", err);
+    ASSERT(merged == expected, "merged base differs from overlay");
+
+    MemStore roTarget((const void*)standalone.data(), standalone.size());
+    err = overlay.squash(&roTarget, scratch, sizeof(scratch));
+    ASSERT(err == STORE_ERR_NOT_WRITABLE, "squash to read-only store should fail (err=%d)", err);
+}
+
+TEST_MAIN() {
+    TEST_START();
+
+    for (auto &b : baseImage)
+        b = (uint8_t)rand();
+    baseImage[510] = 0x55; // Insert boot sector signature.
+    baseImage[511] = 0xaa;
+
+    MemStore base ((const void*)baseImage.data(), baseImage.size());
+    MemStore delta(deltaImage.data(), deltaImage.size());
+
+    TEST_STORE_WITH(OverlayStore(&base, &delta, mapBuffer, sizeof(mapBuffer), true), create);
+    TEST_STORE_WITH(OverlayStore(&base, &delta, mapBuffer, sizeof(mapBuffer), true), seek  );
+    TEST_STORE_WITH(OverlayStore(&base, &delta, mapBuffer, sizeof(mapBuffer), true), read  );
+    TEST_STORE_WITH(OverlayStore(&base, &delta, mapBuffer, sizeof(mapBuffer), true), write );
+    TEST_STORE_WITH(OverlayStore(&base, &delta, mapBuffer, sizeof(mapBuffer), true), read_blocks );
+    TEST_STORE_WITH(OverlayStore(&base, &delta, mapBuffer, sizeof(mapBuffer), true), write_blocks);
+    TEST_STORE_WITH(OverlayStore(&base, &delta, mapBuffer, sizeof(mapBuffer), true), flush );
+    TEST_STORE_WITH(OverlayStore(&base, &delta, mapBuffer, sizeof(mapBuffer), true), borrow_written);
+
+    MemStore roDelta((const void*)deltaImage.data(), deltaImage.size());
+    TEST_STORE_WITH(OverlayStore(&base, &roDelta, mapBuffer, sizeof(mapBuffer)), write_ro);
+    TEST_STORE_WITH(OverlayStore(&base, &roDelta, mapBuffer, sizeof(mapBuffer)), borrow);
+
+    RUN_TEST(copy_on_write);
+    RUN_TEST(clones);
+    RUN_TEST(squash);
+
+    TEST_END();
+}
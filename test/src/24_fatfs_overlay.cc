@@ -0,0 +1,54 @@
+/**
+ * \file
+ * \brief     Tests for FatFs on copy-on-write clones of one image.
+ * \author    Chris Smeele
+ * \copyright Copyright (c) 2016, Chris Smeele
+ * \license   Boost, see LICENSE
+ */
+#include "test.hh"
+#include "fs.hh"
+
+#include <filestore.hh>
+#include <memstore.hh>
+#include <overlaystore.hh>
+#include <fatfs.hh>
+
+#include <vector>
+
+TEST_MAIN() {
+    TEST_START();
+
+    for (const char *path : { MUTEST_FAT12FILE, MUTEST_FAT16FILE }) {
+        LOG("Image: %s", path);
+
+        // One read-only golden image, shared by two clones.
+        auto base = FileStore(path, false);
+
+        size_t deltaBlocks = OverlayStore::getDeltaBlockCount(base.getBlockCount());
+        std::vector<uint8_t> deltaImage1(deltaBlocks * 512);
+        std::vector<uint8_t> deltaImage2(deltaBlocks * 512);
+        auto delta1 = MemStore(deltaImage1.data(), deltaImage1.size());
+        auto delta2 = MemStore(deltaImage2.data(), deltaImage2.size());
+
+        std::vector<uint8_t> map1(OverlayStore::getMapSize(base.getBlockCount()));
+        std::vector<uint8_t> map2(OverlayStore::getMapSize(base.getBlockCount()));
+        auto clone1 = OverlayStore(&base, &delta1, map1.data(), map1.size(), true);
+        auto clone2 = OverlayStore(&base, &delta2, map2.data(), map2.size(), true);
+
+        TEST_FS_WITH(FatFs(&clone1), create);
+        TEST_FS_WITH(FatFs(&clone1), metadata);
+        TEST_FS_WITH(FatFs(&clone1), root_readdir);
+        TEST_FS_WITH(FatFs(&clone1), get_file);
+        TEST_FS_WITH(FatFs(&clone1), get_dir);
+        TEST_FS_WITH(FatFs(&clone1), file_read);
+        TEST_FS_WITH(FatFs(&clone1), file_write);
+
+        TEST_FS_WITH(FatFs(&clone2), root_readdir);
+        TEST_FS_WITH(FatFs(&clone2), file_read);
+        TEST_FS_WITH(FatFs(&clone2), file_write);
+
+        LOG("Modified blocks: %lu, %lu", clone1.getModifiedCount(), clone2.getModifiedCount());
+    }
+
+    TEST_END();
+}
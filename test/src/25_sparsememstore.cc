@@ -0,0 +1,171 @@
+/**
+ * \file
+ * \brief     Tests for SparseMemStore.
+ * \author    Chris Smeele
+ * \copyright Copyright (c) 2016, Chris Smeele
+ * \license   Boost, see LICENSE
+ */
+#include "test.hh"
+#include "store.hh"
+
+#include <sparsememstore.hh>
+
+/// Create a store with a boot sector signature.
+static SparseMemStore makeStore(size_t size, size_t blockSize = 512, size_t pageSize = 64 * 1024) {
+    SparseMemStore sparse(size, blockSize, pageSize);
+
+    uint8_t block[4096] = { };
+    block[510] = 0x55;
+    block[511] = 0xaa;
+    sparse.write(0, block);
+    sparse.seek(0);
+
+    return sparse;
+}
+
+TEST(lazy_allocation) {
+    StoreError err;
+
+    // 4 GiB medium, of which only a few blocks are written.
+    auto sparse = SparseMemStore((size_t)4 << 30);
+    ASSERT(sparse.getBlockCount() == ((size_t)4 << 30) / 512, "bad block count (%lu)", sparse.getBlockCount());
+    ASSERT(sparse.getPageCount() == 0, "new store should have no pages");
+
+    uint8_t buffer[512 * 4];
+    memset(buffer, 0xee, sizeof(buffer));
+    err = sparse.readBlocks(sparse.getBlockCount() - 4, 4, buffer);
+    ASSERT(err == STORE_ERR_OK, "read untouched blocks (err=%d)", err);
+    ASSERT(buffer[0] == 0 && buffer[sizeof(buffer) - 1] == 0, "untouched blocks should read as zeroes");
+    ASSERT(sparse.getPageCount() == 0, "reads should not allocate pages");
+
+    memset(buffer, 0x11, sizeof(buffer));
+    err = sparse.write(1000, buffer);
+    ASSERT(err == STORE_ERR_OK, "write (err=%d)", err);
+    err = sparse.write(sparse.getBlockCount() - 1, buffer);
+    ASSERT(err == STORE_ERR_OK, "write last block (err=%d)", err);
+    ASSERT(sparse.getPageCount() == 2, "expected 2 pages (%lu)", sparse.getPageCount());
+
+    LOG("Memory usage for 4 GiB medium with 2 blocks written: %lu bytes", sparse.getMemoryUsage());
+    ASSERT(sparse.getMemoryUsage() < 1024 * 1024, "memory use should be proportional to data written");
+
+    // Writes crossing a page boundary.
+    size_t lba = 64 * 1024 / 512 * 3 - 2;
+    for (size_t i = 0; i < sizeof(buffer); i++)
+        buffer[i] = (uint8_t)rand();
+    err = sparse.writeBlocks(lba, 4, buffer);
+    ASSERT(err == STORE_ERR_OK, "write across pages (err=%d)", err);
+    ASSERT(sparse.getPageCount() == 4, "expected 4 pages (%lu)", sparse.getPageCount());
+
+    uint8_t buffer2[512 * 4];
+    err = sparse.readBlocks(lba, 4, buffer2);
+    ASSERT(err == STORE_ERR_OK, "read across pages (err=%d)", err);
+    ASSERT(!memcmp(buffer, buffer2, sizeof(buffer)), "read across pages differs");
+}
+
+TEST(zero_elision) {
+    StoreError err;
+
+    auto sparse = SparseMemStore(1024 * 1024, 512, 4096);
+    uint8_t zeroes[512 * 16] = { };
+    uint8_t data[512];
+    memset(data, 0x42, sizeof(data));
+
+    err = sparse.writeBlocks(0, 16, zeroes);
+    ASSERT(err == STORE_ERR_OK, "write zeroes (err=%d)", err);
+    ASSERT(sparse.getPageCount() == 0, "zero writes should not allocate pages");
+
+    err = sparse.write(9, data);
+    ASSERT(err == STORE_ERR_OK, "write (err=%d)", err);
+    err = sparse.write(10, data);
+    ASSERT(err == STORE_ERR_OK, "write (err=%d)", err);
+    ASSERT(sparse.getPageCount() == 1, "expected 1 page (%lu)", sparse.getPageCount());
+
+    // The page is only freed once all of it is zero.
+    err = sparse.write(9, zeroes);
+    ASSERT(err == STORE_ERR_OK, "write zeroes (err=%d)", err);
+    ASSERT(sparse.getPageCount() == 1, "partially zeroed page should be kept");
+
+    err = sparse.read(10, data);
+    ASSERT(err == STORE_ERR_OK && data[0] == 0x42, "data lost by zero write");
+
+    err = sparse.write(10, zeroes);
+    ASSERT(err == STORE_ERR_OK, "write zeroes (err=%d)", err);
+    ASSERT(sparse.getPageCount() == 0, "zeroed page should be freed (%lu)", sparse.getPageCount());
+    ASSERT(sparse.getMemoryUsage() == 0, "no memory should be in use (%lu)", sparse.getMemoryUsage());
+
+    err = sparse.read(10, data);
+    ASSERT(err == STORE_ERR_OK && data[0] == 0, "freed page should read as zeroes");
+}
+
+TEST(borrow_pinned) {
+    StoreError err;
+
+    auto sparse = SparseMemStore(1024 * 1024, 512, 4096);
+    uint8_t zeroes[512 * 8] = { };
+    uint8_t data[512];
+    memset(data, 0x42, sizeof(data));
+
+    ASSERT(!sparse.borrowBlock(9), "untouched blocks should not be lent out");
+
+    err = sparse.write(9, data);
+    ASSERT(err == STORE_ERR_OK, "write (err=%d)", err);
+
+    const uint8_t *block = sparse.borrowBlock(9);
+    ASSERT(block && block[0] == 0x42, "borrow written block");
+
+    // Zeroing the page would normally free it.
+    err = sparse.write(9, zeroes);
+    ASSERT(err == STORE_ERR_OK, "write zeroes (err=%d)", err);
+    ASSERT(sparse.getPageCount() == 1, "borrowed page should be kept");
+    ASSERT(block[0] == 0 && block[511] == 0, "borrowed block should reflect the zero write");
+
+    err = sparse.write(9, data);
+    ASSERT(err == STORE_ERR_OK && block[0] == 0x42, "borrowed block should reflect later writes");
+
+    err = sparse.discard(8, 8);
+    ASSERT(err == STORE_ERR_OK, "discard (err=%d)", err);
+    ASSERT(sparse.getPageCount() == 1, "discarded borrowed page should be kept");
+    ASSERT(block[0] == 0, "discarded borrowed block should read as zeroes");
+
+    uint8_t *writable = sparse.borrowBlockWritable(100);
+    ASSERT(writable, "writable borrow of untouched block");
+    err = sparse.write(100, zeroes);
+    ASSERT(err == STORE_ERR_OK && sparse.getPageCount() == 2, "writable borrowed page should be kept");
+}
+
+TEST(geometry) {
+    auto badBlock = SparseMemStore(1024 * 1024, 1000);
+    ASSERT(badBlock.getBlockCount() == 0, "invalid block size should be rejected");
+    ASSERT(badBlock.seek(0) != STORE_ERR_OK, "seek in rejected store should fail");
+
+    auto badPage = SparseMemStore(1024 * 1024, 4096, 512);
+    ASSERT(badPage.getBlockCount() == 0, "page size smaller than block size should be rejected");
+
+    auto partial = SparseMemStore(1000 * 1000, 4096);
+    ASSERT(partial.getBlockCount() == 1000 * 1000 / 4096, "partial trailing block should not be accessible");
+}
+
+TEST_MAIN() {
+    TEST_START();
+
+    TEST_STORE_WITH(makeStore(1024 * 1024), create);
+    TEST_STORE_WITH(makeStore(1024 * 1024), seek  );
+    TEST_STORE_WITH(makeStore(1024 * 1024), read  );
+    TEST_STORE_WITH(makeStore(1024 * 1024), write );
+    TEST_STORE_WITH(makeStore(1024 * 1024), read_blocks );
+    TEST_STORE_WITH(makeStore(1024 * 1024), write_blocks);
+    TEST_STORE_WITH(makeStore(1024 * 1024), flush );
+    TEST_STORE_WITH(makeStore(1024 * 1024), borrow_written);
+
+    TEST_STORE_WITH(makeStore(1024 * 1024, 4096, 4096), read  );
+    TEST_STORE_WITH(makeStore(1024 * 1024, 4096, 4096), write );
+    TEST_STORE_WITH(makeStore(1024 * 1024, 4096, 4096), read_blocks );
+    TEST_STORE_WITH(makeStore(1024 * 1024, 4096, 4096), write_blocks);
+
+    RUN_TEST(lazy_allocation);
+    RUN_TEST(zero_elision);
+    RUN_TEST(borrow_pinned);
+    RUN_TEST(geometry);
+
+    TEST_END();
+}
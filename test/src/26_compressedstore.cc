@@ -0,0 +1,172 @@
+/**
+ * \file
+ * \brief     Tests for CompressedStore and the LZ compressor.
+ * \author    Chris Smeele
+ * \copyright Copyright (c) 2016, Chris Smeele
+ * \license   Boost, see LICENSE
+ */
+#include "test.hh"
+#include "store.hh"
+
+#include <compressedstore.hh>
+#include <filestore.hh>
+#include <lz.hh>
+#include <memstore.hh>
+#include <vector>
+
+static std::vector<uint8_t> image;
+static std::vector<uint8_t> containerImage;
+
+/// Compress and decompress, returns whether the data survived.
+static bool roundTrip(const std::vector<uint8_t> &data, size_t &compressedSize) {
+    std::vector<uint8_t> compressed(data.size() + data.size() / 255 + 16);
+    std::vector<uint8_t> decompressed(data.size());
+
+    compressedSize = lzCompress(data.data(), data.size(), compressed.data(), compressed.size());
+    if (!compressedSize)
+        return false;
+
+    return lzDecompress(compressed.data(), compressedSize, decompressed.data(), decompressed.size())
+        && decompressed == data;
+}
+
+TEST(lz) {
+    size_t size;
+
+    std::vector<uint8_t> zeroes(65536);
+    ASSERT(roundTrip(zeroes, size), "round trip of zeroes");
+    LOG("zeroes: %lu -> %lu", zeroes.size(), size);
+    ASSERT(size < 400, "zeroes should compress well (%lu)", size);
+
+    std::vector<uint8_t> random(65536);
+    for (auto &b : random)
+        b = (uint8_t)rand();
+    ASSERT(roundTrip(random, size), "round trip of random data");
+    LOG("random: %lu -> %lu", random.size(), size);
+
+    std::vector<uint8_t> text;
+    const char *words[] = { "block ", "store ", "cluster ", "sector ", "MuStore ", "\n" };
+    while (text.size() < 65536) {
+        for (const char *c = words[rand() % 6]; *c; c++)
+            text.push_back((uint8_t)*c);
+    }
+    ASSERT(roundTrip(text, size), "round trip of text");
+    LOG("text: %lu -> %lu", text.size(), size);
+    ASSERT(size < text.size() / 2, "text should compress (%lu)", size);
+
+    for (size_t n : { 0, 1, 3, 4, 5, 15, 16, 300 }) {
+        std::vector<uint8_t> small(n, 'a');
+        ASSERT(roundTrip(small, size), "round trip of %lu bytes", n);
+    }
+
+    // Output that does not fit is reported.
+    uint8_t tiny[16];
+    ASSERT(!lzCompress(random.data(), random.size(), tiny, sizeof(tiny)), "compression into too small buffer should fail");
+
+    // Corrupt input must be rejected, not overrun buffers.
+    std::vector<uint8_t> compressed(text.size() * 2);
+    size = lzCompress(text.data(), text.size(), compressed.data(), compressed.size());
+    std::vector<uint8_t> out(text.size());
+    ASSERT(!lzDecompress(compressed.data(), size - 1, out.data(), out.size()), "truncated input should be rejected");
+    ASSERT(!lzDecompress(compressed.data(), size, out.data(), out.size() - 1), "wrong output size should be rejected");
+
+    size_t rejected = 0;
+    for (size_t i = 0; i < 200; i++) {
+        auto corrupt = compressed;
+        corrupt[(size_t)rand() % size] ^= (uint8_t)(1 + rand() % 255);
+        if (!lzDecompress(corrupt.data(), size, out.data(), out.size()))
+            rejected++;
+    }
+    LOG("rejected %lu of 200 corrupted inputs", rejected);
+}
+
+TEST(pack) {
+    StoreError err;
+
+    MemStore source((const void*)image.data(), image.size());
+    MemStore container(containerImage.data(), containerImage.size());
+
+    size_t used = 0;
+    err = CompressedStore::pack(&source, &container, 60, &used);
+    ASSERT(err == STORE_ERR_OK, "pack (err=%d)", err);
+    LOG("Packed %lu blocks into %lu blocks", source.getBlockCount(), used);
+    ASSERT(used < source.getBlockCount(), "image should compress");
+
+    auto compressed = CompressedStore(&container, 2);
+    ASSERT(compressed.getBlockCount() == source.getBlockCount(), "bad block count (%lu)", compressed.getBlockCount());
+    ASSERT(!compressed.isWritable(), "compressed store should be read-only");
+
+    // Whole image, through the direct path.
+    std::vector<uint8_t> buffer(image.size());
+    err = compressed.readBlocks(0, compressed.getBlockCount(), buffer.data());
+    ASSERT(err == STORE_ERR_OK, "read whole image (err=%d)", err);
+    ASSERT(buffer == image, "image differs");
+    ASSERT(compressed.getStats().misses == 0, "whole groups should not go through the cache");
+
+    // Random single blocks, through the cache.
+    compressed.resetStats();
+    for (size_t i = 0; i < 500; i++) {
+        size_t lba = (size_t)rand() % compressed.getBlockCount();
+        err = compressed.read(lba, buffer.data());
+        ASSERT(err == STORE_ERR_OK, "read block %lu (err=%d)", lba, err);
+        ASSERT(!memcmp(buffer.data(), &image[lba * 512], 512), "block %lu differs", lba);
+    }
+
+    // Cached groups are evicted, so they are not lent out.
+    ASSERT(!compressed.borrowBlock(0), "borrowing should not be supported");
+
+    // Sequential single blocks decompress each group once.
+    auto sequential = CompressedStore(&container, 2);
+    for (size_t lba = 0; lba < sequential.getBlockCount(); lba++)
+        sequential.read(lba, buffer.data());
+    auto stats = sequential.getStats();
+    ASSERT(stats.misses == (sequential.getBlockCount() + 59) / 60,
+           "each group should be decompressed once (misses=%lu)", stats.misses);
+
+    // A moved-from store fails instead of using the moved buffers.
+    auto moved = std::move(sequential);
+    ASSERT(moved.read(0, buffer.data()) == STORE_ERR_OK, "read from moved-to store");
+    ASSERT(sequential.read(0, buffer.data()) == STORE_ERR_IO, "read from moved-from store should fail");
+
+    // Corrupt containers are rejected.
+    containerImage[3] ^= 1;
+    auto bad = CompressedStore(&container);
+    ASSERT(bad.getBlockCount() == 0, "container with bad magic should be rejected");
+    ASSERT(bad.seek(0) != STORE_ERR_OK, "seek in rejected store should fail");
+    containerImage[3] ^= 1;
+
+    MemStore small(containerImage.data(), 4 * 512);
+    err = CompressedStore::pack(&source, &small, 60);
+    ASSERT(err == STORE_ERR_OUT_OF_BOUNDS, "pack into too small container should fail (err=%d)", err);
+}
+
+TEST_MAIN() {
+    TEST_START();
+
+    // A FAT image: partly zero, partly compressible, partly random.
+    {
+        auto file = FileStore(MUTEST_FAT12FILE, false);
+        image.resize(file.getBlockCount() * 512);
+        file.readBlocks(0, file.getBlockCount(), image.data());
+        for (size_t i = 100 * 512; i < 120 * 512; i++)
+            image[i] = (uint8_t)rand();
+
+        MemStore source((const void*)image.data(), image.size());
+        containerImage.resize(CompressedStore::getMaxContainerBlockCount(file.getBlockCount(), 512, 60) * 512);
+        MemStore container(containerImage.data(), containerImage.size());
+        CompressedStore::pack(&source, &container, 60);
+    }
+
+    MemStore container(containerImage.data(), containerImage.size());
+
+    TEST_STORE_WITH(CompressedStore(&container), create);
+    TEST_STORE_WITH(CompressedStore(&container), seek  );
+    TEST_STORE_WITH(CompressedStore(&container), read  );
+    TEST_STORE_WITH(CompressedStore(&container), read_blocks);
+    TEST_STORE_WITH(CompressedStore(&container), write_ro);
+
+    RUN_TEST(lz);
+    RUN_TEST(pack);
+
+    TEST_END();
+}
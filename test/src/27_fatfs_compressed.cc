@@ -0,0 +1,70 @@
+/**
+ * \file
+ * \brief     Tests for FatFs on compressed images.
+ * \author    Chris Smeele
+ * \copyright Copyright (c) 2016, Chris Smeele
+ * \license   Boost, see LICENSE
+ */
+#include "test.hh"
+#include "fs.hh"
+
+#include <compressedstore.hh>
+#include <filestore.hh>
+#include <overlaystore.hh>
+#include <sparsememstore.hh>
+#include <fatfs.hh>
+
+#include <vector>
+
+TEST_MAIN() {
+    TEST_START();
+
+    for (const char *path : { MUTEST_FAT12FILE, MUTEST_FAT16FILE, MUTEST_FAT32FILE }) {
+        LOG("Image: %s", path);
+
+        auto image = FileStore(path, false);
+
+        // Containers are small, but their maximum size is that of the image.
+        auto container = SparseMemStore(
+            CompressedStore::getMaxContainerBlockCount(image.getBlockCount(), 512, 64) * 512);
+
+        size_t used;
+        CompressedStore::pack(&image, &container, 64, &used);
+        LOG("Packed %lu blocks into %lu blocks", image.getBlockCount(), used);
+
+        auto compressed = CompressedStore(&container);
+
+        TEST_FS_WITH(FatFs(&compressed), create);
+        TEST_FS_WITH(FatFs(&compressed), metadata);
+        TEST_FS_WITH(FatFs(&compressed), root_readdir);
+        TEST_FS_WITH(FatFs(&compressed), get_file);
+        TEST_FS_WITH(FatFs(&compressed), get_dir);
+        TEST_FS_WITH(FatFs(&compressed), file_read);
+
+        // Writes go to an overlay.
+        auto delta = SparseMemStore(OverlayStore::getDeltaBlockCount(compressed.getBlockCount()) * 512);
+        std::vector<uint8_t> map(OverlayStore::getMapSize(compressed.getBlockCount()));
+        auto overlay = OverlayStore(&compressed, &delta, map.data(), map.size(), true);
+
+        TEST_FS_WITH(FatFs(&overlay), file_read);
+        TEST_FS_WITH(FatFs(&overlay), file_write);
+    }
+
+    {
+        // With a single cached group, FatFs' FAT lookups evict the directory it is reading.
+        LOG("Image: %s, 1 cached group", MUTEST_FAT32FILE_LARGE);
+
+        auto image     = FileStore(MUTEST_FAT32FILE_LARGE, false);
+        auto container = SparseMemStore(
+            CompressedStore::getMaxContainerBlockCount(image.getBlockCount(), 512, 64) * 512);
+        CompressedStore::pack(&image, &container, 64);
+
+        auto compressed = CompressedStore(&container, 1);
+
+        TEST_FS_WITH(FatFs(&compressed), create);
+        TEST_FS_WITH(FatFs(&compressed), large_root_readdir);
+        TEST_FS_WITH(FatFs(&compressed), large_file_read);
+    }
+
+    TEST_END();
+}
@@ -0,0 +1,191 @@
+/**
+ * \file
+ * \brief     Tests for ChecksumStore and CRC32C.
+ * \author    Chris Smeele
+ * \copyright Copyright (c) 2016, Chris Smeele
+ * \license   Boost, see LICENSE
+ */
+#include "test.hh"
+#include "store.hh"
+
+#include <checksumstore.hh>
+#include <crc32c.hh>
+#include <memstore.hh>
+#include <mirrorstore.hh>
+#include <vector>
+
+static const size_t BLOCKS = 256;
+
+static std::vector<uint8_t> image(BLOCKS * 512);
+static uint32_t sums[BLOCKS];
+
+TEST(crc32c) {
+    uint8_t data[32];
+
+    ASSERT(crc32c("123456789", 9) == 0xe3069283, "check value (%#x)", crc32c("123456789", 9));
+    ASSERT(crc32cPortable("123456789", 9) == 0xe3069283, "portable check value");
+
+    // Test vectors from RFC 3720.
+    memset(data, 0, sizeof(data));
+    ASSERT(crc32c(data, sizeof(data)) == 0x8a9136aa, "32 zero bytes (%#x)", crc32c(data, sizeof(data)));
+    memset(data, 0xff, sizeof(data));
+    ASSERT(crc32c(data, sizeof(data)) == 0x62a8ab43, "32 0xff bytes (%#x)", crc32c(data, sizeof(data)));
+
+    LOG("Hardware acceleration: %s", crc32cIsAccelerated() ? "yes" : "no");
+
+    // Accelerated and portable versions must agree for all sizes and alignments.
+    std::vector<uint8_t> buffer(20000);
+    for (auto &b : buffer)
+        b = (uint8_t)rand();
+
+    for (size_t offset = 0; offset < 9; offset++) {
+        for (size_t size : { 0, 1, 7, 8, 100, 384, 512, 1000, 3072, 4096, 5000, 12289 }) {
+            uint32_t expected = crc32cPortable(buffer.data() + offset, size);
+            ASSERT(crc32c(buffer.data() + offset, size) == expected,
+                   "crc of %lu bytes at offset %lu differs from portable version", size, offset);
+
+            uint32_t part = crc32c(buffer.data() + offset, size / 3);
+            ASSERT(crc32c(buffer.data() + offset + size / 3, size - size / 3, part) == expected,
+                   "crc of %lu bytes at offset %lu in parts differs", size, offset);
+        }
+    }
+}
+
+TEST(corruption) {
+    StoreError err;
+
+    MemStore mem(image.data(), image.size());
+    auto checked = ChecksumStore(&mem, sums, BLOCKS);
+    ASSERT(checked.getBlockCount() == BLOCKS, "bad block count (%lu)", checked.getBlockCount());
+
+    uint8_t buffer[512 * 4];
+    err = checked.readBlocks(0, 4, buffer);
+    ASSERT(err == STORE_ERR_OK, "read (err=%d)", err);
+
+    // Silent corruption in the underlying store.
+    image[42 * 512 + 7] ^= 0x10;
+
+    err = checked.readBlocks(40, 4, buffer);
+    ASSERT(err == STORE_ERR_CHECKSUM, "corrupt block should fail the read (err=%d)", err);
+    ASSERT(checked.getStats().lastMismatch == 42, "mismatch at wrong LBA (%lu)", checked.getStats().lastMismatch);
+    ASSERT(checked.getStats().mismatches == 1, "expected 1 mismatch");
+
+    err = checked.read(41, buffer);
+    ASSERT(err == STORE_ERR_OK, "neighbouring blocks should be fine (err=%d)", err);
+
+    ASSERT(!checked.borrowBlock(42), "corrupt block should not be lent out");
+    ASSERT(checked.borrowBlock(41), "borrow good block");
+
+    // Rewriting the block fixes it.
+    memset(buffer, 0x24, 512);
+    err = checked.write(42, buffer);
+    ASSERT(err == STORE_ERR_OK, "write (err=%d)", err);
+    err = checked.read(42, buffer);
+    ASSERT(err == STORE_ERR_OK, "rewritten block should verify (err=%d)", err);
+
+    // Blocks modified through writable borrows are checksummed on commit.
+    uint8_t *block = checked.borrowBlockWritable(50);
+    ASSERT(block, "borrow writable");
+    block[0] ^= 0xff;
+    err = checked.commitBlock(50);
+    ASSERT(err == STORE_ERR_OK, "commit (err=%d)", err);
+    err = checked.read(50, buffer);
+    ASSERT(err == STORE_ERR_OK, "committed block should verify (err=%d)", err);
+}
+
+TEST(persistent_table) {
+    StoreError err;
+
+    MemStore mem(image.data(), image.size());
+
+    size_t entries = ChecksumStore::getTableSize(BLOCKS, 512);
+    std::vector<uint8_t>  tableImage(entries * sizeof(uint32_t));
+    std::vector<uint32_t> table(entries);
+    std::vector<uint32_t> table2(entries);
+    MemStore tableStore(tableImage.data(), tableImage.size());
+
+    {
+        auto checked = ChecksumStore(&mem, table.data(), table.size(), &tableStore, true);
+        ASSERT(checked.getBlockCount() == BLOCKS, "build table");
+
+        uint8_t buffer[512];
+        memset(buffer, 0x99, sizeof(buffer));
+        err = checked.write(200, buffer);
+        ASSERT(err == STORE_ERR_OK, "write (err=%d)", err);
+    }
+
+    // The table, including the checksum of the write, is loaded from the table store.
+    auto reopened = ChecksumStore(&mem, table2.data(), table2.size(), &tableStore);
+    ASSERT(reopened.getBlockCount() == BLOCKS, "reopen");
+
+    uint8_t buffer[512];
+    err = reopened.read(200, buffer);
+    ASSERT(err == STORE_ERR_OK && buffer[0] == 0x99, "read after reopen (err=%d)", err);
+
+    image[200 * 512] ^= 1;
+    err = reopened.read(200, buffer);
+    ASSERT(err == STORE_ERR_CHECKSUM, "corruption should be detected after reopen (err=%d)", err);
+    image[200 * 512] ^= 1;
+
+    auto tooSmall = ChecksumStore(&mem, table2.data(), 10, &tableStore);
+    ASSERT(tooSmall.getBlockCount() == 0, "too small table should be rejected");
+    ASSERT(tooSmall.seek(0) != STORE_ERR_OK, "seek in rejected store should fail");
+}
+
+TEST(mirror_repair) {
+    StoreError err;
+
+    auto image2 = image;
+    static uint32_t sums2[BLOCKS];
+
+    MemStore mem1(image.data(),  image.size());
+    MemStore mem2(image2.data(), image2.size());
+    auto checked1 = ChecksumStore(&mem1, sums,  BLOCKS);
+    auto checked2 = ChecksumStore(&mem2, sums2, BLOCKS);
+
+    Store *members[] = { &checked1, &checked2 };
+    auto mirror = MirrorStore(members, 2);
+
+    image [10 * 512] ^= 1;
+    image2[200 * 512] ^= 1;
+
+    // Each corrupt block is served by the other member.
+    uint8_t buffer[512];
+    err = mirror.read(10, buffer);
+    ASSERT(err == STORE_ERR_OK, "read block corrupt on member 0 (err=%d)", err);
+    err = mirror.read(200, buffer);
+    ASSERT(err == STORE_ERR_OK, "read block corrupt on member 1 (err=%d)", err);
+
+    image [10 * 512] ^= 1;
+    image2[200 * 512] ^= 1;
+}
+
+TEST_MAIN() {
+    TEST_START();
+
+    for (auto &b : image)
+        b = (uint8_t)rand();
+    image[510] = 0x55; // Insert boot sector signature.
+    image[511] = 0xaa;
+
+    MemStore mem(image.data(), image.size());
+
+    TEST_STORE_WITH(ChecksumStore(&mem, sums, BLOCKS), create);
+    TEST_STORE_WITH(ChecksumStore(&mem, sums, BLOCKS), seek  );
+    TEST_STORE_WITH(ChecksumStore(&mem, sums, BLOCKS), read  );
+    TEST_STORE_WITH(ChecksumStore(&mem, sums, BLOCKS), write );
+    TEST_STORE_WITH(ChecksumStore(&mem, sums, BLOCKS), read_blocks );
+    TEST_STORE_WITH(ChecksumStore(&mem, sums, BLOCKS), write_blocks);
+    TEST_STORE_WITH(ChecksumStore(&mem, sums, BLOCKS), flush );
+    TEST_STORE_WITH(ChecksumStore(&mem, sums, BLOCKS), borrow);
+
+    MemStore roMem((const void*)image.data(), image.size());
+    TEST_STORE_WITH(ChecksumStore(&roMem, sums, BLOCKS), write_ro);
+
+    RUN_TEST(crc32c);
+    RUN_TEST(corruption);
+    RUN_TEST(persistent_table);
+    RUN_TEST(mirror_repair);
+
+    TEST_END();
+}
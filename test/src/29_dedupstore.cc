@@ -0,0 +1,275 @@
+/**
+ * \file
+ * \brief     Tests for DedupStore.
+ * \author    Chris Smeele
+ * \copyright Copyright (c) 2016, Chris Smeele
+ * \license   Boost, see LICENSE
+ */
+#include "test.hh"
+#include "store.hh"
+
+#include <dedupstore.hh>
+#include <memstore.hh>
+#include <vector>
+
+static const size_t BLOCKS = 1024;
+static const size_t CHUNKS = 64;
+
+static std::vector<uint8_t> chunkData(CHUNKS * 512);
+static std::vector<uint8_t> mapData(DedupStore::getMapSize(BLOCKS, 512) * 512);
+
+/// Create a store with a boot sector signature.
+static DedupStore makeStore(Store *chunks, Store *map = nullptr) {
+    DedupStore dedup(chunks, BLOCKS, map);
+
+    uint8_t block[512] = { };
+    block[510] = 0x55;
+    block[511] = 0xaa;
+    dedup.write(0, block);
+    dedup.seek(0);
+
+    return dedup;
+}
+
+/// Fill a block with a pattern.
+static void fill(uint8_t *block, uint8_t pattern) {
+    for (size_t i = 0; i < 512; i++)
+        block[i] = (uint8_t)(pattern + i);
+}
+
+/// A chunk store whose writes can be made to fail.
+struct FailingStore : public MemStore {
+    bool failWrites = false;
+
+    StoreError write(const void *buffer) {
+        return failWrites ? STORE_ERR_IO : MemStore::write(buffer);
+    }
+    StoreError writeBlocks(size_t lba, size_t count, const void *buffer) {
+        return failWrites ? STORE_ERR_IO : MemStore::writeBlocks(lba, count, buffer);
+    }
+    using MemStore::write;
+
+    FailingStore(void *store_, size_t size) : MemStore(store_, size) { }
+};
+
+TEST(hash128) {
+    Hash128 h = hash128("The quick brown fox jumps over the lazy dog", 43);
+    ASSERT(h.lo == 0xe34bbc7bbc071b6cull && h.hi == 0x7a433ca9c49a9347ull,
+           "MurmurHash3 test vector (%#lx %#lx)", h.lo, h.hi);
+
+    h = hash128("", 0);
+    ASSERT(!h.lo && !h.hi, "empty input with seed 0 should hash to zero");
+    ASSERT(hash128("", 0, 1) != h, "seed should change the hash");
+}
+
+TEST(dedup) {
+    StoreError err;
+
+    MemStore chunks(chunkData.data(), chunkData.size());
+    auto dedup = DedupStore(&chunks, BLOCKS);
+    ASSERT(dedup.getBlockCount() == BLOCKS, "bad block count (%lu)", dedup.getBlockCount());
+    ASSERT(dedup.getUsedChunkCount() == 0, "new store should use no chunks");
+
+    uint8_t block[512];
+    uint8_t buffer[512 * 4];
+
+    // The same block at many LBAs is stored once.
+    fill(block, 1);
+    for (size_t lba = 0; lba < BLOCKS; lba += 4) {
+        err = dedup.write(lba, block);
+        ASSERT(err == STORE_ERR_OK, "write (err=%d)", err);
+    }
+    ASSERT(dedup.getMappedCount() == BLOCKS / 4, "expected %lu mapped blocks (%lu)", BLOCKS / 4, dedup.getMappedCount());
+    ASSERT(dedup.getUsedChunkCount() == 1, "expected 1 chunk (%lu)", dedup.getUsedChunkCount());
+
+    err = dedup.readBlocks(100, 4, buffer);
+    ASSERT(err == STORE_ERR_OK, "read (err=%d)", err);
+    ASSERT(!memcmp(buffer, block, 512), "deduplicated block differs");
+    ASSERT(!buffer[512] && !buffer[sizeof(buffer) - 1], "unwritten blocks should read as zeroes");
+
+    ASSERT(!dedup.borrowBlock(100), "chunks can be remapped, so they should not be lent out");
+    ASSERT(!dedup.borrowBlock(101), "zero blocks should not be lent out");
+    ASSERT(!dedup.borrowBlockWritable(100), "shared chunks can not be borrowed writable");
+
+    // Zero blocks are not stored.
+    memset(block, 0, sizeof(block));
+    err = dedup.write(1, block);
+    ASSERT(err == STORE_ERR_OK, "write zeroes (err=%d)", err);
+    ASSERT(dedup.getUsedChunkCount() == 1, "zero block should not use a chunk");
+
+    // Overwriting a shared block allocates a chunk, overwriting an unshared one does not.
+    fill(block, 2);
+    err = dedup.write(0, block);
+    ASSERT(err == STORE_ERR_OK, "write (err=%d)", err);
+    ASSERT(dedup.getUsedChunkCount() == 2, "expected 2 chunks (%lu)", dedup.getUsedChunkCount());
+
+    fill(block, 3);
+    err = dedup.write(0, block);
+    ASSERT(err == STORE_ERR_OK, "write (err=%d)", err);
+    ASSERT(dedup.getUsedChunkCount() == 2, "unshared chunk should be rewritten in place (%lu)", dedup.getUsedChunkCount());
+
+    // Dropping all references frees a chunk.
+    memset(block, 0, sizeof(block));
+    err = dedup.write(0, block);
+    ASSERT(err == STORE_ERR_OK, "write zeroes (err=%d)", err);
+    ASSERT(dedup.getUsedChunkCount() == 1, "chunk should be freed (%lu)", dedup.getUsedChunkCount());
+
+    // Fill the chunk store with unique blocks.
+    for (size_t i = 0; i < CHUNKS - 1; i++) {
+        fill(block, (uint8_t)(10 + i));
+        err = dedup.write(1 + i * 4, block);
+        ASSERT(err == STORE_ERR_OK, "write unique block %lu (err=%d)", i, err);
+    }
+    ASSERT(dedup.getUsedChunkCount() == CHUNKS, "chunk store should be full (%lu)", dedup.getUsedChunkCount());
+
+    fill(block, 200);
+    err = dedup.write(2, block);
+    ASSERT(err == STORE_ERR_IO, "write to a full chunk store should fail (err=%d)", err);
+
+    // Duplicates can still be written.
+    fill(block, 10);
+    err = dedup.write(2, block);
+    ASSERT(err == STORE_ERR_OK, "write duplicate to a full chunk store (err=%d)", err);
+
+    LOG("Memory usage for %lu blocks and %lu chunks: %lu bytes", BLOCKS, CHUNKS, dedup.getMemoryUsage());
+}
+
+TEST(churn) {
+    StoreError err;
+
+    MemStore chunks(chunkData.data(), chunkData.size());
+    auto dedup = DedupStore(&chunks, BLOCKS);
+
+    // Random writes of a few patterns, checked against a plain copy.
+    std::vector<uint8_t> expected(BLOCKS * 512);
+    uint8_t block[512];
+
+    srand(29);
+    for (size_t i = 0; i < 20000; i++) {
+        size_t  lba     = (size_t)rand() % BLOCKS;
+        uint8_t pattern = (uint8_t)(rand() % 40);
+
+        if (pattern)
+            fill(block, pattern);
+        else
+            memset(block, 0, sizeof(block));
+
+        err = dedup.write(lba, block);
+        ASSERT(err == STORE_ERR_OK, "write %lu (err=%d)", i, err);
+        memcpy(&expected[lba * 512], block, 512);
+    }
+
+    std::vector<uint8_t> actual(BLOCKS * 512);
+    err = dedup.readBlocks(0, BLOCKS, actual.data());
+    ASSERT(err == STORE_ERR_OK, "read (err=%d)", err);
+    ASSERT(actual == expected, "contents differ after random writes");
+    ASSERT(dedup.getUsedChunkCount() <= 39, "at most 39 unique blocks expected (%lu)", dedup.getUsedChunkCount());
+
+    LOG("%lu mapped blocks in %lu chunks", dedup.getMappedCount(), dedup.getUsedChunkCount());
+}
+
+TEST(write_failure) {
+    StoreError err;
+
+    FailingStore chunks(chunkData.data(), chunkData.size());
+    auto dedup = DedupStore(&chunks, BLOCKS);
+
+    uint8_t block[512];
+    uint8_t buffer[512];
+    fill(block, 1);
+
+    err = dedup.write(5, block);
+    ASSERT(err == STORE_ERR_OK, "write (err=%d)", err);
+
+    // A failed in-place overwrite keeps the old chunk.
+    chunks.failWrites = true;
+    fill(buffer, 2);
+    err = dedup.write(5, buffer);
+    ASSERT(err == STORE_ERR_IO, "write to failing chunk store should fail (err=%d)", err);
+    chunks.failWrites = false;
+
+    err = dedup.read(5, buffer);
+    ASSERT(err == STORE_ERR_OK && !memcmp(buffer, block, 512), "old data should survive a failed write");
+
+    // ... and keeps it indexed, so that duplicates still share it.
+    err = dedup.write(6, block);
+    ASSERT(err == STORE_ERR_OK, "write duplicate (err=%d)", err);
+    ASSERT(dedup.getUsedChunkCount() == 1, "duplicate should share the old chunk (used=%lu)",
+           dedup.getUsedChunkCount());
+}
+
+TEST(persistent_map) {
+    StoreError err;
+
+    std::fill(mapData.begin(), mapData.end(), 0);
+
+    MemStore chunks(chunkData.data(), chunkData.size());
+    MemStore map(mapData.data(), mapData.size());
+
+    std::vector<uint8_t> expected(BLOCKS * 512);
+    uint8_t block[512];
+    {
+        auto dedup = DedupStore(&chunks, BLOCKS, &map);
+        ASSERT(dedup.getBlockCount() == BLOCKS, "zeroed map should be an empty volume");
+        ASSERT(dedup.getMappedCount() == 0, "zeroed map should be an empty volume");
+
+        for (size_t lba = 0; lba < BLOCKS; lba += 3) {
+            fill(block, (uint8_t)(lba % 7 + 1));
+            err = dedup.write(lba, block);
+            ASSERT(err == STORE_ERR_OK, "write (err=%d)", err);
+            memcpy(&expected[lba * 512], block, 512);
+        }
+        ASSERT(dedup.getUsedChunkCount() == 7, "expected 7 chunks (%lu)", dedup.getUsedChunkCount());
+    }
+
+    auto dedup = DedupStore(&chunks, BLOCKS, &map);
+    ASSERT(dedup.getBlockCount() == BLOCKS, "reopen failed");
+    ASSERT(dedup.getUsedChunkCount() == 7, "expected 7 chunks after reopen (%lu)", dedup.getUsedChunkCount());
+
+    std::vector<uint8_t> actual(BLOCKS * 512);
+    err = dedup.readBlocks(0, BLOCKS, actual.data());
+    ASSERT(err == STORE_ERR_OK, "read (err=%d)", err);
+    ASSERT(actual == expected, "contents differ after reopen");
+
+    // The rebuilt index still finds duplicates.
+    fill(block, 1);
+    err = dedup.write(1, block);
+    ASSERT(err == STORE_ERR_OK, "write (err=%d)", err);
+    ASSERT(dedup.getUsedChunkCount() == 7, "duplicate after reopen should be shared (%lu)", dedup.getUsedChunkCount());
+
+    // A map referring to chunks that do not exist is rejected.
+    uint32_t bad = CHUNKS + 1;
+    memcpy(mapData.data(), &bad, sizeof(bad));
+    auto broken = DedupStore(&chunks, BLOCKS, &map);
+    ASSERT(broken.getBlockCount() == 0, "map with bad chunk numbers should be rejected");
+}
+
+TEST_MAIN() {
+    TEST_START();
+
+    MemStore chunks(chunkData.data(), chunkData.size());
+    MemStore map(mapData.data(), mapData.size());
+
+    TEST_STORE_WITH(makeStore(&chunks), create);
+    TEST_STORE_WITH(makeStore(&chunks), seek  );
+    TEST_STORE_WITH(makeStore(&chunks), read  );
+    TEST_STORE_WITH(makeStore(&chunks), write );
+    TEST_STORE_WITH(makeStore(&chunks), read_blocks );
+    TEST_STORE_WITH(makeStore(&chunks), write_blocks);
+    TEST_STORE_WITH(makeStore(&chunks), flush );
+
+    TEST_STORE_WITH(makeStore(&chunks, &map), read_blocks );
+    TEST_STORE_WITH(makeStore(&chunks, &map), write_blocks);
+
+    // The map written above already holds the signature.
+    MemStore roChunks((const void*)chunkData.data(), chunkData.size());
+    TEST_STORE_WITH(makeStore(&roChunks, &map), write_ro);
+
+    RUN_TEST(hash128);
+    RUN_TEST(dedup);
+    RUN_TEST(churn);
+    RUN_TEST(write_failure);
+    RUN_TEST(persistent_map);
+
+    TEST_END();
+}
@@ -0,0 +1,396 @@
+/**
+ * \file
+ * \brief     Tests for discarding blocks, from FatFs down to the backends.
+ * \author    Chris Smeele
+ * \copyright Copyright (c) 2016, Chris Smeele
+ * \license   Boost, see LICENSE
+ */
+#include "test.hh"
+
+#include <cachedstore.hh>
+#include <checksumstore.hh>
+#include <dedupstore.hh>
+#include <fatfs.hh>
+#include <memstore.hh>
+#include <posixfilestore.hh>
+#include <scalestore.hh>
+#include <sparsememstore.hh>
+#include <stripestore.hh>
+
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+using namespace MuStore;
+
+/// Passes calls on to another store, and records discards.
+class DiscardLog : public Store {
+    Store *store;
+
+public:
+    std::vector<std::pair<size_t, size_t>> discards;
+
+    StoreError seek(size_t lba) {
+        auto err = store->seek(lba);
+        pos = store->getPos();
+        return err;
+    }
+
+    StoreError read(void *buffer) {
+        auto err = store->read(buffer);
+        pos = store->getPos();
+        return err;
+    }
+
+    StoreError write(const void *buffer) {
+        auto err = store->write(buffer);
+        pos = store->getPos();
+        return err;
+    }
+
+    StoreError readBlocks(size_t lba, size_t count, void *buffer) {
+        auto err = store->readBlocks(lba, count, buffer);
+        pos = store->getPos();
+        return err;
+    }
+
+    StoreError writeBlocks(size_t lba, size_t count, const void *buffer) {
+        auto err = store->writeBlocks(lba, count, buffer);
+        pos = store->getPos();
+        return err;
+    }
+
+    StoreError discard(size_t lba, size_t count) {
+        discards.push_back({ lba, count });
+        return store->discard(lba, count);
+    }
+
+    using Store::read;
+    using Store::write;
+
+    size_t discarded() const {
+        size_t total = 0;
+        for (auto &d : discards)
+            total += d.second;
+        return total;
+    }
+
+    DiscardLog(Store *store_)
+        : Store(store_->getBlockSize(), store_->getBlockCount(), store_->isWritable()),
+          store(store_) { }
+};
+
+/// Load an image file into memory.
+static std::vector<uint8_t> loadImage(const char *path) {
+    std::vector<uint8_t> image;
+
+    FILE *fh = fopen(path, "rb");
+    if (!fh)
+        return image;
+
+    uint8_t buffer[64 * 1024];
+    size_t  n;
+    while ((n = fread(buffer, 1, sizeof(buffer), fh)) > 0)
+        image.insert(image.end(), buffer, buffer + n);
+
+    fclose(fh);
+    return image;
+}
+
+TEST(fat_truncate) {
+    FsError err;
+
+    auto image = loadImage(MUTEST_FAT16FILE);
+    ASSERT(image.size(), "could not load " MUTEST_FAT16FILE);
+
+    auto sparse = SparseMemStore(image.size(), 512, 4096);
+    sparse.writeBlocks(0, sparse.getBlockCount(), image.data());
+
+    DiscardLog log(&sparse);
+    FatFs fs(&log);
+
+    FsNode file = fs.get("/write.txt", err);
+    ASSERT(!err, "get() of file '/write.txt' failed (err=%d)", err);
+
+    file.seek(6);
+    err = file.truncate();
+    ASSERT(!err, "truncate failed (err=%d)", err);
+
+    // Grow the file by 256 KiB.
+    std::vector<uint8_t> data(256 * 1024);
+    for (auto &b : data)
+        b = (uint8_t)(rand() | 1);
+
+    size_t before  = sparse.getPageCount();
+    size_t written = file.write(data.data(), data.size(), err);
+    ASSERT(!err && written == data.size(), "write failed (err=%d)", err);
+    ASSERT(sparse.getPageCount() > before + data.size() / 4096 - 2, "write should allocate pages (%lu -> %lu)", before, sparse.getPageCount());
+
+    log.discards.clear();
+
+    file.seek(6);
+    err = file.truncate();
+    ASSERT(!err, "truncate failed (err=%d)", err);
+    ASSERT(file.getSize() == 6, "truncated file should be of size 6, is %lu", file.getSize());
+
+    LOG("Truncate issued %lu discards for %lu blocks", log.discards.size(), log.discarded());
+
+    // All but the first cluster were freed, in a few contiguous runs.
+    ASSERT(log.discards.size() && log.discards.size() <= 4, "discards should be batched (%lu)", log.discards.size());
+    ASSERT(log.discarded() >= data.size() / 512, "freed clusters should be discarded (%lu blocks)", log.discarded());
+    ASSERT(sparse.getPageCount() <= before + 1, "discards should free pages (%lu > %lu)", sparse.getPageCount(), before + 1);
+
+    uint8_t buffer[16] = { };
+    file.rewind();
+    size_t n = file.read(buffer, sizeof(buffer), err);
+    ASSERT(n == 6 && !memcmp(buffer, "START\n", 6), "file contents should be kept");
+
+    // The freed space can be used again.
+    file.seek(6);
+    written = file.write(data.data(), data.size(), err);
+    ASSERT(!err && written == data.size(), "write after truncate failed (err=%d)", err);
+
+    std::vector<uint8_t> check(data.size());
+    file.seek(6);
+    n = file.read(check.data(), check.size(), err);
+    ASSERT(n == check.size() && check == data, "rewritten data differs");
+
+    // Another file is unaffected.
+    FsNode other = fs.get("/test.txt", err);
+    ASSERT(!err, "get() of file '/test.txt' failed (err=%d)", err);
+    n = other.read(buffer, sizeof(buffer), err);
+    ASSERT(n, "read of other file failed (err=%d)", err);
+}
+
+TEST(sparse) {
+    StoreError err;
+
+    auto sparse = SparseMemStore(1024 * 1024, 512, 4096);
+
+    std::vector<uint8_t> data(64 * 512);
+    for (auto &b : data)
+        b = 0x5a;
+
+    err = sparse.writeBlocks(0, 64, data.data());
+    ASSERT(err == STORE_ERR_OK, "write (err=%d)", err);
+    ASSERT(sparse.getPageCount() == 8, "expected 8 pages (%lu)", sparse.getPageCount());
+
+    // Whole pages are freed, partial pages are zeroed.
+    err = sparse.discard(4, 20);
+    ASSERT(err == STORE_ERR_OK, "discard (err=%d)", err);
+    ASSERT(sparse.getPageCount() == 6, "expected 6 pages (%lu)", sparse.getPageCount());
+
+    uint8_t block[512];
+    for (size_t lba = 0; lba < 64; lba++) {
+        sparse.read(lba, block);
+        bool discarded = lba >= 4 && lba < 24;
+        ASSERT(block[0] == (discarded ? 0 : 0x5a), "block %lu has wrong contents", lba);
+    }
+
+    // A page that becomes all zero is freed.
+    err = sparse.discard(0, 4);
+    ASSERT(err == STORE_ERR_OK, "discard (err=%d)", err);
+    ASSERT(sparse.getPageCount() == 5, "expected 5 pages (%lu)", sparse.getPageCount());
+
+    ASSERT(sparse.discard(2040, 10) == STORE_ERR_OUT_OF_BOUNDS, "discard past end should fail");
+}
+
+TEST(decorators) {
+    StoreError err;
+
+    auto sparse = SparseMemStore(1024 * 1024, 512, 4096);
+    DiscardLog log(&sparse);
+
+    // Dirty cached blocks in a discarded range are not written back.
+    std::vector<uint8_t> cacheMem(CachedStore::getMemorySize(512, 16));
+    CachedStore cached(&log, cacheMem.data(), cacheMem.size());
+    cached.setWritePolicy(CachedStore::WritePolicy::WRITE_BACK);
+
+    uint8_t block[4096];
+    memset(block, 0x77, sizeof(block));
+    for (size_t lba = 0; lba < 8; lba++)
+        cached.write(lba, block);
+
+    err = cached.discard(2, 4);
+    ASSERT(err == STORE_ERR_OK, "discard (err=%d)", err);
+    ASSERT(cached.getDirtyBytes() == 4 * 512, "discarded blocks should no longer be dirty (%lu)", cached.getDirtyBytes());
+    ASSERT(log.discards.size() == 1 && log.discards[0] == std::make_pair((size_t)2, (size_t)4), "discard not passed on");
+
+    cached.flush();
+    ASSERT(cached.getStats().writebacks == 4, "expected 4 writebacks (%lu)", cached.getStats().writebacks);
+
+    // Scaling down only discards whole underlying blocks.
+    log.discards.clear();
+    ScaleStore up(&log, 4096);
+    uint8_t scaleBuffer[4096];
+    ScaleStore down(&up, 512, scaleBuffer);
+    ASSERT(down.getBlockCount() == 2048, "bad block count (%lu)", down.getBlockCount());
+
+    err = down.discard(4, 20);
+    ASSERT(err == STORE_ERR_OK, "discard (err=%d)", err);
+    ASSERT(log.discards.size() == 1 && log.discards[0] == std::make_pair((size_t)8, (size_t)16),
+           "expected 4K blocks 1 and 2 to be discarded, as 512-byte blocks 8 to 23");
+}
+
+TEST(stripe) {
+    StoreError err;
+
+    std::vector<SparseMemStore> sparse;
+    std::vector<DiscardLog>     logs;
+    sparse.reserve(3);
+    logs.reserve(3);
+
+    Store *members[3];
+    for (size_t i = 0; i < 3; i++) {
+        sparse.emplace_back(64 * 1024);
+        logs.emplace_back(&sparse.back());
+        members[i] = &logs.back();
+    }
+
+    StripeStore striped(members, 3, 4);
+    ASSERT(striped.getBlockCount() == 3 * 128, "bad block count (%lu)", striped.getBlockCount());
+
+    // Check each member's discarded range against the block mapping.
+    for (size_t lba : { 0, 1, 5, 11, 12, 13, 50 }) {
+        for (size_t count : { 1, 3, 4, 11, 12, 30 }) {
+            for (auto &log : logs)
+                log.discards.clear();
+
+            err = striped.discard(lba, count);
+            ASSERT(err == STORE_ERR_OK, "discard (err=%d)", err);
+
+            for (size_t m = 0; m < 3; m++) {
+                size_t first = ~(size_t)0;
+                size_t last  = 0;
+                size_t total = 0;
+                for (size_t b = lba; b < lba + count; b++) {
+                    size_t stripe = b / 4;
+                    if (stripe % 3 != m)
+                        continue;
+                    size_t memberLba = stripe / 3 * 4 + b % 4;
+                    first = std::min(first, memberLba);
+                    last  = std::max(last, memberLba);
+                    total++;
+                }
+
+                auto &d = logs[m].discards;
+                if (!total) {
+                    ASSERT(d.empty(), "member %lu should not be discarded (%lu+%lu)", m, lba, count);
+                } else {
+                    ASSERT(d.size() == 1 && d[0].first == first && d[0].second == last - first + 1 && total == d[0].second,
+                           "member %lu discarded wrong range for %lu+%lu", m, lba, count);
+                }
+            }
+        }
+    }
+}
+
+TEST(dedup) {
+    StoreError err;
+
+    auto chunks = SparseMemStore(64 * 512, 512, 512);
+    DiscardLog log(&chunks);
+    auto dedup = DedupStore(&log, 1024);
+
+    uint8_t block[512];
+    for (size_t lba = 0; lba < 32; lba++) {
+        memset(block, (int)(lba % 8 + 1), sizeof(block));
+        dedup.write(lba, block);
+    }
+    ASSERT(dedup.getUsedChunkCount() == 8, "expected 8 chunks (%lu)", dedup.getUsedChunkCount());
+    ASSERT(chunks.getPageCount() == 8, "expected 8 chunk pages (%lu)", chunks.getPageCount());
+
+    // Chunks still referenced elsewhere are kept.
+    err = dedup.discard(0, 8);
+    ASSERT(err == STORE_ERR_OK, "discard (err=%d)", err);
+    ASSERT(dedup.getUsedChunkCount() == 8, "shared chunks should be kept (%lu)", dedup.getUsedChunkCount());
+    ASSERT(log.discards.empty(), "shared chunks should not be discarded");
+
+    err = dedup.discard(8, 24);
+    ASSERT(err == STORE_ERR_OK, "discard (err=%d)", err);
+    ASSERT(dedup.getUsedChunkCount() == 0, "all chunks should be freed (%lu)", dedup.getUsedChunkCount());
+    ASSERT(log.discarded() == 8, "freed chunks should be discarded (%lu)", log.discarded());
+    ASSERT(chunks.getPageCount() == 0, "chunk store should be empty (%lu)", chunks.getPageCount());
+
+    dedup.read(12, block);
+    ASSERT(!block[0] && !block[511], "discarded blocks should read as zeroes");
+}
+
+TEST(checksum) {
+    StoreError err;
+
+    auto sparse = SparseMemStore(256 * 512);
+    std::vector<uint32_t> sums(256);
+    ChecksumStore checked(&sparse, sums.data(), sums.size());
+
+    uint8_t block[512];
+    memset(block, 0x42, sizeof(block));
+    for (size_t lba = 0; lba < 16; lba++)
+        checked.write(lba, block);
+
+    err = checked.discard(4, 8);
+    ASSERT(err == STORE_ERR_OK, "discard (err=%d)", err);
+
+    std::vector<uint8_t> buffer(16 * 512);
+    err = checked.readBlocks(0, 16, buffer.data());
+    ASSERT(err == STORE_ERR_OK, "discarded blocks should still verify (err=%d)", err);
+}
+
+TEST(posix_hole) {
+    StoreError err;
+
+    const char *path = "./_test_discard.bin";
+    const size_t size = 4 * 1024 * 1024;
+
+    FILE *fh = fopen(path, "wb");
+    ASSERT(fh, "could not create %s", path);
+    std::vector<uint8_t> data(size, 0xcc);
+    fwrite(data.data(), 1, size, fh);
+    fclose(fh);
+
+    struct stat st;
+    stat(path, &st);
+    long before = (long)st.st_blocks;
+
+    {
+        PosixFileStore file(path, true);
+        ASSERT(file.getBlockCount() == size / 512, "bad block count (%lu)", file.getBlockCount());
+
+        err = file.discard(1024, 4096);
+        ASSERT(err == STORE_ERR_OK, "discard (err=%d)", err);
+
+        uint8_t block[512];
+        file.read(1023, block);
+        ASSERT(block[0] == 0xcc, "blocks before the range should be kept");
+        file.read(1024 + 4096, block);
+        ASSERT(block[0] == 0xcc, "blocks after the range should be kept");
+
+        ASSERT(PosixFileStore(path, false).discard(0, 1) == STORE_ERR_NOT_WRITABLE,
+               "discard on a read-only file should fail");
+    }
+
+    stat(path, &st);
+    LOG("File blocks before discard: %ld, after: %ld", before, (long)st.st_blocks);
+    if (st.st_blocks < before) {
+        ASSERT(st.st_size == (off_t)size, "discard should not change the file size");
+    } else {
+        LOG("Filesystem does not support hole punching");
+    }
+
+    unlink(path);
+}
+
+TEST_MAIN() {
+    TEST_START();
+
+    RUN_TEST(fat_truncate);
+    RUN_TEST(sparse);
+    RUN_TEST(decorators);
+    RUN_TEST(stripe);
+    RUN_TEST(dedup);
+    RUN_TEST(checksum);
+    RUN_TEST(posix_hole);
+
+    TEST_END();
+}
@@ -0,0 +1,150 @@
+/**
+ * \file
+ * \brief     Tests for SimulatedFlashStore.
+ * \author    Chris Smeele
+ * \copyright Copyright (c) 2016, Chris Smeele
+ * \license   Boost, see LICENSE
+ */
+#include "test.hh"
+#include "store.hh"
+
+#include <memstore.hh>
+#include <simulatedflashstore.hh>
+
+static uint8_t data[512 * 64];
+
+/// Timing with round numbers: 1 us per block over the bus, 8-block erase units.
+static SimulatedFlashStore::Timing testTiming() {
+    SimulatedFlashStore::Timing timing;
+    timing.readCommand   = 1000;
+    timing.writeCommand  = 2000;
+    timing.busRate       = 512000000;
+    timing.flashReadRate = 1024000000;
+    timing.programRate   = 512000000;
+    timing.erase         = 10000;
+    timing.eraseUnitSize = 8 * 512;
+    timing.bufferUnits   = 2;
+    return timing;
+}
+
+// Program cost of a unit, and the extra cost of reading n blocks back for read-modify-write.
+static const uint64_t PROGRAM = 10000 + 8 * 1000;
+static uint64_t rmw(size_t written) { return PROGRAM + (8 - written) * 500; }
+
+TEST(timing) {
+    MemStore mem(data, sizeof(data));
+    SimulatedFlashStore flash(&mem, testTiming());
+    ASSERT(flash.getBlockCount() == 64, "bad block count (%lu)", flash.getBlockCount());
+
+    uint8_t buffer[512 * 8] = { };
+
+    ASSERT(!flash.read(0, buffer), "read failed");
+    ASSERT(flash.getLastLatency() == 2000, "bad read latency (%lu)", flash.getLastLatency());
+
+    ASSERT(!flash.readBlocks(0, 4, buffer), "readBlocks failed");
+    ASSERT(flash.getLastLatency() == 5000, "multi-block read should pay one command (%lu)",
+           flash.getLastLatency());
+
+    // A complete erase unit is programmed immediately.
+    ASSERT(!flash.writeBlocks(8, 8, buffer), "writeBlocks failed");
+    ASSERT(flash.getLastLatency() == 2000 + 8000 + PROGRAM,
+           "bad full unit write latency (%lu)", flash.getLastLatency());
+    ASSERT(flash.getStats().unitPrograms == 1, "full unit should be programmed");
+
+    ASSERT(!flash.flush(), "flush failed");
+    ASSERT(flash.getLastLatency() == 0, "flush with an empty buffer should be free");
+
+    // A single block is buffered, and read-modify-written on flush.
+    ASSERT(!flash.write(16, buffer), "write failed");
+    ASSERT(flash.getLastLatency() == 3000, "bad write latency (%lu)", flash.getLastLatency());
+    ASSERT(!flash.flush(), "flush failed");
+    ASSERT(flash.getLastLatency() == rmw(1), "bad flush latency (%lu)", flash.getLastLatency());
+    ASSERT(flash.getStats().unitRmws == 1, "partial unit should be read-modify-written");
+
+    auto &stats = flash.getStats();
+    ASSERT(stats.reads.count == 2 && stats.writes.count == 2 && stats.flushes.count == 2,
+           "bad operation counts");
+    ASSERT(stats.blocksRead == 5 && stats.blocksWritten == 9, "bad block counts");
+    ASSERT(stats.writes.maxTime == 2000 + 8000 + PROGRAM, "bad max write time");
+    ASSERT(flash.getTime() == stats.reads.time + stats.writes.time + stats.flushes.time,
+           "clock should be the sum of operation times");
+
+    flash.resetStats();
+    ASSERT(!flash.getStats().writes.count, "stats not reset");
+    ASSERT(flash.getTime(), "reset should keep the clock");
+}
+
+TEST(write_buffer) {
+    MemStore mem(data, sizeof(data));
+    SimulatedFlashStore flash(&mem, testTiming());
+
+    uint8_t block[512] = { };
+
+    // Rewriting a block does not make a unit complete.
+    for (size_t i = 0; i < 8; i++)
+        ASSERT(!flash.write(0, block), "write failed");
+    ASSERT(!flash.write(1, block), "write failed");
+    ASSERT(!flash.write(8, block), "write failed");
+    ASSERT(!flash.getStats().unitRmws, "two units should fit in the buffer");
+
+    // A third unit evicts the least recently written one, and stalls the write.
+    ASSERT(!flash.write(17, block), "write failed");
+    ASSERT(flash.getLastLatency() == 3000 + rmw(2), "eviction should stall the write (%lu)",
+           flash.getLastLatency());
+    ASSERT(flash.getStats().unitRmws == 1, "one unit should be evicted");
+
+    // Unit 1 is still open.
+    ASSERT(!flash.write(9, block), "write failed");
+    ASSERT(flash.getLastLatency() == 3000, "write to an open unit should not stall");
+
+    // Completing an open unit programs it without reading back.
+    for (size_t i = 10; i < 16; i++)
+        ASSERT(!flash.write(i, block), "write failed");
+    ASSERT(flash.getStats().unitPrograms == 1, "completed unit should be programmed");
+    ASSERT(flash.getStats().unitRmws == 1, "completed unit should not be read-modify-written");
+
+    // Discarding a unit drops it from the buffer.
+    ASSERT(!flash.discard(16, 8), "discard failed");
+    ASSERT(!flash.flush(), "flush failed");
+    ASSERT(flash.getLastLatency() == 0, "discarded unit should not be programmed (%lu)",
+           flash.getLastLatency());
+}
+
+TEST(invalid) {
+    MemStore mem(data, sizeof(data));
+
+    auto timing = testTiming();
+    timing.eraseUnitSize = 700;
+    ASSERT(!SimulatedFlashStore(&mem, timing).getBlockCount(),
+           "erase unit must be a multiple of the block size");
+
+    timing = testTiming();
+    timing.bufferUnits = 0;
+    ASSERT(!SimulatedFlashStore(&mem, timing).getBlockCount(),
+           "write buffer must hold at least one unit");
+}
+
+TEST_MAIN() {
+    TEST_START();
+
+    data[510] = 0x55;
+    data[511] = 0xaa;
+
+    MemStore mem(data, sizeof(data));
+    MemStore roMem((const void*)data, sizeof(data));
+
+    TEST_STORE_WITH(SimulatedFlashStore(&mem), create);
+    TEST_STORE_WITH(SimulatedFlashStore(&mem), seek  );
+    TEST_STORE_WITH(SimulatedFlashStore(&mem), read  );
+    TEST_STORE_WITH(SimulatedFlashStore(&mem), write );
+    TEST_STORE_WITH(SimulatedFlashStore(&mem), read_blocks );
+    TEST_STORE_WITH(SimulatedFlashStore(&mem), write_blocks);
+    TEST_STORE_WITH(SimulatedFlashStore(&mem), flush );
+    TEST_STORE_WITH(SimulatedFlashStore(&roMem), write_ro);
+
+    RUN_TEST(timing);
+    RUN_TEST(write_buffer);
+    RUN_TEST(invalid);
+
+    TEST_END();
+}
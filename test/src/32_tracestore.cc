@@ -0,0 +1,143 @@
+/**
+ * \file
+ * \brief     Tests for TraceStore and TraceReader.
+ * \author    Chris Smeele
+ * \copyright Copyright (c) 2016, Chris Smeele
+ * \license   Boost, see LICENSE
+ */
+#include "test.hh"
+#include "store.hh"
+
+#include <memstore.hh>
+#include <tracestore.hh>
+#include <sys/stat.h>
+
+static const char *TRACE = "./_test_trace.bin";
+
+static uint8_t data[512 * 64];
+
+TEST(record) {
+    StoreError err;
+    uint8_t    buffer[512 * 4] = { };
+
+    {
+        MemStore   mem(data, sizeof(data));
+        TraceStore trace(&mem, TRACE);
+        ASSERT(trace.getBlockCount() == 64, "bad block count (%lu)", trace.getBlockCount());
+
+        trace.seek(3);
+        trace.read(buffer);
+        trace.writeBlocks(10, 4, buffer);
+        trace.readBlocks(0, 2, buffer);
+
+        err = trace.readBlocks(62, 4, buffer);
+        ASSERT(err == STORE_ERR_OUT_OF_BOUNDS, "out of bounds read should fail (err=%d)", err);
+
+        trace.discard(20, 2);
+        trace.flush();
+        trace.write(40, buffer);
+
+        ASSERT(trace.getRecordCount() == 9, "bad record count (%lu)", trace.getRecordCount());
+        ASSERT(trace.isTracing(), "trace should be recording");
+    }
+
+    TraceReader reader(TRACE);
+    ASSERT(reader.isValid(), "could not open trace");
+    ASSERT(reader.getBlockSize() == 512 && reader.getBlockCount() == 64, "bad trace header");
+
+    const struct {
+        TraceOp    op;
+        size_t     lba;
+        size_t     count;
+        StoreError err;
+    } expected[] = {
+        { TraceOp::SEEK,     3, 0, STORE_ERR_OK },
+        { TraceOp::READ,     3, 1, STORE_ERR_OK },
+        { TraceOp::WRITE,   10, 4, STORE_ERR_OK },
+        { TraceOp::READ,     0, 2, STORE_ERR_OK },
+        { TraceOp::READ,    62, 4, STORE_ERR_OUT_OF_BOUNDS },
+        { TraceOp::DISCARD, 20, 2, STORE_ERR_OK },
+        { TraceOp::FLUSH,    0, 0, STORE_ERR_OK },
+        { TraceOp::SEEK,    40, 0, STORE_ERR_OK },
+        { TraceOp::WRITE,   40, 1, STORE_ERR_OK },
+    };
+
+    TraceRecord rec;
+    uint64_t    last = 0;
+
+    for (size_t i = 0; i < sizeof(expected) / sizeof(*expected); i++) {
+        ASSERT(reader.next(rec), "trace ended at record %lu", i);
+        ASSERT(rec.op == expected[i].op && rec.lba == expected[i].lba
+               && rec.count == expected[i].count && rec.err == expected[i].err,
+               "record %lu: op %d lba %lu count %lu err %d", i, (int)rec.op, rec.lba, rec.count, rec.err);
+        ASSERT(rec.time >= last, "record %lu: time went backwards", i);
+        last = rec.time;
+    }
+    ASSERT(!reader.next(rec), "trace should end after the last record");
+}
+
+TEST(compact) {
+    uint8_t block[512];
+
+    {
+        MemStore   mem(data, sizeof(data));
+        TraceStore trace(&mem, TRACE);
+
+        for (size_t pass = 0; pass < 100; pass++) {
+            for (size_t lba = 0; lba < 64; lba++)
+                trace.readBlocks(lba, 1, block);
+        }
+    }
+
+    struct stat st;
+    ASSERT(!stat(TRACE, &st), "trace not written");
+    LOG("6400 sequential reads: %ld bytes", (long)st.st_size);
+    ASSERT(st.st_size < 6400 * 8, "sequential reads should take a few bytes each");
+
+    TraceReader reader(TRACE);
+    TraceRecord rec;
+    size_t      count = 0;
+    while (reader.next(rec)) {
+        ASSERT(rec.op == TraceOp::READ && rec.lba == count % 64 && rec.count == 1,
+               "record %lu: op %d lba %lu count %lu", count, (int)rec.op, rec.lba, rec.count);
+        count++;
+    }
+    ASSERT(count == 6400, "bad record count (%lu)", count);
+}
+
+TEST(invalid) {
+    MemStore mem(data, sizeof(data));
+
+    ASSERT(!TraceStore(&mem, "./nonexistent/trace.bin").getBlockCount(),
+           "unwritable trace should result in a store without blocks");
+
+    ASSERT(!TraceReader(MUTEST_FAT16FILE).isValid(), "non-trace file should be rejected");
+    ASSERT(!TraceReader("./nonexistent/trace.bin").isValid(), "missing trace should be rejected");
+}
+
+TEST_MAIN() {
+    TEST_START();
+
+    data[510] = 0x55;
+    data[511] = 0xaa;
+
+    MemStore mem(data, sizeof(data));
+    MemStore roMem((const void*)data, sizeof(data));
+
+    TEST_STORE_WITH(TraceStore(&mem, TRACE), create);
+    TEST_STORE_WITH(TraceStore(&mem, TRACE), seek  );
+    TEST_STORE_WITH(TraceStore(&mem, TRACE), read  );
+    TEST_STORE_WITH(TraceStore(&mem, TRACE), write );
+    TEST_STORE_WITH(TraceStore(&mem, TRACE), read_blocks );
+    TEST_STORE_WITH(TraceStore(&mem, TRACE), write_blocks);
+    TEST_STORE_WITH(TraceStore(&mem, TRACE), flush );
+    TEST_STORE_WITH(TraceStore(&roMem, TRACE), write_ro);
+
+    RUN_TEST(record);
+    RUN_TEST(compact);
+    RUN_TEST(invalid);
+
+    remove(TRACE);
+
+    TEST_END();
+}
@@ -0,0 +1,92 @@
+/**
+ * \file
+ * \brief     Tests for AsyncStore providers.
+ * \author    Chris Smeele
+ * \copyright Copyright (c) 2016, Chris Smeele
+ * \license   Boost, see LICENSE
+ *
+ * These tests expect `store` to also implement AsyncStore.
+ */
+#pragma once
+
+#include "store.hh"
+#include <asyncstore.hh>
+
+TEST(async_io) {
+    ASSERT(store, "store was not created");
+    AsyncStore *async = dynamic_cast<AsyncStore*>(store);
+    StoreError err;
+
+    const size_t requests = 32;
+    const size_t start    = store->getBlockCount() - requests * 2;
+
+    static uint8_t buffer1[requests][512 * 2];
+    static uint8_t buffer2[requests][512 * 2];
+    bool seen[requests] = { };
+
+    for (size_t i = 0; i < requests; i++) {
+        for (size_t j = 0; j < sizeof(buffer1[i]); j++)
+            buffer1[i][j] = rand();
+
+        err = async->submitWrite(start + i * 2, 2, buffer1[i], &buffer1[i]);
+        ASSERT(err == STORE_ERR_OK, "submit write (err=%d)", err);
+    }
+
+    AsyncStore::Completion completions[8];
+    size_t completed = 0;
+    while (completed < requests) {
+        size_t n = async->poll(completions, 8, 1);
+        ASSERT(n > 0, "no completions while requests are outstanding");
+
+        for (size_t i = 0; i < n; i++) {
+            ASSERT(completions[i].err == STORE_ERR_OK, "write failed (err=%d)", completions[i].err);
+            size_t index = (uint8_t(*)[512 * 2])completions[i].cookie - buffer1;
+            ASSERT(index < requests && !seen[index], "bad cookie");
+            seen[index] = true;
+        }
+        completed += n;
+    }
+    ASSERT(async->getOutstanding() == 0, "requests outstanding after polling all completions");
+    ASSERT(async->poll(completions, 8, 1) == 0, "completion returned without outstanding requests");
+
+    for (size_t i = 0; i < requests; i++) {
+        err = async->submitRead(start + i * 2, 2, buffer2[i], &buffer2[i]);
+        ASSERT(err == STORE_ERR_OK, "submit read (err=%d)", err);
+    }
+
+    // Synchronous operations can be mixed with asynchronous ones.
+    uint8_t buffer[512];
+    err = store->read(start, buffer);
+    ASSERT(err == STORE_ERR_OK, "read block (err=%d)", err);
+    ASSERT(!memcmp(buffer, buffer1[0], sizeof(buffer)), "synchronous read differs");
+
+    // flush() waits for outstanding requests.
+    err = store->flush();
+    ASSERT(err == STORE_ERR_OK, "flush (err=%d)", err);
+    ASSERT(async->getOutstanding() == requests, "expected %lu outstanding requests, got %lu",
+           requests, async->getOutstanding());
+
+    completed = 0;
+    while (size_t n = async->poll(completions, 8)) {
+        for (size_t i = 0; i < n; i++)
+            ASSERT(completions[i].err == STORE_ERR_OK, "read failed (err=%d)", completions[i].err);
+        completed += n;
+    }
+    ASSERT(completed == requests, "expected %lu completions, got %lu", requests, completed);
+
+    ASSERT(!memcmp(buffer1, buffer2, sizeof(buffer1)), "asynchronous reads differ from writes");
+
+    err = async->submitRead(store->getBlockCount() - 1, 2, buffer2[0], nullptr);
+    ASSERT(err == STORE_ERR_OUT_OF_BOUNDS, "submit read past end should fail (err=%d)", err);
+}
+
+TEST(async_write_ro) {
+    ASSERT(store, "store was not created");
+    AsyncStore *async = dynamic_cast<AsyncStore*>(store);
+
+    uint8_t buffer[512] = { };
+
+    StoreError err = async->submitWrite(0, 1, buffer, nullptr);
+    ASSERT(err == STORE_ERR_NOT_WRITABLE, "write to read-only medium should fail (err=%d)", err);
+    ASSERT(async->getOutstanding() == 0, "failed submission is outstanding");
+}
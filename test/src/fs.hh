@@ -224,6 +224,41 @@ TEST(large_file_read) {
     }
 }
 
+TEST(large_file_read_bulk) {
+    FsError err;
+    FILE *fileRef = fopen("testfs_large/rtdir100/huge.txt", "r");
+    ASSERT(fileRef, "fopen() failed: %s", strerror(errno));
+    FsNode fileMu = fs->get("/rtdir100/huge.txt", err);
+    ASSERT(!err, "get() of file '/rtdir100/huge.txt' failed (err=%d)", err);
+
+    // Start unaligned, then continue with reads spanning multiple sectors.
+    const size_t sizes[] = { 100, 1500, 4096, 65536 };
+    static char bufferMu[65536];
+    static char bufferRef[65536];
+
+    for (size_t atATime : sizes) {
+        size_t bytesReadRef = fread(bufferRef, 1, atATime, fileRef);
+        size_t bytesReadMu  = fileMu.read(bufferMu, atATime, err);
+
+        ASSERT(bytesReadRef == bytesReadMu,
+               "fread and FsNode.read() didn't return the same amount of bytes (%lu vs %lu)",
+               bytesReadRef, bytesReadMu);
+
+        ASSERT(!memcmp(bufferRef, bufferMu, bytesReadRef),
+               "read bytes from stdio and Mu are unequal");
+
+        if (err == FS_EOF) {
+            ASSERT(feof(fileRef), "unexpected EOF on read()");
+            break;
+        } else {
+            ASSERT(!err, "read() failed (err=%d)", err);
+        }
+    }
+    ASSERT(err == FS_EOF, "expected EOF on read(), didn't get it");
+
+    fclose(fileRef);
+}
+
 TEST(file_write) {
     FsError err;
     FsNode file = fs->get("/write.txt", err);
@@ -120,3 +120,147 @@ TEST(write_ro) {
            "pos should be %lu (unchanged) after failed write to read-only medium (pos=%lu)",
            store->getBlockCount()-1, store->getPos());
 }
+
+TEST(read_blocks) {
+    ASSERT(store, "store was not created");
+    StoreError err;
+
+    ASSERT(store->getBlockSize() >=  512, "block size too small");
+    ASSERT(store->getBlockSize() <= 4096, "can't test, block size too large");
+    ASSERT(store->getBlockCount() >= 4, "can't test, medium too small");
+
+    size_t bs = store->getBlockSize();
+    uint8_t buffer1[4096 * 4];
+    uint8_t buffer2[4096 * 4] = { };
+
+    for (size_t i = 0; i < 4; i++) {
+        err = store->read(i, buffer1 + i * bs);
+        ASSERT(err == STORE_ERR_OK, "read block %lu (err=%d)", i, err);
+    }
+
+    err = store->readBlocks(0, 4, buffer2);
+    ASSERT(err == STORE_ERR_OK, "read blocks (err=%d)", err);
+    ASSERT(store->getPos() == 4, "pos should be 4 after reading 4 blocks (pos=%lu)", store->getPos());
+
+    ASSERT(memcmp(buffer1, buffer2, 4 * bs) == 0,
+           "multi-block read differs from single block reads");
+
+    err = store->readBlocks(store->getBlockCount() - 2, 4, buffer2);
+    ASSERT(err == STORE_ERR_OUT_OF_BOUNDS, "read blocks past end should fail (err=%d)", err);
+}
+
+TEST(write_blocks) {
+    ASSERT(store, "store was not created");
+    StoreError err;
+
+    ASSERT(store->getBlockSize() >=  512, "block size too small");
+    ASSERT(store->getBlockSize() <= 4096, "can't test, block size too large");
+    ASSERT(store->getBlockCount() >= 4, "can't test, medium too small");
+
+    size_t bs    = store->getBlockSize();
+    size_t start = store->getBlockCount() - 3;
+    uint8_t buffer1[4096 * 3];
+    uint8_t buffer2[4096 * 3] = { };
+
+    for (size_t i = 0; i < 3 * bs; i++)
+        buffer1[i] = rand();
+
+    err = store->writeBlocks(start, 3, buffer1);
+    ASSERT(err == STORE_ERR_OK, "write blocks (err=%d)", err);
+    ASSERT(store->getPos() == store->getBlockCount(),
+           "pos should be %lu after writing last blocks (pos=%lu)",
+           store->getBlockCount(), store->getPos());
+
+    for (size_t i = 0; i < 3; i++) {
+        err = store->read(start + i, buffer2 + i * bs);
+        ASSERT(err == STORE_ERR_OK, "read block %lu (err=%d)", start + i, err);
+    }
+
+    ASSERT(memcmp(buffer1, buffer2, 3 * bs) == 0,
+           "single block reads differ from multi-block write");
+
+    err = store->writeBlocks(start, 4, buffer1);
+    ASSERT(err == STORE_ERR_OUT_OF_BOUNDS, "write blocks past end should fail (err=%d)", err);
+}
+
+TEST(flush) {
+    ASSERT(store, "store was not created");
+    StoreError err;
+
+    ASSERT(store->getBlockSize() <= 4096, "can't test, block size too large");
+
+    uint8_t buffer1[4096];
+    uint8_t buffer2[4096] = { };
+
+    for (size_t i = 0; i < store->getBlockSize(); i++)
+        buffer1[i] = rand();
+
+    err = store->write(store->getBlockCount()-1, buffer1);
+    ASSERT(err == STORE_ERR_OK, "write block (err=%d)", err);
+
+    err = store->flush();
+    ASSERT(err == STORE_ERR_OK, "flush (err=%d)", err);
+
+    err = store->read(store->getBlockCount()-1, buffer2);
+    ASSERT(err == STORE_ERR_OK, "read block (err=%d)", err);
+
+    ASSERT(memcmp(buffer1, buffer2, store->getBlockSize()) == 0,
+           "read block differs from written block after flush");
+}
+
+TEST(borrow) {
+    ASSERT(store, "store was not created");
+    StoreError err;
+
+    ASSERT(store->getBlockSize() <= 4096, "can't test, block size too large");
+    ASSERT(store->getBlockCount() >= 8, "can't test, medium too small");
+
+    size_t bs  = store->getBlockSize();
+    size_t lba = store->getBlockCount() - 4;
+    uint8_t buffer[4096 * 2];
+
+    const uint8_t *block = store->borrowBlock(lba, 2);
+    ASSERT(block, "borrow blocks");
+
+    err = store->readBlocks(lba, 2, buffer);
+    ASSERT(err == STORE_ERR_OK, "read blocks (err=%d)", err);
+    ASSERT(!memcmp(block, buffer, 2 * bs), "borrowed blocks differ from read blocks");
+
+    ASSERT(!store->borrowBlock(lba, 5), "borrow past end should fail");
+
+    uint8_t *writable = store->borrowBlockWritable(lba, 2);
+    if (!store->isWritable()) {
+        ASSERT(!writable, "writable borrow of read-only medium should fail");
+        return;
+    }
+    ASSERT(writable, "borrow blocks writable");
+
+    for (size_t i = 0; i < 2 * bs; i++)
+        writable[i] = (uint8_t)~writable[i];
+
+    err = store->commitBlock(lba, 2);
+    ASSERT(err == STORE_ERR_OK, "commit blocks (err=%d)", err);
+
+    uint8_t buffer2[4096 * 2];
+    err = store->readBlocks(lba, 2, buffer2);
+    ASSERT(err == STORE_ERR_OK, "read blocks (err=%d)", err);
+    for (size_t i = 0; i < 2 * bs; i++)
+        ASSERT(buffer2[i] == (uint8_t)~buffer[i], "committed modification not visible at byte %lu", i);
+    ASSERT(store->borrowBlock(lba)[0] == buffer2[0], "borrowed block does not reflect modification");
+}
+
+/// Borrow test for stores that only lend blocks that have been written.
+TEST(borrow_written) {
+    ASSERT(store, "store was not created");
+    ASSERT(store->isWritable(), "can't test, medium is read-only");
+    ASSERT(store->getBlockSize() <= 4096, "can't test, block size too large");
+    ASSERT(store->getBlockCount() >= 8, "can't test, medium too small");
+
+    uint8_t buffer[4096 * 2];
+    memset(buffer, 0x5a, sizeof(buffer));
+
+    StoreError err = store->writeBlocks(store->getBlockCount() - 4, 2, buffer);
+    ASSERT(err == STORE_ERR_OK, "write blocks (err=%d)", err);
+
+    TEST_NAME(borrow)(_progress, _result, _result_text);
+}
@@ -0,0 +1,118 @@
+/**
+ * \file
+ * \brief     Pack a disk image into a CompressedStore container.
+ * \author    Chris Smeele
+ * \copyright Copyright (c) 2016, Chris Smeele
+ * \license   Boost, see LICENSE
+ *
+ * Usage: mucompress [-b block-size] [-g group-blocks] [-c] <image> <container>
+ *
+ * The container is created or overwritten, and truncated to its final
+ * size. With -c, the container is read back and compared to the image.
+ */
+#include <compressedstore.hh>
+#include <filestore.hh>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+#include <vector>
+
+using namespace MuStore;
+
+static int usage(const char *name) {
+    fprintf(stderr, "usage: %s [-b block-size] [-g group-blocks] [-c] <image> <container>\n", name);
+    return 2;
+}
+
+/// Compare the container with the image.
+static bool check(Store &image, Store &container) {
+    CompressedStore compressed(&container);
+    if (compressed.getBlockCount() != image.getBlockCount())
+        return false;
+
+    size_t chunk = 1024;
+    std::vector<uint8_t> expected(chunk * image.getBlockSize());
+    std::vector<uint8_t> actual  (chunk * image.getBlockSize());
+
+    for (size_t lba = 0; lba < image.getBlockCount(); lba += chunk) {
+        size_t n = image.getBlockCount() - lba < chunk ? image.getBlockCount() - lba : chunk;
+
+        if (image.readBlocks(lba, n, expected.data())
+            || compressed.readBlocks(lba, n, actual.data())
+            || memcmp(expected.data(), actual.data(), n * image.getBlockSize()))
+            return false;
+    }
+
+    return true;
+}
+
+int main(int argc, char **argv) {
+    size_t blockSize   = 512;
+    size_t groupBlocks = 64;
+    bool   verify      = false;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "b:g:c")) != -1) {
+        switch (opt) {
+        case 'b': blockSize   = strtoul(optarg, nullptr, 0); break;
+        case 'g': groupBlocks = strtoul(optarg, nullptr, 0); break;
+        case 'c': verify      = true;                        break;
+        default:  return usage(argv[0]);
+        }
+    }
+    if (argc - optind != 2)
+        return usage(argv[0]);
+
+    const char *imagePath     = argv[optind];
+    const char *containerPath = argv[optind + 1];
+
+    FileStore image(imagePath, false, blockSize);
+    if (!image.getBlockCount()) {
+        fprintf(stderr, "%s: could not open image (or invalid block size)\n", imagePath);
+        return 1;
+    }
+
+    // Create the container at its maximum size, then shrink it after packing.
+    size_t maxBlocks = CompressedStore::getMaxContainerBlockCount(image.getBlockCount(), blockSize, groupBlocks);
+
+    FILE *fh = fopen(containerPath, "wb");
+    if (!fh || fclose(fh) || truncate(containerPath, (off_t)(maxBlocks * blockSize))) {
+        perror(containerPath);
+        return 1;
+    }
+
+    size_t used = 0;
+    {
+        FileStore container(containerPath, true, blockSize);
+
+        auto err = CompressedStore::pack(&image, &container, groupBlocks, &used);
+        if (err) {
+            fprintf(stderr, "%s: packing failed (err=%d)\n", containerPath, err);
+            return 1;
+        }
+    }
+
+    if (truncate(containerPath, (off_t)(used * blockSize))) {
+        perror(containerPath);
+        return 1;
+    }
+
+    printf("%s: %lu blocks -> %lu blocks (%.1f%%)\n",
+           containerPath,
+           image.getBlockCount(),
+           used,
+           100.0 * (double)used / (double)image.getBlockCount());
+
+    if (verify) {
+        FileStore container(containerPath, false, blockSize);
+        if (!check(image, container)) {
+            fprintf(stderr, "%s: verification failed\n", containerPath);
+            return 1;
+        }
+        printf("%s: verified\n", containerPath);
+    }
+
+    return 0;
+}
@@ -0,0 +1,116 @@
+/**
+ * \file
+ * \brief     Report how well disk images would deduplicate in a DedupStore.
+ * \author    Chris Smeele
+ * \copyright Copyright (c) 2016, Chris Smeele
+ * \license   Boost, see LICENSE
+ *
+ * Usage: mudedup [-b block-size] <image>...
+ *
+ * All images are deduplicated together, as if they were volumes
+ * sharing one chunk store. Blocks are compared by their hash128(), so
+ * the result is exact unless hashes collide.
+ */
+#include <filestore.hh>
+#include <hash128.hh>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+#include <unordered_set>
+#include <vector>
+
+using namespace MuStore;
+
+struct HashOf {
+    size_t operator()(const Hash128 &hash) const { return (size_t)hash.lo; }
+};
+
+static int usage(const char *name) {
+    fprintf(stderr, "usage: %s [-b block-size] <image>...\n", name);
+    return 2;
+}
+
+static bool isZero(const uint8_t *data, size_t size) {
+    return !data[0] && !memcmp(data, data + 1, size - 1);
+}
+
+static double mib(size_t blocks, size_t blockSize) {
+    return (double)blocks * (double)blockSize / (1024 * 1024);
+}
+
+int main(int argc, char **argv) {
+    size_t blockSize = 512;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "b:")) != -1) {
+        switch (opt) {
+        case 'b': blockSize = strtoul(optarg, nullptr, 0); break;
+        default:  return usage(argv[0]);
+        }
+    }
+    if (argc - optind < 1)
+        return usage(argv[0]);
+
+    std::unordered_set<Hash128, HashOf> unique;
+
+    size_t totalBlocks = 0;
+    size_t zeroBlocks  = 0;
+
+    size_t chunk = 1024;
+    std::vector<uint8_t> buffer(chunk * blockSize);
+
+    for (int i = optind; i < argc; i++) {
+        FileStore image(argv[i], false, blockSize);
+        if (!image.getBlockCount()) {
+            fprintf(stderr, "%s: could not open image (or invalid block size)\n", argv[i]);
+            return 1;
+        }
+
+        size_t before = unique.size();
+        size_t zeroes = 0;
+
+        for (size_t lba = 0; lba < image.getBlockCount(); lba += chunk) {
+            size_t n = image.getBlockCount() - lba < chunk ? image.getBlockCount() - lba : chunk;
+
+            if (image.readBlocks(lba, n, buffer.data())) {
+                fprintf(stderr, "%s: read error at block %lu\n", argv[i], lba);
+                return 1;
+            }
+
+            for (size_t j = 0; j < n; j++) {
+                const uint8_t *block = buffer.data() + j * blockSize;
+
+                if (isZero(block, blockSize))
+                    zeroes++;
+                else
+                    unique.insert(hash128(block, blockSize));
+            }
+        }
+
+        printf("%s: %lu blocks, %lu zero, %lu new unique\n",
+               argv[i], image.getBlockCount(), zeroes, unique.size() - before);
+
+        totalBlocks += image.getBlockCount();
+        zeroBlocks  += zeroes;
+    }
+
+    size_t stored = unique.size();
+    size_t data   = totalBlocks - zeroBlocks;
+
+    printf("\n");
+    printf("blocks:       %12lu (%.1f MiB)\n", totalBlocks, mib(totalBlocks, blockSize));
+    printf("zero blocks:  %12lu (%.1f MiB)\n", zeroBlocks,  mib(zeroBlocks,  blockSize));
+    printf("unique:       %12lu (%.1f MiB)\n", stored,      mib(stored,      blockSize));
+    printf("dedup ratio:  %12.2f (non-zero blocks / unique blocks)\n",
+           stored ? (double)data / (double)stored : 1.0);
+    printf("total ratio:  %12.2f (all blocks / unique blocks)\n",
+           stored ? (double)totalBlocks / (double)stored : (double)totalBlocks);
+
+    // DedupStore keeps 4 bytes per LBA and about 32 bytes per chunk in memory.
+    printf("map + index:  %12.1f MiB (DedupStore metadata, chunk store sized to fit)\n",
+           (double)(totalBlocks * 4 + stored * 32) / (1024 * 1024));
+
+    return 0;
+}
@@ -0,0 +1,242 @@
+/**
+ * \file
+ * \brief     Replay a TraceStore trace against a Store backend.
+ * \author    Chris Smeele
+ * \copyright Copyright (c) 2016, Chris Smeele
+ * \license   Boost, see LICENSE
+ *
+ * Usage: mureplay [-t] [-w] [-s backend] [-c cache-KiB] <trace> [image]
+ *
+ *   -t  replay at the original timing, instead of as fast as possible
+ *   -w  replay writes and discards (they modify the image!)
+ *   -s  backend for the image: file (default), posix, direct or mmap,
+ *       or mem to replay in memory
+ *   -c  put a write-back CachedStore of this size in front of the backend
+ *
+ * Without an image, or with `-s mem`, the trace is replayed against a
+ * SparseMemStore of the traced size, including writes. Written data is
+ * a fixed pattern, as traces hold no data. Reports throughput, and
+ * latency percentiles per operation next to those recorded in the trace.
+ */
+#include <cachedstore.hh>
+#include <directfilestore.hh>
+#include <filestore.hh>
+#include <mmapstore.hh>
+#include <posixfilestore.hh>
+#include <sparsememstore.hh>
+#include <tracestore.hh>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace MuStore;
+
+static const char *OP_NAMES[] = { "seek", "read", "write", "flush", "discard" };
+static const size_t OP_COUNT  = sizeof(OP_NAMES) / sizeof(*OP_NAMES);
+
+struct OpStats {
+    std::vector<uint64_t> latency; ///< Replayed, in nanoseconds.
+    std::vector<uint64_t> traced;  ///< Recorded in the trace, in nanoseconds.
+    size_t blocks  = 0;
+    size_t skipped = 0;
+};
+
+static int usage(const char *name) {
+    fprintf(stderr, "usage: %s [-t] [-w] [-s file|posix|direct|mmap|mem] [-c cache-KiB] <trace> [image]\n", name);
+    return 2;
+}
+
+static uint64_t nowNs() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/// Get a percentile of sorted values, in microseconds.
+static double percentile(const std::vector<uint64_t> &sorted, double p) {
+    if (sorted.empty())
+        return 0;
+
+    size_t i = (size_t)(p / 100 * (double)sorted.size());
+    return (double)sorted[std::min(i, sorted.size() - 1)] / 1000;
+}
+
+static std::unique_ptr<Store> openImage(const char *backend, const char *path,
+                                        bool writable, size_t blockSize) {
+    Store *store = nullptr;
+
+    if      (!strcmp(backend, "file"))   store = new FileStore     (path, writable, blockSize);
+    else if (!strcmp(backend, "posix"))  store = new PosixFileStore(path, writable, blockSize);
+    else if (!strcmp(backend, "direct")) store = new DirectFileStore(path, writable, blockSize);
+    else if (!strcmp(backend, "mmap"))   store = new MmapStore     (path, writable, blockSize);
+
+    return std::unique_ptr<Store>(store);
+}
+
+int main(int argc, char **argv) {
+    bool        realTime  = false;
+    bool        writes    = false;
+    const char *backend   = "file";
+    size_t      cacheSize = 0;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "tws:c:")) != -1) {
+        switch (opt) {
+        case 't': realTime  = true; break;
+        case 'w': writes    = true; break;
+        case 's': backend   = optarg; break;
+        case 'c': cacheSize = strtoul(optarg, nullptr, 0) * 1024; break;
+        default:  return usage(argv[0]);
+        }
+    }
+    if (argc - optind < 1 || argc - optind > 2)
+        return usage(argv[0]);
+
+    const char *tracePath = argv[optind];
+    const char *imagePath = argc - optind > 1 ? argv[optind + 1] : nullptr;
+
+    TraceReader trace(tracePath);
+    if (!trace.isValid()) {
+        fprintf(stderr, "%s: not a trace\n", tracePath);
+        return 1;
+    }
+
+    size_t blockSize = trace.getBlockSize();
+
+    std::unique_ptr<Store> image;
+    if (!imagePath || !strcmp(backend, "mem")) {
+        image.reset(new SparseMemStore(trace.getBlockCount() * blockSize, blockSize));
+        writes = true;
+    } else {
+        image = openImage(backend, imagePath, writes, blockSize);
+    }
+
+    if (!image || !image->getBlockCount()) {
+        fprintf(stderr, "%s: could not open image (or unknown backend '%s')\n",
+                imagePath ? imagePath : "memory", backend);
+        return 1;
+    }
+    if (image->getBlockCount() < trace.getBlockCount())
+        fprintf(stderr, "warning: image is smaller than the traced store (%lu < %lu blocks)\n",
+                image->getBlockCount(), trace.getBlockCount());
+
+    // Aligned for the direct I/O backend.
+    void *cacheMemory = nullptr;
+    std::unique_ptr<CachedStore> cache;
+    if (cacheSize) {
+        if (posix_memalign(&cacheMemory, 4096, cacheSize))
+            return 1;
+
+        cache.reset(new CachedStore(image.get(), cacheMemory, cacheSize));
+        cache->setWritePolicy(CachedStore::WritePolicy::WRITE_BACK);
+    }
+    Store *store = cache ? (Store*)cache.get() : image.get();
+
+    size_t capacity = 0;
+    void  *buffer   = nullptr;
+
+    OpStats stats[OP_COUNT];
+    size_t  errors       = 0;
+    size_t  tracedErrors = 0;
+    uint64_t tracedEnd   = 0;
+
+    TraceRecord rec;
+    uint64_t    start = nowNs();
+
+    while (trace.next(rec)) {
+        if (rec.count > capacity) {
+            free(buffer);
+            capacity = std::max(rec.count, (size_t)64);
+            if (posix_memalign(&buffer, 4096, capacity * blockSize))
+                return 1;
+            memset(buffer, 0x5a, capacity * blockSize);
+        }
+
+        if (realTime) {
+            uint64_t now = nowNs();
+            if (now - start < rec.time)
+                std::this_thread::sleep_for(std::chrono::nanoseconds(rec.time - (now - start)));
+        }
+
+        OpStats &op = stats[(size_t)rec.op];
+        bool    skip = !writes && (rec.op == TraceOp::WRITE || rec.op == TraceOp::DISCARD);
+
+        StoreError err   = STORE_ERR_OK;
+        uint64_t   begin = nowNs();
+
+        if (!skip) {
+            switch (rec.op) {
+            case TraceOp::SEEK:    err = store->seek(rec.lba);                             break;
+            case TraceOp::READ:    err = store->readBlocks (rec.lba, rec.count, buffer);  break;
+            case TraceOp::WRITE:   err = store->writeBlocks(rec.lba, rec.count, buffer);  break;
+            case TraceOp::FLUSH:   err = store->flush();                                   break;
+            case TraceOp::DISCARD: err = store->discard(rec.lba, rec.count);               break;
+            }
+        }
+
+        uint64_t end = nowNs();
+
+        if (skip) {
+            op.skipped++;
+        } else {
+            op.latency.push_back(end - begin);
+            op.blocks += rec.count;
+        }
+        op.traced.push_back(rec.duration);
+
+        errors       += err     ? 1 : 0;
+        tracedErrors += rec.err ? 1 : 0;
+        tracedEnd     = rec.time + rec.duration;
+    }
+
+    // Write back the cache, so that the replay time includes it.
+    if (writes && store->flush())
+        errors++;
+
+    double elapsed = (double)(nowNs() - start) / 1e9;
+    free(buffer);
+
+    size_t ops = 0;
+    for (auto &op : stats)
+        ops += op.latency.size();
+
+    double readMiB  = (double)(stats[(size_t)TraceOp::READ ].blocks * blockSize) / (1024 * 1024);
+    double writeMiB = (double)(stats[(size_t)TraceOp::WRITE].blocks * blockSize) / (1024 * 1024);
+
+    printf("replayed %lu operations in %.3f s (traced: %.3f s)%s\n",
+           ops, elapsed, (double)tracedEnd / 1e9, realTime ? ", original timing" : "");
+    printf("throughput: %.0f ops/s, read %.1f MiB/s, write %.1f MiB/s\n",
+           ops / elapsed, readMiB / elapsed, writeMiB / elapsed);
+    printf("errors: %lu (%lu in the trace)\n\n", errors, tracedErrors);
+
+    printf("%-8s %9s %9s %10s %10s %10s %10s %10s   %10s %10s\n",
+           "op", "count", "skipped", "p50 us", "p90 us", "p99 us", "p99.9 us", "max us",
+           "trace p50", "trace p99");
+
+    for (size_t i = 0; i < OP_COUNT; i++) {
+        OpStats &op = stats[i];
+        if (op.traced.empty())
+            continue;
+
+        std::sort(op.latency.begin(), op.latency.end());
+        std::sort(op.traced.begin(),  op.traced.end());
+
+        printf("%-8s %9lu %9lu %10.1f %10.1f %10.1f %10.1f %10.1f   %10.1f %10.1f\n",
+               OP_NAMES[i], op.latency.size(), op.skipped,
+               percentile(op.latency, 50), percentile(op.latency, 90),
+               percentile(op.latency, 99), percentile(op.latency, 99.9),
+               percentile(op.latency, 100),
+               percentile(op.traced, 50), percentile(op.traced, 99));
+    }
+
+    cache.reset();
+    free(cacheMemory);
+
+    return errors ? 1 : 0;
+}